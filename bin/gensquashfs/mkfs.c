@@ -7,8 +7,9 @@
 #include "mkfs.h"
 
 static int pack_files(sqfs_block_processor_t *data, fstree_t *fs,
-		      options_t *opt)
+		      manifest_t *manifest, options_t *opt)
 {
+	manifest_entry_t *ent;
 	sqfs_u64 filesize;
 	sqfs_file_t *file;
 	tree_node_t *node;
@@ -58,7 +59,18 @@ static int pack_files(sqfs_block_processor_t *data, fstree_t *fs,
 		if (opt->no_tail_packing && filesize > opt->cfg.block_size)
 			flags |= SQFS_BLK_DONT_FRAGMENT;
 
-		ret = write_data_from_file(path, data, &fi->inode, file, flags);
+		ent = NULL;
+		if (manifest != NULL) {
+			ent = manifest_add_file(manifest, fi);
+			if (ent == NULL) {
+				sqfs_destroy(file);
+				free(node_path);
+				return -1;
+			}
+		}
+
+		ret = write_data_from_file(path, data, &fi->inode, file, flags,
+					   ent == NULL ? NULL : ent->digest);
 		sqfs_destroy(file);
 		free(node_path);
 
@@ -110,6 +122,90 @@ static int relabel_tree_dfs(const char *filename, sqfs_xattr_writer_t *xwr,
 	return 0;
 }
 
+typedef struct {
+	const char *filename;
+	sqfs_xattr_writer_t *xwr;
+	void *selinux_handle;
+} xattr_ctx_t;
+
+static int record_xattrs(void *user, fstree_t *fs, tree_node_t *n,
+			 const dir_scan_xattr_t *xattr, size_t count)
+{
+	xattr_ctx_t *ctx = user;
+	char *path;
+	size_t i;
+	int ret;
+	(void)fs;
+
+	ret = sqfs_xattr_writer_begin(ctx->xwr, 0);
+	if (ret) {
+		sqfs_perror(ctx->filename, "recording xattr key-value pairs",
+			    ret);
+		return -1;
+	}
+
+	for (i = 0; i < count; ++i) {
+		if (xattr[i].value_len == 0)
+			continue;
+
+		ret = sqfs_xattr_writer_add(ctx->xwr, xattr[i].key,
+					    xattr[i].value,
+					    xattr[i].value_len);
+		if (ret) {
+			sqfs_perror(n->name, "storing xattr key-value pairs",
+				    ret);
+			return -1;
+		}
+	}
+
+	if (ctx->selinux_handle != NULL) {
+		path = fstree_get_path(n);
+		if (path == NULL) {
+			perror("getting absolute node path for SELinux "
+			       "relabeling");
+			return -1;
+		}
+
+		ret = selinux_relable_node(ctx->selinux_handle, ctx->xwr,
+					   n, path);
+		free(path);
+
+		if (ret)
+			return -1;
+	}
+
+	ret = sqfs_xattr_writer_end(ctx->xwr, &n->xattr_idx);
+	if (ret) {
+		sqfs_perror(ctx->filename, "flushing completed key-value pairs",
+			    ret);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int scan_directory(fstree_t *fs, options_t *opt,
+			  sqfs_xattr_writer_t *xwr, void *selinux_handle)
+{
+	scan_xattr_callback xattr_cb = NULL;
+	unsigned int flags = opt->dirscan_flags;
+	xattr_ctx_t ctx;
+
+	ctx.filename = opt->cfg.filename;
+	ctx.xwr = xwr;
+	ctx.selinux_handle = selinux_handle;
+
+	if (xwr != NULL && (opt->scan_xattr || selinux_handle != NULL))
+		xattr_cb = record_xattrs;
+
+	if (xattr_cb != NULL && opt->scan_xattr)
+		flags |= DIR_SCAN_READ_XATTR;
+
+	return fstree_from_subdir_parallel(fs, fs->root, opt->packdir, NULL,
+					   NULL, xattr_cb, &ctx, flags,
+					   opt->cfg.num_jobs);
+}
+
 static int read_fstree(fstree_t *fs, options_t *opt, sqfs_xattr_writer_t *xwr,
 		       void *selinux_handle)
 {
@@ -157,10 +253,8 @@ int main(int argc, char **argv)
 	}
 
 	if (opt.infile == NULL) {
-		if (fstree_from_dir(&sqfs.fs, sqfs.fs.root, opt.packdir,
-				    NULL, NULL, opt.dirscan_flags)) {
+		if (scan_directory(&sqfs.fs, &opt, sqfs.xwr, sehnd))
 			goto out;
-		}
 	} else {
 		if (read_fstree(&sqfs.fs, &opt, sqfs.xwr, sehnd))
 			goto out;
@@ -172,14 +266,7 @@ int main(int argc, char **argv)
 	if (fstree_post_process(&sqfs.fs))
 		goto out;
 
-	if (opt.infile == NULL) {
-		if (xattrs_from_dir(&sqfs.fs, opt.packdir, sehnd,
-				    sqfs.xwr, opt.scan_xattr)) {
-			goto out;
-		}
-	}
-
-	if (pack_files(sqfs.data, &sqfs.fs, &opt))
+	if (pack_files(sqfs.data, &sqfs.fs, sqfs.manifest, &opt))
 		goto out;
 
 	if (sqfs_writer_finish(&sqfs, &opt.cfg))
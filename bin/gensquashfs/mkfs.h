@@ -12,18 +12,6 @@
 #include "common.h"
 #include "fstree.h"
 
-#ifdef HAVE_SYS_XATTR_H
-#include <sys/xattr.h>
-
-#if defined(__APPLE__) && defined(__MACH__)
-#define llistxattr(path, list, size) \
-	listxattr(path, list, size, XATTR_NOFOLLOW)
-
-#define lgetxattr(path, name, value, size) \
-	getxattr(path, name, value, size, 0, XATTR_NOFOLLOW)
-#endif
-#endif
-
 #ifdef WITH_SELINUX
 #include <selinux/selinux.h>
 #include <selinux/label.h>
@@ -59,9 +47,6 @@ typedef struct {
 
 void process_command_line(options_t *opt, int argc, char **argv);
 
-int xattrs_from_dir(fstree_t *fs, const char *path, void *selinux_handle,
-		    sqfs_xattr_writer_t *xwr, bool scan_xattr);
-
 void *selinux_open_context_file(const char *filename);
 
 int selinux_relable_node(void *sehnd, sqfs_xattr_writer_t *xwr,
@@ -29,6 +29,7 @@ static struct option long_opts[] = {
 #endif
 	{ "one-file-system", no_argument, NULL, 'o' },
 	{ "exportable", no_argument, NULL, 'e' },
+	{ "manifest", required_argument, NULL, 'M' },
 	{ "no-tail-packing", no_argument, NULL, 'T' },
 	{ "force", no_argument, NULL, 'f' },
 	{ "quiet", no_argument, NULL, 'q' },
@@ -40,7 +41,7 @@ static struct option long_opts[] = {
 	{ NULL, 0, NULL, 0 },
 };
 
-static const char *short_opts = "F:D:X:c:b:B:d:u:g:j:Q:kxoefqThV"
+static const char *short_opts = "F:D:X:c:b:B:d:u:g:j:Q:M:kxoefqThV"
 #ifdef WITH_SELINUX
 "s:"
 #endif
@@ -72,7 +73,8 @@ static const char *help_string =
 "  --comp-extra, -X <options>  A comma separated list of extra options for\n"
 "                              the selected compressor. Specify 'help' to\n"
 "                              get a list of available options.\n"
-"  --num-jobs, -j <count>      Number of compressor jobs to create.\n"
+"  --num-jobs, -j <count>      Number of compressor jobs to create. Also\n"
+"                              used for scanning the --pack-dir tree.\n"
 "  --queue-backlog, -Q <count> Maximum number of data blocks in the thread\n"
 "                              worker queue before the packer starts waiting\n"
 "                              for the block processors to catch up.\n"
@@ -110,6 +112,9 @@ static const char *help_string =
 "  --one-file-system, -o       When using --pack-dir only, stay in local file\n"
 "                              system and do not cross mount points.\n"
 "  --exportable, -e            Generate an export table for NFS support.\n"
+"  --manifest, -M <file>       Write a manifest with the path, inode number,\n"
+"                              size and SHA-256 digest of every regular\n"
+"                              file to the given file.\n"
 "  --no-tail-packing, -T       Do not perform tail end packing on files that\n"
 "                              are larger than block size.\n"
 "  --force, -f                 Overwrite the output file if it exists.\n"
@@ -226,6 +231,9 @@ void process_command_line(options_t *opt, int argc, char **argv)
 				exit(EXIT_FAILURE);
 			}
 			break;
+		case 'M':
+			opt->cfg.manifest = optarg;
+			break;
 		case 'j':
 			opt->cfg.num_jobs = strtol(optarg, NULL, 0);
 			break;
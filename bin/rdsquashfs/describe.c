@@ -70,10 +70,8 @@ static int print_simple(const char *type, const sqfs_tree_node_t *n,
 	return 0;
 }
 
-int describe_tree(const sqfs_tree_node_t *root, const char *unpack_root)
+static int describe_node(const sqfs_tree_node_t *root, const char *unpack_root)
 {
-	const sqfs_tree_node_t *n;
-
 	if (!is_filename_sane((const char *)root->name, false)) {
 		fprintf(stderr, "Encountered illegal file name '%s'\n",
 			root->name);
@@ -119,15 +117,8 @@ int describe_tree(const sqfs_tree_node_t *root, const char *unpack_root)
 		return print_simple("nod", root, buffer);
 	}
 	case S_IFDIR:
-		if (root->name[0] != '\0') {
-			if (print_simple("dir", root, NULL))
-				return -1;
-		}
-
-		for (n = root->children; n != NULL; n = n->next) {
-			if (describe_tree(n, unpack_root))
-				return -1;
-		}
+		if (root->name[0] != '\0')
+			return print_simple("dir", root, NULL);
 		break;
 	default:
 		break;
@@ -135,3 +126,42 @@ int describe_tree(const sqfs_tree_node_t *root, const char *unpack_root)
 
 	return 0;
 }
+
+/*
+  The tree is streamed through an iterator instead of being loaded up front,
+  so only the directories leading to the current node are kept in memory and
+  output starts right away.
+ */
+int describe_tree(sqfs_dir_reader_t *dr, const sqfs_id_table_t *idtbl,
+		  const options_t *opt)
+{
+	const sqfs_tree_node_t *n;
+	sqfs_tree_iterator_t *it;
+	int ret;
+
+	ret = sqfs_tree_iterator_create(dr, idtbl, opt->cmdpath,
+					opt->rdtree_flags, &it);
+	if (ret)
+		goto fail;
+
+	for (;;) {
+		ret = sqfs_tree_iterator_next(it, &n);
+		if (ret > 0)
+			break;
+		if (ret < 0)
+			goto fail_it;
+
+		if (describe_node(n, opt->unpack_root)) {
+			sqfs_destroy(it);
+			return -1;
+		}
+	}
+
+	sqfs_destroy(it);
+	return 0;
+fail_it:
+	sqfs_destroy(it);
+fail:
+	sqfs_perror(opt->image_name, "reading filesystem tree", ret);
+	return -1;
+}
@@ -136,6 +136,7 @@ static int gen_file_list_dfs(const sqfs_tree_node_t *n)
 static int fill_files(sqfs_data_reader_t *data, int flags)
 {
 	int ret, openflags;
+	sqfs_u64 size;
 	ostream_t *fp;
 	size_t i;
 
@@ -149,6 +150,12 @@ static int fill_files(sqfs_data_reader_t *data, int flags)
 		if (fp == NULL)
 			return -1;
 
+		sqfs_inode_get_file_size(files[i].inode, &size);
+		if (ostream_set_size_hint(fp, size)) {
+			sqfs_destroy(fp);
+			return -1;
+		}
+
 		if (!(flags & UNPACK_QUIET))
 			printf("unpacking %s\n", files[i].path);
 
@@ -183,3 +190,71 @@ int fill_unpacked_files(size_t blk_sz, const sqfs_tree_node_t *root,
 	clear_file_list();
 	return status;
 }
+
+/*****************************************************************************/
+
+static int fill_files_parallel(data_pipeline_t *pl, int flags)
+{
+	int ret, openflags;
+	sqfs_u64 size;
+	ostream_t *fp;
+	size_t i;
+
+	openflags = OSTREAM_OPEN_OVERWRITE;
+
+	if (flags & UNPACK_NO_SPARSE)
+		openflags |= OSTREAM_OPEN_SPARSE;
+
+	for (i = 0; i < num_files; ++i) {
+		fp = ostream_open_file(files[i].path, openflags);
+		if (fp == NULL)
+			return -1;
+
+		sqfs_inode_get_file_size(files[i].inode, &size);
+		if (ostream_set_size_hint(fp, size)) {
+			sqfs_destroy(fp);
+			return -1;
+		}
+
+		if (!(flags & UNPACK_QUIET))
+			printf("unpacking %s\n", files[i].path);
+
+		ret = data_pipeline_dump_file(pl, fp, files[i].path,
+					      files[i].inode);
+		if (ret) {
+			sqfs_destroy(fp);
+			return -1;
+		}
+
+		if (data_pipeline_close(pl, fp))
+			return -1;
+	}
+
+	return data_pipeline_flush(pl);
+}
+
+int fill_unpacked_files_parallel(const sqfs_super_t *super, sqfs_file_t *file,
+				 sqfs_compressor_t *cmp,
+				 const sqfs_tree_node_t *root, int flags,
+				 size_t num_jobs)
+{
+	data_pipeline_t *pl;
+	int status = -1;
+
+	block_size = super->block_size;
+
+	if (gen_file_list_dfs(root))
+		goto out;
+
+	qsort(files, num_files, sizeof(files[0]), compare_files);
+
+	pl = data_pipeline_create(file, super, cmp, num_jobs);
+	if (pl == NULL)
+		goto out;
+
+	status = fill_files_parallel(pl, flags);
+	sqfs_destroy(pl);
+out:
+	clear_file_list();
+	return status;
+}
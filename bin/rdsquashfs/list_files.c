@@ -106,53 +106,100 @@ static void print_node_size(const sqfs_tree_node_t *n, char *buffer)
 	}
 }
 
-void list_files(const sqfs_tree_node_t *node)
+static void print_node(const sqfs_tree_node_t *n, int max_uid_chars,
+		       int max_gid_chars, int max_sz_chars)
 {
-	int i, max_uid_chars = 0, max_gid_chars = 0, max_sz_chars = 0;
 	char modestr[12], sizestr[32];
-	const sqfs_tree_node_t *n;
-
-	if (S_ISDIR(node->inode->base.mode)) {
-		for (n = node->children; n != NULL; n = n->next) {
-			i = count_int_chars(n->uid);
-			max_uid_chars = i > max_uid_chars ? i : max_uid_chars;
 
-			i = count_int_chars(n->gid);
-			max_gid_chars = i > max_gid_chars ? i : max_gid_chars;
+	mode_to_str(n->inode->base.mode, modestr);
+	print_node_size(n, sizestr);
 
-			print_node_size(n, sizestr);
-			i = strlen(sizestr);
-			max_sz_chars = i > max_sz_chars ? i : max_sz_chars;
-		}
+	printf("%s %*u/%-*u %*s %s", modestr,
+	       max_uid_chars, n->uid,
+	       max_gid_chars, n->gid,
+	       max_sz_chars, sizestr,
+	       n->name);
 
-		for (n = node->children; n != NULL; n = n->next) {
-			mode_to_str(n->inode->base.mode, modestr);
-			print_node_size(n, sizestr);
-
-			printf("%s %*u/%-*u %*s %s", modestr,
-			       max_uid_chars, n->uid,
-			       max_gid_chars, n->gid,
-			       max_sz_chars, sizestr,
-			       n->name);
-
-			if (S_ISLNK(n->inode->base.mode)) {
-				printf(" -> %s\n",
-				       (const char *)n->inode->extra);
-			} else {
-				fputc('\n', stdout);
-			}
-		}
+	if (S_ISLNK(n->inode->base.mode)) {
+		printf(" -> %s\n", (const char *)n->inode->extra);
 	} else {
-		mode_to_str(node->inode->base.mode, modestr);
-		print_node_size(node, sizestr);
+		fputc('\n', stdout);
+	}
+}
 
-		printf("%s %u/%u %s %s", modestr,
-		       node->uid, node->gid, sizestr, node->name);
+/*
+  The directory is walked twice, once to determine the column widths and
+  once to print the entries, so only a single entry is held in memory at
+  a time. The second pass is served from the meta data block cache.
+ */
+static int walk_dir(sqfs_dir_reader_t *dr, const sqfs_id_table_t *idtbl,
+		    const options_t *opt, bool print, int *max_uid_chars,
+		    int *max_gid_chars, int *max_sz_chars)
+{
+	char sizestr[32];
+	const sqfs_tree_node_t *n;
+	sqfs_tree_iterator_t *it;
+	int i, ret;
+
+	ret = sqfs_tree_iterator_create(dr, idtbl, opt->cmdpath,
+					opt->rdtree_flags, &it);
+	if (ret)
+		goto fail;
+
+	ret = sqfs_tree_iterator_next(it, &n);
+	if (ret < 0)
+		goto fail_it;
+
+	if (!S_ISDIR(n->inode->base.mode)) {
+		if (print)
+			print_node(n, 0, 0, 0);
+		sqfs_destroy(it);
+		return 0;
+	}
 
-		if (S_ISLNK(node->inode->base.mode)) {
-			printf(" -> %s\n", (const char *)node->inode->extra);
-		} else {
-			fputc('\n', stdout);
+	for (;;) {
+		ret = sqfs_tree_iterator_next(it, &n);
+		if (ret > 0)
+			break;
+		if (ret < 0)
+			goto fail_it;
+
+		if (print) {
+			print_node(n, *max_uid_chars, *max_gid_chars,
+				   *max_sz_chars);
+			continue;
 		}
+
+		i = count_int_chars(n->uid);
+		*max_uid_chars = i > *max_uid_chars ? i : *max_uid_chars;
+
+		i = count_int_chars(n->gid);
+		*max_gid_chars = i > *max_gid_chars ? i : *max_gid_chars;
+
+		print_node_size(n, sizestr);
+		i = strlen(sizestr);
+		*max_sz_chars = i > *max_sz_chars ? i : *max_sz_chars;
 	}
+
+	sqfs_destroy(it);
+	return 0;
+fail_it:
+	sqfs_destroy(it);
+fail:
+	sqfs_perror(opt->image_name, "reading filesystem tree", ret);
+	return -1;
+}
+
+int list_files(sqfs_dir_reader_t *dr, const sqfs_id_table_t *idtbl,
+	       const options_t *opt)
+{
+	int max_uid_chars = 0, max_gid_chars = 0, max_sz_chars = 0;
+
+	if (walk_dir(dr, idtbl, opt, false, &max_uid_chars,
+		     &max_gid_chars, &max_sz_chars)) {
+		return -1;
+	}
+
+	return walk_dir(dr, idtbl, opt, true, &max_uid_chars,
+			&max_gid_chars, &max_sz_chars);
 }
@@ -26,6 +26,7 @@ static struct option long_opts[] = {
 	{ "describe", no_argument, NULL, 'd' },
 	{ "chmod", no_argument, NULL, 'C' },
 	{ "chown", no_argument, NULL, 'O' },
+	{ "num-jobs", required_argument, NULL, 'j' },
 	{ "quiet", no_argument, NULL, 'q' },
 	{ "help", no_argument, NULL, 'h' },
 	{ "version", no_argument, NULL, 'V' },
@@ -82,6 +83,9 @@ static const char *help_string =
 "                            those store in the squashfs image.\n"
 "  --chown, -O               Change ownership of unpacked files to the\n"
 "                            UID/GID set in the squashfs image.\n"
+"  --num-jobs, -j <count>    Number of threads to use for decompressing\n"
+"                            file data and restoring file attributes\n"
+"                            while unpacking. Defaults to 1.\n"
 "  --quiet, -q               Do not print out progress while unpacking.\n"
 "\n"
 "  --help, -h                Print help text and exit.\n"
@@ -119,6 +123,7 @@ void process_command_line(options_t *opt, int argc, char **argv)
 	opt->cmdpath = NULL;
 	opt->unpack_root = NULL;
 	opt->image_name = NULL;
+	opt->num_jobs = 1;
 
 	for (;;) {
 		i = getopt_long(argc, argv, short_opts, long_opts, NULL);
@@ -186,6 +191,9 @@ void process_command_line(options_t *opt, int argc, char **argv)
 			opt->op = OP_UNPACK;
 			opt->cmdpath = get_path(opt->cmdpath, optarg);
 			break;
+		case 'j':
+			opt->num_jobs = strtol(optarg, NULL, 0);
+			break;
 		case 'q':
 			opt->flags |= UNPACK_QUIET;
 			break;
@@ -202,6 +210,9 @@ void process_command_line(options_t *opt, int argc, char **argv)
 		}
 	}
 
+	if (opt->num_jobs < 1)
+		opt->num_jobs = 1;
+
 	if (opt->op == OP_NONE) {
 		fputs("No operation specified\n", stderr);
 		goto fail_arg;
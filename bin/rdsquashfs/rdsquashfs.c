@@ -183,6 +183,24 @@ int main(int argc, char **argv)
 		goto out_data;
 	}
 
+	/* these walk the tree incrementally instead of loading it first */
+	switch (opt.op) {
+	case OP_LS:
+		if (list_files(dirrd, idtbl, &opt) == 0)
+			status = EXIT_SUCCESS;
+		goto out_data;
+	case OP_STAT:
+		if (stat_file(dirrd, idtbl, &opt) == 0)
+			status = EXIT_SUCCESS;
+		goto out_data;
+	case OP_DESCRIBE:
+		if (describe_tree(dirrd, idtbl, &opt) == 0)
+			status = EXIT_SUCCESS;
+		goto out_data;
+	default:
+		break;
+	}
+
 	ret = sqfs_dir_reader_get_full_hierarchy(dirrd, idtbl, opt.cmdpath,
 						 opt.rdtree_flags, &n);
 	if (ret) {
@@ -191,13 +209,6 @@ int main(int argc, char **argv)
 	}
 
 	switch (opt.op) {
-	case OP_LS:
-		list_files(n);
-		break;
-	case OP_STAT:
-		if (stat_file(n))
-			goto out;
-		break;
 	case OP_CAT: {
 		ostream_t *fp;
 
@@ -237,14 +248,18 @@ int main(int argc, char **argv)
 		if (restore_fstree(n, opt.flags))
 			goto out;
 
-		if (fill_unpacked_files(super.block_size, n, data, opt.flags))
+		if (opt.num_jobs > 1) {
+			if (fill_unpacked_files_parallel(&super, file, cmp, n,
+							 opt.flags,
+							 opt.num_jobs)) {
+				goto out;
+			}
+		} else if (fill_unpacked_files(super.block_size, n, data,
+					       opt.flags)) {
 			goto out;
+		}
 
-		if (update_tree_attribs(xattr, n, opt.flags))
-			goto out;
-		break;
-	case OP_DESCRIBE:
-		if (describe_tree(n, opt.unpack_root))
+		if (update_tree_attribs(xattr, n, opt.flags, opt.num_jobs))
 			goto out;
 		break;
 	case OP_RDATTR:
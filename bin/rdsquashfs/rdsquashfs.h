@@ -55,24 +55,34 @@ typedef struct {
 	int op;
 	int rdtree_flags;
 	int flags;
+	long num_jobs;
 	char *cmdpath;
 	const char *unpack_root;
 	const char *image_name;
 } options_t;
 
-void list_files(const sqfs_tree_node_t *node);
+int list_files(sqfs_dir_reader_t *dr, const sqfs_id_table_t *idtbl,
+	       const options_t *opt);
 
-int stat_file(const sqfs_tree_node_t *node);
+int stat_file(sqfs_dir_reader_t *dr, const sqfs_id_table_t *idtbl,
+	      const options_t *opt);
 
 int restore_fstree(sqfs_tree_node_t *root, int flags);
 
 int update_tree_attribs(sqfs_xattr_reader_t *xattr,
-			const sqfs_tree_node_t *root, int flags);
+			const sqfs_tree_node_t *root, int flags,
+			size_t num_jobs);
 
 int fill_unpacked_files(size_t blk_sz, const sqfs_tree_node_t *root,
 			sqfs_data_reader_t *data, int flags);
 
-int describe_tree(const sqfs_tree_node_t *root, const char *unpack_root);
+int fill_unpacked_files_parallel(const sqfs_super_t *super, sqfs_file_t *file,
+				 sqfs_compressor_t *cmp,
+				 const sqfs_tree_node_t *root, int flags,
+				 size_t num_jobs);
+
+int describe_tree(sqfs_dir_reader_t *dr, const sqfs_id_table_t *idtbl,
+		  const options_t *opt);
 
 int dump_xattrs(sqfs_xattr_reader_t *xattr, const sqfs_inode_generic_t *inode);
 
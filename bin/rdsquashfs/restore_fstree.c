@@ -5,6 +5,8 @@
  * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
  */
 #include "rdsquashfs.h"
+#include "threadpool.h"
+#include "util.h"
 
 #ifdef _WIN32
 static int create_node(const sqfs_tree_node_t *n, const char *name, int flags)
@@ -45,33 +47,85 @@ fail:
 	free(wpath);
 	return -1;
 }
+
+static int create_node_dfs(int dirfd, const sqfs_tree_node_t *n, int flags)
+{
+	const sqfs_tree_node_t *c;
+	char *name;
+	int ret;
+	(void)dirfd;
+
+	if (!is_filename_sane((const char *)n->name, true)) {
+		fprintf(stderr, "Found an entry named '%s', skipping.\n",
+			n->name);
+		return 0;
+	}
+
+	name = sqfs_tree_node_get_path(n);
+	if (name == NULL) {
+		fprintf(stderr, "Constructing full path for '%s': %s\n",
+			(const char *)n->name, strerror(errno));
+		return -1;
+	}
+
+	ret = canonicalize_name(name);
+	assert(ret == 0);
+
+	if (!(flags & UNPACK_QUIET))
+		printf("creating %s\n", name);
+
+	ret = create_node(n, name, flags);
+	free(name);
+	if (ret)
+		return -1;
+
+	if (S_ISDIR(n->inode->base.mode)) {
+		for (c = n->children; c != NULL; c = c->next) {
+			if (create_node_dfs(AT_FDCWD, c, flags))
+				return -1;
+		}
+	}
+	return 0;
+}
 #else
-static int create_node(const sqfs_tree_node_t *n, const char *name, int flags)
+static void node_error(const sqfs_tree_node_t *n, const char *what)
 {
+	int err = errno;
+	char *path;
+
+	path = sqfs_tree_node_get_path(n);
+	if (path != NULL)
+		canonicalize_name(path);
+
+	fprintf(stderr, "%s %s: %s\n", what,
+		path == NULL ? (const char *)n->name : path, strerror(err));
+	free(path);
+}
+
+static int create_node(int dirfd, const sqfs_tree_node_t *n, int flags)
+{
+	const char *name = (const char *)n->name;
 	sqfs_u32 devno;
 	int fd, mode;
 
 	switch (n->inode->base.mode & S_IFMT) {
 	case S_IFDIR:
-		if (mkdir(name, 0755) && errno != EEXIST) {
-			fprintf(stderr, "mkdir %s: %s\n",
-				name, strerror(errno));
+		if (mkdirat(dirfd, name, 0755) && errno != EEXIST) {
+			node_error(n, "mkdir");
 			return -1;
 		}
 		break;
 	case S_IFLNK:
-		if (symlink((const char *)n->inode->extra, name)) {
-			fprintf(stderr, "ln -s %s %s: %s\n",
-				(const char *)n->inode->extra, name,
-				strerror(errno));
+		if (symlinkat((const char *)n->inode->extra, dirfd, name)) {
+			node_error(n, "creating symlink");
 			return -1;
 		}
 		break;
 	case S_IFSOCK:
 	case S_IFIFO:
-		if (mknod(name, (n->inode->base.mode & S_IFMT) | 0700, 0)) {
-			fprintf(stderr, "creating %s: %s\n",
-				name, strerror(errno));
+		if (mknodat(dirfd, name,
+			    (n->inode->base.mode & S_IFMT) | 0700, 0)) {
+			node_error(n, "creating");
 			return -1;
 		}
 		break;
@@ -84,9 +138,8 @@ static int create_node(const sqfs_tree_node_t *n, const char *name, int flags)
 			devno = n->inode->data.dev.devno;
 		}
 
-		if (mknod(name, n->inode->base.mode & S_IFMT, devno)) {
-			fprintf(stderr, "creating device %s: %s\n",
-				name, strerror(errno));
+		if (mknodat(dirfd, name, n->inode->base.mode & S_IFMT, devno)) {
+			node_error(n, "creating device");
 			return -1;
 		}
 		break;
@@ -97,11 +150,10 @@ static int create_node(const sqfs_tree_node_t *n, const char *name, int flags)
 			mode = 0644;
 		}
 
-		fd = open(name, O_WRONLY | O_CREAT | O_EXCL, mode);
+		fd = openat(dirfd, name, O_WRONLY | O_CREAT | O_EXCL, mode);
 
 		if (fd < 0) {
-			fprintf(stderr, "creating %s: %s\n",
-				name, strerror(errno));
+			node_error(n, "creating");
 			return -1;
 		}
 
@@ -113,13 +165,16 @@ static int create_node(const sqfs_tree_node_t *n, const char *name, int flags)
 
 	return 0;
 }
-#endif
 
-static int create_node_dfs(const sqfs_tree_node_t *n, int flags)
+/*
+  Nodes are created relative to a file descriptor of the parent directory,
+  so the kernel does not have to walk the full path for every single one.
+ */
+static int create_node_dfs(int dirfd, const sqfs_tree_node_t *n, int flags)
 {
 	const sqfs_tree_node_t *c;
 	char *name;
-	int ret;
+	int ret, fd;
 
 	if (!is_filename_sane((const char *)n->name, true)) {
 		fprintf(stderr, "Found an entry named '%s', skipping.\n",
@@ -127,43 +182,77 @@ static int create_node_dfs(const sqfs_tree_node_t *n, int flags)
 		return 0;
 	}
 
-	name = sqfs_tree_node_get_path(n);
-	if (name == NULL) {
-		fprintf(stderr, "Constructing full path for '%s': %s\n",
-			(const char *)n->name, strerror(errno));
-		return -1;
-	}
+	if (!(flags & UNPACK_QUIET)) {
+		name = sqfs_tree_node_get_path(n);
+		if (name == NULL) {
+			fprintf(stderr, "Constructing full path for '%s': "
+				"%s\n", (const char *)n->name,
+				strerror(errno));
+			return -1;
+		}
 
-	ret = canonicalize_name(name);
-	assert(ret == 0);
+		ret = canonicalize_name(name);
+		assert(ret == 0);
 
-	if (!(flags & UNPACK_QUIET))
 		printf("creating %s\n", name);
+		free(name);
+	}
 
-	ret = create_node(n, name, flags);
-	free(name);
-	if (ret)
+	if (create_node(dirfd, n, flags))
 		return -1;
 
-	if (S_ISDIR(n->inode->base.mode)) {
-		for (c = n->children; c != NULL; c = c->next) {
-			if (create_node_dfs(c, flags))
-				return -1;
+	if (!S_ISDIR(n->inode->base.mode) || n->children == NULL)
+		return 0;
+
+	fd = openat(dirfd, (const char *)n->name,
+		    O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0) {
+		node_error(n, "opening");
+		return -1;
+	}
+
+	for (c = n->children; c != NULL; c = c->next) {
+		if (create_node_dfs(fd, c, flags)) {
+			close(fd);
+			return -1;
 		}
 	}
+
+	close(fd);
 	return 0;
 }
+#endif
 
 #ifdef HAVE_SYS_XATTR_H
-static int set_xattr(const char *path, sqfs_xattr_reader_t *xattr,
-		     const sqfs_tree_node_t *n)
-{
-	sqfs_xattr_value_t *value;
+typedef struct xattr_list_t {
+	struct xattr_list_t *next;
+	const sqfs_tree_node_t *node;
 	sqfs_xattr_entry_t *key;
+	sqfs_xattr_value_t *value;
+} xattr_list_t;
+
+static void free_xattrs(xattr_list_t *list)
+{
+	xattr_list_t *ent;
+
+	while (list != NULL) {
+		ent = list;
+		list = list->next;
+
+		sqfs_free(ent->key);
+		sqfs_free(ent->value);
+		free(ent);
+	}
+}
+
+/* read the key-value pairs of a node and append them to a list */
+static int read_xattrs(sqfs_xattr_reader_t *xattr, const sqfs_tree_node_t *n,
+		       xattr_list_t ***tail)
+{
 	sqfs_xattr_id_t desc;
+	xattr_list_t *ent;
 	sqfs_u32 index;
 	size_t i;
-	int ret;
 
 	sqfs_inode_get_xattr_index(n->inode, &index);
 
@@ -181,32 +270,67 @@ static int set_xattr(const char *path, sqfs_xattr_reader_t *xattr,
 	}
 
 	for (i = 0; i < desc.count; ++i) {
-		if (sqfs_xattr_reader_read_key(xattr, &key)) {
+		ent = calloc(1, sizeof(*ent));
+		if (ent == NULL) {
+			perror("reading xattrs");
+			return -1;
+		}
+
+		ent->node = n;
+		**tail = ent;
+		*tail = &ent->next;
+
+		if (sqfs_xattr_reader_read_key(xattr, &ent->key)) {
 			fputs("Error reading xattr key\n", stderr);
 			return -1;
 		}
 
-		if (sqfs_xattr_reader_read_value(xattr, key, &value)) {
+		if (sqfs_xattr_reader_read_value(xattr, ent->key,
+						 &ent->value)) {
 			fputs("Error reading xattr value\n", stderr);
-			sqfs_free(key);
 			return -1;
 		}
+	}
 
-		ret = lsetxattr(path, (const char *)key->key,
-				value->value, value->size, 0);
-		if (ret) {
-			fprintf(stderr, "setting xattr '%s' on %s: %s\n",
-				key->key, path, strerror(errno));
-		}
+	return 0;
+}
 
-		sqfs_free(key);
-		sqfs_free(value);
-		if (ret)
+/* set the leading entries of a list that belong to a node */
+static int apply_xattrs(const char *path, const sqfs_tree_node_t *n,
+			const xattr_list_t **list)
+{
+	const xattr_list_t *ent;
+
+	for (ent = *list; ent != NULL && ent->node == n; ent = ent->next) {
+		if (lsetxattr(path, (const char *)ent->key->key,
+			      ent->value->value, ent->value->size, 0)) {
+			fprintf(stderr, "setting xattr '%s' on %s: %s\n",
+				ent->key->key, path, strerror(errno));
 			return -1;
+		}
 	}
 
+	*list = ent;
 	return 0;
 }
+
+static int set_xattr(const char *path, sqfs_xattr_reader_t *xattr,
+		     const sqfs_tree_node_t *n)
+{
+	xattr_list_t *list = NULL, **tail = &list;
+	const xattr_list_t *it;
+	int ret;
+
+	ret = read_xattrs(xattr, n, &tail);
+
+	if (ret == 0) {
+		it = list;
+		ret = apply_xattrs(path, n, &it);
+	}
+
+	free_xattrs(list);
+	return ret;
+}
 #endif
 
 static int set_attribs(sqfs_xattr_reader_t *xattr,
@@ -293,11 +417,11 @@ int restore_fstree(sqfs_tree_node_t *root, int flags)
 
 	if (S_ISDIR(root->inode->base.mode)) {
 		for (n = root->children; n != NULL; n = n->next) {
-			if (create_node_dfs(n, flags))
+			if (create_node_dfs(AT_FDCWD, n, flags))
 				return -1;
 		}
 	} else {
-		if (create_node_dfs(root, flags))
+		if (create_node_dfs(AT_FDCWD, root, flags))
 			return -1;
 	}
 
@@ -305,8 +429,409 @@ int restore_fstree(sqfs_tree_node_t *root, int flags)
 	return 0;
 }
 
+#ifndef _WIN32
+/*
+  Attributes are restored by a thread pool, one directory at a time. A job
+  sets the attributes of all non-directory entries of a directory relative
+  to a file descriptor of it, and then those of the directory itself.
+  A job is only submitted once all jobs of its sub directories are done,
+  so a directory is finalized after everything below it.
+ */
+typedef struct {
+	const sqfs_tree_node_t *node;
+
+	/* index of the job for the parent directory */
+	size_t parent;
+
+	/* number of sub directory jobs that are not done yet */
+	size_t pending;
+
+	/* the root is not changed itself, only the entries below it */
+	bool is_root;
+
+#ifdef HAVE_SYS_XATTR_H
+	/* pre-loaded by the main thread, the reader is not thread safe */
+	xattr_list_t *xattrs;
+#endif
+} dir_job_t;
+
+typedef struct {
+	dir_job_t *jobs;
+	size_t num_jobs;
+	size_t max_jobs;
+} job_list_t;
+
+static char *join_path(const char *dir, const char *name)
+{
+	size_t dlen, nlen;
+	char *path;
+
+	if (strcmp(dir, ".") == 0)
+		return strdup(name);
+
+	dlen = strlen(dir);
+	nlen = strlen(name);
+
+	path = malloc(dlen + nlen + 2);
+	if (path == NULL)
+		return NULL;
+
+	memcpy(path, dir, dlen);
+	path[dlen] = '/';
+	memcpy(path + dlen + 1, name, nlen + 1);
+	return path;
+}
+
+static void attrib_error(const char *what, const char *dir, const char *name)
+{
+	int err = errno;
+	char *path = join_path(dir, name);
+
+	fprintf(stderr, "%s %s: %s\n", what, path == NULL ? name : path,
+		strerror(err));
+	free(path);
+}
+
+static int set_attribs_at(int dirfd, const char *dirpath,
+			  const sqfs_tree_node_t *n, int flags,
+			  const void **xattrs)
+{
+	const char *name = (const char *)n->name;
+	struct timespec times[2];
+#ifdef HAVE_SYS_XATTR_H
+	const xattr_list_t **list = (const xattr_list_t **)xattrs;
+	char *path;
+	int ret;
+
+	if (*list != NULL && (*list)->node == n) {
+		path = join_path(dirpath, name);
+		if (path == NULL) {
+			perror(name);
+			return -1;
+		}
+
+		ret = apply_xattrs(path, n, list);
+		free(path);
+
+		if (ret)
+			return -1;
+	}
+#else
+	(void)xattrs;
+#endif
+
+	if (flags & UNPACK_SET_TIMES) {
+		memset(times, 0, sizeof(times));
+		times[0].tv_sec = n->inode->base.mod_time;
+		times[1].tv_sec = n->inode->base.mod_time;
+
+		if (utimensat(dirfd, name, times, AT_SYMLINK_NOFOLLOW)) {
+			attrib_error("setting timestamp on", dirpath, name);
+			return -1;
+		}
+	}
+
+	if (flags & UNPACK_CHOWN) {
+		if (fchownat(dirfd, name, n->uid, n->gid,
+			     AT_SYMLINK_NOFOLLOW)) {
+			attrib_error("chown", dirpath, name);
+			return -1;
+		}
+	}
+
+	if (flags & UNPACK_CHMOD && !S_ISLNK(n->inode->base.mode)) {
+		if (fchmodat(dirfd, name, n->inode->base.mode & ~S_IFMT, 0)) {
+			attrib_error("chmod", dirpath, name);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int set_dir_attribs(int fd, const char *path,
+			   const sqfs_tree_node_t *n, int flags,
+			   const void **xattrs)
+{
+	struct timespec times[2];
+
+#ifdef HAVE_SYS_XATTR_H
+	if (apply_xattrs(path, n, (const xattr_list_t **)xattrs))
+		return -1;
+#else
+	(void)xattrs;
+#endif
+
+	if (flags & UNPACK_SET_TIMES) {
+		memset(times, 0, sizeof(times));
+		times[0].tv_sec = n->inode->base.mod_time;
+		times[1].tv_sec = n->inode->base.mod_time;
+
+		if (futimens(fd, times)) {
+			fprintf(stderr, "setting timestamp on %s: %s\n",
+				path, strerror(errno));
+			return -1;
+		}
+	}
+
+	if (flags & UNPACK_CHOWN) {
+		if (fchown(fd, n->uid, n->gid)) {
+			fprintf(stderr, "chown %s: %s\n",
+				path, strerror(errno));
+			return -1;
+		}
+	}
+
+	if (flags & UNPACK_CHMOD) {
+		if (fchmod(fd, n->inode->base.mode & ~S_IFMT)) {
+			fprintf(stderr, "chmod %s: %s\n",
+				path, strerror(errno));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int attrib_worker(void *user, void *work_item)
+{
+	const sqfs_tree_node_t *c;
+	dir_job_t *job = work_item;
+	int flags = *((int *)user);
+	const void *xattrs = NULL;
+	int fd, ret = -1;
+	char *path;
+
+#ifdef HAVE_SYS_XATTR_H
+	xattrs = job->xattrs;
+#endif
+
+	if (job->is_root) {
+		path = strdup(".");
+	} else {
+		path = sqfs_tree_node_get_path(job->node);
+		if (path != NULL)
+			canonicalize_name(path);
+	}
+
+	if (path == NULL) {
+		fprintf(stderr, "Reconstructing full path: %s\n",
+			strerror(errno));
+		return -1;
+	}
+
+	fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "opening %s: %s\n", path, strerror(errno));
+		goto out;
+	}
+
+	for (c = job->node->children; c != NULL; c = c->next) {
+		if (S_ISDIR(c->inode->base.mode))
+			continue;
+
+		if (!is_filename_sane((const char *)c->name, true))
+			continue;
+
+		if (set_attribs_at(fd, path, c, flags, &xattrs))
+			goto out_fd;
+	}
+
+	if (!job->is_root) {
+		if (set_dir_attribs(fd, path, job->node, flags, &xattrs))
+			goto out_fd;
+	}
+
+	ret = 0;
+out_fd:
+	close(fd);
+out:
+	free(path);
+	return ret;
+}
+
+static int collect_dirs(job_list_t *list, const sqfs_tree_node_t *n,
+			size_t parent, bool is_root)
+{
+	const sqfs_tree_node_t *c;
+	size_t new_sz, idx;
+	dir_job_t *new;
+
+	if (list->num_jobs == list->max_jobs) {
+		new_sz = list->max_jobs ? list->max_jobs * 2 : 256;
+		new = realloc(list->jobs, sizeof(list->jobs[0]) * new_sz);
+
+		if (new == NULL) {
+			perror("collecting directory list");
+			return -1;
+		}
+
+		list->jobs = new;
+		list->max_jobs = new_sz;
+	}
+
+	idx = list->num_jobs++;
+	memset(&list->jobs[idx], 0, sizeof(list->jobs[idx]));
+	list->jobs[idx].node = n;
+	list->jobs[idx].parent = parent;
+	list->jobs[idx].is_root = is_root;
+
+	for (c = n->children; c != NULL; c = c->next) {
+		if (!S_ISDIR(c->inode->base.mode))
+			continue;
+
+		if (!is_filename_sane((const char *)c->name, true))
+			continue;
+
+		list->jobs[idx].pending += 1;
+
+		if (collect_dirs(list, c, idx, false))
+			return -1;
+	}
+
+	return 0;
+}
+
+static int prepare_job(sqfs_xattr_reader_t *xattr, dir_job_t *job, int flags)
+{
+#ifdef HAVE_SYS_XATTR_H
+	xattr_list_t **tail = &job->xattrs;
+	const sqfs_tree_node_t *c;
+
+	if (!(flags & UNPACK_SET_XATTR) || xattr == NULL)
+		return 0;
+
+	for (c = job->node->children; c != NULL; c = c->next) {
+		if (S_ISDIR(c->inode->base.mode))
+			continue;
+
+		if (!is_filename_sane((const char *)c->name, true))
+			continue;
+
+		if (read_xattrs(xattr, c, &tail))
+			return -1;
+	}
+
+	if (!job->is_root)
+		return read_xattrs(xattr, job->node, &tail);
+#else
+	(void)xattr; (void)job; (void)flags;
+#endif
+	return 0;
+}
+
+static void release_job(dir_job_t *job)
+{
+#ifdef HAVE_SYS_XATTR_H
+	free_xattrs(job->xattrs);
+	job->xattrs = NULL;
+#else
+	(void)job;
+#endif
+}
+
+static int update_attribs_parallel(sqfs_xattr_reader_t *xattr,
+				   const sqfs_tree_node_t *root, int flags,
+				   size_t num_jobs)
+{
+	size_t i, done = 0, in_flight = 0, max_in_flight, num_ready = 0;
+	job_list_t list = { NULL, 0, 0 };
+	size_t *ready = NULL;
+	thread_pool_t *pool;
+	dir_job_t *job;
+	int status = -1;
+
+	if (collect_dirs(&list, root, 0, true))
+		goto out_list;
+
+	ready = alloc_array(sizeof(ready[0]), list.num_jobs);
+	if (ready == NULL) {
+		perror("collecting directory list");
+		goto out_list;
+	}
+
+	for (i = 0; i < list.num_jobs; ++i) {
+		if (list.jobs[i].pending == 0)
+			ready[num_ready++] = i;
+	}
+
+	if (num_jobs > 1) {
+		pool = thread_pool_create(num_jobs, attrib_worker);
+	} else {
+		pool = thread_pool_create_serial(attrib_worker);
+	}
+
+	if (pool == NULL) {
+		perror("creating thread pool");
+		goto out_list;
+	}
+
+	for (i = 0; i < pool->get_worker_count(pool); ++i)
+		pool->set_worker_ptr(pool, i, &flags);
+
+	max_in_flight = 4 * pool->get_worker_count(pool);
+
+	while (done < list.num_jobs) {
+		while (num_ready > 0 && in_flight < max_in_flight) {
+			job = list.jobs + ready[--num_ready];
+
+			if (prepare_job(xattr, job, flags))
+				goto out_pool;
+
+			if (pool->submit(pool, job)) {
+				release_job(job);
+				goto out_pool;
+			}
+
+			in_flight += 1;
+		}
+
+		job = pool->dequeue(pool);
+		if (job == NULL)
+			goto out_pool;
+
+		in_flight -= 1;
+		done += 1;
+		release_job(job);
+
+		if (pool->get_status(pool) != 0)
+			goto out_pool;
+
+		if (job->is_root)
+			continue;
+
+		i = job->parent;
+		list.jobs[i].pending -= 1;
+
+		if (list.jobs[i].pending == 0)
+			ready[num_ready++] = i;
+	}
+
+	status = 0;
+out_pool:
+	while (in_flight > 0) {
+		job = pool->dequeue(pool);
+		if (job == NULL)
+			break;
+
+		in_flight -= 1;
+		release_job(job);
+	}
+
+	pool->destroy(pool);
+out_list:
+	for (i = 0; i < list.num_jobs; ++i)
+		release_job(list.jobs + i);
+
+	free(list.jobs);
+	free(ready);
+	return status;
+}
+#endif
+
 int update_tree_attribs(sqfs_xattr_reader_t *xattr,
-			const sqfs_tree_node_t *root, int flags)
+			const sqfs_tree_node_t *root, int flags,
+			size_t num_jobs)
 {
 	const sqfs_tree_node_t *n;
 
@@ -315,6 +840,13 @@ int update_tree_attribs(sqfs_xattr_reader_t *xattr,
 		return 0;
 	}
 
+#ifndef _WIN32
+	if (S_ISDIR(root->inode->base.mode))
+		return update_attribs_parallel(xattr, root, flags, num_jobs);
+#else
+	(void)num_jobs;
+#endif
+
 	if (S_ISDIR(root->inode->base.mode)) {
 		for (n = root->children; n != NULL; n = n->next) {
 			if (set_attribs(xattr, n, flags))
@@ -23,7 +23,7 @@ static const char *inode_types[] = {
 	[SQFS_INODE_EXT_SOCKET] = "extended socket",
 };
 
-int stat_file(const sqfs_tree_node_t *node)
+static int stat_node(const sqfs_tree_node_t *node)
 {
 	sqfs_u32 xattr_idx = 0xFFFFFFFF, devno = 0, link_size = 0;
 	const sqfs_inode_generic_t *inode = node->inode;
@@ -183,3 +183,32 @@ int stat_file(const sqfs_tree_node_t *node)
 	}
 	return 0;
 }
+
+int stat_file(sqfs_dir_reader_t *dr, const sqfs_id_table_t *idtbl,
+	      const options_t *opt)
+{
+	const sqfs_tree_node_t *n;
+	sqfs_tree_iterator_t *it;
+	int ret;
+
+	/* only the first node is needed, a directory is not read any further */
+	ret = sqfs_tree_iterator_create(dr, idtbl, opt->cmdpath,
+					opt->rdtree_flags, &it);
+	if (ret)
+		goto fail;
+
+	ret = sqfs_tree_iterator_next(it, &n);
+	if (ret > 0)
+		ret = SQFS_ERROR_NO_ENTRY;
+	if (ret < 0) {
+		sqfs_destroy(it);
+		goto fail;
+	}
+
+	ret = stat_node(n);
+	sqfs_destroy(it);
+	return ret;
+fail:
+	sqfs_perror(opt->image_name, "reading filesystem tree", ret);
+	return -1;
+}
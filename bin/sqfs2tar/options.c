@@ -14,12 +14,13 @@ static struct option long_opts[] = {
 	{ "no-skip", no_argument, NULL, 's' },
 	{ "no-xattr", no_argument, NULL, 'X' },
 	{ "no-hard-links", no_argument, NULL, 'L' },
+	{ "num-jobs", required_argument, NULL, 'j' },
 	{ "help", no_argument, NULL, 'h' },
 	{ "version", no_argument, NULL, 'V' },
 	{ NULL, 0, NULL, 0 },
 };
 
-static const char *short_opts = "c:d:kr:sXLhV";
+static const char *short_opts = "c:d:kr:sXLj:hV";
 
 static const char *usagestr =
 "Usage: sqfs2tar [OPTIONS...] <sqfsfile>\n"
@@ -59,6 +60,10 @@ static const char *usagestr =
 "                            archive. By default, it is simply skipped\n"
 "                            and a warning is written to stderr.\n"
 "\n"
+"  --num-jobs, -j <count>    Number of threads to use for decompressing\n"
+"                            file data and for compressing the output\n"
+"                            tarball. Defaults to 1.\n"
+"\n"
 "  --help, -h                Print help text and exit.\n"
 "  --version, -V             Print version information and exit.\n"
 "\n"
@@ -74,6 +79,7 @@ char **subdirs = NULL;
 size_t num_subdirs = 0;
 static size_t max_subdirs = 0;
 int compressor = 0;
+long num_jobs = 1;
 
 const char *filename = NULL;
 
@@ -160,6 +166,11 @@ void process_args(int argc, char **argv)
 		case 'L':
 			no_links = true;
 			break;
+		case 'j':
+			num_jobs = strtol(optarg, NULL, 0);
+			if (num_jobs < 1)
+				num_jobs = 1;
+			break;
 		case 'h':
 			fputs(usagestr, stdout);
 
@@ -10,6 +10,8 @@ sqfs_xattr_reader_t *xr;
 sqfs_data_reader_t *data;
 sqfs_super_t super;
 ostream_t *out_file = NULL;
+data_pipeline_t *pipeline = NULL;
+ostream_t *pipeline_out = NULL;
 
 static sqfs_file_t *file;
 
@@ -108,6 +110,7 @@ static sqfs_tree_node_t *tree_merge(sqfs_tree_node_t *lhs,
 int main(int argc, char **argv)
 {
 	sqfs_tree_node_t *root = NULL, *subtree;
+	sqfs_tree_iterator_t *it;
 	int flags, ret, status = EXIT_FAILURE;
 	sqfs_compressor_config_t cfg;
 	sqfs_compressor_t *cmp;
@@ -124,7 +127,8 @@ int main(int argc, char **argv)
 	}
 
 	if (compressor > 0) {
-		out_file = ostream_compressor_create(out_file, compressor);
+		out_file = ostream_compressor_create(out_file, compressor,
+						     num_jobs);
 		if (out_file == NULL)
 			goto out_dirs;
 	}
@@ -157,6 +161,18 @@ int main(int argc, char **argv)
 		goto out_fd;
 	}
 
+	if (num_jobs > 1) {
+		pipeline = data_pipeline_create(file, &super, cmp, num_jobs);
+		if (pipeline == NULL)
+			goto out_cmp;
+
+		pipeline_out = out_file;
+
+		out_file = data_pipeline_ostream_create(pipeline, out_file);
+		if (out_file == NULL)
+			goto out_cmp;
+	}
+
 	idtbl = sqfs_id_table_create(0);
 
 	if (idtbl == NULL) {
@@ -205,18 +221,30 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (num_subdirs == 0) {
-		ret = sqfs_dir_reader_get_full_hierarchy(dr, idtbl, NULL,
-							 0, &root);
+	if (num_subdirs <= 1) {
+		flags = 0;
+
+		if (keep_as_dir && num_subdirs > 0)
+			flags = SQFS_TREE_STORE_PARENTS;
+
+		ret = sqfs_tree_iterator_create(dr, idtbl,
+						num_subdirs > 0 ?
+						subdirs[0] : NULL,
+						flags, &it);
 		if (ret) {
-			sqfs_perror(filename, "loading filesystem tree", ret);
+			sqfs_perror(num_subdirs > 0 ? subdirs[0] : filename,
+				    "loading filesystem tree", ret);
 			goto out;
 		}
-	} else {
-		flags = 0;
 
-		if (keep_as_dir || num_subdirs > 1)
-			flags = SQFS_TREE_STORE_PARENTS;
+		ret = write_tree_stream(it);
+		sqfs_destroy(it);
+
+		if (ret)
+			goto out;
+	} else {
+		/* multiple sub trees need to be merged before writing them */
+		flags = SQFS_TREE_STORE_PARENTS;
 
 		for (i = 0; i < num_subdirs; ++i) {
 			ret = sqfs_dir_reader_get_full_hierarchy(dr, idtbl,
@@ -235,10 +263,10 @@ int main(int argc, char **argv)
 				root = tree_merge(root, subtree);
 			}
 		}
-	}
 
-	if (write_tree(root))
-		goto out;
+		if (write_tree(root))
+			goto out;
+	}
 
 	if (terminate_archive())
 		goto out;
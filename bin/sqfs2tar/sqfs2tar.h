@@ -29,6 +29,7 @@ extern char *root_becomes;
 extern char **subdirs;
 extern size_t num_subdirs;
 extern int compressor;
+extern long num_jobs;
 
 extern const char *filename;
 
@@ -40,6 +41,10 @@ extern sqfs_data_reader_t *data;
 extern sqfs_super_t super;
 extern ostream_t *out_file;
 
+/* if set, out_file queues into the pipeline, in front of pipeline_out */
+extern data_pipeline_t *pipeline;
+extern ostream_t *pipeline_out;
+
 char *assemble_tar_path(char *name, bool is_dir);
 
 /* xattr.c */
@@ -49,4 +54,6 @@ int get_xattrs(const char *name, const sqfs_inode_generic_t *inode,
 /* write_tree.c */
 int write_tree(const sqfs_tree_node_t *n);
 
+int write_tree_stream(sqfs_tree_iterator_t *it);
+
 #endif /* SQFS2TAR_H */
@@ -7,24 +7,60 @@
 #include "sqfs2tar.h"
 
 static sqfs_hard_link_t *links = NULL;
+static struct hash_table *link_index = NULL;
 static unsigned int record_counter;
+static bool record_links;
 
 static sqfs_hard_link_t *find_hard_link(const char *name, sqfs_u32 inum)
 {
-	sqfs_hard_link_t *lnk = NULL;
+	sqfs_hard_link_t *lnk;
 
-	for (lnk = links; lnk != NULL; lnk = lnk->next) {
-		if (lnk->inode_number == inum) {
-			if (strcmp(name, lnk->target) == 0)
-				lnk = NULL;
-			break;
-		}
-	}
+	if (link_index == NULL)
+		return NULL;
+
+	lnk = sqfs_hard_link_index_find(link_index, inum);
+
+	if (lnk != NULL && strcmp(name, lnk->target) == 0)
+		lnk = NULL;
 
 	return lnk;
 }
 
-static int write_tree_dfs(const sqfs_tree_node_t *n)
+/*
+  When streaming the tree, the hard links cannot be determined up front.
+  Instead, the first occurrence of an inode that has a link count > 1 is
+  recorded as the link target for all subsequent ones.
+ */
+static int record_hard_link(const char *name, const struct stat *sb)
+{
+	sqfs_hard_link_t *lnk;
+
+	if (!record_links || S_ISDIR(sb->st_mode) || sb->st_nlink < 2)
+		return 0;
+
+	lnk = calloc(1, sizeof(*lnk));
+	if (lnk == NULL)
+		goto fail;
+
+	lnk->inode_number = sb->st_ino;
+	lnk->target = strdup(name);
+	if (lnk->target == NULL)
+		goto fail;
+
+	lnk->next = links;
+	links = lnk;
+	return sqfs_hard_link_index_add(link_index, lnk);
+fail:
+	perror("recording hard link target");
+	free(lnk);
+	return -1;
+}
+
+/*
+  Returns 0 on success, a negative value on failure and a positive value if
+  the node was skipped and its children should not be written either.
+ */
+static int write_tree_node(const sqfs_tree_node_t *n)
 {
 	sqfs_hard_link_t *lnk = NULL;
 	tar_xattr_t *xattr = NULL;
@@ -37,7 +73,7 @@ static int write_tree_dfs(const sqfs_tree_node_t *n)
 
 	if (n->parent == NULL) {
 		if (root_becomes == NULL)
-			goto skip_hdr;
+			return 0;
 
 		len = strlen(root_becomes);
 		name = malloc(len + 2);
@@ -58,7 +94,7 @@ static int write_tree_dfs(const sqfs_tree_node_t *n)
 				      stderr);
 				return -1;
 			}
-			return 0;
+			return 1;
 		}
 
 		name = sqfs_tree_node_get_path(n);
@@ -79,7 +115,12 @@ static int write_tree_dfs(const sqfs_tree_node_t *n)
 			ret = write_hard_link(out_file, &sb, name, lnk->target,
 					      record_counter++);
 			free(name);
-			return ret;
+			return ret < 0 ? -1 : 1;
+		}
+
+		if (record_hard_link(name, &sb)) {
+			free(name);
+			return -1;
 		}
 	}
 
@@ -104,8 +145,15 @@ static int write_tree_dfs(const sqfs_tree_node_t *n)
 	}
 
 	if (S_ISREG(sb.st_mode)) {
-		if (sqfs_data_reader_dump(name, data, n->inode, out_file,
-					  super.block_size)) {
+		if (num_jobs > 1) {
+			ret = data_pipeline_dump_file(pipeline, pipeline_out,
+						      name, n->inode);
+		} else {
+			ret = sqfs_data_reader_dump(name, data, n->inode,
+						    out_file, super.block_size);
+		}
+
+		if (ret) {
 			free(name);
 			return -1;
 		}
@@ -117,11 +165,6 @@ static int write_tree_dfs(const sqfs_tree_node_t *n)
 	}
 
 	free(name);
-skip_hdr:
-	for (n = n->children; n != NULL; n = n->next) {
-		if (write_tree_dfs(n))
-			return -1;
-	}
 	return 0;
 out_skip:
 	if (dont_skip) {
@@ -129,12 +172,56 @@ out_skip:
 		ret = -1;
 	} else {
 		fprintf(stderr, "Skipping %s\n", name);
-		ret = 0;
+		ret = 1;
 	}
 	free(name);
 	return ret;
 }
 
+static int write_tree_dfs(const sqfs_tree_node_t *n)
+{
+	int ret;
+
+	ret = write_tree_node(n);
+	if (ret != 0)
+		return ret < 0 ? -1 : 0;
+
+	for (n = n->children; n != NULL; n = n->next) {
+		if (write_tree_dfs(n))
+			return -1;
+	}
+	return 0;
+}
+
+static int write_parents(const sqfs_tree_node_t *n)
+{
+	int ret;
+
+	if (n == NULL)
+		return 0;
+
+	ret = write_parents(n->parent);
+	if (ret != 0)
+		return ret;
+
+	return write_tree_node(n);
+}
+
+static void free_links(void)
+{
+	sqfs_hard_link_t *lnk;
+
+	sqfs_hard_link_index_destroy(link_index);
+	link_index = NULL;
+
+	while (links != NULL) {
+		lnk = links;
+		links = links->next;
+		free(lnk->target);
+		free(lnk);
+	}
+}
+
 int write_tree(const sqfs_tree_node_t *n)
 {
 	sqfs_hard_link_t *lnk;
@@ -144,21 +231,67 @@ int write_tree(const sqfs_tree_node_t *n)
 		if (sqfs_tree_find_hard_links(n, &links))
 			return -1;
 
+		link_index = sqfs_hard_link_index_create();
+		if (link_index == NULL)
+			goto out_links;
+
 		for (lnk = links; lnk != NULL; lnk = lnk->next) {
 			lnk->target = assemble_tar_path(lnk->target, false);
 
 			if (lnk->target == NULL)
 				goto out_links;
+
+			if (sqfs_hard_link_index_add(link_index, lnk))
+				goto out_links;
 		}
 	}
 
 	status = write_tree_dfs(n);
 out_links:
-	while (links != NULL) {
-		lnk = links;
-		links = links->next;
-		free(lnk->target);
-		free(lnk);
+	free_links();
+	return status;
+}
+
+int write_tree_stream(sqfs_tree_iterator_t *it)
+{
+	const sqfs_tree_node_t *n;
+	int ret, status = -1;
+
+	record_links = !no_links;
+
+	if (record_links) {
+		link_index = sqfs_hard_link_index_create();
+		if (link_index == NULL)
+			return -1;
+	}
+
+	ret = sqfs_tree_iterator_next(it, &n);
+	if (ret < 0)
+		goto fail_read;
+
+	/* with --keep-as-directory, recreate the directories leading to it */
+	ret = write_parents(n->parent);
+	if (ret < 0)
+		goto out;
+
+	while (ret == 0) {
+		ret = write_tree_node(n);
+		if (ret < 0)
+			goto out;
+
+		if (ret > 0)
+			sqfs_tree_iterator_skip(it);
+
+		ret = sqfs_tree_iterator_next(it, &n);
+		if (ret < 0)
+			goto fail_read;
 	}
+
+	status = 0;
+out:
+	free_links();
 	return status;
+fail_read:
+	sqfs_perror(filename, "reading filesystem tree", ret);
+	goto out;
 }
@@ -0,0 +1,454 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * data.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "sqfsck.h"
+#include "threadpool.h"
+
+typedef struct work_item_t {
+	struct work_item_t *next;
+
+	const block_ref_t *blk;
+
+	/* raw block data, at most one block in size */
+	sqfs_u8 *data;
+	size_t data_size;
+
+	/* uncompressed size or a negative SQFS_ERROR value */
+	sqfs_s32 result;
+} work_item_t;
+
+typedef struct {
+	sqfs_compressor_t *cmp;
+	sqfs_u8 *scratch;
+	size_t scratch_size;
+} worker_t;
+
+typedef struct {
+	sqfsck_t *ck;
+
+	thread_pool_t *pool;
+	worker_t *workers;
+	size_t num_workers;
+
+	size_t in_flight;
+	size_t max_in_flight;
+
+	/* recycled work items */
+	work_item_t *free_list;
+
+	/* uncompressed size of each fragment block, 0 if it failed */
+	sqfs_u32 *frag_sizes;
+} data_check_t;
+
+static int decompress_worker(void *user, void *work_item)
+{
+	worker_t *w = user;
+	work_item_t *item = work_item;
+
+	item->result = w->cmp->do_block(w->cmp, item->data, item->data_size,
+					w->scratch, w->scratch_size);
+	return 0;
+}
+
+static int block_cmp(const void *lhs, const void *rhs)
+{
+	const block_ref_t *a = lhs, *b = rhs;
+
+	if (a->location != b->location)
+		return a->location < b->location ? -1 : 1;
+
+	return a->frag_idx < b->frag_idx ? -1 :
+		(a->frag_idx > b->frag_idx ? 1 : 0);
+}
+
+static int add_fragment_blocks(sqfsck_t *ck)
+{
+	sqfs_u32 i, bs = ck->super.block_size;
+	sqfs_fragment_t frag;
+	block_ref_t *new;
+	size_t new_sz;
+	sqfs_u64 loc;
+
+	new_sz = ck->num_blocks + ck->super.fragment_entry_count;
+	if (new_sz > ck->max_blocks) {
+		new = realloc(ck->blocks, sizeof(new[0]) * new_sz);
+		if (new == NULL) {
+			perror("recording fragment blocks");
+			return -1;
+		}
+
+		ck->blocks = new;
+		ck->max_blocks = new_sz;
+	}
+
+	for (i = 0; i < ck->super.fragment_entry_count; ++i) {
+		if (sqfs_frag_table_lookup(ck->fragtbl, i, &frag)) {
+			problem(ck, "fragment table: cannot resolve entry %u\n",
+				(unsigned int)i);
+			continue;
+		}
+
+		loc = frag.start_offset;
+
+		if ((frag.size >> 25) != 0 ||
+		    SQFS_IS_SPARSE_BLOCK(frag.size) ||
+		    SQFS_ON_DISK_BLOCK_SIZE(frag.size) > bs) {
+			problem(ck, "fragment block %u: invalid size word "
+				"0x%08x\n", (unsigned int)i,
+				(unsigned int)frag.size);
+			continue;
+		}
+
+		if (loc < sizeof(sqfs_super_t) ||
+		    loc + SQFS_ON_DISK_BLOCK_SIZE(frag.size) > ck->data_end) {
+			problem(ck, "fragment block %u at 0x%llx is outside of "
+				"the data area\n", (unsigned int)i,
+				(unsigned long long)loc);
+			continue;
+		}
+
+		new = ck->blocks + ck->num_blocks++;
+		memset(new, 0, sizeof(*new));
+		new->location = loc;
+		new->on_disk = frag.size;
+		new->frag_idx = i;
+	}
+
+	return 0;
+}
+
+/*
+  Sort the blocks by location and drop the copies of deduplicated data
+  blocks, so every block is decompressed only once. Blocks at the same
+  location must agree on their size. Everything else sharing bytes on
+  disk is reported as overlapping.
+ */
+static void sort_blocks(sqfsck_t *ck)
+{
+	block_ref_t *prev, *cur;
+	size_t i, j;
+
+	if (ck->num_blocks == 0)
+		return;
+
+	qsort(ck->blocks, ck->num_blocks, sizeof(ck->blocks[0]), block_cmp);
+
+	for (i = 1, j = 0; i < ck->num_blocks; ++i) {
+		prev = ck->blocks + j;
+		cur = ck->blocks + i;
+
+		if (prev->location == cur->location &&
+		    prev->frag_idx == NO_FRAGMENT &&
+		    cur->frag_idx == NO_FRAGMENT) {
+			if (prev->on_disk != cur->on_disk ||
+			    prev->size != cur->size) {
+				problem(ck, "inodes %u and %u share the data "
+					"block at 0x%llx, but disagree on its "
+					"size\n", (unsigned int)prev->inode_num,
+					(unsigned int)cur->inode_num,
+					(unsigned long long)cur->location);
+			}
+			continue;
+		}
+
+		if (prev->location + SQFS_ON_DISK_BLOCK_SIZE(prev->on_disk) >
+		    cur->location) {
+			problem(ck, "block at 0x%llx overlaps with block at "
+				"0x%llx\n", (unsigned long long)prev->location,
+				(unsigned long long)cur->location);
+		}
+
+		ck->blocks[++j] = *cur;
+	}
+
+	ck->num_blocks = j + 1;
+}
+
+static void describe_block(char *buffer, size_t size, const block_ref_t *blk)
+{
+	if (blk->frag_idx == NO_FRAGMENT) {
+		snprintf(buffer, size, "data block at 0x%llx (inode %u)",
+			 (unsigned long long)blk->location,
+			 (unsigned int)blk->inode_num);
+	} else {
+		snprintf(buffer, size, "fragment block %u at 0x%llx",
+			 (unsigned int)blk->frag_idx,
+			 (unsigned long long)blk->location);
+	}
+}
+
+static void check_result(data_check_t *dc, const work_item_t *item)
+{
+	const block_ref_t *blk = item->blk;
+	sqfsck_t *ck = dc->ck;
+	char name[128];
+
+	if (item->result <= 0) {
+		describe_block(name, sizeof(name), blk);
+		problem(ck, "%s: decompression failed: %s\n", name,
+			item->result < 0 ? sqfs_error_string(item->result) :
+			"output does not fit into a block");
+		return;
+	}
+
+	ck->bytes_unpacked += item->result;
+
+	if (blk->frag_idx != NO_FRAGMENT) {
+		dc->frag_sizes[blk->frag_idx] = item->result;
+	} else if ((sqfs_u32)item->result != blk->size) {
+		describe_block(name, sizeof(name), blk);
+		problem(ck, "%s: expected %u bytes, but block has %u\n",
+			name, (unsigned int)blk->size,
+			(unsigned int)item->result);
+	}
+}
+
+static void recycle_item(data_check_t *dc, work_item_t *item)
+{
+	item->next = dc->free_list;
+	dc->free_list = item;
+}
+
+static int dequeue_one(data_check_t *dc)
+{
+	work_item_t *item = dc->pool->dequeue(dc->pool);
+
+	if (item == NULL) {
+		fputs("Error dequeueing work item from thread pool.\n",
+		      stderr);
+		return -1;
+	}
+
+	dc->in_flight -= 1;
+	check_result(dc, item);
+	recycle_item(dc, item);
+	return 0;
+}
+
+static work_item_t *get_item(data_check_t *dc)
+{
+	work_item_t *item = dc->free_list;
+
+	if (item != NULL) {
+		dc->free_list = item->next;
+		return item;
+	}
+
+	item = calloc(1, sizeof(*item));
+	if (item == NULL)
+		goto fail;
+
+	item->data = malloc(dc->ck->super.block_size);
+	if (item->data == NULL) {
+		free(item);
+		goto fail;
+	}
+
+	return item;
+fail:
+	perror("allocating block buffer");
+	return NULL;
+}
+
+static int process_block(data_check_t *dc, const block_ref_t *blk)
+{
+	sqfs_u32 size = SQFS_ON_DISK_BLOCK_SIZE(blk->on_disk);
+	sqfsck_t *ck = dc->ck;
+	work_item_t *item;
+	char name[128];
+	int ret;
+
+	while (dc->in_flight >= dc->max_in_flight) {
+		if (dequeue_one(dc))
+			return -1;
+	}
+
+	item = get_item(dc);
+	if (item == NULL)
+		return -1;
+
+	item->blk = blk;
+	item->data_size = size;
+
+	ret = ck->file->read_at(ck->file, blk->location, item->data, size);
+	if (ret) {
+		describe_block(name, sizeof(name), blk);
+		problem(ck, "%s: %s\n", name, sqfs_error_string(ret));
+		recycle_item(dc, item);
+		return 0;
+	}
+
+	ck->bytes_read += size;
+
+	if (!SQFS_IS_BLOCK_COMPRESSED(blk->on_disk)) {
+		item->result = size;
+		check_result(dc, item);
+		recycle_item(dc, item);
+		return 0;
+	}
+
+	if (dc->pool->submit(dc->pool, item)) {
+		fputs("Error submitting work item to thread pool.\n", stderr);
+		free(item->data);
+		free(item);
+		return -1;
+	}
+
+	dc->in_flight += 1;
+	return 0;
+}
+
+static void check_frag_refs(data_check_t *dc)
+{
+	sqfsck_t *ck = dc->ck;
+	const frag_ref_t *ref;
+	sqfs_u32 fsize;
+	size_t i;
+
+	for (i = 0; i < ck->num_frags; ++i) {
+		ref = ck->frags + i;
+		fsize = dc->frag_sizes[ref->frag_idx];
+
+		/* decompression failure has already been reported */
+		if (fsize == 0)
+			continue;
+
+		if (ref->offset >= fsize || (fsize - ref->offset) < ref->size) {
+			problem(ck, "inode %u: tail end at offset %u with "
+				"%u bytes exceeds fragment block %u (%u "
+				"bytes)\n", (unsigned int)ref->inode_num,
+				(unsigned int)ref->offset,
+				(unsigned int)ref->size,
+				(unsigned int)ref->frag_idx,
+				(unsigned int)fsize);
+		}
+	}
+}
+
+static int setup_workers(data_check_t *dc)
+{
+	sqfsck_t *ck = dc->ck;
+	size_t i;
+
+	dc->pool = thread_pool_create_unordered(ck->num_jobs,
+						decompress_worker);
+	if (dc->pool == NULL) {
+		perror("creating thread pool");
+		return -1;
+	}
+
+	dc->num_workers = dc->pool->get_worker_count(dc->pool);
+	dc->max_in_flight = 4 * dc->num_workers;
+
+	dc->workers = calloc(dc->num_workers, sizeof(dc->workers[0]));
+	if (dc->workers == NULL) {
+		perror("creating thread pool workers");
+		return -1;
+	}
+
+	for (i = 0; i < dc->num_workers; ++i) {
+		dc->workers[i].cmp = sqfs_copy(ck->cmp);
+		if (dc->workers[i].cmp == NULL) {
+			fputs("Error creating compressor copies.\n", stderr);
+			return -1;
+		}
+
+		dc->workers[i].scratch_size = ck->super.block_size;
+		dc->workers[i].scratch = malloc(ck->super.block_size);
+		if (dc->workers[i].scratch == NULL) {
+			perror("creating thread pool workers");
+			return -1;
+		}
+
+		dc->pool->set_worker_ptr(dc->pool, i, dc->workers + i);
+	}
+
+	return 0;
+}
+
+static void cleanup(data_check_t *dc)
+{
+	work_item_t *item;
+	size_t i;
+
+	if (dc->pool != NULL) {
+		while (dc->in_flight > 0) {
+			item = dc->pool->dequeue(dc->pool);
+			if (item == NULL)
+				break;
+			dc->in_flight -= 1;
+			recycle_item(dc, item);
+		}
+
+		dc->pool->destroy(dc->pool);
+	}
+
+	while (dc->free_list != NULL) {
+		item = dc->free_list;
+		dc->free_list = item->next;
+		free(item->data);
+		free(item);
+	}
+
+	if (dc->workers != NULL) {
+		for (i = 0; i < dc->num_workers; ++i) {
+			sqfs_destroy(dc->workers[i].cmp);
+			free(dc->workers[i].scratch);
+		}
+	}
+
+	free(dc->workers);
+	free(dc->frag_sizes);
+}
+
+int check_data(sqfsck_t *ck)
+{
+	struct timespec start, end;
+	data_check_t dc;
+	int status = -1;
+	size_t i;
+
+	memset(&dc, 0, sizeof(dc));
+	dc.ck = ck;
+
+	if (add_fragment_blocks(ck))
+		return -1;
+
+	sort_blocks(ck);
+
+	dc.frag_sizes = calloc(ck->super.fragment_entry_count + 1,
+			       sizeof(dc.frag_sizes[0]));
+	if (dc.frag_sizes == NULL) {
+		perror("recording fragment block sizes");
+		return -1;
+	}
+
+	if (setup_workers(&dc))
+		goto out;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < ck->num_blocks; ++i) {
+		if (process_block(&dc, ck->blocks + i))
+			goto out;
+	}
+
+	while (dc.in_flight > 0) {
+		if (dequeue_one(&dc))
+			goto out;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ck->seconds = (double)(end.tv_sec - start.tv_sec) +
+		(double)(end.tv_nsec - start.tv_nsec) / 1000000000.0;
+
+	check_frag_refs(&dc);
+	status = 0;
+out:
+	cleanup(&dc);
+	return status;
+}
@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * options.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "sqfsck.h"
+
+static struct option long_opts[] = {
+	{ "num-jobs", required_argument, NULL, 'j' },
+	{ "quiet", no_argument, NULL, 'q' },
+	{ "help", no_argument, NULL, 'h' },
+	{ "version", no_argument, NULL, 'V' },
+	{ NULL, 0, NULL, 0 },
+};
+
+static const char *short_opts = "j:qhV";
+
+static const char *usagestr =
+"Usage: sqfsck [OPTIONS...] <sqfsfile>\n"
+"\n"
+"Check the consistency of a SquashFS image without extracting it.\n"
+"\n"
+"The super block, the ID, fragment, export and xattr tables, as well as the\n"
+"inode and directory tables are parsed and cross checked. Every data and\n"
+"fragment block is then read and decompressed exactly once, in the order\n"
+"in which they are stored in the image.\n"
+"\n"
+"Problems are printed to stdout. The exit status is 0 if the image is\n"
+"consistent, 1 if problems were found and 2 if checking was not possible.\n"
+"\n"
+"Possible options:\n"
+"\n"
+"  --num-jobs, -j <count>      Number of threads to use for decompressing\n"
+"                              data blocks. Defaults to 1.\n"
+"  --quiet, -q                 Do not print a summary if no problems are\n"
+"                              found.\n"
+"  --help, -h                  Print help text and exit.\n"
+"  --version, -V               Print version information and exit.\n"
+"\n";
+
+void process_options(sqfsck_t *ck, int argc, char **argv)
+{
+	int i;
+
+	ck->num_jobs = 1;
+
+	for (;;) {
+		i = getopt_long(argc, argv, short_opts, long_opts, NULL);
+		if (i == -1)
+			break;
+
+		switch (i) {
+		case 'j':
+			ck->num_jobs = strtol(optarg, NULL, 0);
+			break;
+		case 'q':
+			ck->quiet = true;
+			break;
+		case 'h':
+			fputs(usagestr, stdout);
+			exit(0);
+		case 'V':
+			print_version("sqfsck");
+			exit(0);
+		default:
+			goto fail_arg;
+		}
+	}
+
+	if (ck->num_jobs < 1)
+		ck->num_jobs = 1;
+
+	if (optind >= argc) {
+		fputs("Missing argument: squashfs image\n", stderr);
+		goto fail_arg;
+	}
+
+	ck->filename = argv[optind++];
+
+	if (optind < argc) {
+		fputs("Unknown extra arguments\n", stderr);
+		goto fail_arg;
+	}
+	return;
+fail_arg:
+	fputs("Try `sqfsck --help' for more information.\n", stderr);
+	exit(2);
+}
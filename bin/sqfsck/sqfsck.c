@@ -0,0 +1,138 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * sqfsck.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "sqfsck.h"
+
+void problem(sqfsck_t *ck, const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stdout, "%s: ", ck->filename);
+
+	va_start(ap, fmt);
+	vfprintf(stdout, fmt, ap);
+	va_end(ap);
+
+	ck->problems += 1;
+}
+
+static int open_image(sqfsck_t *ck)
+{
+	int ret;
+
+	ck->file = sqfs_open_file(ck->filename, SQFS_FILE_OPEN_READ_ONLY);
+	if (ck->file == NULL) {
+		perror(ck->filename);
+		return -1;
+	}
+
+	/* without a super block, there is nothing that could be checked */
+	ret = sqfs_super_read(&ck->super, ck->file);
+	if (ret) {
+		sqfs_perror(ck->filename, "reading super block", ret);
+		return -1;
+	}
+
+	sqfs_compressor_config_init(&ck->cfg, ck->super.compression_id,
+				    ck->super.block_size,
+				    SQFS_COMP_FLAG_UNCOMPRESS);
+
+	ret = sqfs_compressor_create(&ck->cfg, &ck->cmp);
+
+#ifdef WITH_LZO
+	if (ck->super.compression_id == SQFS_COMP_LZO && ret != 0)
+		ret = lzo_compressor_create(&ck->cfg, &ck->cmp);
+#endif
+
+	if (ret != 0) {
+		sqfs_perror(ck->filename, "creating compressor", ret);
+		return -1;
+	}
+
+	if (ck->super.flags & SQFS_FLAG_COMPRESSOR_OPTIONS) {
+		ret = ck->cmp->read_options(ck->cmp, ck->file);
+		if (ret) {
+			problem(ck, "reading compressor options: %s\n",
+				sqfs_error_string(ret));
+		}
+	}
+
+	return 0;
+}
+
+static void print_summary(const sqfsck_t *ck)
+{
+	char read_str[32], unpacked_str[32];
+	double rate = 0.0;
+
+	print_size(ck->bytes_read, read_str, false);
+	print_size(ck->bytes_unpacked, unpacked_str, false);
+
+	if (ck->seconds > 0.0)
+		rate = (double)ck->bytes_unpacked / (1024.0 * 1024.0) /
+			ck->seconds;
+
+	printf("%s: %lu inodes, %lu directories, %lu regular files\n",
+	       ck->filename, (unsigned long)ck->num_inodes,
+	       (unsigned long)ck->num_dirs, (unsigned long)ck->num_files);
+	printf("%s: %lu blocks, %s read, %s decompressed in %.3fs "
+	       "(%.1f MiB/s, %ld jobs)\n", ck->filename,
+	       (unsigned long)ck->num_blocks, read_str, unpacked_str,
+	       ck->seconds, rate, ck->num_jobs);
+	printf("%s: %lu problems found\n", ck->filename,
+	       (unsigned long)ck->problems);
+}
+
+static void cleanup(sqfsck_t *ck)
+{
+	free(ck->blocks);
+	free(ck->frags);
+	free(ck->inode_seen);
+	sqfs_destroy(ck->dr);
+	sqfs_destroy(ck->xr);
+	sqfs_destroy(ck->fragtbl);
+	sqfs_destroy(ck->idtbl);
+	sqfs_destroy(ck->cmp);
+	sqfs_destroy(ck->file);
+}
+
+int main(int argc, char **argv)
+{
+	int ret = -1, status;
+	sqfsck_t ck;
+
+	memset(&ck, 0, sizeof(ck));
+	process_options(&ck, argc, argv);
+
+	if (open_image(&ck))
+		goto out;
+
+	if (check_super(&ck))
+		goto out;
+
+	if (check_tables(&ck))
+		goto out;
+
+	if (check_tree(&ck))
+		goto out;
+
+	if (check_export_table(&ck))
+		goto out;
+
+	ret = check_data(&ck);
+out:
+	if (ret == 0 && (!ck.quiet || ck.problems > 0))
+		print_summary(&ck);
+
+	if (ck.problems > 0) {
+		status = 1;
+	} else {
+		status = ret == 0 ? 0 : 2;
+	}
+
+	cleanup(&ck);
+	return status;
+}
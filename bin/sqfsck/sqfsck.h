@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * sqfsck.h
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#ifndef SQFSCK_H
+#define SQFSCK_H
+
+#include "config.h"
+#include "common.h"
+#include "util.h"
+
+#include "sqfs/meta_reader.h"
+
+#include <stdlib.h>
+#include <getopt.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+
+#define NO_FRAGMENT (0xFFFFFFFF)
+
+/* A data or fragment block that has to be read and decompressed. */
+typedef struct {
+	sqfs_u64 location;
+
+	/* on-disk size word */
+	sqfs_u32 on_disk;
+
+	/* expected size after decompression, unknown for fragment blocks */
+	sqfs_u32 size;
+
+	/* fragment table index or NO_FRAGMENT for file data blocks */
+	sqfs_u32 frag_idx;
+
+	/* inode number of the first file using the block */
+	sqfs_u32 inode_num;
+} block_ref_t;
+
+/* A tail end of a file, packed into a fragment block. */
+typedef struct {
+	sqfs_u32 frag_idx;
+	sqfs_u32 offset;
+	sqfs_u32 size;
+	sqfs_u32 inode_num;
+} frag_ref_t;
+
+typedef struct {
+	const char *filename;
+	long num_jobs;
+	bool quiet;
+
+	sqfs_file_t *file;
+	sqfs_super_t super;
+	sqfs_compressor_config_t cfg;
+	sqfs_compressor_t *cmp;
+	sqfs_id_table_t *idtbl;
+	sqfs_frag_table_t *fragtbl;
+	sqfs_xattr_reader_t *xr;
+	sqfs_dir_reader_t *dr;
+
+	/* end of the area that data and fragment blocks can be in */
+	sqfs_u64 data_end;
+
+	/* one bit per inode number, set when the inode was first seen */
+	sqfs_u8 *inode_seen;
+
+	size_t num_inodes;
+	size_t num_dirs;
+	size_t num_files;
+
+	block_ref_t *blocks;
+	size_t num_blocks;
+	size_t max_blocks;
+
+	frag_ref_t *frags;
+	size_t num_frags;
+	size_t max_frags;
+
+	sqfs_u64 bytes_read;
+	sqfs_u64 bytes_unpacked;
+	double seconds;
+
+	size_t problems;
+} sqfsck_t;
+
+/* Report an inconsistency in the image. Increments the problem count. */
+void problem(sqfsck_t *ck, const char *fmt, ...) PRINTF_ATTRIB(2, 3);
+
+void process_options(sqfsck_t *ck, int argc, char **argv);
+
+/*
+  All of the check functions below return 0 if the check could be performed
+  and -1 on fatal errors that prevent further checking. Inconsistencies are
+  reported through problem().
+ */
+int check_super(sqfsck_t *ck);
+
+int check_tables(sqfsck_t *ck);
+
+/* Walk the directory tree, checking inodes and recording data blocks. */
+int check_tree(sqfsck_t *ck);
+
+int check_export_table(sqfsck_t *ck);
+
+/* Decompress every recorded block once, in on-disk order. */
+int check_data(sqfsck_t *ck);
+
+#endif /* SQFSCK_H */
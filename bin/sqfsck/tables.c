@@ -0,0 +1,189 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * tables.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "sqfsck.h"
+
+static void check_table_start(sqfsck_t *ck, const char *name, sqfs_u64 start)
+{
+	if (start <= ck->super.directory_table_start ||
+	    start >= ck->super.bytes_used) {
+		problem(ck, "super block: %s start 0x%llx is outside of the "
+			"table area\n", name, (unsigned long long)start);
+	}
+}
+
+int check_super(sqfsck_t *ck)
+{
+	const sqfs_super_t *super = &ck->super;
+	sqfs_u64 size = ck->file->get_size(ck->file);
+	sqfs_u64 block, offset;
+
+	if (super->bytes_used > size) {
+		problem(ck, "super block: image claims to be %llu bytes, but "
+			"file is only %llu bytes\n",
+			(unsigned long long)super->bytes_used,
+			(unsigned long long)size);
+		return -1;
+	}
+
+	if (super->inode_table_start < sizeof(*super) ||
+	    super->inode_table_start >= super->directory_table_start ||
+	    super->directory_table_start >= super->bytes_used) {
+		problem(ck, "super block: inode and directory table locations "
+			"are not sane\n");
+		return -1;
+	}
+
+	block = super->root_inode_ref >> 16;
+	offset = super->root_inode_ref & 0xFFFF;
+
+	if (block >= super->directory_table_start - super->inode_table_start ||
+	    offset >= SQFS_META_BLOCK_SIZE) {
+		problem(ck, "super block: root inode reference is out of "
+			"bounds\n");
+		return -1;
+	}
+
+	check_table_start(ck, "ID table", super->id_table_start);
+
+	if (super->fragment_entry_count > 0) {
+		check_table_start(ck, "fragment table",
+				  super->fragment_table_start);
+
+		if (super->flags & SQFS_FLAG_NO_FRAGMENTS) {
+			problem(ck, "super block: no-fragments flag is set, "
+				"but there are %u fragment blocks\n",
+				(unsigned int)super->fragment_entry_count);
+		}
+	}
+
+	if (super->flags & SQFS_FLAG_EXPORTABLE)
+		check_table_start(ck, "export table",
+				  super->export_table_start);
+
+	if (super->xattr_id_table_start != 0xFFFFFFFFFFFFFFFFUL)
+		check_table_start(ck, "xattr table",
+				  super->xattr_id_table_start);
+
+	if (super->inode_count == 0) {
+		problem(ck, "super block: inode count is zero\n");
+		return -1;
+	}
+
+	ck->data_end = super->inode_table_start;
+	return 0;
+}
+
+int check_tables(sqfsck_t *ck)
+{
+	int ret;
+
+	ck->idtbl = sqfs_id_table_create(0);
+	if (ck->idtbl == NULL) {
+		sqfs_perror(ck->filename, "creating ID table",
+			    SQFS_ERROR_ALLOC);
+		return -1;
+	}
+
+	ret = sqfs_id_table_read(ck->idtbl, ck->file, &ck->super, ck->cmp);
+	if (ret) {
+		problem(ck, "loading ID table: %s\n",
+			sqfs_error_string(ret));
+		return -1;
+	}
+
+	ck->fragtbl = sqfs_frag_table_create(0);
+	if (ck->fragtbl == NULL) {
+		sqfs_perror(ck->filename, "creating fragment table",
+			    SQFS_ERROR_ALLOC);
+		return -1;
+	}
+
+	if (ck->super.fragment_entry_count > 0) {
+		ret = sqfs_frag_table_read(ck->fragtbl, ck->file, &ck->super,
+					   ck->cmp);
+		if (ret) {
+			problem(ck, "loading fragment table: %s\n",
+				sqfs_error_string(ret));
+			return -1;
+		}
+	}
+
+	ck->xr = sqfs_xattr_reader_create(0);
+	if (ck->xr == NULL) {
+		sqfs_perror(ck->filename, "creating xattr reader",
+			    SQFS_ERROR_ALLOC);
+		return -1;
+	}
+
+	ret = sqfs_xattr_reader_load(ck->xr, &ck->super, ck->file, ck->cmp);
+	if (ret) {
+		problem(ck, "loading xattr table: %s\n",
+			sqfs_error_string(ret));
+		return -1;
+	}
+
+	return 0;
+}
+
+int check_export_table(sqfsck_t *ck)
+{
+	const sqfs_super_t *super = &ck->super;
+	sqfs_inode_generic_t *inode;
+	sqfs_meta_reader_t *ir;
+	sqfs_u64 *table, ref;
+	int ret;
+	size_t i;
+
+	if (!(super->flags & SQFS_FLAG_EXPORTABLE))
+		return 0;
+
+	ret = sqfs_read_table(ck->file, ck->cmp,
+			      super->inode_count * sizeof(sqfs_u64),
+			      super->export_table_start,
+			      super->directory_table_start,
+			      super->export_table_start, (void **)&table);
+	if (ret) {
+		problem(ck, "loading export table: %s\n",
+			sqfs_error_string(ret));
+		return 0;
+	}
+
+	ir = sqfs_meta_reader_create(ck->file, ck->cmp,
+				     super->inode_table_start,
+				     super->directory_table_start);
+	if (ir == NULL) {
+		sqfs_perror(ck->filename, "creating inode table reader",
+			    SQFS_ERROR_ALLOC);
+		free(table);
+		return -1;
+	}
+
+	for (i = 0; i < super->inode_count; ++i) {
+		ref = le64toh(table[i]);
+
+		ret = sqfs_meta_reader_read_inode(ir, super, ref >> 16,
+						  ref & 0xFFFF, &inode);
+		if (ret) {
+			problem(ck, "export table: cannot read inode %lu: "
+				"%s\n", (unsigned long)(i + 1),
+				sqfs_error_string(ret));
+			continue;
+		}
+
+		if (inode->base.inode_number != i + 1) {
+			problem(ck, "export table: entry %lu points to inode "
+				"%u\n", (unsigned long)(i + 1),
+				(unsigned int)inode->base.inode_number);
+		}
+
+		free(inode);
+	}
+
+	sqfs_destroy(ir);
+	free(table);
+	return 0;
+}
@@ -0,0 +1,459 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * walk.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "sqfsck.h"
+
+typedef struct child_t {
+	struct child_t *next;
+	sqfs_dir_entry_t *ent;
+	sqfs_inode_generic_t *inode;
+} child_t;
+
+static int walk_dir(sqfsck_t *ck, const sqfs_inode_generic_t *inode,
+		    const char *path);
+
+static sqfs_u16 basic_type(sqfs_u16 type)
+{
+	return type > SQFS_INODE_SOCKET ? type - 7 : type;
+}
+
+static bool mode_matches_type(sqfs_u16 mode, sqfs_u16 type)
+{
+	switch (basic_type(type)) {
+	case SQFS_INODE_DIR:      return S_ISDIR(mode);
+	case SQFS_INODE_FILE:     return S_ISREG(mode);
+	case SQFS_INODE_SLINK:    return S_ISLNK(mode);
+	case SQFS_INODE_BDEV:     return S_ISBLK(mode);
+	case SQFS_INODE_CDEV:     return S_ISCHR(mode);
+	case SQFS_INODE_FIFO:     return S_ISFIFO(mode);
+	case SQFS_INODE_SOCKET:   return S_ISSOCK(mode);
+	default:
+		break;
+	}
+	return false;
+}
+
+static char *child_path(const char *parent, const char *name)
+{
+	size_t plen = strlen(parent), nlen = strlen(name);
+	char *path = malloc(plen + nlen + 2);
+
+	if (path == NULL) {
+		perror(name);
+		return NULL;
+	}
+
+	memcpy(path, parent, plen);
+	if (plen == 0 || parent[plen - 1] != '/')
+		path[plen++] = '/';
+	memcpy(path + plen, name, nlen + 1);
+	return path;
+}
+
+static int append_block(sqfsck_t *ck, const block_ref_t *blk)
+{
+	size_t new_sz;
+	void *new;
+
+	if (ck->num_blocks == ck->max_blocks) {
+		new_sz = ck->max_blocks ? ck->max_blocks * 2 : 128;
+		new = realloc(ck->blocks, sizeof(ck->blocks[0]) * new_sz);
+		if (new == NULL) {
+			perror("recording data blocks");
+			return -1;
+		}
+
+		ck->blocks = new;
+		ck->max_blocks = new_sz;
+	}
+
+	ck->blocks[ck->num_blocks++] = *blk;
+	return 0;
+}
+
+static int append_frag(sqfsck_t *ck, const frag_ref_t *frag)
+{
+	size_t new_sz;
+	void *new;
+
+	if (ck->num_frags == ck->max_frags) {
+		new_sz = ck->max_frags ? ck->max_frags * 2 : 128;
+		new = realloc(ck->frags, sizeof(ck->frags[0]) * new_sz);
+		if (new == NULL) {
+			perror("recording fragment references");
+			return -1;
+		}
+
+		ck->frags = new;
+		ck->max_frags = new_sz;
+	}
+
+	ck->frags[ck->num_frags++] = *frag;
+	return 0;
+}
+
+static void check_ids(sqfsck_t *ck, const char *path,
+		      const sqfs_inode_generic_t *inode)
+{
+	sqfs_u32 id;
+
+	if (sqfs_id_table_index_to_id(ck->idtbl, inode->base.uid_idx, &id)) {
+		problem(ck, "%s: UID index %u is not in the ID table\n",
+			path, (unsigned int)inode->base.uid_idx);
+	}
+
+	if (sqfs_id_table_index_to_id(ck->idtbl, inode->base.gid_idx, &id)) {
+		problem(ck, "%s: GID index %u is not in the ID table\n",
+			path, (unsigned int)inode->base.gid_idx);
+	}
+}
+
+static void check_xattr(sqfsck_t *ck, const char *path,
+			const sqfs_inode_generic_t *inode)
+{
+	sqfs_xattr_value_t *value;
+	sqfs_xattr_entry_t *key;
+	sqfs_xattr_id_t desc;
+	sqfs_u32 idx, i;
+	int ret;
+
+	if (sqfs_inode_get_xattr_index(inode, &idx) || idx == 0xFFFFFFFF)
+		return;
+
+	ret = sqfs_xattr_reader_get_desc(ck->xr, idx, &desc);
+	if (ret) {
+		problem(ck, "%s: resolving xattr index %u: %s\n", path,
+			(unsigned int)idx, sqfs_error_string(ret));
+		return;
+	}
+
+	ret = sqfs_xattr_reader_seek_kv(ck->xr, &desc);
+	if (ret)
+		goto fail;
+
+	for (i = 0; i < desc.count; ++i) {
+		ret = sqfs_xattr_reader_read_key(ck->xr, &key);
+		if (ret)
+			goto fail;
+
+		ret = sqfs_xattr_reader_read_value(ck->xr, key, &value);
+		free(key);
+		if (ret)
+			goto fail;
+
+		free(value);
+	}
+	return;
+fail:
+	problem(ck, "%s: reading xattr key/value pairs: %s\n", path,
+		sqfs_error_string(ret));
+}
+
+static int record_file(sqfsck_t *ck, const char *path,
+		       const sqfs_inode_generic_t *inode)
+{
+	sqfs_u32 bs = ck->super.block_size, count, frag_idx, frag_off, word;
+	sqfs_u64 size, location;
+	block_ref_t blk;
+	frag_ref_t frag;
+	size_t i;
+
+	sqfs_inode_get_file_size(inode, &size);
+	sqfs_inode_get_file_block_start(inode, &location);
+	sqfs_inode_get_frag_location(inode, &frag_idx, &frag_off);
+	count = sqfs_inode_get_file_block_count(inode);
+
+	for (i = 0; i < count; ++i) {
+		word = inode->extra[i];
+
+		if ((word >> 25) != 0) {
+			problem(ck, "%s: block %lu: invalid size word 0x%08x\n",
+				path, (unsigned long)i, (unsigned int)word);
+			return 0;
+		}
+
+		if (SQFS_ON_DISK_BLOCK_SIZE(word) > bs) {
+			problem(ck, "%s: block %lu: on-disk size %u exceeds "
+				"block size\n", path, (unsigned long)i,
+				(unsigned int)SQFS_ON_DISK_BLOCK_SIZE(word));
+			return 0;
+		}
+
+		if (SQFS_IS_SPARSE_BLOCK(word))
+			continue;
+
+		if (location < sizeof(sqfs_super_t) ||
+		    location + SQFS_ON_DISK_BLOCK_SIZE(word) > ck->data_end) {
+			problem(ck, "%s: block %lu at 0x%llx is outside of "
+				"the data area\n", path, (unsigned long)i,
+				(unsigned long long)location);
+			return 0;
+		}
+
+		memset(&blk, 0, sizeof(blk));
+		blk.location = location;
+		blk.on_disk = word;
+		blk.size = bs;
+		blk.frag_idx = NO_FRAGMENT;
+		blk.inode_num = inode->base.inode_number;
+
+		if (i == count - 1 && frag_idx == NO_FRAGMENT &&
+		    (size % bs) != 0) {
+			blk.size = size % bs;
+		}
+
+		if (append_block(ck, &blk))
+			return -1;
+
+		location += SQFS_ON_DISK_BLOCK_SIZE(word);
+	}
+
+	if (frag_idx == NO_FRAGMENT)
+		return 0;
+
+	if (frag_idx >= ck->super.fragment_entry_count) {
+		problem(ck, "%s: fragment index %u is out of bounds\n",
+			path, (unsigned int)frag_idx);
+		return 0;
+	}
+
+	if ((size % bs) == 0) {
+		problem(ck, "%s: file has a fragment, but its size is a "
+			"multiple of the block size\n", path);
+		return 0;
+	}
+
+	frag.frag_idx = frag_idx;
+	frag.offset = frag_off;
+	frag.size = size % bs;
+	frag.inode_num = inode->base.inode_number;
+	return append_frag(ck, &frag);
+}
+
+/*
+  Returns 0 if checking can continue, -1 on fatal errors. Each inode is
+  checked only once, hard links are only counted.
+ */
+static int check_inode(sqfsck_t *ck, const char *path, sqfs_u16 ent_type,
+		       const sqfs_inode_generic_t *inode)
+{
+	sqfs_u32 inum = inode->base.inode_number;
+	sqfs_u16 type = inode->base.type;
+
+	if (basic_type(ent_type) != basic_type(type)) {
+		problem(ck, "%s: directory entry type %u does not match "
+			"inode type %u\n", path, (unsigned int)ent_type,
+			(unsigned int)type);
+	}
+
+	if (inum < 1 || inum > ck->super.inode_count) {
+		problem(ck, "%s: inode number %u is out of range\n",
+			path, (unsigned int)inum);
+		return 0;
+	}
+
+	if (ck->inode_seen[(inum - 1) / 8] & (1 << ((inum - 1) % 8))) {
+		if (basic_type(type) == SQFS_INODE_DIR) {
+			problem(ck, "%s: directory inode %u is referenced more "
+				"than once\n", path, (unsigned int)inum);
+		}
+		return 0;
+	}
+
+	ck->inode_seen[(inum - 1) / 8] |= 1 << ((inum - 1) % 8);
+	ck->num_inodes += 1;
+
+	if (!mode_matches_type(inode->base.mode, type)) {
+		problem(ck, "%s: mode 0%o does not match inode type %u\n",
+			path, (unsigned int)inode->base.mode,
+			(unsigned int)type);
+	}
+
+	check_ids(ck, path, inode);
+	check_xattr(ck, path, inode);
+
+	switch (basic_type(type)) {
+	case SQFS_INODE_DIR:
+		ck->num_dirs += 1;
+		return walk_dir(ck, inode, path);
+	case SQFS_INODE_FILE:
+		ck->num_files += 1;
+		return record_file(ck, path, inode);
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static void free_children(child_t *list)
+{
+	child_t *it;
+
+	while (list != NULL) {
+		it = list;
+		list = list->next;
+
+		free(it->ent);
+		free(it->inode);
+		free(it);
+	}
+}
+
+/*
+  The directory reader only keeps the state of one listing, so the entries
+  of a directory are gathered before descending into any of them.
+ */
+static int read_children(sqfsck_t *ck, const sqfs_inode_generic_t *inode,
+			 const char *path, child_t **out)
+{
+	child_t *list = NULL, *last = NULL, *it;
+	sqfs_dir_entry_t *ent;
+	int ret;
+
+	*out = NULL;
+
+	ret = sqfs_dir_reader_open_dir(ck->dr, inode, 0);
+	if (ret) {
+		problem(ck, "%s: opening directory listing: %s\n", path,
+			sqfs_error_string(ret));
+		return 0;
+	}
+
+	for (;;) {
+		ret = sqfs_dir_reader_read(ck->dr, &ent);
+		if (ret > 0)
+			break;
+		if (ret < 0) {
+			problem(ck, "%s: reading directory entry: %s\n",
+				path, sqfs_error_string(ret));
+			break;
+		}
+
+		it = calloc(1, sizeof(*it));
+		if (it == NULL) {
+			perror(path);
+			free(ent);
+			free_children(list);
+			return -1;
+		}
+
+		it->ent = ent;
+
+		ret = sqfs_dir_reader_get_inode(ck->dr, &it->inode);
+		if (ret) {
+			problem(ck, "%s/%s: reading inode: %s\n", path,
+				(const char *)ent->name,
+				sqfs_error_string(ret));
+			free_children(it);
+			continue;
+		}
+
+		if (last == NULL) {
+			list = it;
+		} else {
+			last->next = it;
+		}
+		last = it;
+	}
+
+	*out = list;
+	return 0;
+}
+
+static void check_name(sqfsck_t *ck, const char *path,
+		       const sqfs_dir_entry_t *ent, const sqfs_dir_entry_t *prev)
+{
+	const char *name = (const char *)ent->name;
+
+	if (strlen(name) != (size_t)ent->size + 1 || strchr(name, '/') != NULL ||
+	    !strcmp(name, ".") || !strcmp(name, "..")) {
+		problem(ck, "%s: invalid entry name\n", path);
+	}
+
+	if (prev != NULL && strcmp((const char *)prev->name, name) >= 0) {
+		problem(ck, "%s: entry is not sorted after '%s'\n", path,
+			(const char *)prev->name);
+	}
+}
+
+static int walk_dir(sqfsck_t *ck, const sqfs_inode_generic_t *inode,
+		    const char *path)
+{
+	sqfs_dir_entry_t *prev = NULL;
+	child_t *list, *it;
+	char *cpath;
+	int ret = 0;
+
+	if (read_children(ck, inode, path, &list))
+		return -1;
+
+	for (it = list; it != NULL; it = it->next) {
+		cpath = child_path(path, (const char *)it->ent->name);
+		if (cpath == NULL) {
+			ret = -1;
+			break;
+		}
+
+		check_name(ck, cpath, it->ent, prev);
+		prev = it->ent;
+
+		ret = check_inode(ck, cpath, it->ent->type, it->inode);
+		free(cpath);
+
+		if (ret)
+			break;
+	}
+
+	free_children(list);
+	return ret;
+}
+
+int check_tree(sqfsck_t *ck)
+{
+	sqfs_inode_generic_t *root;
+	int ret;
+
+	ck->dr = sqfs_dir_reader_create(&ck->super, ck->cmp, ck->file, 0);
+	if (ck->dr == NULL) {
+		sqfs_perror(ck->filename, "creating directory reader",
+			    SQFS_ERROR_ALLOC);
+		return -1;
+	}
+
+	ck->inode_seen = calloc(1, ck->super.inode_count / 8 + 1);
+	if (ck->inode_seen == NULL) {
+		perror("creating inode bitmap");
+		return -1;
+	}
+
+	ret = sqfs_dir_reader_get_root_inode(ck->dr, &root);
+	if (ret) {
+		problem(ck, "reading root inode: %s\n",
+			sqfs_error_string(ret));
+		return -1;
+	}
+
+	if (basic_type(root->base.type) != SQFS_INODE_DIR) {
+		problem(ck, "root inode is not a directory\n");
+		free(root);
+		return -1;
+	}
+
+	ret = check_inode(ck, "/", SQFS_INODE_DIR, root);
+	free(root);
+	if (ret)
+		return -1;
+
+	if (ck->num_inodes != ck->super.inode_count) {
+		problem(ck, "super block claims %u inodes, but %lu are "
+			"reachable from the root directory\n",
+			(unsigned int)ck->super.inode_count,
+			(unsigned long)ck->num_inodes);
+	}
+
+	return 0;
+}
@@ -13,7 +13,7 @@ static int print_omitted(sqfsdiff_t *sd, bool is_old, sqfs_tree_node_t *n)
 	if (path == NULL)
 		return -1;
 
-	fprintf(stdout, "%c %s\n", is_old ? '<' : '>', path);
+	report(sd, "%c %s\n", is_old ? '<' : '>', path);
 
 	if ((sd->compare_flags & COMPARE_EXTRACT_FILES) &&
 	    S_ISREG(n->inode->base.mode)) {
@@ -6,8 +6,8 @@
  */
 #include "sqfsdiff.h"
 
-static unsigned char old_buf[MAX_WINDOW_SIZE];
-static unsigned char new_buf[MAX_WINDOW_SIZE];
+static sqfs_u8 old_buf[MAX_WINDOW_SIZE];
+static sqfs_u8 new_buf[MAX_WINDOW_SIZE];
 
 static int read_blob(const char *prefix, const char *path,
 		     sqfs_data_reader_t *rd, const sqfs_inode_generic_t *inode,
@@ -27,21 +27,197 @@ static int read_blob(const char *prefix, const char *path,
 	return 0;
 }
 
-int compare_files(sqfsdiff_t *sd, const sqfs_inode_generic_t *old,
-		  const sqfs_inode_generic_t *new, const char *path)
+static int compare_chunks(sqfs_u8 *old_data, size_t old_size,
+			  sqfs_u8 *new_data, size_t new_size)
+{
+	int ret = 0;
+
+	if (old_size != new_size || memcmp(old_data, new_data, old_size) != 0)
+		ret = 1;
+
+	free(old_data);
+	free(new_data);
+	return ret;
+}
+
+static int decompress_and_compare(sqfsdiff_t *sd, content_reader_t *rd,
+				  const sqfs_inode_generic_t *old,
+				  const sqfs_inode_generic_t *new,
+				  const char *path, size_t index)
+{
+	sqfs_u8 *old_data, *new_data;
+	size_t old_size, new_size;
+	int ret;
+
+	ret = sqfs_data_reader_get_block(rd->old_data, old, index,
+					 &old_size, &old_data);
+	if (ret) {
+		sqfs_perror(sd->old_path, path, ret);
+		return -1;
+	}
+
+	ret = sqfs_data_reader_get_block(rd->new_data, new, index,
+					 &new_size, &new_data);
+	if (ret) {
+		free(old_data);
+		sqfs_perror(sd->new_path, path, ret);
+		return -1;
+	}
+
+	return compare_chunks(old_data, old_size, new_data, new_size);
+}
+
+static int compare_fragments(sqfsdiff_t *sd, content_reader_t *rd,
+			     const sqfs_inode_generic_t *old,
+			     const sqfs_inode_generic_t *new, const char *path)
+{
+	sqfs_u8 *old_data, *new_data;
+	size_t old_size, new_size;
+	int ret;
+
+	ret = sqfs_data_reader_get_fragment(rd->old_data, old,
+					    &old_size, &old_data);
+	if (ret) {
+		sqfs_perror(sd->old_path, path, ret);
+		return -1;
+	}
+
+	ret = sqfs_data_reader_get_fragment(rd->new_data, new,
+					    &new_size, &new_data);
+	if (ret) {
+		free(old_data);
+		sqfs_perror(sd->new_path, path, ret);
+		return -1;
+	}
+
+	return compare_chunks(old_data, old_size, new_data, new_size);
+}
+
+static bool has_fragment(const sqfs_inode_generic_t *inode)
+{
+	sqfs_u32 frag_idx, frag_off;
+
+	sqfs_inode_get_frag_location(inode, &frag_idx, &frag_off);
+	return frag_idx != 0xFFFFFFFF;
+}
+
+/*
+  The raw comparison only works if both files are split up the same way.
+  The same data can still be packed differently, e.g. with or without tail
+  end packing, in which case the decompressed contents have to be compared.
+ */
+static bool same_block_layout(const sqfs_inode_generic_t *old,
+			      const sqfs_inode_generic_t *new)
+{
+	size_t i, count;
+
+	count = sqfs_inode_get_file_block_count(old);
+	if (count != sqfs_inode_get_file_block_count(new))
+		return false;
+
+	if (has_fragment(old) != has_fragment(new))
+		return false;
+
+	for (i = 0; i < count; ++i) {
+		if (SQFS_IS_SPARSE_BLOCK(old->extra[i]) !=
+		    SQFS_IS_SPARSE_BLOCK(new->extra[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+  If both images use the same compressor configuration and block size,
+  identical data blocks are stored identically. Compare the on-disk size
+  words and raw block contents first and only decompress if they differ.
+ */
+static int compare_files_raw(sqfsdiff_t *sd, content_reader_t *rd,
+			     const sqfs_inode_generic_t *old,
+			     const sqfs_inode_generic_t *new, const char *path,
+			     sqfs_u64 filesz)
+{
+	size_t i, count, block_size = sd->sqfs_old.super.block_size;
+	sqfs_u64 old_loc, new_loc;
+	sqfs_u32 old_sz, new_sz;
+	int ret;
+
+	count = sqfs_inode_get_file_block_count(old);
+
+	sqfs_inode_get_file_block_start(old, &old_loc);
+	sqfs_inode_get_file_block_start(new, &new_loc);
+
+	for (i = 0; i < count; ++i) {
+		old_sz = SQFS_ON_DISK_BLOCK_SIZE(old->extra[i]);
+		new_sz = SQFS_ON_DISK_BLOCK_SIZE(new->extra[i]);
+
+		if (old->extra[i] == new->extra[i] && old_sz <= block_size) {
+			if (old_sz == 0)
+				goto next;
+
+			ret = rd->old_file->read_at(rd->old_file, old_loc,
+						    rd->old_buf, old_sz);
+			if (ret) {
+				sqfs_perror(sd->old_path, path, ret);
+				return -1;
+			}
+
+			ret = rd->new_file->read_at(rd->new_file, new_loc,
+						    rd->new_buf, new_sz);
+			if (ret) {
+				sqfs_perror(sd->new_path, path, ret);
+				return -1;
+			}
+
+			if (memcmp(rd->old_buf, rd->new_buf, old_sz) == 0)
+				goto next;
+		}
+
+		ret = decompress_and_compare(sd, rd, old, new, path, i);
+		if (ret != 0)
+			return ret;
+	next:
+		old_loc += old_sz;
+		new_loc += new_sz;
+		filesz -= filesz < block_size ? filesz : block_size;
+	}
+
+	if (filesz > 0)
+		return compare_fragments(sd, rd, old, new, path);
+
+	return 0;
+}
+
+void content_reader_init(content_reader_t *rd, sqfsdiff_t *sd)
+{
+	rd->old_file = sd->sqfs_old.file;
+	rd->new_file = sd->sqfs_new.file;
+	rd->old_data = sd->sqfs_old.data;
+	rd->new_data = sd->sqfs_new.data;
+	rd->old_buf = old_buf;
+	rd->new_buf = new_buf;
+}
+
+int compare_file_contents(sqfsdiff_t *sd, content_reader_t *rd,
+			  const sqfs_inode_generic_t *old,
+			  const sqfs_inode_generic_t *new, const char *path)
 {
 	sqfs_u64 offset, diff, oldsz, newsz;
-	int status = 0, ret;
+	int ret;
 
 	sqfs_inode_get_file_size(old, &oldsz);
 	sqfs_inode_get_file_size(new, &newsz);
 
 	if (oldsz != newsz)
-		goto out_different;
+		return 1;
 
 	if (sd->compare_flags & COMPARE_NO_CONTENTS)
 		return 0;
 
+	if (sd->raw_compare && same_block_layout(old, new))
+		return compare_files_raw(sd, rd, old, new, path, oldsz);
+
 	for (offset = 0; offset < oldsz; offset += diff) {
 		diff = oldsz - offset;
 
@@ -49,24 +225,39 @@ int compare_files(sqfsdiff_t *sd, const sqfs_inode_generic_t *old,
 			diff = MAX_WINDOW_SIZE;
 
 		ret = read_blob(sd->old_path, path,
-				sd->sqfs_old.data, old, old_buf, offset, diff);
+				rd->old_data, old, rd->old_buf, offset, diff);
 		if (ret)
 			return -1;
 
 		ret = read_blob(sd->new_path, path,
-				sd->sqfs_new.data, new, new_buf, offset, diff);
+				rd->new_data, new, rd->new_buf, offset, diff);
 		if (ret)
 			return -1;
 
-		if (memcmp(old_buf, new_buf, diff) != 0)
-			goto out_different;
+		if (memcmp(rd->old_buf, rd->new_buf, diff) != 0)
+			return 1;
 	}
 
-	return status;
-out_different:
-	if (sd->compare_flags & COMPARE_EXTRACT_FILES) {
+	return 0;
+}
+
+int compare_files(sqfsdiff_t *sd, const sqfs_inode_generic_t *old,
+		  const sqfs_inode_generic_t *new, const char *path)
+{
+	content_reader_t rd;
+	int ret;
+
+	if (sd->pool != NULL && !(sd->compare_flags & COMPARE_NO_CONTENTS))
+		return diff_pool_submit(sd, old, new, path);
+
+	content_reader_init(&rd, sd);
+
+	ret = compare_file_contents(sd, &rd, old, new, path);
+
+	if (ret > 0 && (sd->compare_flags & COMPARE_EXTRACT_FILES)) {
 		if (extract_files(sd, old, new, path))
 			return -1;
 	}
-	return 1;
+
+	return ret;
 }
@@ -0,0 +1,235 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * compare_manifest.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "sqfsdiff.h"
+
+/*
+  If one side of the comparison is an image, a manifest is generated from its
+  directory tree. The digest of a file is only computed if the other side has
+  an entry with the same path and size, so files that obviously differ or
+  exist on one side only are never decompressed.
+ */
+typedef struct {
+	manifest_entry_t ent;
+
+	const sqfs_inode_generic_t *inode;
+	bool have_digest;
+} image_entry_t;
+
+typedef struct {
+	const char *path;
+	sqfs_state_t *sqfs;
+	manifest_t *m;
+} manifest_side_t;
+
+static int collect_files(manifest_t *m, const sqfs_tree_node_t *n)
+{
+	manifest_entry_t **new;
+	image_entry_t *ie;
+	size_t new_sz;
+
+	if (S_ISDIR(n->inode->base.mode)) {
+		for (n = n->children; n != NULL; n = n->next) {
+			if (collect_files(m, n))
+				return -1;
+		}
+		return 0;
+	}
+
+	if (!S_ISREG(n->inode->base.mode))
+		return 0;
+
+	if (m->count == m->max) {
+		new_sz = m->max ? m->max * 2 : 128;
+		new = realloc(m->entries, sizeof(new[0]) * new_sz);
+		if (new == NULL)
+			goto fail_errno;
+
+		m->entries = new;
+		m->max = new_sz;
+	}
+
+	ie = calloc(1, sizeof(*ie));
+	if (ie == NULL)
+		goto fail_errno;
+
+	m->entries[m->count++] = (manifest_entry_t *)ie;
+
+	ie->inode = n->inode;
+	ie->ent.inode_num = n->inode->base.inode_number;
+	sqfs_inode_get_file_size(n->inode, &ie->ent.size);
+
+	ie->ent.path = node_path(n);
+	if (ie->ent.path == NULL)
+		return -1;
+
+	return 0;
+fail_errno:
+	perror("building file list");
+	return -1;
+}
+
+static int hash_image_file(sqfs_state_t *sqfs, image_entry_t *ie,
+			   sqfs_u8 *buffer)
+{
+	sqfs_u64 offset;
+	sha256_ctx_t sha;
+	sqfs_s32 ret;
+
+	sha256_init(&sha);
+
+	for (offset = 0; offset < ie->ent.size; offset += ret) {
+		ret = sqfs_data_reader_read(sqfs->data, ie->inode, offset,
+					    buffer, MAX_WINDOW_SIZE);
+		if (ret < 0) {
+			sqfs_perror(ie->ent.path, "reading file data", ret);
+			return -1;
+		}
+
+		if (ret == 0) {
+			fprintf(stderr, "%s: unexpected end of file\n",
+				ie->ent.path);
+			return -1;
+		}
+
+		sha256_update(&sha, buffer, ret);
+	}
+
+	sha256_final(&sha, ie->ent.digest);
+	ie->have_digest = true;
+	return 0;
+}
+
+static int get_digest(manifest_side_t *side, manifest_entry_t *ent,
+		      sqfs_u8 *buffer)
+{
+	image_entry_t *ie = (image_entry_t *)ent;
+
+	if (side->sqfs == NULL || ie->have_digest)
+		return 0;
+
+	return hash_image_file(side->sqfs, ie, buffer);
+}
+
+static int load_side(manifest_side_t *side)
+{
+	if (side->sqfs == NULL) {
+		side->m = manifest_read(side->path);
+		return side->m == NULL ? -1 : 0;
+	}
+
+	side->m = calloc(1, sizeof(*side->m));
+	if (side->m == NULL) {
+		perror("building file list");
+		return -1;
+	}
+
+	if (collect_files(side->m, side->sqfs->root))
+		return -1;
+
+	manifest_sort(side->m);
+	return 0;
+}
+
+/*
+  Manifest paths are canonical, i.e. without the leading slash. Add it back
+  when reporting, so the output matches the one from comparing the trees.
+ */
+static int compare_entries(sqfsdiff_t *sd, manifest_side_t *old,
+			   manifest_side_t *new, manifest_entry_t *a,
+			   manifest_entry_t *b, sqfs_u8 *buffer)
+{
+	int status = 0;
+
+	if ((sd->compare_flags & COMPARE_INODE_NUM) &&
+	    a->inode_num != b->inode_num) {
+		report(sd, "/%s has a different inode number\n", a->path);
+		status = 1;
+	}
+
+	if (sd->compare_flags & COMPARE_NO_CONTENTS)
+		return status;
+
+	if (a->size == b->size) {
+		if (get_digest(old, a, buffer) || get_digest(new, b, buffer))
+			return -1;
+
+		if (memcmp(a->digest, b->digest, sizeof(a->digest)) == 0)
+			return status;
+	}
+
+	report(sd, "regular file /%s differs\n", a->path);
+	return 1;
+}
+
+int compare_manifests(sqfsdiff_t *sd)
+{
+	manifest_side_t old, new;
+	size_t i = 0, j = 0;
+	int ret, status = 0;
+	sqfs_u8 *buffer;
+
+	memset(&old, 0, sizeof(old));
+	memset(&new, 0, sizeof(new));
+
+	if (sd->old_manifest != NULL) {
+		old.path = sd->old_manifest;
+	} else {
+		old.path = sd->old_path;
+		old.sqfs = &sd->sqfs_old;
+	}
+
+	if (sd->new_manifest != NULL) {
+		new.path = sd->new_manifest;
+	} else {
+		new.path = sd->new_path;
+		new.sqfs = &sd->sqfs_new;
+	}
+
+	buffer = malloc(MAX_WINDOW_SIZE);
+	if (buffer == NULL) {
+		perror("allocating file buffer");
+		return -1;
+	}
+
+	if (load_side(&old) || load_side(&new)) {
+		status = -1;
+		goto out;
+	}
+
+	while (i < old.m->count || j < new.m->count) {
+		if (i < old.m->count && j < new.m->count) {
+			ret = strcmp(old.m->entries[i]->path,
+				     new.m->entries[j]->path);
+		} else {
+			ret = (i < old.m->count) ? -1 : 1;
+		}
+
+		if (ret < 0) {
+			report(sd, "< %s\n", old.m->entries[i++]->path);
+			status = 1;
+		} else if (ret > 0) {
+			report(sd, "> %s\n", new.m->entries[j++]->path);
+			status = 1;
+		} else {
+			ret = compare_entries(sd, &old, &new,
+					      old.m->entries[i++],
+					      new.m->entries[j++], buffer);
+			if (ret < 0) {
+				status = -1;
+				goto out;
+			}
+
+			if (ret > 0)
+				status = 1;
+		}
+	}
+out:
+	manifest_destroy(old.m);
+	manifest_destroy(new.m);
+	free(buffer);
+	return status;
+}
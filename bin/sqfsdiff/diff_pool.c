@@ -0,0 +1,359 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * diff_pool.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "sqfsdiff.h"
+#include "threadpool.h"
+
+/*
+  In parallel mode, the tree walk still happens on the main thread, but
+  comparing the contents of a file pair is handed to an ordered thread pool.
+  Everything the tree walk reports in the mean time is buffered and attached
+  to the next work item, so the main thread can print it along with the
+  result once the item comes back out of the pool, in the same order as a
+  sequential run would.
+ */
+typedef struct {
+	const sqfs_inode_generic_t *old;
+	const sqfs_inode_generic_t *new;
+	char *path;
+
+	/* report output that precedes the result */
+	char *text;
+
+	int result;
+} diff_item_t;
+
+typedef struct {
+	sqfs_file_t *file;
+	sqfs_compressor_t *cmp;
+	sqfs_data_reader_t *data;
+} image_copy_t;
+
+typedef struct {
+	sqfsdiff_t *sd;
+	content_reader_t rd;
+	image_copy_t old;
+	image_copy_t new;
+} diff_worker_t;
+
+struct diff_pool_t {
+	thread_pool_t *pool;
+	diff_worker_t *workers;
+	size_t num_workers;
+
+	size_t in_flight;
+	size_t max_in_flight;
+
+	char *text;
+	size_t text_used;
+	size_t text_max;
+
+	int status;
+};
+
+static int compare_worker(void *user, void *work_item)
+{
+	diff_worker_t *w = user;
+	diff_item_t *item = work_item;
+
+	item->result = compare_file_contents(w->sd, &w->rd, item->old,
+					     item->new, item->path);
+	return 0;
+}
+
+static void free_item(diff_item_t *item)
+{
+	free(item->path);
+	free(item->text);
+	free(item);
+}
+
+static int image_copy_init(image_copy_t *cp, const sqfs_state_t *state,
+			   const char *path)
+{
+	int ret;
+
+	cp->file = sqfs_copy(state->file);
+	cp->cmp = sqfs_copy(state->cmp);
+
+	if (cp->file == NULL || cp->cmp == NULL) {
+		fprintf(stderr, "%s: error creating reader copies.\n", path);
+		return -1;
+	}
+
+	cp->data = sqfs_data_reader_create(cp->file, state->super.block_size,
+					   cp->cmp, 0);
+	if (cp->data == NULL) {
+		sqfs_perror(path, "creating data reader", SQFS_ERROR_ALLOC);
+		return -1;
+	}
+
+	ret = sqfs_data_reader_load_fragment_table(cp->data, &state->super);
+	if (ret) {
+		sqfs_perror(path, "loading fragment table", ret);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void image_copy_cleanup(image_copy_t *cp)
+{
+	sqfs_destroy(cp->data);
+	sqfs_destroy(cp->cmp);
+	sqfs_destroy(cp->file);
+}
+
+static int worker_init(diff_worker_t *w, sqfsdiff_t *sd)
+{
+	w->sd = sd;
+
+	if (image_copy_init(&w->old, &sd->sqfs_old, sd->old_path))
+		return -1;
+
+	if (image_copy_init(&w->new, &sd->sqfs_new, sd->new_path))
+		return -1;
+
+	w->rd.old_file = w->old.file;
+	w->rd.new_file = w->new.file;
+	w->rd.old_data = w->old.data;
+	w->rd.new_data = w->new.data;
+	w->rd.old_buf = malloc(MAX_WINDOW_SIZE);
+	w->rd.new_buf = malloc(MAX_WINDOW_SIZE);
+
+	if (w->rd.old_buf == NULL || w->rd.new_buf == NULL) {
+		perror("allocating comparison buffers");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void worker_cleanup(diff_worker_t *w)
+{
+	free(w->rd.old_buf);
+	free(w->rd.new_buf);
+	image_copy_cleanup(&w->old);
+	image_copy_cleanup(&w->new);
+}
+
+static void flush_text(diff_pool_t *dp)
+{
+	if (dp->text_used > 0) {
+		fwrite(dp->text, 1, dp->text_used, stdout);
+		dp->text_used = 0;
+	}
+}
+
+static int complete_item(sqfsdiff_t *sd)
+{
+	diff_pool_t *dp = sd->pool;
+	diff_item_t *item;
+	int ret = 0;
+
+	item = dp->pool->dequeue(dp->pool);
+	if (item == NULL) {
+		fputs("comparing files: thread pool failure\n", stderr);
+		dp->status = -1;
+		return -1;
+	}
+
+	dp->in_flight -= 1;
+
+	if (item->text != NULL)
+		fputs(item->text, stdout);
+
+	if (item->result < 0) {
+		ret = -1;
+	} else if (item->result > 0) {
+		fprintf(stdout, "regular file %s differs\n", item->path);
+
+		if (sd->compare_flags & COMPARE_EXTRACT_FILES)
+			ret = extract_files(sd, item->old, item->new,
+					    item->path);
+
+		if (dp->status == 0)
+			dp->status = 1;
+	}
+
+	if (ret < 0)
+		dp->status = -1;
+
+	free_item(item);
+	return ret;
+}
+
+int diff_pool_submit(sqfsdiff_t *sd, const sqfs_inode_generic_t *old,
+		     const sqfs_inode_generic_t *new, const char *path)
+{
+	diff_pool_t *dp = sd->pool;
+	diff_item_t *item;
+
+	item = calloc(1, sizeof(*item));
+	if (item == NULL)
+		goto fail_errno;
+
+	item->old = old;
+	item->new = new;
+	item->path = strdup(path);
+	if (item->path == NULL)
+		goto fail_errno;
+
+	if (dp->text_used > 0) {
+		item->text = dp->text;
+		dp->text = NULL;
+		dp->text_used = 0;
+		dp->text_max = 0;
+	}
+
+	if (dp->pool->submit(dp->pool, item)) {
+		fputs("comparing files: error submitting work item\n", stderr);
+		free_item(item);
+		return -1;
+	}
+
+	dp->in_flight += 1;
+
+	while (dp->in_flight >= dp->max_in_flight) {
+		if (complete_item(sd))
+			return -1;
+	}
+
+	return 0;
+fail_errno:
+	perror(path);
+	if (item != NULL)
+		free_item(item);
+	return -1;
+}
+
+int diff_pool_report(diff_pool_t *dp, const char *text, size_t len)
+{
+	size_t new_sz;
+	char *new;
+
+	if (text == NULL) {
+		dp->status = -1;
+		return -1;
+	}
+
+	/* nothing pending that would have to be printed first */
+	if (dp->in_flight == 0) {
+		flush_text(dp);
+		fwrite(text, 1, len, stdout);
+		return 0;
+	}
+
+	if (dp->text_max - dp->text_used <= len) {
+		new_sz = dp->text_max ? dp->text_max : 1024;
+
+		while (new_sz - dp->text_used <= len)
+			new_sz *= 2;
+
+		new = realloc(dp->text, new_sz);
+		if (new == NULL) {
+			perror("buffering difference report");
+			dp->status = -1;
+			return -1;
+		}
+
+		dp->text = new;
+		dp->text_max = new_sz;
+	}
+
+	memcpy(dp->text + dp->text_used, text, len);
+	dp->text_used += len;
+	dp->text[dp->text_used] = '\0';
+	return 0;
+}
+
+int diff_pool_create(sqfsdiff_t *sd, size_t num_jobs)
+{
+	diff_pool_t *dp = calloc(1, sizeof(*dp));
+	size_t i;
+
+	if (dp == NULL) {
+		perror("creating thread pool");
+		return -1;
+	}
+
+	sd->pool = dp;
+
+	dp->pool = thread_pool_create(num_jobs, compare_worker);
+	if (dp->pool == NULL) {
+		perror("creating thread pool");
+		goto fail;
+	}
+
+	dp->num_workers = dp->pool->get_worker_count(dp->pool);
+	dp->max_in_flight = 4 * dp->num_workers;
+
+	dp->workers = calloc(dp->num_workers, sizeof(dp->workers[0]));
+	if (dp->workers == NULL) {
+		perror("creating thread pool");
+		goto fail;
+	}
+
+	for (i = 0; i < dp->num_workers; ++i) {
+		if (worker_init(dp->workers + i, sd))
+			goto fail;
+
+		dp->pool->set_worker_ptr(dp->pool, i, dp->workers + i);
+	}
+
+	return 0;
+fail:
+	diff_pool_destroy(sd);
+	return -1;
+}
+
+int diff_pool_finish(sqfsdiff_t *sd)
+{
+	diff_pool_t *dp = sd->pool;
+
+	while (dp->in_flight > 0) {
+		if (complete_item(sd))
+			break;
+	}
+
+	if (dp->status >= 0)
+		flush_text(dp);
+
+	return dp->status;
+}
+
+void diff_pool_destroy(sqfsdiff_t *sd)
+{
+	diff_pool_t *dp = sd->pool;
+	diff_item_t *item;
+	size_t i;
+
+	if (dp == NULL)
+		return;
+
+	if (dp->pool != NULL) {
+		while (dp->in_flight > 0) {
+			item = dp->pool->dequeue(dp->pool);
+			if (item == NULL)
+				break;
+
+			dp->in_flight -= 1;
+			free_item(item);
+		}
+
+		dp->pool->destroy(dp->pool);
+	}
+
+	if (dp->workers != NULL) {
+		for (i = 0; i < dp->num_workers; ++i)
+			worker_cleanup(dp->workers + i);
+		free(dp->workers);
+	}
+
+	free(dp->text);
+	free(dp);
+	sd->pool = NULL;
+}
@@ -10,6 +10,7 @@ static int extract(sqfs_data_reader_t *data, const sqfs_inode_generic_t *inode,
 		   const char *prefix, const char *path, size_t block_size)
 {
 	char *ptr, *temp;
+	sqfs_u64 size;
 	ostream_t *fp;
 
 	temp = alloca(strlen(prefix) + strlen(path) + 2);
@@ -28,7 +29,10 @@ static int extract(sqfs_data_reader_t *data, const sqfs_inode_generic_t *inode,
 		return -1;
 	}
 
-	if (sqfs_data_reader_dump(path, data, inode, fp, block_size)) {
+	sqfs_inode_get_file_size(inode, &size);
+
+	if (ostream_set_size_hint(fp, size) ||
+	    sqfs_data_reader_dump(path, data, inode, fp, block_size)) {
 		sqfs_destroy(fp);
 		return -1;
 	}
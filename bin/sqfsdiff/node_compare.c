@@ -83,13 +83,13 @@ int node_compare(sqfsdiff_t *sd, sqfs_tree_node_t *a, sqfs_tree_node_t *b)
 		}
 
 		if (promoted) {
-			fprintf(stdout, "%s has an extended type\n", path);
+			report(sd, "%s has an extended type\n", path);
 			status = 1;
 		} else if (demoted) {
-			fprintf(stdout, "%s has a basic type\n", path);
+			report(sd, "%s has a basic type\n", path);
 			status = 1;
 		} else {
-			fprintf(stdout, "%s has a different type\n", path);
+			report(sd, "%s has a different type\n", path);
 			free(path);
 			return 1;
 		}
@@ -98,7 +98,7 @@ int node_compare(sqfsdiff_t *sd, sqfs_tree_node_t *a, sqfs_tree_node_t *b)
 	if (!(sd->compare_flags & COMPARE_NO_PERM)) {
 		if ((a->inode->base.mode & ~S_IFMT) !=
 		    (b->inode->base.mode & ~S_IFMT)) {
-			fprintf(stdout, "%s has different permissions\n",
+			report(sd, "%s has different permissions\n",
 				path);
 			status = 1;
 		}
@@ -106,14 +106,14 @@ int node_compare(sqfsdiff_t *sd, sqfs_tree_node_t *a, sqfs_tree_node_t *b)
 
 	if (!(sd->compare_flags & COMPARE_NO_OWNER)) {
 		if (a->uid != b->uid || a->gid != b->gid) {
-			fprintf(stdout, "%s has different ownership\n", path);
+			report(sd, "%s has different ownership\n", path);
 			status = 1;
 		}
 	}
 
 	if (sd->compare_flags & COMPARE_TIMESTAMP) {
 		if (a->inode->base.mod_time != b->inode->base.mod_time) {
-			fprintf(stdout, "%s has a different timestamp\n", path);
+			report(sd, "%s has a different timestamp\n", path);
 			status = 1;
 		}
 	}
@@ -121,7 +121,7 @@ int node_compare(sqfsdiff_t *sd, sqfs_tree_node_t *a, sqfs_tree_node_t *b)
 	if (sd->compare_flags & COMPARE_INODE_NUM) {
 		if (a->inode->base.inode_number !=
 		    b->inode->base.inode_number) {
-			fprintf(stdout, "%s has a different inode number\n",
+			report(sd, "%s has a different inode number\n",
 				path);
 			status = 1;
 		}
@@ -136,7 +136,7 @@ int node_compare(sqfsdiff_t *sd, sqfs_tree_node_t *a, sqfs_tree_node_t *b)
 	case SQFS_INODE_BDEV:
 	case SQFS_INODE_CDEV:
 		if (a->inode->data.dev.devno != b->inode->data.dev.devno) {
-			fprintf(stdout, "%s has different device number\n",
+			report(sd, "%s has different device number\n",
 				path);
 			status = 1;
 		}
@@ -145,7 +145,7 @@ int node_compare(sqfsdiff_t *sd, sqfs_tree_node_t *a, sqfs_tree_node_t *b)
 	case SQFS_INODE_EXT_CDEV:
 		if (a->inode->data.dev_ext.devno !=
 		    b->inode->data.dev_ext.devno) {
-			fprintf(stdout, "%s has different device number\n",
+			report(sd, "%s has different device number\n",
 				path);
 			status = 1;
 		}
@@ -154,7 +154,7 @@ int node_compare(sqfsdiff_t *sd, sqfs_tree_node_t *a, sqfs_tree_node_t *b)
 	case SQFS_INODE_EXT_SLINK:
 		if (strcmp((const char *)a->inode->extra,
 			   (const char *)b->inode->extra)) {
-			fprintf(stdout, "%s has a different link target\n",
+			report(sd, "%s has a different link target\n",
 				path);
 		}
 		break;
@@ -191,12 +191,12 @@ int node_compare(sqfsdiff_t *sd, sqfs_tree_node_t *a, sqfs_tree_node_t *b)
 		if (ret < 0) {
 			status = -1;
 		} else if (ret > 0) {
-			fprintf(stdout, "regular file %s differs\n", path);
+			report(sd, "regular file %s differs\n", path);
 			status = 1;
 		}
 		break;
 	default:
-		fprintf(stdout, "%s has unknown type, ignoring\n", path);
+		report(sd, "%s has unknown type, ignoring\n", path);
 		break;
 	}
 
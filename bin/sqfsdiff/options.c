@@ -9,6 +9,8 @@
 static struct option long_opts[] = {
 	{ "old", required_argument, NULL, 'a' },
 	{ "new", required_argument, NULL, 'b' },
+	{ "old-manifest", required_argument, NULL, 'A' },
+	{ "new-manifest", required_argument, NULL, 'B' },
 	{ "no-owner", no_argument, NULL, 'O' },
 	{ "no-permissions", no_argument, NULL, 'P' },
 	{ "no-contents", no_argument, NULL, 'C' },
@@ -16,12 +18,13 @@ static struct option long_opts[] = {
 	{ "inode-num", no_argument, NULL, 'I' },
 	{ "super", no_argument, NULL, 'S' },
 	{ "extract", required_argument, NULL, 'e' },
+	{ "num-jobs", required_argument, NULL, 'j' },
 	{ "help", no_argument, NULL, 'h' },
 	{ "version", no_argument, NULL, 'V' },
 	{ NULL, 0, NULL, 0 },
 };
 
-static const char *short_opts = "a:b:OPCTISe:hV";
+static const char *short_opts = "a:b:A:B:OPCTISe:j:hV";
 
 static const char *usagestr =
 "Usage: sqfsdiff [OPTIONS...] --old,-a <first> --new,-b <second>\n"
@@ -44,6 +47,16 @@ static const char *usagestr =
 "  --old, -a <first>           The first of the two filesystems to compare.\n"
 "  --new, -b <second>          The second of the two filesystems to compare.\n"
 "\n"
+"  --old-manifest, -A <file>   Use a content manifest written by gensquashfs\n"
+"                              or tar2sqfs in place of the first filesystem.\n"
+"  --new-manifest, -B <file>   Use a content manifest in place of the second\n"
+"                              filesystem.\n"
+"\n"
+"                              If a manifest is used, only the regular files\n"
+"                              are compared, by path, size and digest. Files\n"
+"                              from an image are only decompressed if their\n"
+"                              size matches the manifest entry.\n"
+"\n"
 "  --no-contents, -C           Do not compare file contents.\n"
 "  --no-owner, -O              Do not compare file owners.\n"
 "  --no-permissions, -P        Do not compare permission bits.\n"
@@ -57,6 +70,9 @@ static const char *usagestr =
 "                              end up in a subdirectory 'old' and of the\n"
 "                              second filesystem in a subdirectory 'new'.\n"
 "\n"
+"  --num-jobs, -j <count>      Number of threads to use for comparing file\n"
+"                              contents. Defaults to 1.\n"
+"\n"
 "  --help, -h                  Print help text and exit.\n"
 "  --version, -V               Print version information and exit.\n"
 "\n";
@@ -65,6 +81,8 @@ void process_options(sqfsdiff_t *sd, int argc, char **argv)
 {
 	int i;
 
+	sd->num_jobs = 1;
+
 	for (;;) {
 		i = getopt_long(argc, argv, short_opts, long_opts, NULL);
 		if (i == -1)
@@ -77,6 +95,12 @@ void process_options(sqfsdiff_t *sd, int argc, char **argv)
 		case 'b':
 			sd->new_path = optarg;
 			break;
+		case 'A':
+			sd->old_manifest = optarg;
+			break;
+		case 'B':
+			sd->new_manifest = optarg;
+			break;
 		case 'O':
 			sd->compare_flags |= COMPARE_NO_OWNER;
 			break;
@@ -99,6 +123,9 @@ void process_options(sqfsdiff_t *sd, int argc, char **argv)
 			sd->compare_flags |= COMPARE_EXTRACT_FILES;
 			sd->extract_dir = optarg;
 			break;
+		case 'j':
+			sd->num_jobs = strtol(optarg, NULL, 0);
+			break;
 		case 'h':
 			fputs(usagestr, stdout);
 			exit(0);
@@ -110,16 +137,30 @@ void process_options(sqfsdiff_t *sd, int argc, char **argv)
 		}
 	}
 
-	if (sd->old_path == NULL) {
+	if (sd->old_path == NULL && sd->old_manifest == NULL) {
 		fputs("Missing arguments: first filesystem\n", stderr);
 		goto fail_arg;
 	}
 
-	if (sd->new_path == NULL) {
+	if (sd->new_path == NULL && sd->new_manifest == NULL) {
 		fputs("Missing arguments: second filesystem\n", stderr);
 		goto fail_arg;
 	}
 
+	if ((sd->old_path != NULL && sd->old_manifest != NULL) ||
+	    (sd->new_path != NULL && sd->new_manifest != NULL)) {
+		fputs("A filesystem and a manifest cannot be specified for "
+		      "the same side\n", stderr);
+		goto fail_arg;
+	}
+
+	if ((sd->old_manifest != NULL || sd->new_manifest != NULL) &&
+	    (sd->compare_super || sd->extract_dir != NULL)) {
+		fputs("--super and --extract cannot be used with "
+		      "manifests\n", stderr);
+		goto fail_arg;
+	}
+
 	if (optind < argc) {
 		fputs("Unknown extra arguments\n", stderr);
 		goto fail_arg;
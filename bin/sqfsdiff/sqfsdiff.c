@@ -111,6 +111,25 @@ fail_file:
 	return -1;
 }
 
+static bool same_data_encoding(const sqfs_state_t *a, const sqfs_state_t *b)
+{
+	if (a->super.compression_id != b->super.compression_id)
+		return false;
+
+	if (a->super.block_size != b->super.block_size)
+		return false;
+
+	if (a->have_options != b->have_options)
+		return false;
+
+	if (a->have_options &&
+	    memcmp(&a->options, &b->options, sizeof(a->options)) != 0) {
+		return false;
+	}
+
+	return true;
+}
+
 static void close_sfqs(sqfs_state_t *state)
 {
 	sqfs_destroy(state->data);
@@ -123,7 +142,7 @@ static void close_sfqs(sqfs_state_t *state)
 
 int main(int argc, char **argv)
 {
-	int status, ret = 0;
+	int status, pool_ret, ret = 0;
 	sqfsdiff_t sd;
 
 	memset(&sd, 0, sizeof(sd));
@@ -134,14 +153,21 @@ int main(int argc, char **argv)
 			return 2;
 	}
 
-	if (open_sfqs(&sd.sqfs_old, sd.old_path))
+	if (sd.old_path != NULL && open_sfqs(&sd.sqfs_old, sd.old_path))
 		return 2;
 
-	if (open_sfqs(&sd.sqfs_new, sd.new_path)) {
+	if (sd.new_path != NULL && open_sfqs(&sd.sqfs_new, sd.new_path)) {
 		status = 2;
 		goto out_sqfs_old;
 	}
 
+	if (sd.old_manifest != NULL || sd.new_manifest != NULL) {
+		ret = compare_manifests(&sd);
+		goto out;
+	}
+
+	sd.raw_compare = same_data_encoding(&sd.sqfs_old, &sd.sqfs_new);
+
 	if (sd.extract_dir != NULL) {
 		if (chdir(sd.extract_dir)) {
 			perror(sd.extract_dir);
@@ -150,7 +176,25 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (sd.num_jobs > 1) {
+		if (diff_pool_create(&sd, sd.num_jobs)) {
+			ret = -1;
+			goto out;
+		}
+	}
+
 	ret = node_compare(&sd, sd.sqfs_old.root, sd.sqfs_new.root);
+
+	if (sd.pool != NULL) {
+		if (ret >= 0) {
+			pool_ret = diff_pool_finish(&sd);
+			if (pool_ret < 0 || (pool_ret > 0 && ret == 0))
+				ret = pool_ret;
+		}
+
+		diff_pool_destroy(&sd);
+	}
+
 	if (ret != 0)
 		goto out;
 
@@ -168,8 +212,10 @@ out:
 	} else {
 		status = 0;
 	}
-	close_sfqs(&sd.sqfs_new);
+	if (sd.new_path != NULL)
+		close_sfqs(&sd.sqfs_new);
 out_sqfs_old:
-	close_sfqs(&sd.sqfs_old);
+	if (sd.old_path != NULL)
+		close_sfqs(&sd.sqfs_old);
 	return status;
 }
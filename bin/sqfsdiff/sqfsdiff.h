@@ -32,14 +32,33 @@ typedef struct {
 	bool have_options;
 } sqfs_state_t;
 
+typedef struct diff_pool_t diff_pool_t;
+
+typedef struct {
+	sqfs_file_t *old_file;
+	sqfs_file_t *new_file;
+	sqfs_data_reader_t *old_data;
+	sqfs_data_reader_t *new_data;
+	sqfs_u8 *old_buf;
+	sqfs_u8 *new_buf;
+} content_reader_t;
+
 typedef struct {
 	const char *old_path;
 	const char *new_path;
+	const char *old_manifest;
+	const char *new_manifest;
 	int compare_flags;
 	sqfs_state_t sqfs_old;
 	sqfs_state_t sqfs_new;
 	bool compare_super;
 	const char *extract_dir;
+
+	/* both images store data blocks the same way */
+	bool raw_compare;
+
+	long num_jobs;
+	diff_pool_t *pool;
 } sqfsdiff_t;
 
 enum {
@@ -56,9 +75,17 @@ int compare_dir_entries(sqfsdiff_t *sd, sqfs_tree_node_t *old,
 
 char *node_path(const sqfs_tree_node_t *n);
 
+void report(sqfsdiff_t *sd, const char *fmt, ...) PRINTF_ATTRIB(2, 3);
+
 int compare_files(sqfsdiff_t *sd, const sqfs_inode_generic_t *old,
 		  const sqfs_inode_generic_t *new, const char *path);
 
+void content_reader_init(content_reader_t *rd, sqfsdiff_t *sd);
+
+int compare_file_contents(sqfsdiff_t *sd, content_reader_t *rd,
+			  const sqfs_inode_generic_t *old,
+			  const sqfs_inode_generic_t *new, const char *path);
+
 int node_compare(sqfsdiff_t *sd, sqfs_tree_node_t *a, sqfs_tree_node_t *b);
 
 int compare_super_blocks(const sqfs_super_t *a, const sqfs_super_t *b);
@@ -67,6 +94,19 @@ int extract_files(sqfsdiff_t *sd, const sqfs_inode_generic_t *old,
 		  const sqfs_inode_generic_t *new,
 		  const char *path);
 
+int compare_manifests(sqfsdiff_t *sd);
+
 void process_options(sqfsdiff_t *sd, int argc, char **argv);
 
+int diff_pool_create(sqfsdiff_t *sd, size_t num_jobs);
+
+int diff_pool_submit(sqfsdiff_t *sd, const sqfs_inode_generic_t *old,
+		     const sqfs_inode_generic_t *new, const char *path);
+
+int diff_pool_report(diff_pool_t *dp, const char *text, size_t len);
+
+int diff_pool_finish(sqfsdiff_t *sd);
+
+void diff_pool_destroy(sqfsdiff_t *sd);
+
 #endif /* DIFFTOOL_H */
@@ -6,6 +6,8 @@
  */
 #include "sqfsdiff.h"
 
+#include <stdarg.h>
+
 char *node_path(const sqfs_tree_node_t *n)
 {
 	char *path = sqfs_tree_node_get_path(n);
@@ -23,3 +25,30 @@ char *node_path(const sqfs_tree_node_t *n)
 
 	return path;
 }
+
+void report(sqfsdiff_t *sd, const char *fmt, ...)
+{
+	char *temp = NULL;
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+
+	if (sd->pool == NULL) {
+		vfprintf(stdout, fmt, ap);
+		va_end(ap);
+		return;
+	}
+
+	ret = vasprintf(&temp, fmt, ap);
+	va_end(ap);
+
+	if (ret < 0) {
+		perror("buffering difference report");
+		temp = NULL;
+		ret = 0;
+	}
+
+	diff_pool_report(sd->pool, temp, ret);
+	free(temp);
+}
@@ -0,0 +1,126 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * index.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "tar2sqfs.h"
+
+/* how far ahead of the current read position file data is prefetched */
+#define PREFETCH_WINDOW (32 * 1024 * 1024)
+
+static int add_extent(tar_index_t *idx, sqfs_u64 offset, sqfs_u64 size)
+{
+	size_t new_sz;
+	void *new;
+
+	if (idx->count == idx->max_count) {
+		new_sz = idx->max_count ? idx->max_count * 2 : 64;
+		new = realloc(idx->extents, sizeof(idx->extents[0]) * new_sz);
+
+		if (new == NULL) {
+			perror("building tar index");
+			return -1;
+		}
+
+		idx->extents = new;
+		idx->max_count = new_sz;
+	}
+
+	idx->extents[idx->count].offset = offset;
+	idx->extents[idx->count].size = size;
+	idx->count += 1;
+	return 0;
+}
+
+int tar_index_build(tar_index_t *idx, istream_t *input_file)
+{
+	tar_header_decoded_t hdr;
+	sqfs_s64 start, pos;
+	int ret;
+
+	memset(idx, 0, sizeof(*idx));
+
+	start = istream_tell(input_file);
+	if (start < 0)
+		return -1;
+
+	for (;;) {
+		ret = read_header(input_file, &hdr);
+		if (ret > 0)
+			break;
+		if (ret < 0)
+			goto fail;
+
+		if (S_ISREG(hdr.sb.st_mode) && !hdr.is_hard_link &&
+		    hdr.record_size > 0) {
+			pos = istream_tell(input_file);
+			if (pos < 0)
+				goto fail_hdr;
+
+			if (add_extent(idx, pos, hdr.record_size))
+				goto fail_hdr;
+		}
+
+		if (skip_entry(input_file, hdr.record_size))
+			goto fail_hdr;
+
+		clear_header(&hdr);
+	}
+
+	if (istream_seek(input_file, start))
+		goto fail;
+
+	return 0;
+fail_hdr:
+	clear_header(&hdr);
+fail:
+	tar_index_cleanup(idx);
+	return -1;
+}
+
+void tar_index_prefetch(tar_index_t *idx, istream_t *input_file,
+			sqfs_u64 position)
+{
+	sqfs_u64 offset, end, limit = position + PREFETCH_WINDOW;
+	const tar_extent_t *ext;
+
+	/* avoid a hint for every block, as long as enough is in flight */
+	if (idx->prefetched >= position + PREFETCH_WINDOW / 2)
+		return;
+
+	while (idx->next < idx->count) {
+		ext = idx->extents + idx->next;
+		end = ext->offset + ext->size;
+
+		if (end <= position) {
+			idx->next += 1;
+			continue;
+		}
+
+		offset = ext->offset;
+		if (offset < idx->prefetched)
+			offset = idx->prefetched;
+
+		if (offset >= limit)
+			break;
+
+		if (end > limit) {
+			istream_prefetch(input_file, offset, limit - offset);
+			idx->prefetched = limit;
+			break;
+		}
+
+		if (offset < end)
+			istream_prefetch(input_file, offset, end - offset);
+
+		idx->prefetched = end;
+		idx->next += 1;
+	}
+}
+
+void tar_index_cleanup(tar_index_t *idx)
+{
+	free(idx->extents);
+	memset(idx, 0, sizeof(*idx));
+}
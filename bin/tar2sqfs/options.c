@@ -19,6 +19,7 @@ static struct option long_opts[] = {
 	{ "no-xattr", no_argument, NULL, 'x' },
 	{ "no-keep-time", no_argument, NULL, 'k' },
 	{ "exportable", no_argument, NULL, 'e' },
+	{ "manifest", required_argument, NULL, 'M' },
 	{ "no-symlink-retarget", no_argument, NULL, 'S' },
 	{ "no-tail-packing", no_argument, NULL, 'T' },
 	{ "force", no_argument, NULL, 'f' },
@@ -28,7 +29,7 @@ static struct option long_opts[] = {
 	{ NULL, 0, NULL, 0 },
 };
 
-static const char *short_opts = "r:c:b:B:d:X:j:Q:sxekfqSThV";
+static const char *short_opts = "r:c:b:B:d:X:j:Q:M:sxekfqSThV";
 
 static const char *usagestr =
 "Usage: tar2sqfs [OPTIONS...] <sqfsfile>\n"
@@ -53,7 +54,9 @@ static const char *usagestr =
 "  --comp-extra, -X <options>  A comma separated list of extra options for\n"
 "                              the selected compressor. Specify 'help' to\n"
 "                              get a list of available options.\n"
-"  --num-jobs, -j <count>      Number of compressor jobs to create.\n"
+"  --num-jobs, -j <count>      Number of compressor jobs to create. If the\n"
+"                              input is compressed in a way that allows it,\n"
+"                              it is also decompressed with that many jobs.\n"
 "  --queue-backlog, -Q <count> Maximum number of data blocks in the thread\n"
 "                              worker queue before the packer starts waiting\n"
 "                              for the block processors to catch up.\n"
@@ -77,6 +80,9 @@ static const char *usagestr =
 "  --no-keep-time, -k          Do not keep the time stamps stored in the\n"
 "                              archive. Instead, set defaults on all files.\n"
 "  --exportable, -e            Generate an export table for NFS support.\n"
+"  --manifest, -M <file>       Write a manifest with the path, inode number,\n"
+"                              size and SHA-256 digest of every regular\n"
+"                              file to the given file.\n"
 "  --no-tail-packing, -T       Do not perform tail end packing on files that\n"
 "                              are larger than block size.\n"
 "  --force, -f                 Overwrite the output file if it exists.\n"
@@ -168,6 +174,9 @@ void process_args(int argc, char **argv)
 
 			cfg.comp_id = ret;
 			break;
+		case 'M':
+			cfg.manifest = optarg;
+			break;
 		case 'j':
 			cfg.num_jobs = strtol(optarg, NULL, 0);
 			break;
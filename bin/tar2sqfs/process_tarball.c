@@ -6,21 +6,38 @@
  */
 #include "tar2sqfs.h"
 
+/* large files are read in steps, so the prefetch window keeps moving ahead */
+#define PREFETCH_STEP (1024 * 1024)
+
 static int write_file(istream_t *input_file, sqfs_writer_t *sqfs,
-		      const tar_header_decoded_t *hdr,
+		      const tar_header_decoded_t *hdr, tar_index_t *idx,
 		      file_info_t *fi, sqfs_u64 filesize)
 {
+	manifest_entry_t *ent = NULL;
 	const sparse_map_t *list;
 	int flags = 0, ret = 0;
 	sqfs_u64 offset, diff;
 	bool sparse_region;
+	sqfs_s64 pos = 0;
 	ostream_t *out;
 
+	if (idx != NULL) {
+		pos = istream_tell(input_file);
+		if (pos < 0)
+			return -1;
+	}
+
 	if (no_tail_pack && filesize > cfg.block_size)
 		flags |= SQFS_BLK_DONT_FRAGMENT;
 
+	if (sqfs->manifest != NULL) {
+		ent = manifest_add_file(sqfs->manifest, fi);
+		if (ent == NULL)
+			return -1;
+	}
+
 	out = data_writer_ostream_create(hdr->name, sqfs->data, &fi->inode,
-					 flags);
+					 flags, ent == NULL ? NULL : ent->digest);
 
 	if (out == NULL)
 		return -1;
@@ -54,6 +71,13 @@ static int write_file(istream_t *input_file, sqfs_writer_t *sqfs,
 		if (sparse_region) {
 			ret = ostream_append_sparse(out, diff);
 		} else {
+			if (idx != NULL) {
+				if (diff > PREFETCH_STEP)
+					diff = PREFETCH_STEP;
+
+				tar_index_prefetch(idx, input_file, pos);
+			}
+
 			ret = ostream_append_from_istream(out, input_file,
 							  diff);
 
@@ -63,6 +87,7 @@ static int write_file(istream_t *input_file, sqfs_writer_t *sqfs,
 				ret = -1;
 			} else if (ret > 0) {
 				diff = ret;
+				pos += diff;
 				ret = 0;
 			}
 		}
@@ -125,7 +150,8 @@ static int copy_xattr(sqfs_writer_t *sqfs, tree_node_t *node,
 
 static int create_node_and_repack_data(istream_t *input_file,
 				       sqfs_writer_t *sqfs,
-				       tar_header_decoded_t *hdr)
+				       tar_header_decoded_t *hdr,
+				       tar_index_t *idx)
 {
 	tree_node_t *node;
 
@@ -160,7 +186,7 @@ static int create_node_and_repack_data(istream_t *input_file,
 	}
 
 	if (S_ISREG(hdr->sb.st_mode)) {
-		if (write_file(input_file, sqfs, hdr, &node->data.file,
+		if (write_file(input_file, sqfs, hdr, idx, &node->data.file,
 			       hdr->sb.st_size)) {
 			return -1;
 		}
@@ -195,7 +221,8 @@ static int set_root_attribs(sqfs_writer_t *sqfs,
 	return 0;
 }
 
-int process_tarball(istream_t *input_file, sqfs_writer_t *sqfs)
+int process_tarball(istream_t *input_file, sqfs_writer_t *sqfs,
+		    tar_index_t *idx)
 {
 	bool skip, is_root, is_prefixed;
 	tar_header_decoded_t hdr;
@@ -326,7 +353,7 @@ int process_tarball(istream_t *input_file, sqfs_writer_t *sqfs)
 			continue;
 		}
 
-		if (create_node_and_repack_data(input_file, sqfs, &hdr))
+		if (create_node_and_repack_data(input_file, sqfs, &hdr, idx))
 			goto fail;
 
 		clear_header(&hdr);
@@ -36,6 +36,7 @@ int main(int argc, char **argv)
 {
 	int status = EXIT_FAILURE;
 	istream_t *input_file = NULL;
+	tar_index_t tar_idx, *idx = NULL;
 	sqfs_writer_t sqfs;
 	int ret;
 
@@ -58,16 +59,27 @@ int main(int argc, char **argv)
 			goto out_if;
 		}
 
-		input_file = istream_compressor_create(input_file, ret);
+		input_file = istream_compressor_create(input_file, ret,
+						       cfg.num_jobs);
 		if (input_file == NULL)
 			return EXIT_FAILURE;
+	} else if (istream_tell(input_file) >= 0) {
+		/*
+		  An uncompressed tarball in a regular file. Locate all the
+		  file data up front, so it can be prefetched ahead of the
+		  reader and skipped entries can be seeked over.
+		 */
+		if (tar_index_build(&tar_idx, input_file))
+			goto out_if;
+
+		idx = &tar_idx;
 	}
 
 	memset(&sqfs, 0, sizeof(sqfs));
 	if (sqfs_writer_init(&sqfs, &cfg))
 		goto out_if;
 
-	if (process_tarball(input_file, &sqfs))
+	if (process_tarball(input_file, &sqfs, idx))
 		goto out;
 
 	if (fstree_post_process(&sqfs.fs))
@@ -80,6 +92,8 @@ int main(int argc, char **argv)
 out:
 	sqfs_writer_cleanup(&sqfs, status);
 out_if:
+	if (idx != NULL)
+		tar_index_cleanup(idx);
 	sqfs_destroy(input_file);
 	return status;
 }
@@ -18,6 +18,27 @@
 #include <stdio.h>
 #include <errno.h>
 
+/*
+  Location of the file data of a regular file entry within a seekable,
+  uncompressed tarball.
+ */
+typedef struct {
+	sqfs_u64 offset;
+	sqfs_u64 size;
+} tar_extent_t;
+
+typedef struct {
+	tar_extent_t *extents;
+	size_t count;
+	size_t max_count;
+
+	/* first extent not yet completely prefetched */
+	size_t next;
+
+	/* end of the data that has been prefetched so far */
+	sqfs_u64 prefetched;
+} tar_index_t;
+
 /* options.c */
 extern bool dont_skip;
 extern bool keep_time;
@@ -28,7 +49,16 @@ extern char *root_becomes;
 
 void process_args(int argc, char **argv);
 
+/* index.c */
+int tar_index_build(tar_index_t *idx, istream_t *input_file);
+
+void tar_index_prefetch(tar_index_t *idx, istream_t *input_file,
+			sqfs_u64 position);
+
+void tar_index_cleanup(tar_index_t *idx);
+
 /* process_tarball.c */
-int process_tarball(istream_t *input_file, sqfs_writer_t *sqfs);
+int process_tarball(istream_t *input_file, sqfs_writer_t *sqfs,
+		    tar_index_t *idx);
 
 #endif /* TAR2SQFS_H */
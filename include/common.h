@@ -27,6 +27,8 @@
 
 #include <stddef.h>
 
+struct hash_table;
+
 typedef struct sqfs_hard_link_t {
 	struct sqfs_hard_link_t *next;
 	sqfs_u32 inode_number;
@@ -44,15 +46,36 @@ int sqfs_data_reader_dump(const char *name, sqfs_data_reader_t *data,
 			  const sqfs_inode_generic_t *inode,
 			  ostream_t *fp, size_t block_size);
 
+/*
+  Pack the contents of a file. If digest is not NULL, the SHA-256 of the data
+  fed into the block processor is stored there (SHA256_DIGEST_SIZE bytes).
+ */
 int write_data_from_file(const char *filename, sqfs_block_processor_t *data,
 			 sqfs_inode_generic_t **inode,
-			 sqfs_file_t *file, int flags);
+			 sqfs_file_t *file, int flags, sqfs_u8 *digest);
 
 void sqfs_perror(const char *file, const char *action, int error_code);
 
+/* Get a human readable description of an SQFS_ERROR code. */
+const char *sqfs_error_string(int error_code);
+
 int sqfs_tree_find_hard_links(const sqfs_tree_node_t *root,
 			      sqfs_hard_link_t **out);
 
+/*
+  A hash table that maps inode numbers to entries of a hard link list.
+  The table only points into the list, which remains owned by the caller.
+  If an inode number is added more than once, the first entry is kept.
+*/
+struct hash_table *sqfs_hard_link_index_create(void);
+
+int sqfs_hard_link_index_add(struct hash_table *ht, sqfs_hard_link_t *lnk);
+
+sqfs_hard_link_t *sqfs_hard_link_index_find(struct hash_table *ht,
+					    sqfs_u32 inum);
+
+void sqfs_hard_link_index_destroy(struct hash_table *ht);
+
 /*
   A wrapper around mkdir() that behaves like 'mkdir -p'. It tries to create
   every component of the given path and skips already existing entries.
@@ -78,9 +101,52 @@ int parse_size(const char *what, size_t *out, const char *str,
 
 void print_size(sqfs_u64 size, char *buffer, bool round_to_int);
 
+/*
+  An output stream that feeds a file into a block processor. If digest is not
+  NULL, the SHA-256 of the appended data is stored there when the stream is
+  flushed.
+ */
 ostream_t *data_writer_ostream_create(const char *filename,
 				      sqfs_block_processor_t *proc,
 				      sqfs_inode_generic_t **inode,
-				      int flags);
+				      int flags, sqfs_u8 *digest);
+
+/*
+  Unpacks the data of files on a thread pool. Raw blocks are read from the
+  image in the order they are submitted and decompressed in parallel. All
+  data, including raw data that is passed through, is written to the output
+  streams strictly in submission order. Destroy with sqfs_destroy.
+ */
+typedef struct data_pipeline_t data_pipeline_t;
+
+data_pipeline_t *data_pipeline_create(sqfs_file_t *file,
+				      const sqfs_super_t *super,
+				      sqfs_compressor_t *cmp, size_t num_jobs);
+
+/* Queue the contents of a file. The name is used for error messages. */
+int data_pipeline_dump_file(data_pipeline_t *pl, ostream_t *out,
+			    const char *name,
+			    const sqfs_inode_generic_t *inode);
+
+int data_pipeline_append(data_pipeline_t *pl, ostream_t *out,
+			 const void *data, size_t size);
+
+int data_pipeline_append_sparse(data_pipeline_t *pl, ostream_t *out,
+				size_t size);
+
+/*
+  Takes ownership of a stream. It is flushed and destroyed once everything
+  queued before has been written to it.
+ */
+int data_pipeline_close(data_pipeline_t *pl, ostream_t *out);
+
+/* Wait until everything queued so far has been written out. */
+int data_pipeline_flush(data_pipeline_t *pl);
+
+/*
+  An output stream that queues everything appended to it in a pipeline, in
+  front of the actual output stream. Takes ownership of both.
+ */
+ostream_t *data_pipeline_ostream_create(data_pipeline_t *pl, ostream_t *out);
 
 #endif /* COMMON_H */
@@ -17,44 +17,81 @@
 #endif
 
 /**
- * @struct ostream_t
+ * @struct istream_t
  *
  * @extends sqfs_object_t
  *
- * @brief An append-only data stream.
+ * @brief A sequential, read-only data stream.
  */
-typedef struct ostream_t {
+typedef struct istream_t {
 	sqfs_object_t base;
 
-	int (*append)(struct ostream_t *strm, const void *data, size_t size);
+	size_t buffer_used;
+	size_t buffer_offset;
+	bool eof;
 
-	int (*append_sparse)(struct ostream_t *strm, size_t size);
+	sqfs_u8 *buffer;
 
-	int (*flush)(struct ostream_t *strm);
+	int (*precache)(struct istream_t *strm);
 
-	const char *(*get_filename)(struct ostream_t *strm);
-} ostream_t;
+	/*
+	  Set if precache moves unread data in front of the new data on its
+	  own, instead of having it moved to the start of the buffer first.
+	  Either way, buffer_offset is zero once precache returns.
+	 */
+	bool precache_compacts;
+
+	/*
+	  Optional. Called by istream_read instead of precache once the
+	  buffer is drained, to produce data directly in caller memory.
+	  Returns the number of bytes read, 0 to fall back to precache.
+	 */
+	sqfs_s32 (*read_direct)(struct istream_t *strm, void *data,
+				size_t size);
+
+	/*
+	  Optional, only set if the underlying file is seekable. Reposition
+	  the underlying file, report the position it is currently at (i.e.
+	  the end of the buffered data) and hint that a range of the file is
+	  going to be read soon.
+	 */
+	int (*seek)(struct istream_t *strm, sqfs_u64 offset);
+
+	sqfs_s64 (*tell)(struct istream_t *strm);
+
+	void (*prefetch)(struct istream_t *strm, sqfs_u64 offset,
+			 sqfs_u64 size);
+
+	const char *(*get_filename)(struct istream_t *strm);
+} istream_t;
 
 /**
- * @struct istream_t
+ * @struct ostream_t
  *
  * @extends sqfs_object_t
  *
- * @brief A sequential, read-only data stream.
+ * @brief An append-only data stream.
  */
-typedef struct istream_t {
+typedef struct ostream_t {
 	sqfs_object_t base;
 
-	size_t buffer_used;
-	size_t buffer_offset;
-	bool eof;
+	int (*append)(struct ostream_t *strm, const void *data, size_t size);
 
-	sqfs_u8 *buffer;
+	int (*append_sparse)(struct ostream_t *strm, size_t size);
 
-	int (*precache)(struct istream_t *strm);
+	int (*flush)(struct ostream_t *strm);
 
-	const char *(*get_filename)(struct istream_t *strm);
-} istream_t;
+	const char *(*get_filename)(struct ostream_t *strm);
+
+	int (*set_size_hint)(struct ostream_t *strm, sqfs_u64 size);
+
+	/*
+	  Optional. Lets the output stream pull data out of an input stream,
+	  e.g. to have it read directly into memory owned by the output.
+	 */
+	sqfs_s32 (*append_from_istream)(struct ostream_t *strm, istream_t *in,
+					sqfs_u32 size);
+} ostream_t;
 
 
 enum {
@@ -83,8 +120,16 @@ enum {
 
 	FSTREAM_COMPRESSOR_BZIP2 = 4,
 
+	/**
+	 * @brief LZ4 frame format with independent blocks.
+	 *
+	 * Frames made up of linked blocks, as produced by lz4 -BD, cannot
+	 * be decoded.
+	 */
+	FSTREAM_COMPRESSOR_LZ4 = 5,
+
 	FSTREAM_COMPRESSOR_MIN = 1,
-	FSTREAM_COMPRESSOR_MAX = 4,
+	FSTREAM_COMPRESSOR_MAX = 5,
 };
 
 #ifdef __cplusplus
@@ -153,13 +198,22 @@ SQFS_INTERNAL istream_t *istream_open_stdin(void);
  * the compressor stream is destroyed. If this function fails, the wrapped
  * stream is also destroyed.
  *
+ * If more than one job is requested, the data is compressed in parallel
+ * where possible. For xz and zstd, the respective library does the
+ * threading (if it was built with support for it). The gzip compressor
+ * splits the data into independently compressed members that are written
+ * out in order, which any gzip decoder can read. For bzip2, the number of
+ * jobs is ignored.
+ *
  * @param strm A pointer to another stream that should be wrapped.
  * @param comp_id An identifier describing the compressor to use.
+ * @param num_jobs The number of threads to use for compression.
  *
  * @return A pointer to an output stream on success, NULL on failure.
  */
 SQFS_INTERNAL ostream_t *ostream_compressor_create(ostream_t *strm,
-						   int comp_id);
+						   int comp_id,
+						   size_t num_jobs);
 
 /**
  * @brief Create an input stream that transparently uncompresses data.
@@ -174,13 +228,20 @@ SQFS_INTERNAL ostream_t *ostream_compressor_create(ostream_t *strm,
  * the compressor stream is destroyed. If this function fails, the wrapped
  * stream is also destroyed.
  *
+ * If more than one job is requested, the input is decoded in parallel where
+ * the format allows it, i.e. for xz files made up of multiple blocks (if
+ * liblzma supports multi threaded decoding) and for gzip files made up of
+ * BGZF members. Anything else is transparently decoded serially.
+ *
  * @param strm A pointer to another stream that should be wrapped.
  * @param comp_id An identifier describing the compressor to use.
+ * @param num_jobs The number of worker threads to decode with.
  *
  * @return A pointer to an input stream on success, NULL on failure.
  */
 SQFS_INTERNAL istream_t *istream_compressor_create(istream_t *strm,
-						   int comp_id);
+						   int comp_id,
+						   size_t num_jobs);
 
 /**
  * @brief Probe the buffered data in an istream to check if it is compressed.
@@ -231,6 +292,24 @@ SQFS_INTERNAL int ostream_append(ostream_t *strm, const void *data,
  */
 SQFS_INTERNAL int ostream_append_sparse(ostream_t *strm, size_t size);
 
+/**
+ * @brief Tell an output stream how large the written data will be in total.
+ *
+ * @memberof ostream_t
+ *
+ * This is purely advisory and should be called right after opening the
+ * stream, before anything is appended. An implementation that writes to
+ * a file can use it to reserve the space up front, reducing fragmentation
+ * when writing large files. Implementations that cannot make use of the
+ * hint simply ignore it.
+ *
+ * @param strm A pointer to an output stream.
+ * @param size The expected total number of bytes, including holes.
+ *
+ * @return Zero on success, -1 on failure.
+ */
+SQFS_INTERNAL int ostream_set_size_hint(ostream_t *strm, sqfs_u64 size);
+
 /**
  * @brief Process all pending, buffered data and flush it to disk.
  *
@@ -305,6 +384,10 @@ SQFS_INTERNAL int istream_get_line(istream_t *strm, char **out,
  *
  * @memberof istream_t
  *
+ * Whatever is left in the internal buffer is copied out first. For larger
+ * reads, streams that support it then produce the rest of the data directly
+ * in the destination buffer, bypassing the internal buffer altogether.
+ *
  * @param strm A pointer to an input stream.
  * @param data A buffer to read into.
  * @param size The number of bytes to read into the buffer.
@@ -352,6 +435,51 @@ SQFS_INTERNAL const char *istream_get_filename(istream_t *strm);
  */
 SQFS_INTERNAL int istream_skip(istream_t *strm, sqfs_u64 size);
 
+/**
+ * @brief Get the current read position of an input stream.
+ *
+ * @memberof istream_t
+ *
+ * The position takes data into account that has already been buffered,
+ * but not yet consumed.
+ *
+ * @param strm A pointer to an input stream.
+ *
+ * @return The absolute position within the underlying file, or -1 if
+ *         the stream is not seekable or on failure.
+ */
+SQFS_INTERNAL sqfs_s64 istream_tell(istream_t *strm);
+
+/**
+ * @brief Move the read position of a seekable input stream.
+ *
+ * @memberof istream_t
+ *
+ * If the new position is inside the buffered data, only the buffer offset
+ * is adjusted, otherwise the buffer is discarded.
+ *
+ * @param strm A pointer to an input stream.
+ * @param offset An absolute position within the underlying file.
+ *
+ * @return Zero on success, -1 on failure.
+ */
+SQFS_INTERNAL int istream_seek(istream_t *strm, sqfs_u64 offset);
+
+/**
+ * @brief Hint that a range of a seekable input stream will be read soon.
+ *
+ * @memberof istream_t
+ *
+ * This is purely advisory and does nothing if the stream does not
+ * support it.
+ *
+ * @param strm A pointer to an input stream.
+ * @param offset An absolute position within the underlying file.
+ * @param size The number of bytes starting at that position.
+ */
+SQFS_INTERNAL void istream_prefetch(istream_t *strm, sqfs_u64 offset,
+				    sqfs_u64 size);
+
 /**
  * @brief Read data from an input stream and append it to an output stream
  *
@@ -31,6 +31,8 @@ enum {
 	DIR_SCAN_NO_DIR = 0x0080,
 	DIR_SCAN_NO_CHR = 0x0100,
 	DIR_SCAN_NO_FIFO = 0x0200,
+
+	DIR_SCAN_READ_XATTR = 0x0400,
 };
 
 #define FSTREE_MODE_HARD_LINK (0)
@@ -41,6 +43,9 @@ typedef struct file_info_t file_info_t;
 typedef struct dir_info_t dir_info_t;
 typedef struct fstree_t fstree_t;
 
+struct hash_table;
+struct mem_arena_t;
+
 /*
   Optionally used by fstree_from_dir and fstree_from_subdir to
   execute custom actions for each discovered node.
@@ -50,6 +55,25 @@ typedef struct fstree_t fstree_t;
  */
 typedef int (*scan_node_callback)(void *user, fstree_t *fs, tree_node_t *node);
 
+/* An extended attribute read from the input directory during a scan. */
+typedef struct {
+	const char *key;
+	const sqfs_u8 *value;
+	size_t value_len;
+} dir_scan_xattr_t;
+
+/*
+  Optionally used by fstree_from_subdir_parallel. Called for every node that
+  was kept, after the scan_node_callback, including the scan root itself.
+  If DIR_SCAN_READ_XATTR is set, the extended attributes of the input file
+  are passed along, otherwise count is always 0.
+
+  If it returns a non-zero value, scanning is aborted.
+ */
+typedef int (*scan_xattr_callback)(void *user, fstree_t *fs, tree_node_t *node,
+				   const dir_scan_xattr_t *xattr,
+				   size_t count);
+
 /* Additional meta data stored in a tree_node_t for regular files. */
 struct file_info_t {
 	/* Linked list pointer for files in fstree_t */
@@ -66,6 +90,12 @@ struct dir_info_t {
 	/* Linked list head for children in the directory */
 	tree_node_t *children;
 
+	/* Optional hash table of the children, see dir_index.c */
+	struct hash_table *index;
+
+	/* Set if adding to the index failed, it is rebuilt on next use */
+	bool index_stale;
+
 	/* Set to true for implicitly generated directories.  */
 	bool created_implicitly;
 
@@ -123,6 +153,14 @@ struct fstree_t {
 
 	/* linear linked list of all regular files */
 	file_info_t *files;
+
+	/* owns all nodes of the tree, NULL if allocated individually */
+	struct mem_arena_t *arena;
+
+	/* hash tables of large directories, see dir_index.c */
+	struct hash_table **dir_indices;
+	size_t num_dir_indices;
+	size_t max_dir_indices;
 };
 
 /*
@@ -137,6 +175,7 @@ struct fstree_t {
 */
 int fstree_init(fstree_t *fs, char *defaults);
 
+/* Releases all nodes of the tree at once, with no per node work. */
 void fstree_cleanup(fstree_t *fs);
 
 /*
@@ -149,11 +188,13 @@ void fstree_cleanup(fstree_t *fs);
   This function does not print anything to stderr, instead it sets an
   appropriate errno value.
 
-  The resulting node can be freed with a single free() call.
+  If fs is not NULL, the node is allocated from the tree and is freed by
+  fstree_cleanup. Every node that is added to a tree has to be created this
+  way. If fs is NULL, the node can be freed with a single free() call.
 */
-tree_node_t *fstree_mknode(tree_node_t *parent, const char *name,
-			   size_t name_len, const char *extra,
-			   const struct stat *sb);
+tree_node_t *fstree_mknode(fstree_t *fs, tree_node_t *parent,
+			   const char *name, size_t name_len,
+			   const char *extra, const struct stat *sb);
 
 /*
   Add a node to an fstree at a specific path.
@@ -274,4 +315,23 @@ int fstree_from_subdir(fstree_t *fs, tree_node_t *root,
 		       const char *path, const char *subdir,
 		       scan_node_callback cb, void *user, unsigned int flags);
 
+/*
+  Same as fstree_from_subdir, but directories are read by a pool of num_jobs
+  worker threads. Nodes are still created and passed to the callback on the
+  calling thread, directory by directory, so the resulting tree does not
+  depend on the number of workers. Sub directories are visited breadth first
+  instead of depth first.
+
+  The workers also read the extended attributes if DIR_SCAN_READ_XATTR is
+  set, using the same buffers for every file. On Windows, this simply calls
+  fstree_from_subdir and the xattr callback is not used.
+
+  Returns 0 on success, prints to stderr on failure.
+ */
+int fstree_from_subdir_parallel(fstree_t *fs, tree_node_t *root,
+				const char *path, const char *subdir,
+				scan_node_callback cb,
+				scan_xattr_callback xattr_cb, void *user,
+				unsigned int flags, size_t num_jobs);
+
 #endif /* FSTREE_H */
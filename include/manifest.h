@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * manifest.h
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include "config.h"
+
+#include "fstream.h"
+#include "fstree.h"
+#include "util.h"
+
+/*
+  A content manifest lists every regular file of an image with its path,
+  inode number, size and the SHA-256 digest of its contents. It is written
+  as a text file next to the image, one file per line, sorted by path:
+
+    <digest in hex> <size> <inode number> <path>
+
+  The path is relative to the root of the image, backslashes and line breaks
+  in it are escaped as "\\" and "\n" respectively.
+ */
+typedef struct {
+	/* The tree node entry the digest was computed for, packer side only. */
+	const file_info_t *fi;
+
+	char *path;
+	sqfs_u64 size;
+	sqfs_u32 inode_num;
+	sqfs_u8 digest[SHA256_DIGEST_SIZE];
+} manifest_entry_t;
+
+typedef struct {
+	manifest_entry_t **entries;
+	size_t count;
+	size_t max;
+} manifest_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+manifest_t *manifest_create(void);
+
+void manifest_destroy(manifest_t *m);
+
+/*
+  Add an entry for a file that is being packed. The caller fills in the
+  digest. Path, size and inode number are resolved from the tree node by
+  manifest_write.
+
+  Prints an error to stderr and returns NULL on failure.
+ */
+manifest_entry_t *manifest_add_file(manifest_t *m, const file_info_t *fi);
+
+/* Sort the entries by path, using strcmp. */
+void manifest_sort(manifest_t *m);
+
+/*
+  Write a line for every name of a regular file in the tree that has an entry
+  recorded with manifest_add_file. This has to be done after post processing
+  the tree and finishing the block processor, but before the tree is
+  serialized, which releases the file inodes.
+
+  Returns 0 on success, prints an error message to stderr and returns -1 on
+  failure.
+ */
+int manifest_write(manifest_t *m, fstree_t *fs, ostream_t *out);
+
+/*
+  Read a manifest file written by manifest_write. The entries of the
+  returned manifest are sorted by path. Prints an error message to stderr
+  and returns NULL on failure.
+ */
+manifest_t *manifest_read(const char *filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANIFEST_H */
@@ -12,6 +12,8 @@
 
 typedef struct mem_pool_t mem_pool_t;
 
+typedef struct mem_arena_t mem_arena_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -24,6 +26,17 @@ SQFS_INTERNAL void *mem_pool_allocate(mem_pool_t *mem);
 
 SQFS_INTERNAL void mem_pool_free(mem_pool_t *mem, void *ptr);
 
+/*
+  A bump allocator for objects of varying size that are never freed
+  individually. All of them are released at once when the arena is
+  destroyed. Returned memory is zero initialized.
+ */
+SQFS_INTERNAL mem_arena_t *mem_arena_create(void);
+
+SQFS_INTERNAL void mem_arena_destroy(mem_arena_t *arena);
+
+SQFS_INTERNAL void *mem_arena_allocate(mem_arena_t *arena, size_t size);
+
 #ifdef __cplusplus
 }
 #endif
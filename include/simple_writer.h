@@ -21,6 +21,7 @@
 #include "sqfs/io.h"
 
 #include "fstree.h"
+#include "manifest.h"
 
 typedef struct {
 	const char *filename;
@@ -37,10 +38,15 @@ typedef struct {
 	sqfs_super_t super;
 	fstree_t fs;
 	sqfs_xattr_writer_t *xwr;
+
+	/* Only created if a manifest file name is configured. */
+	manifest_t *manifest;
+	ostream_t *manifest_file;
 } sqfs_writer_t;
 
 typedef struct {
 	const char *filename;
+	const char *manifest;
 	char *fs_defaults;
 	char *comp_extra;
 	size_t block_size;
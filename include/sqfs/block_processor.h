@@ -290,6 +290,52 @@ SQFS_API int sqfs_block_processor_begin_file(sqfs_block_processor_t *proc,
 SQFS_API int sqfs_block_processor_append(sqfs_block_processor_t *proc,
 					 const void *data, size_t size);
 
+/**
+ * @brief Get direct access to the unused tail of the current data block.
+ *
+ * @memberof sqfs_block_processor_t
+ *
+ * This function, together with @ref sqfs_block_processor_commit, provides an
+ * alternative to @ref sqfs_block_processor_append that allows producing the
+ * file data directly inside the block buffer (e.g. by reading from a file
+ * descriptor or running a decompressor into it), instead of having the block
+ * processor copy it over from a separate buffer.
+ *
+ * The returned memory region is owned by the block processor. It is only
+ * valid until the next call to any other block processor function. Data
+ * placed in it is not considered part of the file, until it is confirmed
+ * with @ref sqfs_block_processor_commit.
+ *
+ * @param proc A pointer to a block processor object.
+ * @param data Returns a pointer to the first unused byte of the current block.
+ * @param size Returns the number of bytes available at that location.
+ *             This is always at least one.
+ *
+ * @return Zero on success, an @ref SQFS_ERROR value on failure.
+ */
+SQFS_API int sqfs_block_processor_get_buffer(sqfs_block_processor_t *proc,
+					     sqfs_u8 **data, size_t *size);
+
+/**
+ * @brief Add data produced in place to the current file.
+ *
+ * @memberof sqfs_block_processor_t
+ *
+ * After filling (part of) the region returned by
+ * @ref sqfs_block_processor_get_buffer, call this function to append the
+ * first @p size bytes of it to the current file. Once the block is full, it
+ * is handed off for processing, same as with @ref sqfs_block_processor_append.
+ *
+ * @param proc A pointer to a block processor object.
+ * @param size The number of bytes that were written to the buffer. Must not
+ *             exceed the size reported by
+ *             @ref sqfs_block_processor_get_buffer.
+ *
+ * @return Zero on success, an @ref SQFS_ERROR value on failure.
+ */
+SQFS_API int sqfs_block_processor_commit(sqfs_block_processor_t *proc,
+					 size_t size);
+
 /**
  * @brief Stop writing the current file and flush everything that is
  *        buffered internally.
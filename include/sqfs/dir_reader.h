@@ -170,6 +170,61 @@ SQFS_API sqfs_dir_reader_t *sqfs_dir_reader_create(const sqfs_super_t *super,
 						   sqfs_file_t *file,
 						   sqfs_u32 flags);
 
+/**
+ * @brief Replace the meta data block cache of a directory reader.
+ *
+ * @memberof sqfs_dir_reader_t
+ *
+ * A directory reader internally creates a cache of a default size that is
+ * shared by its inode and directory table readers, as well as by all copies
+ * of it. This function can be used to replace it, e.g. with a bigger one,
+ * or with one that is shared with other directory readers for the same image.
+ *
+ * @param rd A pointer to a directory reader.
+ * @param cache A pointer to a cache object or NULL to disable caching.
+ *              The reader grabs its own reference.
+ */
+SQFS_API void sqfs_dir_reader_set_cache(sqfs_dir_reader_t *rd,
+					sqfs_meta_cache_t *cache);
+
+/**
+ * @brief Enable a cache for path lookups on a directory reader.
+ *
+ * @memberof sqfs_dir_reader_t
+ *
+ * If enabled, @ref sqfs_dir_reader_find_by_path remembers which inode a name
+ * in a directory resolved to. Repeated lookups of paths with common prefixes
+ * can then skip reading and decoding the inodes and directory listings of
+ * the intermediate directories.
+ *
+ * The cache is bounded and direct mapped, i.e. if two entries collide, the
+ * newer one replaces the older one. Setting a new cache drops all cached
+ * entries and resets the statistics. Copies of a directory reader start
+ * with an empty cache of the same size.
+ *
+ * @param rd A pointer to a directory reader.
+ * @param max_entries The maximum number of cached entries. Zero disables
+ *                    the cache, which is the default.
+ *
+ * @return Zero on success, an @ref SQFS_ERROR value on failure.
+ */
+SQFS_API int sqfs_dir_reader_set_dentry_cache(sqfs_dir_reader_t *rd,
+					      size_t max_entries);
+
+/**
+ * @brief Get the hit and miss counts of the path lookup cache.
+ *
+ * @memberof sqfs_dir_reader_t
+ *
+ * @param rd A pointer to a directory reader.
+ * @param hits Returns the number of path components resolved from the cache.
+ * @param misses Returns the number of path components that were not found
+ *               in the cache and had to be looked up in the directory.
+ */
+SQFS_API
+void sqfs_dir_reader_get_dentry_cache_stats(const sqfs_dir_reader_t *rd,
+					    sqfs_u64 *hits, sqfs_u64 *misses);
+
 /**
  * @brief Navigate a directory reader to the location of a directory
  *        represented by an inode.
@@ -324,6 +379,77 @@ SQFS_API int sqfs_dir_reader_get_full_hierarchy(sqfs_dir_reader_t *rd,
  */
 SQFS_API void sqfs_dir_tree_destroy(sqfs_tree_node_t *root);
 
+/**
+ * @brief Create an iterator that walks a file system hierarchy depth first.
+ *
+ * @memberof sqfs_tree_iterator_t
+ *
+ * This is a streaming alternative to @ref sqfs_dir_reader_get_full_hierarchy.
+ * Instead of deserializing the entire hierarchy up front, the iterator hands
+ * out one node at a time, in the same order a depth first traversal of the
+ * tree returned by @ref sqfs_dir_reader_get_full_hierarchy would visit them.
+ * Only the chain of directories leading to the current node is kept in
+ * memory.
+ *
+ * The iterator uses the given directory reader internally. While the
+ * iterator is in use, the directory reader must not be used otherwise.
+ *
+ * The returned object can be destroyed using @ref sqfs_destroy and does not
+ * support copying.
+ *
+ * @param rd A pointer to a directory reader.
+ * @param idtbl An ID table used to resolve the user and group IDs.
+ * @param path A path to resolve into an inode to start at. Can be set to NULL
+ *             to start at the root inode.
+ * @param flags A combination of @ref SQFS_TREE_FILTER_FLAGS flags. If
+ *              @ref SQFS_TREE_STORE_PARENTS is set, the node returned first
+ *              has its chain of parents attached, but the parent nodes
+ *              themselves are not returned by the iterator.
+ * @param out Returns a pointer to the iterator on success.
+ *
+ * @return Zero on success, an @ref SQFS_ERROR value on failure.
+ */
+SQFS_API int sqfs_tree_iterator_create(sqfs_dir_reader_t *rd,
+				       const sqfs_id_table_t *idtbl,
+				       const char *path, sqfs_u32 flags,
+				       sqfs_tree_iterator_t **out);
+
+/**
+ * @brief Get the next node from a tree iterator.
+ *
+ * @memberof sqfs_tree_iterator_t
+ *
+ * The first node returned is the one the iterator was created for. After
+ * that, every directory is returned before its children. The returned node
+ * has no children or siblings attached, but its parent pointer is valid and
+ * can be used to walk up to the starting node, e.g. to assemble a path.
+ *
+ * The node and all its parents are owned by the iterator. A node remains
+ * valid until the next call to this function, a directory node until all of
+ * its children have been returned.
+ *
+ * @param it A pointer to a tree iterator.
+ * @param out Returns a pointer to the next node.
+ *
+ * @return Zero on success, an @ref SQFS_ERROR value on failure, a positive
+ *         number if the end of the hierarchy has been reached.
+ */
+SQFS_API int sqfs_tree_iterator_next(sqfs_tree_iterator_t *it,
+				     const sqfs_tree_node_t **out);
+
+/**
+ * @brief Do not descend into the most recently returned directory.
+ *
+ * @memberof sqfs_tree_iterator_t
+ *
+ * If the node most recently returned by @ref sqfs_tree_iterator_next is a
+ * directory, its children are not returned. Otherwise, calling this function
+ * has no effect.
+ *
+ * @param it A pointer to a tree iterator.
+ */
+SQFS_API void sqfs_tree_iterator_skip(sqfs_tree_iterator_t *it);
+
 #ifdef __cplusplus
 }
 #endif
@@ -54,7 +54,23 @@ typedef enum {
 	 */
 	SQFS_FILE_OPEN_OVERWRITE = 0x02,
 
-	SQFS_FILE_OPEN_ALL_FLAGS = 0x03,
+	/**
+	 * @brief Use asynchronous I/O, if the operating system supports it.
+	 *
+	 * On Linux, this uses an io_uring based implementation, where writes
+	 * are copied to an internal buffer, queued and completed in the
+	 * background. Write errors may thus be reported by a later call
+	 * to any of the I/O functions, at the latest by the flush callback.
+	 * Reads, truncation and overlapping writes wait for all outstanding
+	 * requests to complete first.
+	 *
+	 * If asynchronous I/O is not available (e.g. the kernel is too old
+	 * or the interface is disabled), this flag is silently ignored and
+	 * the regular, synchronous implementation is used instead.
+	 */
+	SQFS_FILE_OPEN_ASYNC_IO = 0x04,
+
+	SQFS_FILE_OPEN_ALL_FLAGS = 0x07,
 } SQFS_FILE_OPEN_FLAGS;
 
 /**
@@ -120,6 +136,21 @@ struct sqfs_file_t {
 	 *         directly to the caller.
 	 */
 	int (*truncate)(sqfs_file_t *file, sqfs_u64 size);
+
+	/**
+	 * @brief Wait for all outstanding writes to complete.
+	 *
+	 * This is optional and can be NULL if the implementation does not
+	 * defer writes. Otherwise, it must be called once all data has been
+	 * written, because errors from deferred writes may not be reported
+	 * any other way.
+	 *
+	 * @param file A pointer to the file object.
+	 *
+	 * @return Zero on success, an @ref SQFS_ERROR identifier on failure,
+	 *         i.e. if any of the outstanding writes failed.
+	 */
+	int (*flush)(sqfs_file_t *file);
 };
 
 #ifdef __cplusplus
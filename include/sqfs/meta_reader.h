@@ -47,6 +47,24 @@
  * from disk and reading transparently across block boarders if required.
  */
 
+/**
+ * @struct sqfs_meta_cache_t
+ *
+ * @implements sqfs_object_t
+ *
+ * @brief A least recently used cache of uncompressed meta data blocks.
+ *
+ * Blocks are keyed by their absolute location in the image, so a single
+ * cache can be shared between several @ref sqfs_meta_reader_t instances
+ * that read from the same image, e.g. the inode and directory table
+ * readers of a @ref sqfs_dir_reader_t and all copies made from it.
+ *
+ * The cache is reference counted. Every meta data reader that uses it holds
+ * a reference, and @ref sqfs_destroy merely drops the reference of the
+ * caller. Accesses to the cache are serialized internally, so readers that
+ * share it can be used from different threads. The cache cannot be copied.
+ */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -71,6 +89,51 @@ SQFS_API sqfs_meta_reader_t *sqfs_meta_reader_create(sqfs_file_t *file,
 						     sqfs_u64 start,
 						     sqfs_u64 limit);
 
+/**
+ * @brief Create a meta data block cache.
+ *
+ * @memberof sqfs_meta_cache_t
+ *
+ * @param max_size The maximum number of bytes the cache may use for storing
+ *                 blocks, including bookkeeping overhead. It is rounded up
+ *                 so that at least one block fits.
+ * @param flags Currently must be zero or the function fails.
+ *
+ * @return A pointer to a cache object on success, NULL on allocation failure
+ *         or if an unknown flag was set.
+ */
+SQFS_API sqfs_meta_cache_t *sqfs_meta_cache_create(size_t max_size,
+						   sqfs_u32 flags);
+
+/**
+ * @brief Get the number of cache hits and misses so far.
+ *
+ * @memberof sqfs_meta_cache_t
+ *
+ * @param cache A pointer to a cache object.
+ * @param hits Returns the number of lookups that found the block.
+ * @param misses Returns the number of lookups that had to read the block.
+ */
+SQFS_API void sqfs_meta_cache_get_stats(sqfs_meta_cache_t *cache,
+					sqfs_u64 *hits, sqfs_u64 *misses);
+
+/**
+ * @brief Make a meta data reader use a block cache.
+ *
+ * @memberof sqfs_meta_reader_t
+ *
+ * Whenever the reader needs a block that is not the current one, it first
+ * tries to fetch it from the cache and only reads and uncompresses it if
+ * that fails, adding the result to the cache. Copies of the reader share
+ * the same cache.
+ *
+ * @param m A pointer to a meta data reader.
+ * @param cache A pointer to a cache object or NULL to stop using the
+ *              current cache. The reader grabs its own reference.
+ */
+SQFS_API void sqfs_meta_reader_set_cache(sqfs_meta_reader_t *m,
+					 sqfs_meta_cache_t *cache);
+
 /**
  * @brief Seek to a specific meta data block and offset.
  *
@@ -68,7 +68,9 @@ typedef struct thread_pool_t {
 	 * This function guarantees to return the items in the same order as
 	 * they were submitted, so the function can actually block longer than
 	 * necessary, because it has to wait until the next item in sequence
-	 * is finished.
+	 * is finished. A pool created with
+	 * @ref thread_pool_create_unordered instead returns whatever item
+	 * is completed first.
 	 *
 	 * @return A pointer to a new work item or NULL if there are none
 	 *         in the pipeline.
@@ -104,6 +106,25 @@ extern "C" {
 SQFS_INTERNAL thread_pool_t *thread_pool_create(size_t num_jobs,
 						thread_pool_worker_t worker);
 
+/**
+ * @brief Create a thread pool instance that does not preserve ordering.
+ *
+ * This works exactly like @ref thread_pool_create, except that the dequeue
+ * function of the returned pool hands out completed items in the order in
+ * which the workers finish them, instead of the order they were submitted.
+ * This is useful if the work items are independent of each other and
+ * waiting for a slow item would only stall the pipeline.
+ *
+ * @param num_jobs The number of worker threads to launch.
+ * @param worker A function to call from the worker threads to process
+ *               the work items.
+ *
+ * @return A pointer to a thread pool on success, NULL on failure.
+ */
+SQFS_INTERNAL
+thread_pool_t *thread_pool_create_unordered(size_t num_jobs,
+					    thread_pool_worker_t worker);
+
 /**
  * @brief Create a serial mockup thread pool implementation.
  *
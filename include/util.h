@@ -30,6 +30,47 @@ void *alloc_array(size_t item_size, size_t nmemb);
 
 SQFS_INTERNAL sqfs_u32 xxh32(const void *input, const size_t len);
 
+typedef struct {
+	sqfs_u32 total_len;
+	sqfs_u32 large_len;
+	sqfs_u32 v1, v2, v3, v4;
+	sqfs_u32 mem32[4];
+	sqfs_u32 memsize;
+} xxh32_ctx_t;
+
+/*
+  Incremental xxHash32 with a seed of 0. Unlike xxh32 above, which seeds
+  one of its lanes differently and is only used for in-memory hashing, this
+  computes the reference digest, as stored in e.g. LZ4 frames.
+ */
+SQFS_INTERNAL void xxh32_init(xxh32_ctx_t *ctx);
+
+SQFS_INTERNAL void xxh32_update(xxh32_ctx_t *ctx, const void *input,
+				size_t len);
+
+SQFS_INTERNAL sqfs_u32 xxh32_final(const xxh32_ctx_t *ctx);
+
+#define SHA256_DIGEST_SIZE (32)
+
+typedef struct {
+	sqfs_u32 state[8];
+	sqfs_u64 count;
+	sqfs_u8 buffer[64];
+} sha256_ctx_t;
+
+/*
+  Incremental SHA-256. Data can be fed in chunks of arbitrary size,
+  sha256_final writes the digest and leaves the context unusable until
+  it is initialized again.
+ */
+SQFS_INTERNAL void sha256_init(sha256_ctx_t *ctx);
+
+SQFS_INTERNAL void sha256_update(sha256_ctx_t *ctx, const void *data,
+				 size_t size);
+
+SQFS_INTERNAL void sha256_final(sha256_ctx_t *ctx,
+				sqfs_u8 digest[SHA256_DIGEST_SIZE]);
+
 /*
   Returns true if the given region of memory is filled with zero-bytes only.
  */
@@ -0,0 +1,656 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * data_pipeline.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "config.h"
+#include "common.h"
+#include "threadpool.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+/*
+  The main thread reads the raw blocks of files from the image in the order
+  they are submitted. Decompression is done by an ordered thread pool, where
+  each worker owns a copy of the compressor. The pool returns the work items
+  in submission order, so they can be written to their output streams in
+  sequence, while later blocks are still being decompressed.
+ */
+#define RAW_BUFFER_SIZE (16384)
+
+enum {
+	ITEM_RAW = 0,
+	ITEM_FILE_BEGIN,
+	ITEM_SPARSE_BLOCK,
+	ITEM_DATA_BLOCK,
+	ITEM_FRAG_BLOCK,
+	ITEM_FRAG_TAIL,
+	ITEM_CLOSE,
+};
+
+typedef struct {
+	int type;
+
+	/* the stream the item is written to */
+	ostream_t *out;
+
+	/* on-disk size word of the block */
+	sqfs_u32 on_disk;
+
+	/* expected size after decompression */
+	size_t size;
+
+	/* for ITEM_FRAG_TAIL, offset of the tail end in the fragment block */
+	sqfs_u32 frag_off;
+
+	/* raw data when submitted, uncompressed data when dequeued */
+	sqfs_u8 *data;
+	size_t data_size;
+
+	/* for ITEM_FILE_BEGIN, the name used in error messages */
+	char *name;
+
+	int err;
+} work_item_t;
+
+struct data_pipeline_t {
+	sqfs_object_t base;
+
+	thread_pool_t *pool;
+	sqfs_compressor_t **cmp;
+	size_t num_workers;
+
+	size_t in_flight;
+	size_t max_in_flight;
+
+	/* producer side */
+	sqfs_file_t *file;
+	sqfs_frag_table_t *frag_tbl;
+	size_t block_size;
+	sqfs_u32 frag_idx;
+	bool have_frag;
+
+	work_item_t *raw;
+
+	/* consumer side */
+	char *name;
+	sqfs_u8 *frag_block;
+	size_t frag_size;
+	bool failed;
+};
+
+typedef struct {
+	ostream_t base;
+
+	data_pipeline_t *pl;
+	ostream_t *wrapped;
+} pipeline_ostream_t;
+
+static void free_item(work_item_t *item)
+{
+	if (item != NULL) {
+		if (item->type == ITEM_CLOSE)
+			sqfs_destroy(item->out);
+
+		free(item->data);
+		free(item->name);
+		free(item);
+	}
+}
+
+static int decompress_worker(void *user, void *work_item)
+{
+	sqfs_compressor_t *cmp = user;
+	work_item_t *item = work_item;
+	sqfs_s32 ret;
+	sqfs_u8 *out;
+
+	if (item->type != ITEM_DATA_BLOCK && item->type != ITEM_FRAG_BLOCK)
+		return 0;
+
+	if (item->data == NULL || !SQFS_IS_BLOCK_COMPRESSED(item->on_disk))
+		return 0;
+
+	out = alloc_array(1, item->size);
+	if (out == NULL) {
+		item->err = SQFS_ERROR_ALLOC;
+		goto out_free;
+	}
+
+	ret = cmp->do_block(cmp, item->data, item->data_size, out, item->size);
+	if (ret <= 0) {
+		item->err = ret < 0 ? ret : SQFS_ERROR_OVERFLOW;
+		free(out);
+		out = NULL;
+		ret = 0;
+	}
+
+	free(item->data);
+	item->data = out;
+	item->data_size = ret;
+	return 0;
+out_free:
+	free(item->data);
+	item->data = NULL;
+	item->data_size = 0;
+	return 0;
+}
+
+static int process_item(data_pipeline_t *pl, work_item_t *item)
+{
+	ostream_t *out = item->out;
+	int ret;
+
+	switch (item->type) {
+	case ITEM_RAW:
+		return ostream_append(out, item->data, item->data_size);
+	case ITEM_FILE_BEGIN:
+		free(pl->name);
+		pl->name = item->name;
+		item->name = NULL;
+		break;
+	case ITEM_SPARSE_BLOCK:
+		return ostream_append_sparse(out, item->size);
+	case ITEM_DATA_BLOCK:
+		if (item->err) {
+			sqfs_perror(pl->name, "reading data block", item->err);
+			return -1;
+		}
+
+		return ostream_append(out, item->data, item->data_size);
+	case ITEM_FRAG_BLOCK:
+		if (item->err) {
+			sqfs_perror(pl->name, "reading fragment block",
+				    item->err);
+			return -1;
+		}
+
+		free(pl->frag_block);
+		pl->frag_block = item->data;
+		pl->frag_size = item->data_size;
+		item->data = NULL;
+		break;
+	case ITEM_FRAG_TAIL:
+		if (pl->frag_block == NULL || item->frag_off > pl->frag_size ||
+		    item->size > pl->frag_size - item->frag_off) {
+			sqfs_perror(pl->name, "reading fragment block",
+				    SQFS_ERROR_OUT_OF_BOUNDS);
+			return -1;
+		}
+
+		return ostream_append(out, pl->frag_block + item->frag_off,
+				      item->size);
+	case ITEM_CLOSE:
+		ret = ostream_flush(out);
+		sqfs_destroy(out);
+		item->out = NULL;
+		return ret;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static int complete_item(data_pipeline_t *pl)
+{
+	work_item_t *item;
+	int ret;
+
+	item = pl->pool->dequeue(pl->pool);
+	if (item == NULL) {
+		fputs("unpacking file data: thread pool failure\n", stderr);
+		return -1;
+	}
+
+	pl->in_flight -= 1;
+	ret = process_item(pl, item);
+	free_item(item);
+	return ret;
+}
+
+static int submit_item(data_pipeline_t *pl, work_item_t *item)
+{
+	if (pl->failed) {
+		free_item(item);
+		return -1;
+	}
+
+	if (pl->pool->submit(pl->pool, item)) {
+		fputs("unpacking file data: error submitting work item\n",
+		      stderr);
+		free_item(item);
+		goto fail;
+	}
+
+	pl->in_flight += 1;
+
+	while (pl->in_flight >= pl->max_in_flight) {
+		if (complete_item(pl))
+			goto fail;
+	}
+
+	return 0;
+fail:
+	pl->failed = true;
+	return -1;
+}
+
+static work_item_t *create_item(int type, ostream_t *out)
+{
+	work_item_t *item = calloc(1, sizeof(*item));
+
+	if (item == NULL) {
+		perror("creating work item");
+		return NULL;
+	}
+
+	item->type = type;
+	item->out = out;
+	return item;
+}
+
+/* raw data is collected and submitted in larger chunks */
+static int submit_raw(data_pipeline_t *pl)
+{
+	work_item_t *item = pl->raw;
+
+	if (item == NULL)
+		return 0;
+
+	pl->raw = NULL;
+	return submit_item(pl, item);
+}
+
+static int submit_typed(data_pipeline_t *pl, work_item_t *item)
+{
+	if (submit_raw(pl)) {
+		free_item(item);
+		return -1;
+	}
+
+	return submit_item(pl, item);
+}
+
+static void read_raw(data_pipeline_t *pl, work_item_t *item,
+		     sqfs_u64 location)
+{
+	sqfs_u32 on_disk_size = SQFS_ON_DISK_BLOCK_SIZE(item->on_disk);
+
+	if (on_disk_size > item->size) {
+		item->err = SQFS_ERROR_OVERFLOW;
+		return;
+	}
+
+	/* like the data reader, pass uncompressed blocks through as-is, but
+	   in a buffer with the full uncompressed size */
+	item->data = alloc_array(1, SQFS_IS_BLOCK_COMPRESSED(item->on_disk) ?
+				 on_disk_size : item->size);
+	if (item->data == NULL) {
+		item->err = SQFS_ERROR_ALLOC;
+		return;
+	}
+
+	item->err = pl->file->read_at(pl->file, location, item->data,
+				      on_disk_size);
+	if (item->err) {
+		free(item->data);
+		item->data = NULL;
+		return;
+	}
+
+	item->data_size = on_disk_size;
+}
+
+static int submit_fragment(data_pipeline_t *pl, ostream_t *out,
+			   const sqfs_inode_generic_t *inode, sqfs_u64 filesz)
+{
+	sqfs_u32 frag_idx, frag_off;
+	sqfs_fragment_t ent;
+	work_item_t *item;
+	int ret;
+
+	sqfs_inode_get_frag_location(inode, &frag_idx, &frag_off);
+
+	if (!pl->have_frag || pl->frag_idx != frag_idx) {
+		item = create_item(ITEM_FRAG_BLOCK, out);
+		if (item == NULL)
+			return -1;
+
+		item->size = pl->block_size;
+
+		ret = sqfs_frag_table_lookup(pl->frag_tbl, frag_idx, &ent);
+		if (ret != 0) {
+			item->err = ret;
+		} else {
+			item->on_disk = ent.size;
+			read_raw(pl, item, ent.start_offset);
+		}
+
+		if (submit_typed(pl, item))
+			return -1;
+
+		pl->frag_idx = frag_idx;
+		pl->have_frag = true;
+	}
+
+	item = create_item(ITEM_FRAG_TAIL, out);
+	if (item == NULL)
+		return -1;
+
+	item->size = filesz;
+	item->frag_off = frag_off;
+	return submit_typed(pl, item);
+}
+
+int data_pipeline_dump_file(data_pipeline_t *pl, ostream_t *out,
+			    const char *name,
+			    const sqfs_inode_generic_t *inode)
+{
+	sqfs_u64 location, filesz;
+	size_t i, count, diff;
+	work_item_t *item;
+
+	item = create_item(ITEM_FILE_BEGIN, out);
+	if (item == NULL)
+		return -1;
+
+	item->name = strdup(name);
+	if (item->name == NULL) {
+		perror(name);
+		free_item(item);
+		return -1;
+	}
+
+	if (submit_typed(pl, item))
+		return -1;
+
+	sqfs_inode_get_file_block_start(inode, &location);
+	sqfs_inode_get_file_size(inode, &filesz);
+	count = sqfs_inode_get_file_block_count(inode);
+
+	for (i = 0; i < count; ++i) {
+		diff = (filesz < pl->block_size) ? filesz : pl->block_size;
+
+		if (SQFS_IS_SPARSE_BLOCK(inode->extra[i])) {
+			item = create_item(ITEM_SPARSE_BLOCK, out);
+			if (item == NULL)
+				return -1;
+
+			item->size = diff;
+		} else {
+			item = create_item(ITEM_DATA_BLOCK, out);
+			if (item == NULL)
+				return -1;
+
+			item->on_disk = inode->extra[i];
+			item->size = diff;
+			read_raw(pl, item, location);
+			location += SQFS_ON_DISK_BLOCK_SIZE(inode->extra[i]);
+		}
+
+		if (submit_typed(pl, item))
+			return -1;
+
+		filesz -= diff;
+	}
+
+	if (filesz > 0)
+		return submit_fragment(pl, out, inode, filesz);
+
+	return 0;
+}
+
+int data_pipeline_append(data_pipeline_t *pl, ostream_t *out,
+			 const void *data, size_t size)
+{
+	work_item_t *item;
+	size_t diff;
+
+	if (pl->raw != NULL && pl->raw->out != out) {
+		if (submit_raw(pl))
+			return -1;
+	}
+
+	while (size > 0) {
+		if (pl->raw == NULL) {
+			item = create_item(ITEM_RAW, out);
+			if (item == NULL)
+				return -1;
+
+			item->data = malloc(RAW_BUFFER_SIZE);
+			if (item->data == NULL) {
+				perror("queueing output data");
+				free_item(item);
+				return -1;
+			}
+
+			pl->raw = item;
+		}
+
+		diff = RAW_BUFFER_SIZE - pl->raw->data_size;
+		if (diff > size)
+			diff = size;
+
+		memcpy(pl->raw->data + pl->raw->data_size, data, diff);
+		pl->raw->data_size += diff;
+
+		data = (const char *)data + diff;
+		size -= diff;
+
+		if (pl->raw->data_size == RAW_BUFFER_SIZE) {
+			if (submit_raw(pl))
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+int data_pipeline_append_sparse(data_pipeline_t *pl, ostream_t *out,
+				size_t size)
+{
+	work_item_t *item;
+
+	item = create_item(ITEM_SPARSE_BLOCK, out);
+	if (item == NULL)
+		return -1;
+
+	item->size = size;
+	return submit_typed(pl, item);
+}
+
+int data_pipeline_close(data_pipeline_t *pl, ostream_t *out)
+{
+	work_item_t *item;
+
+	item = create_item(ITEM_CLOSE, out);
+	if (item == NULL) {
+		sqfs_destroy(out);
+		return -1;
+	}
+
+	return submit_typed(pl, item);
+}
+
+int data_pipeline_flush(data_pipeline_t *pl)
+{
+	if (submit_raw(pl))
+		return -1;
+
+	while (pl->in_flight > 0) {
+		if (complete_item(pl)) {
+			pl->failed = true;
+			return -1;
+		}
+	}
+
+	return pl->failed ? -1 : 0;
+}
+
+static void pipeline_destroy(sqfs_object_t *obj)
+{
+	data_pipeline_t *pl = (data_pipeline_t *)obj;
+	work_item_t *item;
+	size_t i;
+
+	if (pl->pool != NULL) {
+		while (pl->in_flight > 0) {
+			item = pl->pool->dequeue(pl->pool);
+			if (item == NULL)
+				break;
+
+			pl->in_flight -= 1;
+			free_item(item);
+		}
+
+		pl->pool->destroy(pl->pool);
+	}
+
+	if (pl->cmp != NULL) {
+		for (i = 0; i < pl->num_workers; ++i)
+			sqfs_destroy(pl->cmp[i]);
+		free(pl->cmp);
+	}
+
+	free_item(pl->raw);
+	free(pl->frag_block);
+	free(pl->name);
+
+	if (pl->frag_tbl != NULL)
+		sqfs_destroy(pl->frag_tbl);
+
+	free(pl);
+}
+
+data_pipeline_t *data_pipeline_create(sqfs_file_t *file,
+				      const sqfs_super_t *super,
+				      sqfs_compressor_t *cmp, size_t num_jobs)
+{
+	data_pipeline_t *pl = calloc(1, sizeof(*pl));
+	sqfs_object_t *obj = (sqfs_object_t *)pl;
+	size_t i;
+	int ret;
+
+	if (pl == NULL) {
+		perror("creating data pipeline");
+		return NULL;
+	}
+
+	pl->file = file;
+	pl->block_size = super->block_size;
+	obj->destroy = pipeline_destroy;
+
+	pl->frag_tbl = sqfs_frag_table_create(0);
+	if (pl->frag_tbl == NULL) {
+		perror("creating fragment table");
+		goto fail;
+	}
+
+	ret = sqfs_frag_table_read(pl->frag_tbl, file, super, cmp);
+	if (ret) {
+		sqfs_perror(NULL, "loading fragment table", ret);
+		goto fail;
+	}
+
+	pl->pool = thread_pool_create(num_jobs, decompress_worker);
+	if (pl->pool == NULL) {
+		perror("creating thread pool");
+		goto fail;
+	}
+
+	pl->num_workers = pl->pool->get_worker_count(pl->pool);
+	pl->max_in_flight = 4 * pl->num_workers;
+
+	pl->cmp = calloc(pl->num_workers, sizeof(pl->cmp[0]));
+	if (pl->cmp == NULL) {
+		perror("creating compressor copies");
+		goto fail;
+	}
+
+	for (i = 0; i < pl->num_workers; ++i) {
+		pl->cmp[i] = sqfs_copy(cmp);
+		if (pl->cmp[i] == NULL) {
+			fputs("Error creating compressor copies.\n", stderr);
+			goto fail;
+		}
+
+		pl->pool->set_worker_ptr(pl->pool, i, pl->cmp[i]);
+	}
+
+	return pl;
+fail:
+	sqfs_destroy(pl);
+	return NULL;
+}
+
+/*****************************************************************************/
+
+static int stream_append(ostream_t *strm, const void *data, size_t size)
+{
+	pipeline_ostream_t *pos = (pipeline_ostream_t *)strm;
+
+	return data_pipeline_append(pos->pl, pos->wrapped, data, size);
+}
+
+static int stream_append_sparse(ostream_t *strm, size_t size)
+{
+	pipeline_ostream_t *pos = (pipeline_ostream_t *)strm;
+
+	return data_pipeline_append_sparse(pos->pl, pos->wrapped, size);
+}
+
+static int stream_flush(ostream_t *strm)
+{
+	pipeline_ostream_t *pos = (pipeline_ostream_t *)strm;
+
+	if (data_pipeline_flush(pos->pl))
+		return -1;
+
+	return ostream_flush(pos->wrapped);
+}
+
+static const char *stream_get_filename(ostream_t *strm)
+{
+	pipeline_ostream_t *pos = (pipeline_ostream_t *)strm;
+
+	return ostream_get_filename(pos->wrapped);
+}
+
+static void stream_destroy(sqfs_object_t *obj)
+{
+	pipeline_ostream_t *pos = (pipeline_ostream_t *)obj;
+
+	/* drains the pipeline, which may still refer to the stream */
+	sqfs_destroy(pos->pl);
+	sqfs_destroy(pos->wrapped);
+	free(pos);
+}
+
+ostream_t *data_pipeline_ostream_create(data_pipeline_t *pl, ostream_t *out)
+{
+	pipeline_ostream_t *pos = calloc(1, sizeof(*pos));
+	sqfs_object_t *obj = (sqfs_object_t *)pos;
+	ostream_t *strm = (ostream_t *)pos;
+
+	if (pos == NULL) {
+		perror("creating data pipeline stream");
+		sqfs_destroy(pl);
+		sqfs_destroy(out);
+		return NULL;
+	}
+
+	pos->pl = pl;
+	pos->wrapped = out;
+
+	strm->append = stream_append;
+	strm->append_sparse = stream_append_sparse;
+	strm->flush = stream_flush;
+	strm->get_filename = stream_get_filename;
+	obj->destroy = stream_destroy;
+	return strm;
+}
@@ -5,17 +5,22 @@
  * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
  */
 #include "common.h"
+#include "util.h"
 
 static sqfs_u8 buffer[4096];
 
 int write_data_from_file(const char *filename, sqfs_block_processor_t *data,
 			 sqfs_inode_generic_t **inode, sqfs_file_t *file,
-			 int flags)
+			 int flags, sqfs_u8 *digest)
 {
 	sqfs_u64 filesz, offset;
+	sha256_ctx_t sha;
 	size_t diff;
 	int ret;
 
+	if (digest != NULL)
+		sha256_init(&sha);
+
 	ret = sqfs_block_processor_begin_file(data, inode, NULL, flags);
 	if (ret) {
 		sqfs_perror(filename, "beginning file data blocks", ret);
@@ -37,6 +42,9 @@ int write_data_from_file(const char *filename, sqfs_block_processor_t *data,
 			return -1;
 		}
 
+		if (digest != NULL)
+			sha256_update(&sha, buffer, diff);
+
 		ret = sqfs_block_processor_append(data, buffer, diff);
 		if (ret) {
 			sqfs_perror(filename, "packing file data", ret);
@@ -50,5 +58,8 @@ int write_data_from_file(const char *filename, sqfs_block_processor_t *data,
 		return -1;
 	}
 
+	if (digest != NULL)
+		sha256_final(&sha, digest);
+
 	return 0;
 }
@@ -6,6 +6,7 @@
  */
 #include "config.h"
 #include "common.h"
+#include "util.h"
 
 #include <stdlib.h>
 
@@ -14,6 +15,9 @@ typedef struct{
 
 	sqfs_block_processor_t *proc;
 	const char *filename;
+
+	sqfs_u8 *digest;
+	sha256_ctx_t sha;
 } data_writer_ostream_t;
 
 static int stream_append(ostream_t *base, const void *data, size_t size)
@@ -21,6 +25,9 @@ static int stream_append(ostream_t *base, const void *data, size_t size)
 	data_writer_ostream_t *strm = (data_writer_ostream_t *)base;
 	int ret;
 
+	if (strm->digest != NULL)
+		sha256_update(&strm->sha, data, size);
+
 	ret = sqfs_block_processor_append(strm->proc, data, size);
 
 	if (ret != 0) {
@@ -31,6 +38,47 @@ static int stream_append(ostream_t *base, const void *data, size_t size)
 	return 0;
 }
 
+static sqfs_s32 stream_append_from_istream(ostream_t *base, istream_t *in,
+					   sqfs_u32 size)
+{
+	data_writer_ostream_t *strm = (data_writer_ostream_t *)base;
+	sqfs_s32 ret, total = 0;
+	sqfs_u8 *data;
+	size_t avail;
+	int err;
+
+	while (size > 0) {
+		err = sqfs_block_processor_get_buffer(strm->proc,
+						      &data, &avail);
+		if (err != 0)
+			goto fail;
+
+		if (avail > size)
+			avail = size;
+
+		ret = istream_read(in, data, avail);
+		if (ret < 0)
+			return -1;
+		if (ret == 0)
+			break;
+
+		if (strm->digest != NULL)
+			sha256_update(&strm->sha, data, ret);
+
+		err = sqfs_block_processor_commit(strm->proc, ret);
+		if (err != 0)
+			goto fail;
+
+		size -= ret;
+		total += ret;
+	}
+
+	return total;
+fail:
+	sqfs_perror(strm->filename, NULL, err);
+	return -1;
+}
+
 static int stream_flush(ostream_t *base)
 {
 	data_writer_ostream_t *strm = (data_writer_ostream_t *)base;
@@ -43,6 +91,9 @@ static int stream_flush(ostream_t *base)
 		return -1;
 	}
 
+	if (strm->digest != NULL)
+		sha256_final(&strm->sha, strm->digest);
+
 	return 0;
 }
 
@@ -61,7 +112,7 @@ static void stream_destroy(sqfs_object_t *base)
 ostream_t *data_writer_ostream_create(const char *filename,
 				      sqfs_block_processor_t *proc,
 				      sqfs_inode_generic_t **inode,
-				      int flags)
+				      int flags, sqfs_u8 *digest)
 {
 	data_writer_ostream_t *strm = calloc(1, sizeof(*strm));
 	sqfs_object_t *obj = (sqfs_object_t *)strm;
@@ -83,7 +134,13 @@ ostream_t *data_writer_ostream_create(const char *filename,
 
 	strm->proc = proc;
 	strm->filename = filename;
+	strm->digest = digest;
+
+	if (digest != NULL)
+		sha256_init(&strm->sha);
+
 	base->append = stream_append;
+	base->append_from_istream = stream_append_from_istream;
 	base->flush = stream_flush;
 	base->get_filename = stream_get_filename;
 	obj->destroy = stream_destroy;
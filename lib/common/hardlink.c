@@ -6,6 +6,7 @@
  */
 #include "common.h"
 #include "rbtree.h"
+#include "hash_table.h"
 
 #include <stdlib.h>
 #include <assert.h>
@@ -110,3 +111,62 @@ int sqfs_tree_find_hard_links(const sqfs_tree_node_t *root,
 
 	return 0;
 }
+
+/* integer finalizer from MurmurHash3 */
+static sqfs_u32 inum_hash(sqfs_u32 x)
+{
+	x ^= x >> 16;
+	x *= 0x85ebca6b;
+	x ^= x >> 13;
+	x *= 0xc2b2ae35;
+	x ^= x >> 16;
+	return x;
+}
+
+static bool inum_equals(void *user, const void *a, const void *b)
+{
+	(void)user;
+	return *((const sqfs_u32 *)a) == *((const sqfs_u32 *)b);
+}
+
+struct hash_table *sqfs_hard_link_index_create(void)
+{
+	struct hash_table *ht = hash_table_create(NULL, inum_equals);
+
+	if (ht == NULL)
+		perror("creating hard link index");
+
+	return ht;
+}
+
+int sqfs_hard_link_index_add(struct hash_table *ht, sqfs_hard_link_t *lnk)
+{
+	sqfs_u32 hash = inum_hash(lnk->inode_number);
+
+	if (hash_table_search_pre_hashed(ht, hash, &lnk->inode_number))
+		return 0;
+
+	if (hash_table_insert_pre_hashed(ht, hash, &lnk->inode_number,
+					 lnk) == NULL) {
+		perror("indexing hard link");
+		return -1;
+	}
+
+	return 0;
+}
+
+sqfs_hard_link_t *sqfs_hard_link_index_find(struct hash_table *ht,
+					    sqfs_u32 inum)
+{
+	struct hash_entry *ent;
+
+	ent = hash_table_search_pre_hashed(ht, inum_hash(inum), &inum);
+
+	return ent == NULL ? NULL : ent->data;
+}
+
+void sqfs_hard_link_index_destroy(struct hash_table *ht)
+{
+	if (ht != NULL)
+		hash_table_destroy(ht, NULL);
+}
@@ -0,0 +1,385 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * manifest.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "config.h"
+#include "manifest.h"
+#include "common.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+static int entry_path_cmp(const void *lhs, const void *rhs)
+{
+	const manifest_entry_t *a = *((manifest_entry_t *const *)lhs);
+	const manifest_entry_t *b = *((manifest_entry_t *const *)rhs);
+
+	return strcmp(a->path, b->path);
+}
+
+static manifest_entry_t *append_entry(manifest_t *m)
+{
+	manifest_entry_t **new, *ent;
+	size_t new_sz;
+
+	if (m->count == m->max) {
+		new_sz = m->max ? m->max * 2 : 128;
+		new = realloc(m->entries, sizeof(new[0]) * new_sz);
+		if (new == NULL)
+			return NULL;
+
+		m->entries = new;
+		m->max = new_sz;
+	}
+
+	ent = calloc(1, sizeof(*ent));
+	if (ent == NULL)
+		return NULL;
+
+	m->entries[m->count++] = ent;
+	return ent;
+}
+
+manifest_t *manifest_create(void)
+{
+	manifest_t *m = calloc(1, sizeof(*m));
+
+	if (m == NULL)
+		perror("creating file manifest");
+
+	return m;
+}
+
+void manifest_destroy(manifest_t *m)
+{
+	size_t i;
+
+	if (m == NULL)
+		return;
+
+	for (i = 0; i < m->count; ++i) {
+		free(m->entries[i]->path);
+		free(m->entries[i]);
+	}
+
+	free(m->entries);
+	free(m);
+}
+
+manifest_entry_t *manifest_add_file(manifest_t *m, const file_info_t *fi)
+{
+	manifest_entry_t *ent = append_entry(m);
+
+	if (ent == NULL) {
+		perror("recording file manifest entry");
+		return NULL;
+	}
+
+	ent->fi = fi;
+	return ent;
+}
+
+void manifest_sort(manifest_t *m)
+{
+	if (m->count > 1) {
+		qsort(m->entries, m->count, sizeof(m->entries[0]),
+		      entry_path_cmp);
+	}
+}
+
+/*****************************************************************************/
+
+static int entry_fi_cmp(const void *lhs, const void *rhs)
+{
+	const manifest_entry_t *a = *((manifest_entry_t *const *)lhs);
+	const manifest_entry_t *b = *((manifest_entry_t *const *)rhs);
+
+	return (a->fi < b->fi) ? -1 : ((a->fi > b->fi) ? 1 : 0);
+}
+
+static manifest_entry_t *find_by_fi(manifest_t *m, const file_info_t *fi)
+{
+	manifest_entry_t key, *kptr = &key, **ret;
+
+	key.fi = fi;
+	ret = bsearch(&kptr, m->entries, m->count, sizeof(m->entries[0]),
+		      entry_fi_cmp);
+
+	return ret == NULL ? NULL : *ret;
+}
+
+/*
+  Hard links are resolved at this point, so every name of a file gets its own
+  line, with the inode number and digest of the link target.
+ */
+static int collect_dfs(manifest_t *m, manifest_t *out, tree_node_t *n)
+{
+	manifest_entry_t *src, *ent;
+	tree_node_t *tgt = n;
+
+	if (S_ISDIR(n->mode)) {
+		for (n = n->data.dir.children; n != NULL; n = n->next) {
+			if (collect_dfs(m, out, n))
+				return -1;
+		}
+		return 0;
+	}
+
+	if (n->mode == FSTREE_MODE_HARD_LINK_RESOLVED)
+		tgt = n->data.target_node;
+
+	if (!S_ISREG(tgt->mode))
+		return 0;
+
+	src = find_by_fi(m, &tgt->data.file);
+	if (src == NULL)
+		return 0;
+
+	ent = append_entry(out);
+	if (ent == NULL)
+		goto fail_errno;
+
+	ent->inode_num = tgt->inode_num;
+	memcpy(ent->digest, src->digest, sizeof(ent->digest));
+
+	if (tgt->data.file.inode != NULL)
+		sqfs_inode_get_file_size(tgt->data.file.inode, &ent->size);
+
+	ent->path = fstree_get_path(n);
+	if (ent->path == NULL)
+		goto fail_errno;
+
+	if (canonicalize_name(ent->path)) {
+		fprintf(stderr, "failed to canonicalize '%s'\n", ent->path);
+		return -1;
+	}
+
+	return 0;
+fail_errno:
+	perror("recording file manifest entry");
+	return -1;
+}
+
+static size_t escape_path(char *out, const char *path)
+{
+	size_t len = 0;
+
+	for (; *path != '\0'; ++path) {
+		if (*path == '\\' || *path == '\n') {
+			if (out != NULL) {
+				out[len] = '\\';
+				out[len + 1] = (*path == '\n') ? 'n' : '\\';
+			}
+			len += 2;
+		} else {
+			if (out != NULL)
+				out[len] = *path;
+			len += 1;
+		}
+	}
+
+	return len;
+}
+
+static int write_entry(ostream_t *out, const manifest_entry_t *ent)
+{
+	char *line, *ptr;
+	size_t i, len;
+	int ret;
+
+	len = 2 * SHA256_DIGEST_SIZE + 2 * 32 + escape_path(NULL, ent->path);
+
+	line = malloc(len + 2);
+	if (line == NULL) {
+		perror(ent->path);
+		return -1;
+	}
+
+	ptr = line;
+
+	for (i = 0; i < SHA256_DIGEST_SIZE; ++i) {
+		sprintf(ptr, "%02x", ent->digest[i]);
+		ptr += 2;
+	}
+
+	ptr += sprintf(ptr, " %llu %u ", (unsigned long long)ent->size,
+		       (unsigned int)ent->inode_num);
+	ptr += escape_path(ptr, ent->path);
+	*(ptr++) = '\n';
+
+	ret = ostream_append(out, line, ptr - line);
+	free(line);
+	return ret;
+}
+
+int manifest_write(manifest_t *m, fstree_t *fs, ostream_t *out)
+{
+	int status = -1;
+	manifest_t *lst;
+	size_t i;
+
+	lst = manifest_create();
+	if (lst == NULL)
+		return -1;
+
+	if (m->count > 1) {
+		qsort(m->entries, m->count, sizeof(m->entries[0]),
+		      entry_fi_cmp);
+	}
+
+	if (collect_dfs(m, lst, fs->root))
+		goto out;
+
+	manifest_sort(lst);
+
+	for (i = 0; i < lst->count; ++i) {
+		if (write_entry(out, lst->entries[i]))
+			goto out;
+	}
+
+	if (ostream_flush(out))
+		goto out;
+
+	status = 0;
+out:
+	manifest_destroy(lst);
+	return status;
+}
+
+/*****************************************************************************/
+
+static int hex_value(int c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static int unescape_path(char *path)
+{
+	char *out = path;
+
+	for (; *path != '\0'; ++path) {
+		if (*path != '\\') {
+			*(out++) = *path;
+			continue;
+		}
+
+		++path;
+
+		if (*path == 'n') {
+			*(out++) = '\n';
+		} else if (*path == '\\') {
+			*(out++) = '\\';
+		} else {
+			return -1;
+		}
+	}
+
+	*out = '\0';
+	return 0;
+}
+
+static int parse_line(manifest_entry_t *ent, const char *line)
+{
+	unsigned long long size;
+	unsigned long inum;
+	int hi, lo, i;
+	char *end;
+
+	for (i = 0; i < SHA256_DIGEST_SIZE; ++i) {
+		hi = hex_value(line[2 * i]);
+		lo = hex_value(hi < 0 ? '\0' : line[2 * i + 1]);
+		if (hi < 0 || lo < 0)
+			return -1;
+
+		ent->digest[i] = (sqfs_u8)((hi << 4) | lo);
+	}
+
+	line += 2 * SHA256_DIGEST_SIZE;
+	if (*(line++) != ' ')
+		return -1;
+
+	size = strtoull(line, &end, 10);
+	if (end == line || *end != ' ')
+		return -1;
+	line = end + 1;
+
+	inum = strtoul(line, &end, 10);
+	if (end == line || *end != ' ' || inum > 0xFFFFFFFFUL)
+		return -1;
+	line = end + 1;
+
+	if (*line == '\0')
+		return -1;
+
+	ent->size = size;
+	ent->inode_num = inum;
+	ent->path = strdup(line);
+
+	if (ent->path == NULL)
+		return -1;
+
+	return unescape_path(ent->path);
+}
+
+manifest_t *manifest_read(const char *filename)
+{
+	manifest_entry_t *ent;
+	size_t line_num = 1;
+	istream_t *fp;
+	manifest_t *m;
+	char *line;
+	int ret;
+
+	fp = istream_open_file(filename);
+	if (fp == NULL)
+		return NULL;
+
+	m = manifest_create();
+	if (m == NULL)
+		goto fail_fp;
+
+	for (;;) {
+		ret = istream_get_line(fp, &line, &line_num,
+				       ISTREAM_LINE_SKIP_EMPTY);
+		if (ret < 0)
+			goto fail;
+		if (ret > 0)
+			break;
+
+		ent = append_entry(m);
+		if (ent == NULL) {
+			perror(filename);
+			free(line);
+			goto fail;
+		}
+
+		if (parse_line(ent, line)) {
+			fprintf(stderr, "%s: " PRI_SZ ": malformed manifest "
+				"entry\n", filename, line_num);
+			free(line);
+			goto fail;
+		}
+
+		free(line);
+		++line_num;
+	}
+
+	manifest_sort(m);
+
+	sqfs_destroy(fp);
+	return m;
+fail:
+	manifest_destroy(m);
+fail_fp:
+	sqfs_destroy(fp);
+	return NULL;
+}
@@ -8,7 +8,7 @@
 
 #include <stdio.h>
 
-void sqfs_perror(const char *file, const char *action, int error_code)
+const char *sqfs_error_string(int error_code)
 {
 	const char *errstr;
 
@@ -69,6 +69,13 @@ void sqfs_perror(const char *file, const char *action, int error_code)
 		break;
 	}
 
+	return errstr;
+}
+
+void sqfs_perror(const char *file, const char *action, int error_code)
+{
+	const char *errstr = sqfs_error_string(error_code);
+
 	if (file != NULL)
 		fprintf(stderr, "%s: ", file);
 
@@ -24,6 +24,10 @@ void sqfs_writer_cleanup(sqfs_writer_t *sqfs, int status)
 	sqfs_destroy(sqfs->uncmp);
 	fstree_cleanup(&sqfs->fs);
 	sqfs_destroy(sqfs->outfile);
+	manifest_destroy(sqfs->manifest);
+
+	if (sqfs->manifest_file != NULL)
+		sqfs_destroy(sqfs->manifest_file);
 
 	if (status != EXIT_SUCCESS) {
 #if defined(_WIN32) || defined(__WINDOWS__)
@@ -101,6 +101,16 @@ int sqfs_writer_finish(sqfs_writer_t *sqfs, const sqfs_writer_cfg_t *cfg)
 		return -1;
 	}
 
+	if (sqfs->manifest != NULL) {
+		if (!cfg->quiet)
+			fputs("Writing content manifest...\n", stdout);
+
+		if (manifest_write(sqfs->manifest, &sqfs->fs,
+				   sqfs->manifest_file)) {
+			return -1;
+		}
+	}
+
 	if (!cfg->quiet)
 		fputs("Writing inodes and directories...\n", stdout);
 
@@ -169,6 +179,14 @@ int sqfs_writer_finish(sqfs_writer_t *sqfs, const sqfs_writer_cfg_t *cfg)
 		return -1;
 	}
 
+	if (sqfs->outfile->flush != NULL) {
+		ret = sqfs->outfile->flush(sqfs->outfile);
+		if (ret) {
+			sqfs_perror(cfg->filename, "writing image", ret);
+			return -1;
+		}
+	}
+
 	if (!cfg->quiet)
 		print_statistics(&sqfs->super, sqfs->data, sqfs->blkwr);
 
@@ -45,6 +45,8 @@ int sqfs_writer_init(sqfs_writer_t *sqfs, const sqfs_writer_cfg_t *wrcfg)
 	int ret, flags;
 
 	sqfs->filename = wrcfg->filename;
+	sqfs->manifest = NULL;
+	sqfs->manifest_file = NULL;
 
 	if (compressor_cfg_init_options(&cfg, wrcfg->comp_id,
 					wrcfg->block_size,
@@ -52,7 +54,8 @@ int sqfs_writer_init(sqfs_writer_t *sqfs, const sqfs_writer_cfg_t *wrcfg)
 		return -1;
 	}
 
-	sqfs->outfile = sqfs_open_file(wrcfg->filename, wrcfg->outmode);
+	sqfs->outfile = sqfs_open_file(wrcfg->filename,
+				       wrcfg->outmode | SQFS_FILE_OPEN_ASYNC_IO);
 	if (sqfs->outfile == NULL) {
 		perror(wrcfg->filename);
 		return -1;
@@ -187,7 +190,23 @@ int sqfs_writer_init(sqfs_writer_t *sqfs, const sqfs_writer_cfg_t *wrcfg)
 		goto fail_dm;
 	}
 
+	if (wrcfg->manifest != NULL) {
+		sqfs->manifest = manifest_create();
+		if (sqfs->manifest == NULL)
+			goto fail_dirwr;
+
+		/* opened right away, the packers may chdir() later on */
+		sqfs->manifest_file = ostream_open_file(wrcfg->manifest,
+							OSTREAM_OPEN_OVERWRITE);
+		if (sqfs->manifest_file == NULL)
+			goto fail_manifest;
+	}
+
 	return 0;
+fail_manifest:
+	manifest_destroy(sqfs->manifest);
+fail_dirwr:
+	sqfs_destroy(sqfs->dirwr);
 fail_dm:
 	sqfs_destroy(sqfs->dm);
 fail_im:
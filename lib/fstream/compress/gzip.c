@@ -57,6 +57,42 @@ static int flush_inbuf(ostream_comp_t *base, bool finish)
 	return 0;
 }
 
+/*
+  Compress a unit into a complete gzip member. A sequence of members is
+  still a valid gzip file, so units can be compressed in parallel.
+ */
+static int encode_unit(void *user, void *item)
+{
+	comp_unit_t *unit = item;
+	z_stream strm;
+	int ret;
+	(void)user;
+
+	memset(&strm, 0, sizeof(strm));
+	ret = deflateInit2(&strm, 9, Z_DEFLATED, 16 + 15, 8,
+			   Z_DEFAULT_STRATEGY);
+	if (ret != Z_OK) {
+		unit->status = -1;
+		return 0;
+	}
+
+	strm.next_in = unit->in;
+	strm.avail_in = unit->in_size;
+	strm.next_out = unit->out;
+	strm.avail_out = unit->out_size;
+
+	ret = deflate(&strm, Z_FINISH);
+
+	if (ret == Z_STREAM_END) {
+		unit->out_size -= strm.avail_out;
+	} else {
+		unit->status = -1;
+	}
+
+	deflateEnd(&strm);
+	return 0;
+}
+
 static void cleanup(ostream_comp_t *base)
 {
 	ostream_gzip_t *gzip = (ostream_gzip_t *)base;
@@ -88,5 +124,7 @@ ostream_comp_t *ostream_gzip_create(const char *filename)
 
 	base->flush_inbuf = flush_inbuf;
 	base->cleanup = cleanup;
+	base->encode_unit = encode_unit;
+	base->unit_bound = deflateBound(&gzip->strm, BUFSZ);
 	return base;
 }
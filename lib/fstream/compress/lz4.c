@@ -0,0 +1,127 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * lz4.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "../internal.h"
+
+#include <lz4.h>
+
+/*
+  Each buffer is written as a frame of its own, holding a single block.
+  Concatenated frames are a valid LZ4 stream and the frames are entirely
+  independent of each other, so they can also be compressed in parallel.
+ */
+#define HEADER_SIZE (4 + 2 + 8 + 1)
+#define FRAME_BOUND(size) (HEADER_SIZE + 4 + (size) + 4 + 4)
+
+/* 256 KiB blocks, same as BUFSZ */
+#define BLOCK_SIZE_ID (5)
+
+typedef struct {
+	ostream_comp_t base;
+
+	sqfs_u8 frame[FRAME_BOUND(BUFSZ)];
+} ostream_lz4_t;
+
+static void write_le32(sqfs_u8 *ptr, sqfs_u32 value)
+{
+	value = htole32(value);
+	memcpy(ptr, &value, sizeof(value));
+}
+
+static sqfs_u32 hash(const void *data, size_t size)
+{
+	xxh32_ctx_t ctx;
+
+	xxh32_init(&ctx);
+	xxh32_update(&ctx, data, size);
+	return xxh32_final(&ctx);
+}
+
+static size_t encode_frame(const sqfs_u8 *in, size_t size, sqfs_u8 *out)
+{
+	sqfs_u8 *ptr = out;
+	sqfs_u64 csize;
+	int ret;
+
+	write_le32(ptr, LZ4_FRAME_MAGIC);
+	ptr[4] = LZ4_FLG_VERSION | LZ4_FLG_BLOCK_INDEP |
+		LZ4_FLG_CONTENT_SIZE | LZ4_FLG_CONTENT_CHECKSUM;
+	ptr[5] = BLOCK_SIZE_ID << LZ4_BD_SHIFT;
+
+	csize = htole64(size);
+	memcpy(ptr + 6, &csize, sizeof(csize));
+
+	ptr[14] = (hash(ptr + 4, HEADER_SIZE - 5) >> 8) & 0xFF;
+	ptr += HEADER_SIZE;
+
+	if (size > 0) {
+		/* store the block as-is if compressing does not shrink it */
+		ret = LZ4_compress_default((const char *)in, (char *)ptr + 4,
+					   size, size - 1);
+
+		if (ret > 0) {
+			write_le32(ptr, ret);
+			ptr += 4 + ret;
+		} else {
+			write_le32(ptr, size | LZ4_BLOCK_UNCOMPRESSED);
+			memcpy(ptr + 4, in, size);
+			ptr += 4 + size;
+		}
+	}
+
+	write_le32(ptr, 0);
+	write_le32(ptr + 4, hash(in, size));
+	ptr += 8;
+
+	return ptr - out;
+}
+
+static int flush_inbuf(ostream_comp_t *base, bool finish)
+{
+	ostream_lz4_t *lz4 = (ostream_lz4_t *)base;
+	size_t size;
+	(void)finish;
+
+	size = encode_frame(base->inbuf, base->inbuf_used, lz4->frame);
+
+	if (base->wrapped->append(base->wrapped, lz4->frame, size))
+		return -1;
+
+	base->inbuf_used = 0;
+	return 0;
+}
+
+static int encode_unit(void *user, void *item)
+{
+	comp_unit_t *unit = item;
+	(void)user;
+
+	unit->out_size = encode_frame(unit->in, unit->in_size, unit->out);
+	return 0;
+}
+
+static void cleanup(ostream_comp_t *base)
+{
+	(void)base;
+}
+
+ostream_comp_t *ostream_lz4_create(const char *filename)
+{
+	ostream_lz4_t *lz4 = calloc(1, sizeof(*lz4));
+	ostream_comp_t *base = (ostream_comp_t *)lz4;
+
+	if (lz4 == NULL) {
+		fprintf(stderr, "%s: creating lz4 wrapper: %s.\n",
+			filename, strerror(errno));
+		return NULL;
+	}
+
+	base->flush_inbuf = flush_inbuf;
+	base->cleanup = cleanup;
+	base->encode_unit = encode_unit;
+	base->unit_bound = FRAME_BOUND(BUFSZ);
+	return base;
+}
@@ -6,6 +6,75 @@
  */
 #include "../internal.h"
 
+static int write_unit(ostream_comp_t *comp)
+{
+	comp_unit_t *unit;
+	int ret;
+
+	unit = comp->pool->dequeue(comp->pool);
+	comp->in_flight -= 1;
+
+	if (unit == NULL || unit->status != 0) {
+		fprintf(stderr, "%s: error compressing data.\n",
+			comp->wrapped->get_filename(comp->wrapped));
+		free(unit);
+		return -1;
+	}
+
+	ret = comp->wrapped->append(comp->wrapped, unit->out, unit->out_size);
+	free(unit);
+	return ret;
+}
+
+static int flush_parallel(ostream_comp_t *comp, bool finish)
+{
+	comp_unit_t *unit;
+
+	if (comp->inbuf_used > 0) {
+		unit = malloc(sizeof(*unit) + comp->inbuf_used +
+			      comp->unit_bound);
+		if (unit == NULL) {
+			fprintf(stderr, "%s: allocating compressor job: %s.\n",
+				comp->wrapped->get_filename(comp->wrapped),
+				strerror(errno));
+			return -1;
+		}
+
+		unit->in_size = comp->inbuf_used;
+		unit->out_size = comp->unit_bound;
+		unit->status = 0;
+		unit->out = unit->in + comp->inbuf_used;
+		memcpy(unit->in, comp->inbuf, comp->inbuf_used);
+
+		if (comp->pool->submit(comp->pool, unit)) {
+			fprintf(stderr, "%s: submitting compressor job "
+				"failed.\n",
+				comp->wrapped->get_filename(comp->wrapped));
+			free(unit);
+			return -1;
+		}
+
+		comp->in_flight += 1;
+		comp->inbuf_used = 0;
+	}
+
+	while (comp->in_flight >= comp->max_in_flight ||
+	       (finish && comp->in_flight > 0)) {
+		if (write_unit(comp))
+			return -1;
+	}
+
+	return 0;
+}
+
+static int comp_flush_inbuf(ostream_comp_t *comp, bool finish)
+{
+	if (comp->pool != NULL)
+		return flush_parallel(comp, finish);
+
+	return comp->flush_inbuf(comp, finish);
+}
+
 static int comp_append(ostream_t *strm, const void *data, size_t size)
 {
 	ostream_comp_t *comp = (ostream_comp_t *)strm;
@@ -13,7 +82,7 @@ static int comp_append(ostream_t *strm, const void *data, size_t size)
 
 	while (size > 0) {
 		if (comp->inbuf_used >= BUFSZ) {
-			if (comp->flush_inbuf(comp, false))
+			if (comp_flush_inbuf(comp, false))
 				return -1;
 		}
 
@@ -36,8 +105,8 @@ static int comp_flush(ostream_t *strm)
 {
 	ostream_comp_t *comp = (ostream_comp_t *)strm;
 
-	if (comp->inbuf_used > 0) {
-		if (comp->flush_inbuf(comp, true))
+	if (comp->inbuf_used > 0 || comp->in_flight > 0) {
+		if (comp_flush_inbuf(comp, true))
 			return -1;
 	}
 
@@ -55,12 +124,22 @@ static void comp_destroy(sqfs_object_t *obj)
 {
 	ostream_comp_t *comp = (ostream_comp_t *)obj;
 
+	if (comp->pool != NULL) {
+		while (comp->in_flight > 0) {
+			free(comp->pool->dequeue(comp->pool));
+			comp->in_flight -= 1;
+		}
+
+		comp->pool->destroy(comp->pool);
+	}
+
 	comp->cleanup(comp);
 	sqfs_destroy(comp->wrapped);
 	free(comp);
 }
 
-ostream_t *ostream_compressor_create(ostream_t *strm, int comp_id)
+ostream_t *ostream_compressor_create(ostream_t *strm, int comp_id,
+				     size_t num_jobs)
 {
 	ostream_comp_t *comp = NULL;
 	sqfs_object_t *obj;
@@ -74,17 +153,23 @@ ostream_t *ostream_compressor_create(ostream_t *strm, int comp_id)
 		break;
 	case FSTREAM_COMPRESSOR_XZ:
 #ifdef WITH_XZ
-		comp = ostream_xz_create(strm->get_filename(strm));
+		comp = ostream_xz_create(strm->get_filename(strm), num_jobs);
 #endif
 		break;
 	case FSTREAM_COMPRESSOR_ZSTD:
 #if defined(WITH_ZSTD) && defined(HAVE_ZSTD_STREAM)
-		comp = ostream_zstd_create(strm->get_filename(strm));
+		comp = ostream_zstd_create(strm->get_filename(strm),
+					   num_jobs);
 #endif
 		break;
 	case FSTREAM_COMPRESSOR_BZIP2:
 #ifdef WITH_BZIP2
 		comp = ostream_bzip2_create(strm->get_filename(strm));
+#endif
+		break;
+	case FSTREAM_COMPRESSOR_LZ4:
+#ifdef WITH_LZ4
+		comp = ostream_lz4_create(strm->get_filename(strm));
 #endif
 		break;
 	default:
@@ -97,6 +182,14 @@ ostream_t *ostream_compressor_create(ostream_t *strm, int comp_id)
 	comp->wrapped = strm;
 	comp->inbuf_used = 0;
 
+	if (num_jobs > 1 && comp->encode_unit != NULL) {
+		comp->pool = thread_pool_create(num_jobs, comp->encode_unit);
+
+		/* no big deal, it still works serially */
+		if (comp->pool != NULL)
+			comp->max_in_flight = 2 * num_jobs;
+	}
+
 	base = (ostream_t *)comp;
 	base->append = comp_append;
 	base->flush = comp_flush;
@@ -8,6 +8,11 @@
 
 #include <lzma.h>
 
+/* liblzma rejects larger thread counts, but does not export the limit */
+#ifndef LZMA_THREADS_MAX
+#define LZMA_THREADS_MAX (16384)
+#endif
+
 typedef struct {
 	ostream_comp_t base;
 
@@ -53,7 +58,28 @@ static void cleanup(ostream_comp_t *base)
 	lzma_end(&xz->strm);
 }
 
-ostream_comp_t *ostream_xz_create(const char *filename)
+static lzma_ret init_encoder(ostream_xz_t *xz, size_t num_jobs)
+{
+#ifdef HAVE_XZ_ENCODER_MT
+	lzma_mt mt;
+
+	if (num_jobs > 1) {
+		memset(&mt, 0, sizeof(mt));
+		mt.threads = num_jobs > LZMA_THREADS_MAX ?
+			LZMA_THREADS_MAX : num_jobs;
+		mt.preset = LZMA_PRESET_DEFAULT;
+		mt.check = LZMA_CHECK_CRC64;
+
+		return lzma_stream_encoder_mt(&xz->strm, &mt);
+	}
+#else
+	(void)num_jobs;
+#endif
+	return lzma_easy_encoder(&xz->strm, LZMA_PRESET_DEFAULT,
+				 LZMA_CHECK_CRC64);
+}
+
+ostream_comp_t *ostream_xz_create(const char *filename, size_t num_jobs)
 {
 	ostream_xz_t *xz = calloc(1, sizeof(*xz));
 	ostream_comp_t *base = (ostream_comp_t *)xz;
@@ -65,8 +91,7 @@ ostream_comp_t *ostream_xz_create(const char *filename)
 		return NULL;
 	}
 
-	ret_xz = lzma_easy_encoder(&xz->strm, LZMA_PRESET_DEFAULT,
-				   LZMA_CHECK_CRC64);
+	ret_xz = init_encoder(xz, num_jobs);
 	if (ret_xz != LZMA_OK) {
 		fprintf(stderr, "%s: error initializing XZ compressor\n",
 			filename);
@@ -7,6 +7,7 @@
 #include "../internal.h"
 
 #include <zstd.h>
+#include <limits.h>
 
 #ifdef HAVE_ZSTD_STREAM
 typedef struct {
@@ -68,7 +69,7 @@ static void cleanup(ostream_comp_t *base)
 	ZSTD_freeCStream(zstd->strm);
 }
 
-ostream_comp_t *ostream_zstd_create(const char *filename)
+ostream_comp_t *ostream_zstd_create(const char *filename, size_t num_jobs)
 {
 	ostream_zstd_t *zstd = calloc(1, sizeof(*zstd));
 	ostream_comp_t *base = (ostream_comp_t *)zstd;
@@ -87,6 +88,15 @@ ostream_comp_t *ostream_zstd_create(const char *filename)
 		return NULL;
 	}
 
+	/*
+	  Fails if libzstd was built without multi threading support,
+	  in which case we simply keep compressing on the calling thread.
+	 */
+	if (num_jobs > 1) {
+		ZSTD_CCtx_setParameter(zstd->strm, ZSTD_c_nbWorkers,
+				       num_jobs > INT_MAX ? INT_MAX : (int)num_jobs);
+	}
+
 	base->flush_inbuf = flush_inbuf;
 	base->cleanup = cleanup;
 	return base;
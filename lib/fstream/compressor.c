@@ -20,6 +20,9 @@ int fstream_compressor_id_from_name(const char *name)
 	if (strcmp(name, "bzip2") == 0)
 		return FSTREAM_COMPRESSOR_BZIP2;
 
+	if (strcmp(name, "lz4") == 0)
+		return FSTREAM_COMPRESSOR_LZ4;
+
 	return -1;
 }
 
@@ -37,6 +40,9 @@ const char *fstream_compressor_name_from_id(int id)
 	if (id == FSTREAM_COMPRESSOR_BZIP2)
 		return "bzip2";
 
+	if (id == FSTREAM_COMPRESSOR_LZ4)
+		return "lz4";
+
 	return NULL;
 }
 
@@ -58,6 +64,10 @@ bool fstream_compressor_exists(int id)
 #ifdef WITH_BZIP2
 	case FSTREAM_COMPRESSOR_BZIP2:
 		return true;
+#endif
+#ifdef WITH_LZ4
+	case FSTREAM_COMPRESSOR_LZ4:
+		return true;
 #endif
 	default:
 		break;
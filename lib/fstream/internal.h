@@ -10,6 +10,8 @@
 #include "config.h"
 #include "compat.h"
 #include "fstream.h"
+#include "threadpool.h"
+#include "util.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -23,6 +25,28 @@
 
 #define BUFSZ (262144)
 
+/* smaller reads are served through the buffer, to batch up syscalls */
+#define DIRECT_READ_MIN (4096)
+
+/* LZ4 frame format */
+#define LZ4_FRAME_MAGIC (0x184D2204)
+#define LZ4_SKIPPABLE_MAGIC (0x184D2A50)
+#define LZ4_SKIPPABLE_MASK (0xFFFFFFF0)
+
+#define LZ4_FLG_VERSION (0x40)
+#define LZ4_FLG_VERSION_MASK (0xC0)
+#define LZ4_FLG_BLOCK_INDEP (0x20)
+#define LZ4_FLG_BLOCK_CHECKSUM (0x10)
+#define LZ4_FLG_CONTENT_SIZE (0x08)
+#define LZ4_FLG_CONTENT_CHECKSUM (0x04)
+#define LZ4_FLG_RESERVED (0x02)
+#define LZ4_FLG_DICT_ID (0x01)
+
+#define LZ4_BD_RESERVED (0x8F)
+#define LZ4_BD_SHIFT (4)
+
+#define LZ4_BLOCK_UNCOMPRESSED (0x80000000)
+
 typedef struct ostream_comp_t {
 	ostream_t base;
 
@@ -36,8 +60,31 @@ typedef struct ostream_comp_t {
 	int (*flush_inbuf)(struct ostream_comp_t *ostrm, bool finish);
 
 	void (*cleanup)(struct ostream_comp_t *ostrm);
+
+	/*
+	  Optional. Compress a unit of input into a self contained piece of
+	  output, so units can be processed on a thread pool and concatenated
+	  in order. unit_bound is the worst case output size for BUFSZ bytes
+	  of input.
+	 */
+	thread_pool_worker_t encode_unit;
+	size_t unit_bound;
+
+	thread_pool_t *pool;
+	size_t in_flight;
+	size_t max_in_flight;
 } ostream_comp_t;
 
+/* an independently processed chunk of stream data */
+typedef struct {
+	size_t in_size;
+	size_t out_size;
+	int status;
+
+	sqfs_u8 *out;
+	sqfs_u8 in[];
+} comp_unit_t;
+
 typedef struct istream_comp_t {
 	istream_t base;
 
@@ -47,7 +94,30 @@ typedef struct istream_comp_t {
 
 	bool eof;
 
+	/*
+	  Decode data into out, which holds size bytes, *used of which
+	  are already occupied. *used is advanced by the amount produced.
+	 */
+	int (*decode)(struct istream_comp_t *strm, sqfs_u8 *out, size_t size,
+		      size_t *used);
+
 	void (*cleanup)(struct istream_comp_t *strm);
+
+	/*
+	  Optional. Cut the next unit out of the wrapped stream if the input
+	  at the current position can be split up, set *out to NULL if not.
+	  The units are decoded by decode_unit on a thread pool and the rest
+	  of the input is handed to decode once no more units are found.
+	 */
+	int (*next_unit)(struct istream_comp_t *strm, comp_unit_t **out);
+
+	thread_pool_worker_t decode_unit;
+
+	thread_pool_t *pool;
+	comp_unit_t *unit;
+	size_t unit_offset;
+	size_t in_flight;
+	size_t max_in_flight;
 } istream_comp_t;
 
 #ifdef __cplusplus
@@ -56,20 +126,27 @@ extern "C" {
 
 SQFS_INTERNAL ostream_comp_t *ostream_gzip_create(const char *filename);
 
-SQFS_INTERNAL ostream_comp_t *ostream_xz_create(const char *filename);
+SQFS_INTERNAL ostream_comp_t *ostream_xz_create(const char *filename,
+						size_t num_jobs);
 
-SQFS_INTERNAL ostream_comp_t *ostream_zstd_create(const char *filename);
+SQFS_INTERNAL ostream_comp_t *ostream_zstd_create(const char *filename,
+						  size_t num_jobs);
 
 SQFS_INTERNAL ostream_comp_t *ostream_bzip2_create(const char *filename);
 
+SQFS_INTERNAL ostream_comp_t *ostream_lz4_create(const char *filename);
+
 SQFS_INTERNAL istream_comp_t *istream_gzip_create(const char *filename);
 
-SQFS_INTERNAL istream_comp_t *istream_xz_create(const char *filename);
+SQFS_INTERNAL istream_comp_t *istream_xz_create(const char *filename,
+						size_t num_jobs);
 
 SQFS_INTERNAL istream_comp_t *istream_zstd_create(const char *filename);
 
 SQFS_INTERNAL istream_comp_t *istream_bzip2_create(const char *filename);
 
+SQFS_INTERNAL istream_comp_t *istream_lz4_create(const char *filename);
+
 #ifdef __cplusplus
 }
 #endif
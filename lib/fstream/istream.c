@@ -9,7 +9,7 @@
 
 sqfs_s32 istream_read(istream_t *strm, void *data, size_t size)
 {
-	sqfs_s32 total = 0;
+	sqfs_s32 ret, total = 0;
 	size_t diff;
 
 	if (size > 0x7FFFFFFF)
@@ -17,6 +17,20 @@ sqfs_s32 istream_read(istream_t *strm, void *data, size_t size)
 
 	while (size > 0) {
 		if (strm->buffer_offset >= strm->buffer_used) {
+			if (strm->read_direct != NULL && !strm->eof &&
+			    size >= DIRECT_READ_MIN) {
+				ret = strm->read_direct(strm, data, size);
+				if (ret < 0)
+					return -1;
+
+				if (ret > 0) {
+					data = (char *)data + ret;
+					size -= ret;
+					total += ret;
+					continue;
+				}
+			}
+
 			if (istream_precache(strm))
 				return -1;
 
@@ -44,6 +58,9 @@ int istream_precache(istream_t *strm)
 		strm->buffer_offset = 0;
 		strm->buffer_used = 0;
 	} else if (strm->buffer_offset > 0) {
+		if (strm->precache_compacts && !strm->eof)
+			return strm->precache(strm);
+
 		memmove(strm->buffer,
 			strm->buffer + strm->buffer_offset,
 			strm->buffer_used - strm->buffer_offset);
@@ -65,8 +82,18 @@ const char *istream_get_filename(istream_t *strm)
 
 int istream_skip(istream_t *strm, sqfs_u64 size)
 {
+	sqfs_s64 pos;
 	size_t diff;
 
+	if (strm->seek != NULL &&
+	    size > (sqfs_u64)(strm->buffer_used - strm->buffer_offset)) {
+		pos = istream_tell(strm);
+		if (pos < 0)
+			return -1;
+
+		return istream_seek(strm, pos + size);
+	}
+
 	while (size > 0) {
 		if (strm->buffer_offset >= strm->buffer_used) {
 			if (istream_precache(strm))
@@ -89,3 +116,54 @@ int istream_skip(istream_t *strm, sqfs_u64 size)
 
 	return 0;
 }
+
+sqfs_s64 istream_tell(istream_t *strm)
+{
+	sqfs_s64 pos;
+
+	if (strm->tell == NULL)
+		return -1;
+
+	pos = strm->tell(strm);
+	if (pos < 0)
+		return -1;
+
+	return pos - (strm->buffer_used - strm->buffer_offset);
+}
+
+int istream_seek(istream_t *strm, sqfs_u64 offset)
+{
+	sqfs_s64 end;
+	sqfs_u64 start;
+
+	if (strm->seek == NULL || strm->tell == NULL) {
+		fprintf(stderr, "%s: stream is not seekable\n",
+			strm->get_filename(strm));
+		return -1;
+	}
+
+	end = strm->tell(strm);
+	if (end < 0)
+		return -1;
+
+	start = end - strm->buffer_used;
+
+	if (offset >= start && offset <= (sqfs_u64)end) {
+		strm->buffer_offset = offset - start;
+		return 0;
+	}
+
+	if (strm->seek(strm, offset))
+		return -1;
+
+	strm->buffer_offset = 0;
+	strm->buffer_used = 0;
+	strm->eof = false;
+	return 0;
+}
+
+void istream_prefetch(istream_t *strm, sqfs_u64 offset, sqfs_u64 size)
+{
+	if (strm->prefetch != NULL)
+		strm->prefetch(strm, offset, size);
+}
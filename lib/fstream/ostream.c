@@ -40,6 +40,14 @@ int ostream_append_sparse(ostream_t *strm, size_t size)
 	return strm->append_sparse(strm, size);
 }
 
+int ostream_set_size_hint(ostream_t *strm, sqfs_u64 size)
+{
+	if (strm->set_size_hint == NULL)
+		return 0;
+
+	return strm->set_size_hint(strm, size);
+}
+
 int ostream_flush(ostream_t *strm)
 {
 	return strm->flush(strm);
@@ -59,6 +67,9 @@ sqfs_s32 ostream_append_from_istream(ostream_t *out, istream_t *in,
 	if (size > 0x7FFFFFFF)
 		size = 0x7FFFFFFF;
 
+	if (out->append_from_istream != NULL)
+		return out->append_from_istream(out, in, size);
+
 	while (size > 0) {
 		if (in->buffer_offset >= in->buffer_used) {
 			if (istream_precache(in))
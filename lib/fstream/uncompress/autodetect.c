@@ -15,6 +15,7 @@ static const struct {
 	{ FSTREAM_COMPRESSOR_XZ, (const sqfs_u8 *)("\xFD" "7zXZ"), 6 },
 	{ FSTREAM_COMPRESSOR_ZSTD, (const sqfs_u8 *)"\x28\xB5\x2F\xFD", 4 },
 	{ FSTREAM_COMPRESSOR_BZIP2, (const sqfs_u8 *)"BZh", 3 },
+	{ FSTREAM_COMPRESSOR_LZ4, (const sqfs_u8 *)"\x04\x22\x4D\x18", 4 },
 };
 
 int istream_detect_compressor(istream_t *strm,
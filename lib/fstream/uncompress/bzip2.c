@@ -15,10 +15,11 @@ typedef struct {
 	bz_stream strm;
 } istream_bzip2_t;
 
-static int precache(istream_t *base)
+static int decode(istream_comp_t *base, sqfs_u8 *out, size_t size,
+		  size_t *used)
 {
 	istream_bzip2_t *bzip2 = (istream_bzip2_t *)base;
-	istream_t *wrapped = ((istream_comp_t *)base)->wrapped;
+	istream_t *wrapped = base->wrapped;
 	size_t avail;
 	int ret;
 
@@ -47,17 +48,17 @@ static int precache(istream_t *base)
 		bzip2->strm.next_in = (char *)wrapped->buffer;
 		bzip2->strm.avail_in = (unsigned int)avail;
 
-		if (base->buffer_used > BUFSZ)
-			base->buffer_used = BUFSZ;
+		if (*used > size)
+			*used = size;
 
-		avail = BUFSZ - base->buffer_used;
+		avail = size - *used;
 
 		if ((sizeof(size_t) > sizeof(unsigned int)) &&
 		    (avail > (size_t)UINT_MAX)) {
 			avail = UINT_MAX;
 		}
 
-		bzip2->strm.next_out = (char *)base->buffer + base->buffer_used;
+		bzip2->strm.next_out = (char *)out + *used;
 		bzip2->strm.avail_out = (unsigned int)avail;
 
 		if (bzip2->strm.avail_out < 1)
@@ -72,7 +73,7 @@ static int precache(istream_t *base)
 			return -1;
 		}
 
-		base->buffer_used = BUFSZ - bzip2->strm.avail_out;
+		*used = (sqfs_u8 *)bzip2->strm.next_out - out;
 		wrapped->buffer_offset = wrapped->buffer_used -
 					 bzip2->strm.avail_in;
 
@@ -84,7 +85,7 @@ static int precache(istream_t *base)
 			bzip2->initialized = false;
 
 			if (wrapped->buffer_used == 0) {
-				base->eof = true;
+				((istream_t *)base)->eof = true;
 				break;
 			}
 		}
@@ -112,7 +113,7 @@ istream_comp_t *istream_bzip2_create(const char *filename)
 		return NULL;
 	}
 
-	((istream_t *)base)->precache = precache;
+	base->decode = decode;
 	base->cleanup = cleanup;
 	return base;
 }
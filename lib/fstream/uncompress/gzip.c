@@ -8,16 +8,63 @@
 
 #include <zlib.h>
 
+#define BGZF_MAX_MEMBER (65536)
+#define MAX_UNIT_SIZE (1024 * 1024)
+
 typedef struct {
 	istream_comp_t base;
 
 	z_stream strm;
+	bool member_start;
 } istream_gzip_t;
 
-static int precache(istream_t *base)
+static bool is_gzip_member(const istream_t *strm)
+{
+	const sqfs_u8 *ptr = strm->buffer + strm->buffer_offset;
+
+	return (strm->buffer_used - strm->buffer_offset) >= 2 &&
+		ptr[0] == 0x1f && ptr[1] == 0x8b;
+}
+
+/*
+  BGZF members store their total size in an extra header field, so the
+  input can be cut into members without decoding anything. Returns 0 if
+  the data does not start with a BGZF member header.
+ */
+static size_t bgzf_member_size(const sqfs_u8 *ptr, size_t avail)
+{
+	size_t i, xlen, slen, size;
+
+	if (avail < 18 || ptr[0] != 0x1f || ptr[1] != 0x8b ||
+	    ptr[2] != 0x08 || !(ptr[3] & 0x04)) {
+		return 0;
+	}
+
+	xlen = ptr[10] | (ptr[11] << 8);
+	if (avail < 12 + xlen)
+		return 0;
+
+	for (i = 12; (i + 4) <= (12 + xlen); i += 4 + slen) {
+		slen = ptr[i + 2] | (ptr[i + 3] << 8);
+
+		if (ptr[i] != 'B' || ptr[i + 1] != 'C' || slen != 2)
+			continue;
+
+		if ((i + 6) > (12 + xlen))
+			return 0;
+
+		size = (ptr[i + 4] | (ptr[i + 5] << 8)) + 1;
+		return size < (12 + xlen + 8) ? 0 : size;
+	}
+
+	return 0;
+}
+
+static int decode(istream_comp_t *base, sqfs_u8 *out, size_t size,
+		  size_t *used)
 {
-	istream_t *wrapped = ((istream_comp_t *)base)->wrapped;
 	istream_gzip_t *gzip = (istream_gzip_t *)base;
+	istream_t *wrapped = base->wrapped;
 	size_t avail_in, avail_out;
 	int ret;
 
@@ -26,8 +73,18 @@ static int precache(istream_t *base)
 		if (ret != 0)
 			return ret;
 
+		if (gzip->member_start) {
+			/* ignore trailing garbage, like gzip does */
+			if (!is_gzip_member(wrapped)) {
+				((istream_t *)base)->eof = true;
+				break;
+			}
+
+			gzip->member_start = false;
+		}
+
 		avail_in = wrapped->buffer_used;
-		avail_out = BUFSZ - base->buffer_used;
+		avail_out = size - *used;
 
 		if (sizeof(size_t) > sizeof(uInt)) {
 			gzip->strm.avail_in = ~((uInt)0U);
@@ -44,31 +101,133 @@ static int precache(istream_t *base)
 		}
 
 		gzip->strm.next_in = wrapped->buffer;
-		gzip->strm.next_out = base->buffer + base->buffer_used;
+		gzip->strm.next_out = out + *used;
 
 		ret = inflate(&gzip->strm, Z_NO_FLUSH);
 
 		wrapped->buffer_offset = wrapped->buffer_used -
 					 gzip->strm.avail_in;
 
-		base->buffer_used = BUFSZ - gzip->strm.avail_out;
+		*used = gzip->strm.next_out - out;
 
 		if (ret == Z_BUF_ERROR)
 			break;
 
 		if (ret == Z_STREAM_END) {
-			base->eof = true;
+			/* concatenated gzip files are one file */
+			if (inflateReset(&gzip->strm) != Z_OK)
+				goto fail;
+
+			gzip->member_start = true;
+			continue;
+		}
+
+		if (ret != Z_OK)
+			goto fail;
+	}
+
+	return 0;
+fail:
+	fprintf(stderr, "%s: internal error in gzip decoder.\n",
+		wrapped->get_filename(wrapped));
+	return -1;
+}
+
+static int next_unit(istream_comp_t *base, comp_unit_t **out)
+{
+	istream_t *wrapped = base->wrapped;
+	size_t avail, size, isize, in_size = 0, out_size = 0;
+	const sqfs_u8 *ptr, *trailer;
+	comp_unit_t *unit;
+
+	*out = NULL;
+
+	if ((wrapped->buffer_used - wrapped->buffer_offset) < BGZF_MAX_MEMBER) {
+		if (istream_precache(wrapped))
+			return -1;
+	}
+
+	ptr = wrapped->buffer + wrapped->buffer_offset;
+	avail = wrapped->buffer_used - wrapped->buffer_offset;
+
+	while (in_size < avail) {
+		size = bgzf_member_size(ptr + in_size, avail - in_size);
+		if (size == 0 || size > (avail - in_size))
+			break;
+
+		trailer = ptr + in_size + size - 4;
+		isize = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) |
+			((sqfs_u32)trailer[3] << 24);
+
+		if (isize > BGZF_MAX_MEMBER)
+			break;
+
+		if (in_size > 0 && (out_size + isize) > MAX_UNIT_SIZE)
 			break;
+
+		in_size += size;
+		out_size += isize;
+	}
+
+	if (in_size == 0)
+		return 0;
+
+	unit = malloc(sizeof(*unit) + in_size + out_size);
+	if (unit == NULL) {
+		fprintf(stderr, "%s: allocating decoder job: %s.\n",
+			wrapped->get_filename(wrapped), strerror(errno));
+		return -1;
+	}
+
+	unit->in_size = in_size;
+	unit->out_size = out_size;
+	unit->status = 0;
+	unit->out = unit->in + in_size;
+	memcpy(unit->in, ptr, in_size);
+
+	wrapped->buffer_offset += in_size;
+	*out = unit;
+	return 0;
+}
+
+static int decode_unit(void *user, void *item)
+{
+	comp_unit_t *unit = item;
+	z_stream strm;
+	int ret;
+	(void)user;
+
+	memset(&strm, 0, sizeof(strm));
+	if (inflateInit2(&strm, 16 + 15) != Z_OK) {
+		unit->status = -1;
+		return 0;
+	}
+
+	strm.next_in = unit->in;
+	strm.avail_in = unit->in_size;
+	strm.next_out = unit->out;
+	strm.avail_out = unit->out_size;
+
+	for (;;) {
+		ret = inflate(&strm, Z_NO_FLUSH);
+
+		if (ret == Z_STREAM_END) {
+			if (strm.avail_in == 0)
+				break;
+
+			ret = inflateReset(&strm);
 		}
 
 		if (ret != Z_OK) {
-			fprintf(stderr,
-				"%s: internal error in gzip decoder.\n",
-				wrapped->get_filename(wrapped));
-			return -1;
+			unit->status = -1;
+			break;
 		}
 	}
 
+	if (strm.avail_out != 0)
+		unit->status = -1;
+
+	inflateEnd(&strm);
 	return 0;
 }
 
@@ -100,7 +259,11 @@ istream_comp_t *istream_gzip_create(const char *filename)
 		return NULL;
 	}
 
-	((istream_t *)base)->precache = precache;
+	gzip->member_start = true;
+
+	base->decode = decode;
+	base->next_unit = next_unit;
+	base->decode_unit = decode_unit;
 	base->cleanup = cleanup;
 	return base;
 }
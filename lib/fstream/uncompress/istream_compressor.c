@@ -6,6 +6,101 @@
  */
 #include "../internal.h"
 
+static int decode_parallel(istream_comp_t *comp, sqfs_u8 *out, size_t size,
+			   size_t *used)
+{
+	comp_unit_t *unit;
+	size_t diff;
+
+	while (*used < size) {
+		if (comp->unit != NULL) {
+			diff = comp->unit->out_size - comp->unit_offset;
+			if (diff > (size - *used))
+				diff = size - *used;
+
+			memcpy(out + *used, comp->unit->out + comp->unit_offset,
+			       diff);
+			comp->unit_offset += diff;
+			*used += diff;
+
+			if (comp->unit_offset < comp->unit->out_size)
+				break;
+
+			free(comp->unit);
+			comp->unit = NULL;
+		}
+
+		while (comp->in_flight < comp->max_in_flight) {
+			if (comp->next_unit(comp, &unit))
+				return -1;
+
+			if (unit == NULL) {
+				comp->max_in_flight = 0;
+				break;
+			}
+
+			if (comp->pool->submit(comp->pool, unit)) {
+				fprintf(stderr, "%s: submitting decoder job "
+					"failed.\n",
+					comp->wrapped->get_filename(comp->wrapped));
+				free(unit);
+				return -1;
+			}
+
+			comp->in_flight += 1;
+		}
+
+		if (comp->in_flight == 0) {
+			/* whatever follows is not splittable */
+			comp->pool->destroy(comp->pool);
+			comp->pool = NULL;
+			return comp->decode(comp, out, size, used);
+		}
+
+		unit = comp->pool->dequeue(comp->pool);
+		comp->in_flight -= 1;
+
+		if (unit == NULL || unit->status != 0) {
+			fprintf(stderr, "%s: error decoding compressed data.\n",
+				comp->wrapped->get_filename(comp->wrapped));
+			free(unit);
+			return -1;
+		}
+
+		comp->unit = unit;
+		comp->unit_offset = 0;
+	}
+
+	return 0;
+}
+
+static int comp_decode(istream_comp_t *comp, sqfs_u8 *out, size_t size,
+		       size_t *used)
+{
+	if (comp->pool != NULL)
+		return decode_parallel(comp, out, size, used);
+
+	return comp->decode(comp, out, size, used);
+}
+
+static int comp_precache(istream_t *strm)
+{
+	istream_comp_t *comp = (istream_comp_t *)strm;
+
+	return comp_decode(comp, strm->buffer, BUFSZ, &strm->buffer_used);
+}
+
+static sqfs_s32 comp_read_direct(istream_t *strm, void *data, size_t size)
+{
+	istream_comp_t *comp = (istream_comp_t *)strm;
+	size_t used = 0;
+
+	if (comp_decode(comp, data, size, &used))
+		return -1;
+
+	return used;
+}
+
 static const char *comp_get_filename(istream_t *strm)
 {
 	istream_comp_t *comp = (istream_comp_t *)strm;
@@ -17,12 +112,23 @@ static void comp_destroy(sqfs_object_t *obj)
 {
 	istream_comp_t *comp = (istream_comp_t *)obj;
 
+	if (comp->pool != NULL) {
+		while (comp->in_flight > 0) {
+			free(comp->pool->dequeue(comp->pool));
+			comp->in_flight -= 1;
+		}
+
+		comp->pool->destroy(comp->pool);
+	}
+
+	free(comp->unit);
 	comp->cleanup(comp);
 	sqfs_destroy(comp->wrapped);
 	free(comp);
 }
 
-istream_t *istream_compressor_create(istream_t *strm, int comp_id)
+istream_t *istream_compressor_create(istream_t *strm, int comp_id,
+				     size_t num_jobs)
 {
 	istream_comp_t *comp = NULL;
 	sqfs_object_t *obj;
@@ -36,7 +142,7 @@ istream_t *istream_compressor_create(istream_t *strm, int comp_id)
 		break;
 	case FSTREAM_COMPRESSOR_XZ:
 #ifdef WITH_XZ
-		comp = istream_xz_create(strm->get_filename(strm));
+		comp = istream_xz_create(strm->get_filename(strm), num_jobs);
 #endif
 		break;
 	case FSTREAM_COMPRESSOR_ZSTD:
@@ -47,6 +153,11 @@ istream_t *istream_compressor_create(istream_t *strm, int comp_id)
 	case FSTREAM_COMPRESSOR_BZIP2:
 #ifdef WITH_BZIP2
 		comp = istream_bzip2_create(strm->get_filename(strm));
+#endif
+		break;
+	case FSTREAM_COMPRESSOR_LZ4:
+#ifdef WITH_LZ4
+		comp = istream_lz4_create(strm->get_filename(strm));
 #endif
 		break;
 	default:
@@ -58,7 +169,17 @@ istream_t *istream_compressor_create(istream_t *strm, int comp_id)
 
 	comp->wrapped = strm;
 
+	if (num_jobs > 1 && comp->next_unit != NULL) {
+		comp->pool = thread_pool_create(num_jobs, comp->decode_unit);
+
+		/* no big deal, it still works serially */
+		if (comp->pool != NULL)
+			comp->max_in_flight = 2 * num_jobs;
+	}
+
 	base = (istream_t *)comp;
+	base->precache = comp_precache;
+	base->read_direct = comp_read_direct;
 	base->get_filename = comp_get_filename;
 	base->buffer = comp->uncompressed;
 	base->eof = false;
@@ -0,0 +1,316 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * lz4.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "../internal.h"
+
+#include <lz4.h>
+
+typedef struct {
+	istream_comp_t base;
+
+	bool in_frame;
+	bool seen_frame;
+	sqfs_u8 flags;
+
+	sqfs_u64 content_size;
+	sqfs_u64 total_out;
+	xxh32_ctx_t xxh;
+
+	size_t block_max;
+	sqfs_u8 *block;
+
+	sqfs_u8 *data;
+	size_t data_used;
+	size_t data_offset;
+} istream_lz4_t;
+
+static sqfs_u32 read_le32(const sqfs_u8 *ptr)
+{
+	sqfs_u32 value;
+
+	memcpy(&value, ptr, sizeof(value));
+	return le32toh(value);
+}
+
+static int read_exact(istream_lz4_t *lz4, void *data, size_t size)
+{
+	istream_t *wrapped = lz4->base.wrapped;
+	sqfs_s32 ret;
+
+	ret = istream_read(wrapped, data, size);
+	if (ret < 0)
+		return -1;
+
+	if ((size_t)ret < size) {
+		fprintf(stderr, "%s: unexpected end of LZ4 frame.\n",
+			wrapped->get_filename(wrapped));
+		return -1;
+	}
+
+	return 0;
+}
+
+static int read_frame_header(istream_lz4_t *lz4)
+{
+	istream_t *wrapped = lz4->base.wrapped;
+	const char *filename = wrapped->get_filename(wrapped);
+	sqfs_u8 header[4 + 2 + 8 + 1];
+	size_t size, block_max;
+	xxh32_ctx_t ctx;
+	sqfs_u32 magic;
+	sqfs_u8 *new;
+	sqfs_s32 ret;
+
+	for (;;) {
+		ret = istream_read(wrapped, header, 4);
+		if (ret < 0)
+			return -1;
+
+		if (ret == 0 && lz4->seen_frame)
+			return 1;
+
+		if (ret < 4)
+			goto fail_magic;
+
+		magic = read_le32(header);
+
+		if ((magic & LZ4_SKIPPABLE_MASK) != LZ4_SKIPPABLE_MAGIC)
+			break;
+
+		if (read_exact(lz4, header, 4))
+			return -1;
+
+		if (istream_skip(wrapped, read_le32(header)))
+			return -1;
+	}
+
+	if (magic != LZ4_FRAME_MAGIC) {
+		/* like gzip, ignore trailing garbage after the last frame */
+		if (lz4->seen_frame) {
+			wrapped->buffer_offset = wrapped->buffer_used;
+			return 1;
+		}
+		goto fail_magic;
+	}
+
+	if (read_exact(lz4, header + 4, 2))
+		return -1;
+
+	lz4->flags = header[4];
+
+	if ((lz4->flags & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION ||
+	    (lz4->flags & LZ4_FLG_RESERVED) || (header[5] & LZ4_BD_RESERVED) ||
+	    (header[5] >> LZ4_BD_SHIFT) < 4) {
+		fprintf(stderr, "%s: unsupported LZ4 frame descriptor.\n",
+			filename);
+		return -1;
+	}
+
+	if (!(lz4->flags & LZ4_FLG_BLOCK_INDEP)) {
+		fprintf(stderr, "%s: LZ4 frames with linked blocks are not "
+			"supported.\n", filename);
+		return -1;
+	}
+
+	if (lz4->flags & LZ4_FLG_DICT_ID) {
+		fprintf(stderr, "%s: LZ4 frame requires a dictionary.\n",
+			filename);
+		return -1;
+	}
+
+	size = 6;
+
+	if (lz4->flags & LZ4_FLG_CONTENT_SIZE) {
+		if (read_exact(lz4, header + size, 8))
+			return -1;
+
+		memcpy(&lz4->content_size, header + size, 8);
+		lz4->content_size = le64toh(lz4->content_size);
+		size += 8;
+	}
+
+	if (read_exact(lz4, header + size, 1))
+		return -1;
+
+	xxh32_init(&ctx);
+	xxh32_update(&ctx, header + 4, size - 4);
+
+	if (((xxh32_final(&ctx) >> 8) & 0xFF) != header[size]) {
+		fprintf(stderr, "%s: LZ4 frame header checksum mismatch.\n",
+			filename);
+		return -1;
+	}
+
+	/* 64 KiB, 256 KiB, 1 MiB or 4 MiB */
+	block_max = (size_t)1 << (16 + 2 * ((header[5] >> LZ4_BD_SHIFT) - 4));
+
+	if (block_max > lz4->block_max) {
+		new = realloc(lz4->block, 2 * block_max);
+		if (new == NULL) {
+			fprintf(stderr, "%s: allocating LZ4 block buffer: "
+				"%s.\n", filename, strerror(errno));
+			return -1;
+		}
+
+		lz4->block = new;
+		lz4->data = new + block_max;
+		lz4->block_max = block_max;
+	}
+
+	xxh32_init(&lz4->xxh);
+	lz4->total_out = 0;
+	lz4->in_frame = true;
+	lz4->seen_frame = true;
+	return 0;
+fail_magic:
+	fprintf(stderr, "%s: not an LZ4 frame.\n", filename);
+	return -1;
+}
+
+static int end_frame(istream_lz4_t *lz4)
+{
+	istream_t *wrapped = lz4->base.wrapped;
+	sqfs_u8 buffer[4];
+
+	if (lz4->flags & LZ4_FLG_CONTENT_CHECKSUM) {
+		if (read_exact(lz4, buffer, 4))
+			return -1;
+
+		if (read_le32(buffer) != xxh32_final(&lz4->xxh))
+			goto fail;
+	}
+
+	if ((lz4->flags & LZ4_FLG_CONTENT_SIZE) &&
+	    lz4->content_size != lz4->total_out) {
+		goto fail;
+	}
+
+	lz4->in_frame = false;
+	return 0;
+fail:
+	fprintf(stderr, "%s: LZ4 frame content does not match its "
+		"checksum or size.\n", wrapped->get_filename(wrapped));
+	return -1;
+}
+
+static int read_block(istream_lz4_t *lz4)
+{
+	istream_t *wrapped = lz4->base.wrapped;
+	sqfs_u32 word, size;
+	sqfs_u8 buffer[4];
+	xxh32_ctx_t ctx;
+	sqfs_u8 *dst;
+	int ret;
+
+	if (read_exact(lz4, buffer, 4))
+		return -1;
+
+	word = read_le32(buffer);
+	if (word == 0)
+		return end_frame(lz4);
+
+	size = word & ~LZ4_BLOCK_UNCOMPRESSED;
+	if (size > lz4->block_max)
+		goto fail;
+
+	dst = (word & LZ4_BLOCK_UNCOMPRESSED) ? lz4->data : lz4->block;
+
+	if (read_exact(lz4, dst, size))
+		return -1;
+
+	if (lz4->flags & LZ4_FLG_BLOCK_CHECKSUM) {
+		if (read_exact(lz4, buffer, 4))
+			return -1;
+
+		xxh32_init(&ctx);
+		xxh32_update(&ctx, dst, size);
+
+		if (read_le32(buffer) != xxh32_final(&ctx))
+			goto fail;
+	}
+
+	if (word & LZ4_BLOCK_UNCOMPRESSED) {
+		lz4->data_used = size;
+	} else {
+		ret = LZ4_decompress_safe((const char *)lz4->block,
+					  (char *)lz4->data, size,
+					  lz4->block_max);
+		if (ret < 0)
+			goto fail;
+
+		lz4->data_used = ret;
+	}
+
+	lz4->data_offset = 0;
+	lz4->total_out += lz4->data_used;
+	xxh32_update(&lz4->xxh, lz4->data, lz4->data_used);
+	return 0;
+fail:
+	fprintf(stderr, "%s: error decoding LZ4 block.\n",
+		wrapped->get_filename(wrapped));
+	return -1;
+}
+
+static int decode(istream_comp_t *base, sqfs_u8 *out, size_t size,
+		  size_t *used)
+{
+	istream_lz4_t *lz4 = (istream_lz4_t *)base;
+	size_t diff;
+	int ret;
+
+	while (*used < size) {
+		if (lz4->data_offset < lz4->data_used) {
+			diff = lz4->data_used - lz4->data_offset;
+			if (diff > (size - *used))
+				diff = size - *used;
+
+			memcpy(out + *used, lz4->data + lz4->data_offset, diff);
+			lz4->data_offset += diff;
+			*used += diff;
+			continue;
+		}
+
+		if (lz4->in_frame) {
+			if (read_block(lz4))
+				return -1;
+			continue;
+		}
+
+		ret = read_frame_header(lz4);
+		if (ret < 0)
+			return -1;
+
+		if (ret > 0) {
+			((istream_t *)base)->eof = true;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static void cleanup(istream_comp_t *base)
+{
+	istream_lz4_t *lz4 = (istream_lz4_t *)base;
+
+	free(lz4->block);
+}
+
+istream_comp_t *istream_lz4_create(const char *filename)
+{
+	istream_lz4_t *lz4 = calloc(1, sizeof(*lz4));
+	istream_comp_t *base = (istream_comp_t *)lz4;
+
+	if (lz4 == NULL) {
+		fprintf(stderr, "%s: creating lz4 decoder: %s.\n",
+			filename, strerror(errno));
+		return NULL;
+	}
+
+	base->decode = decode;
+	base->cleanup = cleanup;
+	return base;
+}
@@ -8,16 +8,22 @@
 
 #include <lzma.h>
 
+/* liblzma rejects larger thread counts, but does not export the limit */
+#ifndef LZMA_THREADS_MAX
+#define LZMA_THREADS_MAX (16384)
+#endif
+
 typedef struct {
 	istream_comp_t base;
 
 	lzma_stream strm;
 } istream_xz_t;
 
-static int precache(istream_t *base)
+static int decode(istream_comp_t *base, sqfs_u8 *out, size_t size,
+		  size_t *used)
 {
 	istream_xz_t *xz = (istream_xz_t *)base;
-	istream_t *wrapped = ((istream_comp_t *)base)->wrapped;
+	istream_t *wrapped = base->wrapped;
 	lzma_action action;
 	lzma_ret ret_xz;
 	int ret;
@@ -32,12 +38,12 @@ static int precache(istream_t *base)
 		xz->strm.avail_in = wrapped->buffer_used;
 		xz->strm.next_in = wrapped->buffer;
 
-		xz->strm.avail_out = BUFSZ - base->buffer_used;
-		xz->strm.next_out = base->buffer + base->buffer_used;
+		xz->strm.avail_out = size - *used;
+		xz->strm.next_out = out + *used;
 
 		ret_xz = lzma_code(&xz->strm, action);
 
-		base->buffer_used = BUFSZ - xz->strm.avail_out;
+		*used = size - xz->strm.avail_out;
 		wrapped->buffer_offset = wrapped->buffer_used -
 					 xz->strm.avail_in;
 
@@ -45,7 +51,7 @@ static int precache(istream_t *base)
 			break;
 
 		if (ret_xz == LZMA_STREAM_END) {
-			base->eof = true;
+			((istream_t *)base)->eof = true;
 			break;
 		}
 
@@ -67,11 +73,41 @@ static void cleanup(istream_comp_t *base)
 	lzma_end(&xz->strm);
 }
 
-istream_comp_t *istream_xz_create(const char *filename)
+static lzma_ret init_decoder(istream_xz_t *xz, size_t num_jobs)
+{
+	sqfs_u64 memlimit = 65 * 1024 * 1024;
+#ifdef HAVE_XZ_DECODER_MT
+	lzma_mt mt;
+
+	if (num_jobs > 1) {
+		memset(&mt, 0, sizeof(mt));
+		mt.flags = LZMA_CONCATENATED;
+		mt.threads = num_jobs > LZMA_THREADS_MAX ?
+			LZMA_THREADS_MAX : num_jobs;
+
+		/*
+		  Blocks that don't record their size are decoded by a
+		  single thread. So are all of them, if decoding in parallel
+		  would exceed the threading limit.
+		 */
+		mt.memlimit_threading = lzma_physmem() / 4;
+		if (mt.memlimit_threading < memlimit)
+			mt.memlimit_threading = memlimit;
+
+		mt.memlimit_stop = mt.memlimit_threading;
+
+		return lzma_stream_decoder_mt(&xz->strm, &mt);
+	}
+#else
+	(void)num_jobs;
+#endif
+	return lzma_stream_decoder(&xz->strm, memlimit, LZMA_CONCATENATED);
+}
+
+istream_comp_t *istream_xz_create(const char *filename, size_t num_jobs)
 {
 	istream_xz_t *xz = calloc(1, sizeof(*xz));
 	istream_comp_t *base = (istream_comp_t *)xz;
-	sqfs_u64 memlimit = 65 * 1024 * 1024;
 	lzma_ret ret_xz;
 
 	if (xz == NULL) {
@@ -80,7 +116,7 @@ istream_comp_t *istream_xz_create(const char *filename)
 		return NULL;
 	}
 
-	ret_xz = lzma_stream_decoder(&xz->strm, memlimit, LZMA_CONCATENATED);
+	ret_xz = init_decoder(xz, num_jobs);
 
 	if (ret_xz != LZMA_OK) {
 		fprintf(stderr,
@@ -90,7 +126,7 @@ istream_comp_t *istream_xz_create(const char *filename)
 		return NULL;
 	}
 
-	((istream_t *)base)->precache = precache;
+	base->decode = decode;
 	base->cleanup = cleanup;
 	return base;
 }
@@ -15,11 +15,12 @@ typedef struct {
 	ZSTD_DStream* strm;
 } istream_zstd_t;
 
-static int precache(istream_t *base)
+static int decode(istream_comp_t *base, sqfs_u8 *out, size_t size,
+		  size_t *used)
 {
 	istream_zstd_t *zstd = (istream_zstd_t *)base;
-	istream_t *wrapped = ((istream_comp_t *)base)->wrapped;
-	ZSTD_outBuffer out;
+	istream_t *wrapped = base->wrapped;
+	ZSTD_outBuffer zout;
 	ZSTD_inBuffer in;
 	size_t ret;
 
@@ -27,15 +28,15 @@ static int precache(istream_t *base)
 		return -1;
 
 	memset(&in, 0, sizeof(in));
-	memset(&out, 0, sizeof(out));
+	memset(&zout, 0, sizeof(zout));
 
 	in.src = wrapped->buffer;
 	in.size = wrapped->buffer_used;
 
-	out.dst = ((istream_comp_t *)base)->uncompressed + base->buffer_used;
-	out.size = BUFSZ - base->buffer_used;
+	zout.dst = out + *used;
+	zout.size = size - *used;
 
-	ret = ZSTD_decompressStream(zstd->strm, &out, &in);
+	ret = ZSTD_decompressStream(zstd->strm, &zout, &in);
 
 	if (ZSTD_isError(ret)) {
 		fprintf(stderr, "%s: error in zstd decoder.\n",
@@ -44,7 +45,7 @@ static int precache(istream_t *base)
 	}
 
 	wrapped->buffer_offset = in.pos;
-	base->buffer_used += out.pos;
+	*used += zout.pos;
 	return 0;
 }
 
@@ -74,7 +75,7 @@ istream_comp_t *istream_zstd_create(const char *filename)
 		return NULL;
 	}
 
-	((istream_t *)base)->precache = precache;
+	base->decode = decode;
 	base->cleanup = cleanup;
 	return base;
 }
@@ -6,12 +6,34 @@
  */
 #include "../internal.h"
 
+#include <sys/stat.h>
+
+#define NUM_CHUNKS (4)
+
+/*
+  A chunk filled by the background reader. The data is read into the
+  upper half, the lower half is room for unconsumed data from the
+  previous chunk, so it can be prepended without moving the new data.
+ */
+typedef struct {
+	int fd;
+	int error;
+	bool eof;
+	size_t size;
+
+	sqfs_u8 data[2 * BUFSZ];
+} read_chunk_t;
+
 typedef struct {
 	istream_t base;
 	char *path;
 	int fd;
 	bool eof;
 
+	thread_pool_t *reader;
+	read_chunk_t *current;
+	size_t in_flight;
+
 	sqfs_u8 buffer[BUFSZ];
 } file_istream_t;
 
@@ -45,6 +67,234 @@ static int file_precache(istream_t *strm)
 	return 0;
 }
 
+static sqfs_s32 file_read_direct(istream_t *strm, void *data, size_t size)
+{
+	file_istream_t *file = (file_istream_t *)strm;
+	ssize_t ret;
+
+	do {
+		ret = read(file->fd, data, size);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0) {
+		perror(file->path);
+		return -1;
+	}
+
+	return ret;
+}
+
+static int file_seek(istream_t *strm, sqfs_u64 offset)
+{
+	file_istream_t *file = (file_istream_t *)strm;
+	struct stat sb;
+
+	if (fstat(file->fd, &sb) != 0)
+		goto fail;
+
+	if (offset > (sqfs_u64)sb.st_size) {
+		fprintf(stderr, "%s: unexpected end-of-file\n", file->path);
+		return -1;
+	}
+
+	if (lseek(file->fd, offset, SEEK_SET) == (off_t)-1)
+		goto fail;
+
+	file->eof = false;
+	return 0;
+fail:
+	perror(file->path);
+	return -1;
+}
+
+static sqfs_s64 file_tell(istream_t *strm)
+{
+	file_istream_t *file = (file_istream_t *)strm;
+	off_t ret;
+
+	ret = lseek(file->fd, 0, SEEK_CUR);
+	if (ret == (off_t)-1) {
+		perror(file->path);
+		return -1;
+	}
+
+	return ret;
+}
+
+static void file_prefetch(istream_t *strm, sqfs_u64 offset, sqfs_u64 size)
+{
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+	file_istream_t *file = (file_istream_t *)strm;
+
+	posix_fadvise(file->fd, offset, size, POSIX_FADV_WILLNEED);
+#else
+	(void)strm;
+	(void)offset;
+	(void)size;
+#endif
+}
+
+static int fill_chunk(void *user, void *item)
+{
+	read_chunk_t *chunk = item;
+	ssize_t ret;
+	(void)user;
+
+	while (chunk->size < BUFSZ) {
+		ret = read(chunk->fd, chunk->data + BUFSZ + chunk->size,
+			   BUFSZ - chunk->size);
+
+		if (ret == 0) {
+			chunk->eof = true;
+			break;
+		}
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			chunk->error = errno;
+			break;
+		}
+
+		chunk->size += ret;
+	}
+
+	return 0;
+}
+
+static int submit_chunk(file_istream_t *file, read_chunk_t *chunk)
+{
+	chunk->error = 0;
+	chunk->eof = false;
+	chunk->size = 0;
+
+	if (file->reader->submit(file->reader, chunk)) {
+		fprintf(stderr, "%s: error queueing read-ahead request.\n",
+			file->path);
+		free(chunk);
+		return -1;
+	}
+
+	file->in_flight += 1;
+	return 0;
+}
+
+static int file_precache_async(istream_t *strm)
+{
+	file_istream_t *file = (file_istream_t *)strm;
+	size_t used = strm->buffer_used - strm->buffer_offset;
+	read_chunk_t *chunk, *old;
+
+	/* unread data that does not fit the headroom stays where it is */
+	if (file->eof || used > BUFSZ) {
+		if (strm->buffer_offset > 0) {
+			strm->buffer += strm->buffer_offset;
+			strm->buffer_used = used;
+			strm->buffer_offset = 0;
+		}
+		return 0;
+	}
+
+	chunk = file->reader->dequeue(file->reader);
+	if (chunk == NULL) {
+		fprintf(stderr, "%s: read-ahead stalled.\n", file->path);
+		return -1;
+	}
+
+	file->in_flight -= 1;
+
+	if (chunk->error != 0) {
+		errno = chunk->error;
+		perror(file->path);
+		free(chunk);
+		return -1;
+	}
+
+	if (used > 0)
+		memcpy(chunk->data + BUFSZ - used,
+		       strm->buffer + strm->buffer_offset, used);
+
+	strm->buffer = chunk->data + BUFSZ - used;
+	strm->buffer_used = used + chunk->size;
+	strm->buffer_offset = 0;
+	file->eof = chunk->eof;
+
+	old = file->current;
+	file->current = chunk;
+
+	if (old == NULL)
+		return 0;
+
+	if (file->eof) {
+		free(old);
+		return 0;
+	}
+
+	return submit_chunk(file, old);
+}
+
+/*
+  Reading from a pipe blocks until the other end produces data. Move that
+  into a background thread that keeps a few chunks ahead of the consumer.
+ */
+static void start_read_ahead(file_istream_t *file)
+{
+	istream_t *strm = (istream_t *)file;
+	read_chunk_t *chunk;
+	size_t i;
+
+	file->reader = thread_pool_create(1, fill_chunk);
+	if (file->reader == NULL)
+		return;
+
+	for (i = 0; i < NUM_CHUNKS; ++i) {
+		chunk = calloc(1, sizeof(*chunk));
+		if (chunk == NULL)
+			break;
+
+		chunk->fd = file->fd;
+
+		if (submit_chunk(file, chunk))
+			break;
+	}
+
+	if (file->in_flight == 0) {
+		file->reader->destroy(file->reader);
+		file->reader = NULL;
+		return;
+	}
+
+	strm->buffer = NULL;
+	strm->precache = file_precache_async;
+	strm->precache_compacts = true;
+	strm->read_direct = NULL;
+}
+
+static void file_setup(file_istream_t *file)
+{
+	istream_t *strm = (istream_t *)file;
+	struct stat sb;
+
+	strm->buffer = file->buffer;
+	strm->precache = file_precache;
+	strm->read_direct = file_read_direct;
+
+	if (fstat(file->fd, &sb) != 0)
+		return;
+
+	if (S_ISFIFO(sb.st_mode) || S_ISSOCK(sb.st_mode)) {
+		start_read_ahead(file);
+	} else if (S_ISREG(sb.st_mode)) {
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_SEQUENTIAL)
+		posix_fadvise(file->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+		strm->seek = file_seek;
+		strm->tell = file_tell;
+		strm->prefetch = file_prefetch;
+	}
+}
+
 static const char *file_get_filename(istream_t *strm)
 {
 	file_istream_t *file = (file_istream_t *)strm;
@@ -56,6 +306,16 @@ static void file_destroy(sqfs_object_t *obj)
 {
 	file_istream_t *file = (file_istream_t *)obj;
 
+	if (file->reader != NULL) {
+		while (file->in_flight > 0) {
+			free(file->reader->dequeue(file->reader));
+			file->in_flight -= 1;
+		}
+
+		file->reader->destroy(file->reader);
+		free(file->current);
+	}
+
 	if (file->fd != STDIN_FILENO)
 		close(file->fd);
 
@@ -86,8 +346,7 @@ istream_t *istream_open_file(const char *path)
 		goto fail_path;
 	}
 
-	strm->buffer = file->buffer;
-	strm->precache = file_precache;
+	file_setup(file);
 	strm->get_filename = file_get_filename;
 	obj->destroy = file_destroy;
 	return strm;
@@ -112,8 +371,7 @@ istream_t *istream_open_stdin(void)
 		goto fail;
 
 	file->fd = STDIN_FILENO;
-	strm->buffer = file->buffer;
-	strm->precache = file_precache;
+	file_setup(file);
 	strm->get_filename = file_get_filename;
 	obj->destroy = file_destroy;
 	return strm;
@@ -11,8 +11,11 @@ typedef struct {
 	char *path;
 	int fd;
 
+	bool sparse;
+
 	off_t sparse_count;
 	off_t size;
+	off_t size_hint;
 } file_ostream_t;
 
 static int file_append(ostream_t *strm, const void *data, size_t size)
@@ -65,11 +68,44 @@ static int file_append_sparse(ostream_t *strm, size_t size)
 	return 0;
 }
 
+static int file_set_size_hint(ostream_t *strm, sqfs_u64 size)
+{
+	file_ostream_t *file = (file_ostream_t *)strm;
+
+	if (file->size != 0 || size == 0)
+		return 0;
+
+	if ((off_t)size < 0 || (sqfs_u64)((off_t)size) != size)
+		return 0;
+
+	file->size_hint = size;
+
+	/* holes are left unallocated, just set the final size */
+	if (file->sparse) {
+		if (ftruncate(file->fd, file->size_hint) != 0)
+			goto fail;
+		return 0;
+	}
+
+#ifdef HAVE_FALLOCATE
+	/* reserve the space, but keep the apparent size until written */
+	if (fallocate(file->fd, FALLOC_FL_KEEP_SIZE, 0, file->size_hint)) {
+		if (errno == EOPNOTSUPP || errno == ENOSYS || errno == EINVAL)
+			return 0;
+		goto fail;
+	}
+#endif
+	return 0;
+fail:
+	perror(file->path);
+	return -1;
+}
+
 static int file_flush(ostream_t *strm)
 {
 	file_ostream_t *file = (file_ostream_t *)strm;
 
-	if (file->sparse_count > 0) {
+	if (file->sparse_count > 0 || file->size < file->size_hint) {
 		if (ftruncate(file->fd, file->size) != 0)
 			goto fail;
 	}
@@ -132,10 +168,13 @@ ostream_t *ostream_open_file(const char *path, int flags)
 		goto fail_path;
 	}
 
-	if (flags & OSTREAM_OPEN_SPARSE)
+	if (flags & OSTREAM_OPEN_SPARSE) {
 		strm->append_sparse = file_append_sparse;
+		file->sparse = true;
+	}
 
 	strm->append = file_append;
+	strm->set_size_hint = file_set_size_hint;
 	strm->flush = file_flush;
 	strm->get_filename = file_get_filename;
 	obj->destroy = file_destroy;
@@ -4,9 +4,7 @@
  *
  * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
  */
-#include "config.h"
-
-#include "fstree.h"
+#include "internal.h"
 
 #include <string.h>
 #include <assert.h>
@@ -31,9 +29,7 @@ tree_node_t *fstree_add_generic(fstree_t *fs, const char *path,
 	name = strrchr(path, '/');
 	name = (name == NULL ? path : (name + 1));
 
-	child = parent->data.dir.children;
-	while (child != NULL && strcmp(child->name, name) != 0)
-		child = child->next;
+	child = dir_index_lookup(fs, parent, name, strlen(name));
 out:
 	if (child != NULL) {
 		if (!S_ISDIR(child->mode) || !S_ISDIR(sb->st_mode) ||
@@ -50,5 +46,5 @@ out:
 		return child;
 	}
 
-	return fstree_mknode(parent, name, strlen(name), extra, sb);
+	return fstree_mknode(fs, parent, name, strlen(name), extra, sb);
 }
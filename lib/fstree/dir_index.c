@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * dir_index.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "internal.h"
+#include "hash_table.h"
+#include "util.h"
+
+#include <string.h>
+
+/*
+  The keys are the node names. Lookups use a path component that is
+  terminated by either a '\0' or a '/', which cannot be part of a name.
+ */
+static bool name_equals(void *user, const void *a, const void *b)
+{
+	const char *lhs = a, *rhs = b;
+	(void)user;
+
+	while (*lhs != '\0' && *lhs != '/' && *lhs == *rhs) {
+		++lhs;
+		++rhs;
+	}
+
+	return (*lhs == '\0' || *lhs == '/') && (*rhs == '\0' || *rhs == '/');
+}
+
+static int register_index(fstree_t *fs, struct hash_table *ht)
+{
+	struct hash_table **new;
+	size_t size;
+
+	if (fs->num_dir_indices == fs->max_dir_indices) {
+		size = fs->max_dir_indices ? fs->max_dir_indices * 2 : 16;
+		new = realloc(fs->dir_indices, size * sizeof(new[0]));
+		if (new == NULL)
+			return -1;
+
+		fs->dir_indices = new;
+		fs->max_dir_indices = size;
+	}
+
+	fs->dir_indices[fs->num_dir_indices++] = ht;
+	return 0;
+}
+
+static void build_index(fstree_t *fs, tree_node_t *dir)
+{
+	struct hash_table *ht;
+	tree_node_t *it;
+
+	ht = hash_table_create(NULL, name_equals);
+	if (ht == NULL)
+		return;
+
+	for (it = dir->data.dir.children; it != NULL; it = it->next) {
+		if (hash_table_insert_pre_hashed(ht, xxh32(it->name,
+							   strlen(it->name)),
+						 it->name, it) == NULL) {
+			goto fail;
+		}
+	}
+
+	/* the tree keeps track of them, so it can free all in one go */
+	if (register_index(fs, ht))
+		goto fail;
+
+	dir->data.dir.index = ht;
+	return;
+fail:
+	/* keep going without an index */
+	hash_table_destroy(ht, NULL);
+}
+
+tree_node_t *dir_index_lookup(fstree_t *fs, tree_node_t *dir,
+			      const char *name, size_t len)
+{
+	struct hash_entry *ent;
+	tree_node_t *n;
+	size_t count = 0;
+
+	if (dir->data.dir.index_stale)
+		dir_index_drop(fs, dir);
+
+	if (dir->data.dir.index == NULL) {
+		for (n = dir->data.dir.children; n != NULL; n = n->next) {
+			if (strncmp(n->name, name, len) == 0 &&
+			    n->name[len] == '\0') {
+				return n;
+			}
+
+			++count;
+		}
+
+		if (count < DIR_INDEX_THRESHOLD)
+			return NULL;
+
+		build_index(fs, dir);
+		return NULL;
+	}
+
+	ent = hash_table_search_pre_hashed(dir->data.dir.index,
+					   xxh32(name, len), name);
+
+	return ent == NULL ? NULL : ent->data;
+}
+
+void dir_index_add(tree_node_t *dir, tree_node_t *n)
+{
+	struct hash_table *ht = dir->data.dir.index;
+
+	if (ht == NULL)
+		return;
+
+	/* on failure, leave a stale index behind, dropped by the next lookup */
+	if (hash_table_insert_pre_hashed(ht, xxh32(n->name, strlen(n->name)),
+					 n->name, n) == NULL) {
+		dir->data.dir.index_stale = true;
+	}
+}
+
+void dir_index_drop(fstree_t *fs, tree_node_t *dir)
+{
+	struct hash_table *ht = dir->data.dir.index;
+	size_t i;
+
+	if (ht == NULL)
+		return;
+
+	for (i = 0; i < fs->num_dir_indices; ++i) {
+		if (fs->dir_indices[i] == ht) {
+			fs->dir_indices[i] =
+				fs->dir_indices[--fs->num_dir_indices];
+			break;
+		}
+	}
+
+	hash_table_destroy(ht, NULL);
+	dir->data.dir.index = NULL;
+	dir->data.dir.index_stale = false;
+}
+
+void dir_index_cleanup(fstree_t *fs)
+{
+	size_t i;
+
+	for (i = 0; i < fs->num_dir_indices; ++i)
+		hash_table_destroy(fs->dir_indices[i], NULL);
+
+	free(fs->dir_indices);
+	fs->dir_indices = NULL;
+	fs->num_dir_indices = 0;
+	fs->max_dir_indices = 0;
+}
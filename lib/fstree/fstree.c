@@ -6,6 +6,10 @@
  */
 #include "internal.h"
 
+#ifndef NO_CUSTOM_ALLOC
+#include "mempool.h"
+#endif
+
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -113,10 +117,21 @@ int fstree_init(fstree_t *fs, char *defaults)
 	if (defaults != NULL && process_defaults(&fs->defaults, defaults) != 0)
 		return -1;
 
-	fs->root = fstree_mknode(NULL, "", 0, NULL, &fs->defaults);
+#ifndef NO_CUSTOM_ALLOC
+	fs->arena = mem_arena_create();
+	if (fs->arena == NULL) {
+		perror("initializing file system tree");
+		return -1;
+	}
+#endif
+
+	fs->root = fstree_mknode(fs, NULL, "", 0, NULL, &fs->defaults);
 
 	if (fs->root == NULL) {
 		perror("initializing file system tree");
+#ifndef NO_CUSTOM_ALLOC
+		mem_arena_destroy(fs->arena);
+#endif
 		return -1;
 	}
 
@@ -126,7 +141,18 @@ int fstree_init(fstree_t *fs, char *defaults)
 
 void fstree_cleanup(fstree_t *fs)
 {
+	dir_index_cleanup(fs);
+
+#ifndef NO_CUSTOM_ALLOC
+	if (fs->arena != NULL) {
+		mem_arena_destroy(fs->arena);
+	} else {
+		free_recursive(fs->root);
+	}
+#else
 	free_recursive(fs->root);
+#endif
+
 	free(fs->inodes);
 	memset(fs, 0, sizeof(*fs));
 }
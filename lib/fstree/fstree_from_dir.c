@@ -4,14 +4,32 @@
  *
  * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
  */
-#include "config.h"
-#include "fstree.h"
+#include "internal.h"
+#include "threadpool.h"
 
 #include <dirent.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 
+#ifdef HAVE_SYS_XATTR_H
+#include <sys/xattr.h>
+
+#if defined(__APPLE__) && defined(__MACH__)
+#define llistxattr(path, list, size) \
+	listxattr(path, list, size, XATTR_NOFOLLOW)
+
+#define lgetxattr(path, name, value, size) \
+	getxattr(path, name, value, size, 0, XATTR_NOFOLLOW)
+
+#define listxattr(path, list, size) \
+	listxattr(path, list, size, 0)
+
+#define getxattr(path, name, value, size) \
+	getxattr(path, name, value, size, 0, 0)
+#endif
+#endif
+
 #if defined(_WIN32) || defined(__WINDOWS__)
 #define UNIX_EPOCH_ON_W32 11644473600UL
 #define W32_TICS_PER_SEC 10000000UL
@@ -57,7 +75,7 @@ static int add_node(fstree_t *fs, tree_node_t *root,
 		return -1;
 	}
 
-	n = calloc(1, sizeof(*n) + length + 1);
+	n = node_alloc(fs, length + 1);
 	if (n == NULL) {
 		fprintf(stderr, "creating tree node: out-of-memory\n");
 		return -1;
@@ -69,14 +87,14 @@ static int add_node(fstree_t *fs, tree_node_t *root,
 
 	if (entry->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
 		if (flags & DIR_SCAN_NO_DIR) {
-			free(n);
+			node_free(fs, n);
 			return 0;
 		}
 
 		n->mode = S_IFDIR | 0755;
 	} else {
 		if (flags & DIR_SCAN_NO_FILE) {
-			free(n);
+			node_free(fs, n);
 			return 0;
 		}
 
@@ -87,7 +105,7 @@ static int add_node(fstree_t *fs, tree_node_t *root,
 		int ret = cb(user, fs, n);
 
 		if (ret != 0) {
-			free(n);
+			node_free(fs, n);
 			return ret < 0 ? ret : 0;
 		}
 	}
@@ -101,6 +119,7 @@ static int add_node(fstree_t *fs, tree_node_t *root,
 	n->parent = root;
 	n->next = root->data.dir.children;
 	root->data.dir.children = n;
+	dir_index_add(root, n);
 	return 0;
 }
 
@@ -263,26 +282,18 @@ fail:
 	return -1;
 
 }
-#else
-static void discard_node(tree_node_t *root, tree_node_t *n)
-{
-	tree_node_t *it;
-
-	if (n == root->data.dir.children) {
-		root->data.dir.children = n->next;
-	} else {
-		it = root->data.dir.children;
-
-		while (it != NULL && it->next != n)
-			it = it->next;
-
-		if (it != NULL)
-			it->next = n->next;
-	}
 
-	free(n);
+int fstree_from_subdir_parallel(fstree_t *fs, tree_node_t *root,
+				const char *path, const char *subdir,
+				scan_node_callback cb,
+				scan_xattr_callback xattr_cb, void *user,
+				unsigned int flags, size_t num_jobs)
+{
+	(void)xattr_cb;
+	(void)num_jobs;
+	return fstree_from_subdir(fs, root, path, subdir, cb, user, flags);
 }
-
+#else
 static int populate_dir(int dir_fd, fstree_t *fs, tree_node_t *root,
 			dev_t devstart, scan_node_callback cb,
 			void *user, unsigned int flags)
@@ -394,7 +405,7 @@ static int populate_dir(int dir_fd, fstree_t *fs, tree_node_t *root,
 
 			ret = 0;
 		} else {
-			n = fstree_mknode(root, ent->d_name,
+			n = fstree_mknode(fs, root, ent->d_name,
 					  strlen(ent->d_name), extra, &sb);
 			if (n == NULL) {
 				perror("creating tree node");
@@ -411,7 +422,7 @@ static int populate_dir(int dir_fd, fstree_t *fs, tree_node_t *root,
 			goto fail;
 
 		if (ret > 0) {
-			discard_node(root, n);
+			node_discard(fs, n);
 			continue;
 		}
 
@@ -492,4 +503,872 @@ int fstree_from_dir(fstree_t *fs, tree_node_t *root,
 {
 	return fstree_from_subdir(fs, root, path, NULL, cb, user, flags);
 }
+
+/*****************************************************************************/
+
+/*
+  The parallel scanner splits the work into one job per directory. A worker
+  reads the directory and collects the stat data, link targets and extended
+  attributes of the entries, sorted by name. The calling thread creates the
+  tree nodes and runs the callbacks, one directory at a time, in the order
+  the jobs were submitted. The resulting tree and the order of callbacks thus
+  do not depend on the number of workers or on how they are scheduled.
+ */
+typedef struct {
+	struct stat sb;
+	char *link_target;
+
+	/* key/value pairs, followed by the keys and values in one block */
+	dir_scan_xattr_t *xattrs;
+	size_t num_xattrs;
+
+	char name[];
+} scan_entry_t;
+
+typedef struct scan_job_t {
+	struct scan_job_t *next;
+
+	/* directory node to populate, only touched by the calling thread */
+	tree_node_t *node;
+
+	/* relative to the directory the scan was started at */
+	char *path;
+
+	/* offset of the part of the path below the starting directory */
+	size_t rel;
+
+	/* for the first job, the xattrs of the starting directory itself */
+	bool want_self;
+	scan_entry_t *self;
+
+	scan_entry_t **entries;
+	size_t count;
+	size_t max;
+
+	/* errno value and the name of what failed, set by the worker */
+	int err;
+	char *err_name;
+} scan_job_t;
+
+typedef struct {
+	int root_fd;
+	dev_t devstart;
+
+	/* the starting directory, i.e. root_fd or the sub directory in it */
+	int start_fd;
+	unsigned int flags;
+
+	/* path of the starting directory */
+	const char *root_path;
+
+	/* access files through /proc/self/fd and O_PATH descriptors */
+	bool use_fd_path;
+} scan_ctx_t;
+
+/* per worker state, with buffers that are reused across entries */
+typedef struct {
+	const scan_ctx_t *ctx;
+
+	char *key_list;
+	size_t key_list_size;
+
+	sqfs_u8 *value;
+	size_t value_size;
+
+	/* keys and values of the current entry, copied out when complete */
+	sqfs_u8 *blob;
+	size_t blob_used;
+	size_t blob_size;
+
+	size_t *offsets;
+	size_t offsets_max;
+
+	char *path;
+	size_t path_size;
+} scan_worker_t;
+
+static void free_entry(scan_entry_t *ent)
+{
+	if (ent != NULL) {
+		free(ent->link_target);
+		free(ent->xattrs);
+		free(ent);
+	}
+}
+
+static void free_job(scan_job_t *job)
+{
+	size_t i;
+
+	if (job == NULL)
+		return;
+
+	for (i = 0; i < job->count; ++i)
+		free_entry(job->entries[i]);
+
+	free_entry(job->self);
+	free(job->entries);
+	free(job->err_name);
+	free(job->path);
+	free(job);
+}
+
+static scan_job_t *create_job(tree_node_t *node, const scan_job_t *parent,
+			      const char *name)
+{
+	size_t plen = parent == NULL ? 0 : strlen(parent->path);
+	size_t nlen = strlen(name);
+	scan_job_t *job;
+
+	job = calloc(1, sizeof(*job));
+	if (job == NULL)
+		return NULL;
+
+	job->path = malloc(plen + nlen + 2);
+	if (job->path == NULL) {
+		free(job);
+		return NULL;
+	}
+
+	if (plen > 0) {
+		memcpy(job->path, parent->path, plen);
+		job->path[plen++] = '/';
+	}
+
+	memcpy(job->path + plen, name, nlen + 1);
+
+	if (parent == NULL) {
+		job->rel = nlen;
+	} else if (parent->path[parent->rel] == '\0') {
+		job->rel = plen;
+	} else {
+		job->rel = parent->rel;
+	}
+
+	job->node = node;
+	return job;
+}
+
+static bool skip_by_type(mode_t mode, unsigned int flags)
+{
+	switch (mode & S_IFMT) {
+	case S_IFSOCK: return (flags & DIR_SCAN_NO_SOCK) != 0;
+	case S_IFLNK:  return (flags & DIR_SCAN_NO_SLINK) != 0;
+	case S_IFREG:  return (flags & DIR_SCAN_NO_FILE) != 0;
+	case S_IFBLK:  return (flags & DIR_SCAN_NO_BLK) != 0;
+	case S_IFCHR:  return (flags & DIR_SCAN_NO_CHR) != 0;
+	case S_IFIFO:  return (flags & DIR_SCAN_NO_FIFO) != 0;
+	default:
+		break;
+	}
+	return false;
+}
+
+static int entry_cmp(const void *lhs, const void *rhs)
+{
+	const scan_entry_t *a = *((scan_entry_t *const *)lhs);
+	const scan_entry_t *b = *((scan_entry_t *const *)rhs);
+
+	return strcmp(a->name, b->name);
+}
+
+static int job_fail(scan_job_t *job, const char *name)
+{
+	job->err = errno;
+	job->err_name = strdup(name);
+	return 0;
+}
+
+#ifdef HAVE_SYS_XATTR_H
+static int grow_buffer(void **buffer, size_t *size, size_t need)
+{
+	size_t new_sz = *size ? *size : 256;
+	void *new;
+
+	while (new_sz < need) {
+		if (SZ_MUL_OV(new_sz, 2, &new_sz)) {
+			errno = EOVERFLOW;
+			return -1;
+		}
+	}
+
+	if (new_sz == *size)
+		return 0;
+
+	new = realloc(*buffer, new_sz);
+	if (new == NULL)
+		return -1;
+
+	*buffer = new;
+	*size = new_sz;
+	return 0;
+}
+
+static ssize_t list_keys(scan_worker_t *w, bool follow)
+{
+	ssize_t ret;
+
+	/* try with the buffer from the last file, probe only if too small */
+	for (;;) {
+		if (follow) {
+			ret = listxattr(w->path, w->key_list,
+					w->key_list_size);
+		} else {
+			ret = llistxattr(w->path, w->key_list,
+					 w->key_list_size);
+		}
+
+		/* with a zero sized buffer, only the size is returned */
+		if (ret >= 0 && (ret == 0 || w->key_list_size > 0))
+			break;
+
+		if (ret < 0) {
+			if (errno != ERANGE)
+				break;
+
+			ret = follow ? listxattr(w->path, NULL, 0) :
+				llistxattr(w->path, NULL, 0);
+			if (ret < 0)
+				break;
+		}
+
+		if (grow_buffer((void **)&w->key_list, &w->key_list_size,
+				(size_t)ret + 1)) {
+			return -1;
+		}
+	}
+
+	if (ret < 0 && errno == ENOTSUP)
+		ret = 0;
+
+	return ret;
+}
+
+static ssize_t get_value(scan_worker_t *w, bool follow, const char *key)
+{
+	ssize_t ret;
+
+	for (;;) {
+		if (follow) {
+			ret = getxattr(w->path, key, w->value,
+				       w->value_size);
+		} else {
+			ret = lgetxattr(w->path, key, w->value,
+					w->value_size);
+		}
+
+		if (ret >= 0 && (ret == 0 || w->value_size > 0))
+			break;
+
+		if (ret < 0) {
+			if (errno != ERANGE)
+				break;
+
+			ret = follow ? getxattr(w->path, key, NULL, 0) :
+				lgetxattr(w->path, key, NULL, 0);
+			if (ret < 0)
+				break;
+		}
+
+		if (grow_buffer((void **)&w->value, &w->value_size,
+				(size_t)ret + 1)) {
+			return -1;
+		}
+	}
+
+	return ret;
+}
+
+static int blob_append(scan_worker_t *w, const void *data, size_t size)
+{
+	size_t need;
+
+	if (SZ_ADD_OV(w->blob_used, size, &need)) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	if (grow_buffer((void **)&w->blob, &w->blob_size, need))
+		return -1;
+
+	memcpy(w->blob + w->blob_used, data, size);
+	w->blob_used += size;
+	return 0;
+}
+
+static int set_path(scan_worker_t *w, int fd, const char *dir,
+		    const char *name)
+{
+	size_t rlen, dlen, nlen, need;
+
+	if (fd >= 0) {
+		if (grow_buffer((void **)&w->path, &w->path_size, 32))
+			return -1;
+
+		snprintf(w->path, w->path_size, "/proc/self/fd/%d", fd);
+		return 0;
+	}
+
+	rlen = strlen(w->ctx->root_path);
+	dlen = dir == NULL ? 0 : strlen(dir);
+	nlen = strlen(name);
+	need = rlen + dlen + nlen + 3;
+
+	if (grow_buffer((void **)&w->path, &w->path_size, need))
+		return -1;
+
+	memcpy(w->path, w->ctx->root_path, rlen);
+	w->path[rlen++] = '/';
+
+	if (dlen > 0) {
+		memcpy(w->path + rlen, dir, dlen);
+		rlen += dlen;
+		w->path[rlen++] = '/';
+	}
+
+	memcpy(w->path + rlen, name, nlen + 1);
+	return 0;
+}
+
+/*
+  Reads the keys and values into the worker buffers first. The entry gets a
+  single allocation holding the pair array, followed by the keys and values.
+ */
+static int collect_xattrs(scan_worker_t *w, scan_entry_t *ent, bool follow)
+{
+	size_t i, count = 0, pos = 0, *new;
+	dir_scan_xattr_t *pairs;
+	ssize_t list_len, ret;
+	sqfs_u8 *data;
+	char *key;
+
+	w->blob_used = 0;
+
+	list_len = list_keys(w, follow);
+	if (list_len <= 0)
+		return list_len < 0 ? -1 : 0;
+
+	while (pos < (size_t)list_len) {
+		key = w->key_list + pos;
+		pos += strlen(key) + 1;
+
+		ret = get_value(w, follow, key);
+		if (ret < 0) {
+			/* removed while we were looking at it */
+			if (errno == ENODATA)
+				continue;
+			return -1;
+		}
+
+		if (count == w->offsets_max) {
+			size_t sz = w->offsets_max ? w->offsets_max * 2 : 16;
+
+			new = realloc(w->offsets, sz * 2 * sizeof(new[0]));
+			if (new == NULL)
+				return -1;
+
+			w->offsets = new;
+			w->offsets_max = sz;
+		}
+
+		w->offsets[count * 2] = w->blob_used;
+		if (blob_append(w, key, strlen(key) + 1))
+			return -1;
+
+		w->offsets[count * 2 + 1] = w->blob_used;
+		if (blob_append(w, w->value, (size_t)ret))
+			return -1;
+
+		++count;
+	}
+
+	if (count == 0)
+		return 0;
+
+	pairs = malloc(count * sizeof(pairs[0]) + w->blob_used);
+	if (pairs == NULL)
+		return -1;
+
+	data = (sqfs_u8 *)(pairs + count);
+	memcpy(data, w->blob, w->blob_used);
+
+	for (i = 0; i < count; ++i) {
+		size_t koff = w->offsets[i * 2], voff = w->offsets[i * 2 + 1];
+		size_t vend = (i + 1) < count ?
+			w->offsets[(i + 1) * 2] : w->blob_used;
+
+		pairs[i].key = (const char *)data + koff;
+		pairs[i].value = data + voff;
+		pairs[i].value_len = vend - voff;
+	}
+
+	ent->xattrs = pairs;
+	ent->num_xattrs = count;
+	return 0;
+}
+
+static int read_xattrs(scan_worker_t *w, scan_entry_t *ent, int dir_fd,
+		       const char *dir, const char *name)
+{
+	int fd = -1, ret;
+
+#ifdef O_PATH
+	/*
+	  The f*xattr calls do not accept O_PATH descriptors, but going
+	  through the magic link in /proc operates on the file itself,
+	  even if it is a symlink, without resolving the path again.
+	 */
+	if (w->ctx->use_fd_path) {
+		fd = openat(dir_fd, name, O_PATH | O_NOFOLLOW | O_CLOEXEC);
+		if (fd < 0)
+			return -1;
+	}
+#else
+	(void)dir_fd;
+#endif
+
+	ret = set_path(w, fd, dir, name);
+	if (ret == 0)
+		ret = collect_xattrs(w, ent, fd >= 0);
+
+	if (fd >= 0)
+		close(fd);
+
+	return ret;
+}
+#endif
+
+static scan_entry_t *create_entry(const struct stat *sb, const char *name)
+{
+	size_t nlen = strlen(name);
+	scan_entry_t *ent;
+
+	ent = calloc(1, sizeof(*ent) + nlen + 1);
+	if (ent == NULL)
+		return NULL;
+
+	ent->sb = *sb;
+	memcpy(ent->name, name, nlen + 1);
+	return ent;
+}
+
+static int read_entry(scan_job_t *job, scan_worker_t *w, int dir_fd,
+		      const char *name)
+{
+	const scan_ctx_t *ctx = w->ctx;
+	scan_entry_t *ent, **new;
+	struct stat sb;
+	size_t size;
+
+	if (fstatat(dir_fd, name, &sb, AT_SYMLINK_NOFOLLOW))
+		return -1;
+
+	if (skip_by_type(sb.st_mode, ctx->flags))
+		return 0;
+
+	if ((ctx->flags & DIR_SCAN_ONE_FILESYSTEM) &&
+	    sb.st_dev != ctx->devstart) {
+		return 0;
+	}
+
+	if (job->count == job->max) {
+		size = job->max ? job->max * 2 : 32;
+		new = realloc(job->entries, sizeof(new[0]) * size);
+		if (new == NULL)
+			return -1;
+
+		job->entries = new;
+		job->max = size;
+	}
+
+	ent = create_entry(&sb, name);
+	if (ent == NULL)
+		return -1;
+
+	job->entries[job->count++] = ent;
+
+#ifdef HAVE_SYS_XATTR_H
+	if (ctx->flags & DIR_SCAN_READ_XATTR) {
+		if (read_xattrs(w, ent, dir_fd, job->path, name))
+			return -1;
+	}
+#endif
+
+	if (!S_ISLNK(sb.st_mode))
+		return 0;
+
+	if ((sizeof(sb.st_size) > sizeof(size_t)) && sb.st_size > SIZE_MAX) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	if (SZ_ADD_OV((size_t)sb.st_size, 1, &size)) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	ent->link_target = calloc(1, size);
+	if (ent->link_target == NULL)
+		return -1;
+
+	if (readlinkat(dir_fd, name, ent->link_target,
+		       (size_t)sb.st_size) < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+static int read_self(scan_job_t *job, scan_worker_t *w)
+{
+	struct stat sb;
+
+	memset(&sb, 0, sizeof(sb));
+
+	job->self = create_entry(&sb, job->path);
+	if (job->self == NULL)
+		return -1;
+
+#ifdef HAVE_SYS_XATTR_H
+	if (w->ctx->flags & DIR_SCAN_READ_XATTR) {
+		if (read_xattrs(w, job->self, w->ctx->root_fd, NULL,
+				job->path)) {
+			return -1;
+		}
+	}
+#else
+	(void)w;
+#endif
+	return 0;
+}
+
+/*
+  Open the directory of a job one component at a time, relative to the
+  starting directory. The full path can grow past PATH_MAX, so it cannot
+  be opened in one go.
+ */
+static int open_job_dir(const scan_ctx_t *ctx, scan_job_t *job)
+{
+	int fd = ctx->start_fd, next, err;
+	char *name = job->path + job->rel;
+	char *end;
+
+	if (*name == '\0')
+		return openat(fd, ".", O_DIRECTORY | O_RDONLY | O_CLOEXEC);
+
+	for (;;) {
+		end = strchr(name, '/');
+		if (end != NULL)
+			*end = '\0';
+
+		next = openat(fd, name, O_DIRECTORY | O_RDONLY | O_CLOEXEC);
+		err = errno;
+
+		if (end != NULL)
+			*end = '/';
+
+		if (fd != ctx->start_fd)
+			close(fd);
+
+		if (next < 0) {
+			errno = err;
+			return -1;
+		}
+
+		fd = next;
+		if (end == NULL)
+			break;
+
+		name = end + 1;
+	}
+
+	return fd;
+}
+
+static int scan_worker(void *user, void *work_item)
+{
+	scan_worker_t *w = user;
+	scan_job_t *job = work_item;
+	struct dirent *ent;
+	DIR *dir;
+	int fd;
+
+	if (job->want_self && read_self(job, w))
+		return job_fail(job, job->path);
+
+	fd = open_job_dir(w->ctx, job);
+	if (fd < 0)
+		return job_fail(job, job->path);
+
+	dir = fdopendir(fd);
+	if (dir == NULL) {
+		job_fail(job, job->path);
+		close(fd);
+		return 0;
+	}
+
+	for (;;) {
+		errno = 0;
+		ent = readdir(dir);
+
+		if (ent == NULL) {
+			if (errno)
+				job_fail(job, job->path);
+			break;
+		}
+
+		if (!strcmp(ent->d_name, "..") || !strcmp(ent->d_name, "."))
+			continue;
+
+		if (read_entry(job, w, dirfd(dir), ent->d_name)) {
+			job_fail(job, ent->d_name);
+			break;
+		}
+	}
+
+	closedir(dir);
+
+	if (job->err == 0 && job->count > 1) {
+		qsort(job->entries, job->count, sizeof(job->entries[0]),
+		      entry_cmp);
+	}
+
+	return 0;
+}
+
+static int merge_job(fstree_t *fs, scan_job_t *job, scan_node_callback cb,
+		     scan_xattr_callback xattr_cb, void *user,
+		     unsigned int flags, scan_job_t **pending_tail)
+{
+	tree_node_t *root = job->node, *n;
+	scan_entry_t *ent;
+	scan_job_t *sub;
+	size_t i;
+	int ret;
+
+	if (job->err != 0) {
+		fprintf(stderr, "%s: %s\n", job->err_name == NULL ?
+			job->path : job->err_name, strerror(job->err));
+		return -1;
+	}
+
+	if (job->self != NULL && xattr_cb != NULL) {
+		if (xattr_cb(user, fs, root, job->self->xattrs,
+			     job->self->num_xattrs)) {
+			return -1;
+		}
+	}
+
+	for (i = 0; i < job->count; ++i) {
+		ent = job->entries[i];
+
+		if (!(flags & DIR_SCAN_KEEP_TIME))
+			ent->sb.st_mtime = fs->defaults.st_mtime;
+
+		if (S_ISDIR(ent->sb.st_mode) && (flags & DIR_SCAN_NO_DIR)) {
+			n = fstree_get_node_by_path(fs, root, ent->name,
+						    false, false);
+			if (n == NULL)
+				continue;
+
+			ret = 0;
+		} else {
+			n = fstree_mknode(fs, root, ent->name,
+					  strlen(ent->name), ent->link_target,
+					  &ent->sb);
+			if (n == NULL) {
+				perror("creating tree node");
+				return -1;
+			}
+
+			ret = (cb == NULL) ? 0 : cb(user, fs, n);
+
+			if (ret == 0 && xattr_cb != NULL) {
+				if (xattr_cb(user, fs, n, ent->xattrs,
+					     ent->num_xattrs)) {
+					return -1;
+				}
+			}
+		}
+
+		if (ret < 0)
+			return -1;
+
+		if (ret > 0) {
+			node_discard(fs, n);
+			continue;
+		}
+
+		if (S_ISDIR(n->mode) && !(flags & DIR_SCAN_NO_RECURSION)) {
+			sub = create_job(n, job, ent->name);
+			if (sub == NULL) {
+				perror(ent->name);
+				return -1;
+			}
+
+			(*pending_tail)->next = sub;
+			*pending_tail = sub;
+		}
+	}
+
+	return 0;
+}
+
+static void cleanup_workers(scan_worker_t *workers, size_t count)
+{
+	size_t i;
+
+	if (workers == NULL)
+		return;
+
+	for (i = 0; i < count; ++i) {
+		free(workers[i].key_list);
+		free(workers[i].value);
+		free(workers[i].blob);
+		free(workers[i].offsets);
+		free(workers[i].path);
+	}
+
+	free(workers);
+}
+
+int fstree_from_subdir_parallel(fstree_t *fs, tree_node_t *root,
+				const char *path, const char *subdir,
+				scan_node_callback cb,
+				scan_xattr_callback xattr_cb, void *user,
+				unsigned int flags, size_t num_jobs)
+{
+	scan_job_t pending, *tail = &pending, *job;
+	size_t i, in_flight = 0, max_in_flight, count = 0;
+	scan_worker_t *workers = NULL;
+	thread_pool_t *pool = NULL;
+	int status = -1;
+	scan_ctx_t ctx;
+	struct stat sb;
+
+	if (!S_ISDIR(root->mode)) {
+		fprintf(stderr,
+			"scanning %s/%s into %s: target is not a directory\n",
+			path, subdir == NULL ? "" : subdir, root->name);
+		return -1;
+	}
+
+	memset(&ctx, 0, sizeof(ctx));
+	memset(&pending, 0, sizeof(pending));
+	ctx.flags = flags;
+	ctx.root_path = path;
+#ifdef O_PATH
+	ctx.use_fd_path = access("/proc/self/fd", X_OK) == 0;
+#endif
+
+	ctx.root_fd = open(path, O_DIRECTORY | O_RDONLY | O_CLOEXEC);
+	if (ctx.root_fd < 0) {
+		perror(path);
+		return -1;
+	}
+
+	ctx.start_fd = ctx.root_fd;
+
+	if (subdir != NULL) {
+		ctx.start_fd = openat(ctx.root_fd, subdir,
+				      O_DIRECTORY | O_RDONLY | O_CLOEXEC);
+	}
+
+	if (ctx.start_fd < 0 || fstat(ctx.start_fd, &sb)) {
+		fprintf(stderr, "%s/%s: %s\n", path,
+			subdir == NULL ? "" : subdir, strerror(errno));
+		goto out;
+	}
+
+	ctx.devstart = sb.st_dev;
+
+	job = create_job(root, NULL, subdir == NULL ? "." : subdir);
+	if (job == NULL) {
+		perror(path);
+		goto out;
+	}
+
+	job->want_self = (xattr_cb != NULL);
+	tail->next = job;
+	tail = job;
+
+	pool = thread_pool_create(num_jobs, scan_worker);
+	if (pool == NULL) {
+		perror("creating directory scanner thread pool");
+		goto out;
+	}
+
+	count = pool->get_worker_count(pool);
+
+	workers = calloc(count, sizeof(workers[0]));
+	if (workers == NULL) {
+		perror("creating directory scanner state");
+		goto out;
+	}
+
+	for (i = 0; i < count; ++i) {
+		workers[i].ctx = &ctx;
+		pool->set_worker_ptr(pool, i, workers + i);
+	}
+
+	max_in_flight = 4 * count;
+
+	for (;;) {
+		while (pending.next != NULL && in_flight < max_in_flight) {
+			job = pending.next;
+			pending.next = job->next;
+			job->next = NULL;
+
+			if (tail == job)
+				tail = &pending;
+
+			if (pool->submit(pool, job)) {
+				fputs("Error submitting directory to "
+				      "scanner thread pool.\n", stderr);
+				free_job(job);
+				goto out;
+			}
+
+			in_flight += 1;
+		}
+
+		if (in_flight == 0)
+			break;
+
+		job = pool->dequeue(pool);
+		in_flight -= 1;
+
+		if (merge_job(fs, job, cb, xattr_cb, user, flags, &tail)) {
+			free_job(job);
+			goto out;
+		}
+
+		free_job(job);
+	}
+
+	status = 0;
+out:
+	if (pool != NULL) {
+		while (in_flight > 0) {
+			free_job(pool->dequeue(pool));
+			in_flight -= 1;
+		}
+
+		pool->destroy(pool);
+	}
+
+	cleanup_workers(workers, count);
+
+	while (pending.next != NULL) {
+		job = pending.next;
+		pending.next = job->next;
+		free_job(job);
+	}
+
+	if (ctx.start_fd >= 0 && ctx.start_fd != ctx.root_fd)
+		close(ctx.start_fd);
+
+	close(ctx.root_fd);
+	return status;
+}
 #endif
@@ -4,28 +4,11 @@
  *
  * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
  */
-#include "config.h"
-
-#include "fstree.h"
+#include "internal.h"
 
 #include <string.h>
 #include <errno.h>
 
-static tree_node_t *child_by_name(tree_node_t *root, const char *name,
-				  size_t len)
-{
-	tree_node_t *n = root->data.dir.children;
-
-	while (n != NULL) {
-		if (strncmp(n->name, name, len) == 0 && n->name[len] == '\0')
-			break;
-
-		n = n->next;
-	}
-
-	return n;
-}
-
 tree_node_t *fstree_get_node_by_path(fstree_t *fs, tree_node_t *root,
 				     const char *path, bool create_implicitly,
 				     bool stop_at_parent)
@@ -53,7 +36,7 @@ tree_node_t *fstree_get_node_by_path(fstree_t *fs, tree_node_t *root,
 			len = end - path;
 		}
 
-		n = child_by_name(root, path, len);
+		n = dir_index_lookup(fs, root, path, len);
 
 		if (n == NULL) {
 			if (!create_implicitly) {
@@ -61,7 +44,8 @@ tree_node_t *fstree_get_node_by_path(fstree_t *fs, tree_node_t *root,
 				return NULL;
 			}
 
-			n = fstree_mknode(root, path, len, NULL, &fs->defaults);
+			n = fstree_mknode(fs, root, path, len, NULL,
+					  &fs->defaults);
 			if (n == NULL)
 				return NULL;
 
@@ -4,9 +4,7 @@
  *
  * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
  */
-#include "config.h"
-
-#include "fstree.h"
+#include "internal.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -24,7 +22,7 @@ tree_node_t *fstree_add_hard_link(fstree_t *fs, const char *path,
 	n = fstree_add_generic(fs, path, &sb, target);
 	if (n != NULL) {
 		if (canonicalize_name(n->data.target)) {
-			free(n);
+			node_discard(fs, n);
 			errno = EINVAL;
 			return NULL;
 		}
@@ -10,6 +10,42 @@
 #include "config.h"
 #include "fstree.h"
 
+/*
+  Directories with at least this many children get a hash table that maps
+  names to child nodes, once a lookup had to walk the whole list.
+ */
+#define DIR_INDEX_THRESHOLD (32)
+
+/*
+  Find a child of a directory by name. The name does not have to be null
+  terminated, but must be followed by either a null byte or a '/'. Walks the
+  child list, or uses the index if the directory has one, creating it if the
+  directory has grown large enough.
+ */
+tree_node_t *dir_index_lookup(fstree_t *fs, tree_node_t *dir,
+			      const char *name, size_t len);
+
+/* Add a new child node to the index of a directory, if it has one. */
+void dir_index_add(tree_node_t *dir, tree_node_t *n);
+
+/* Free the index of a directory, e.g. after removing children. */
+void dir_index_drop(fstree_t *fs, tree_node_t *dir);
+
+/* Free the indices of all directories in a tree. */
+void dir_index_cleanup(fstree_t *fs);
+
+/*
+  Allocate a zero initialized node with size bytes of payload, from the
+  arena of the tree if it has one.
+ */
+tree_node_t *node_alloc(fstree_t *fs, size_t size);
+
+/* Release a node that was never linked into a tree or has been unlinked. */
+void node_free(fstree_t *fs, tree_node_t *n);
+
+/* Unlink a freshly created node from its parent and release it. */
+void node_discard(fstree_t *fs, tree_node_t *n);
+
 /* ASCIIbetically sort a linked list of tree nodes */
 tree_node_t *tree_node_list_sort(tree_node_t *head);
 
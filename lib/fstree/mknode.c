@@ -4,17 +4,69 @@
  *
  * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
  */
-#include "config.h"
+#include "internal.h"
 
-#include "fstree.h"
+#ifndef NO_CUSTOM_ALLOC
+#include "mempool.h"
+#endif
 
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
 
-tree_node_t *fstree_mknode(tree_node_t *parent, const char *name,
-			   size_t name_len, const char *extra,
-			   const struct stat *sb)
+tree_node_t *node_alloc(fstree_t *fs, size_t size)
+{
+	tree_node_t *n;
+
+	if (SZ_ADD_OV(sizeof(*n), size, &size)) {
+		errno = EOVERFLOW;
+		return NULL;
+	}
+
+#ifndef NO_CUSTOM_ALLOC
+	if (fs != NULL && fs->arena != NULL) {
+		n = mem_arena_allocate(fs->arena, size);
+		if (n == NULL)
+			errno = ENOMEM;
+		return n;
+	}
+#else
+	(void)fs;
+#endif
+	return calloc(1, size);
+}
+
+void node_free(fstree_t *fs, tree_node_t *n)
+{
+	/* memory from the arena is only released with the whole tree */
+	if (fs == NULL || fs->arena == NULL)
+		free(n);
+}
+
+void node_discard(fstree_t *fs, tree_node_t *n)
+{
+	tree_node_t *root = n->parent, *it;
+
+	dir_index_drop(fs, root);
+
+	if (n == root->data.dir.children) {
+		root->data.dir.children = n->next;
+	} else {
+		it = root->data.dir.children;
+
+		while (it != NULL && it->next != n)
+			it = it->next;
+
+		if (it != NULL)
+			it->next = n->next;
+	}
+
+	node_free(fs, n);
+}
+
+tree_node_t *fstree_mknode(fstree_t *fs, tree_node_t *parent,
+			   const char *name, size_t name_len,
+			   const char *extra, const struct stat *sb)
 {
 	tree_node_t *n;
 	size_t size;
@@ -25,20 +77,14 @@ tree_node_t *fstree_mknode(tree_node_t *parent, const char *name,
 		return NULL;
 	}
 
-	size = sizeof(tree_node_t) + name_len + 1;
+	size = name_len + 1;
 	if (extra != NULL)
 		size += strlen(extra) + 1;
 
-	n = calloc(1, size);
+	n = node_alloc(fs, size);
 	if (n == NULL)
 		return NULL;
 
-	if (parent != NULL) {
-		n->next = parent->data.dir.children;
-		parent->data.dir.children = n;
-		n->parent = parent;
-	}
-
 	n->xattr_idx = 0xFFFFFFFF;
 	n->uid = sb->st_uid;
 	n->gid = sb->st_gid;
@@ -76,12 +122,17 @@ tree_node_t *fstree_mknode(tree_node_t *parent, const char *name,
 
 	if (parent != NULL) {
 		if (parent->link_count == 0x0FFFF) {
-			free(n);
+			node_free(fs, n);
 			errno = EMLINK;
 			return NULL;
 		}
 
 		parent->link_count++;
+
+		n->next = parent->data.dir.children;
+		parent->data.dir.children = n;
+		n->parent = parent;
+		dir_index_add(parent, n);
 	}
 
 	return n;
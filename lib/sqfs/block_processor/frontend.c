@@ -48,6 +48,20 @@ static int add_sentinel_block(sqfs_block_processor_t *proc)
 	return enqueue_block(proc, blk);
 }
 
+/* give back a block from get_buffer that nothing was ever committed to */
+static void discard_current_block(sqfs_block_processor_t *proc)
+{
+	sqfs_block_t *blk = proc->blk_current;
+
+	proc->blk_current = NULL;
+	proc->blk_index -= 1;
+	proc->blk_flags |= blk->flags & SQFS_BLK_FIRST_BLOCK;
+
+	blk->next = proc->free_list;
+	proc->free_list = blk;
+	proc->backlog -= 1;
+}
+
 int enqueue_block(sqfs_block_processor_t *proc, sqfs_block_t *blk)
 {
 	int status;
@@ -108,66 +122,95 @@ int sqfs_block_processor_begin_file(sqfs_block_processor_t *proc,
 	return 0;
 }
 
-int sqfs_block_processor_append(sqfs_block_processor_t *proc, const void *data,
-				size_t size)
+int sqfs_block_processor_get_buffer(sqfs_block_processor_t *proc,
+				    sqfs_u8 **data, size_t *size)
 {
 	sqfs_block_t *new;
+	int err;
+
+	if (!proc->begin_called)
+		return SQFS_ERROR_SEQUENCE;
+
+	if (proc->blk_current == NULL) {
+		err = get_new_block(proc, &new);
+		if (err != 0)
+			return err;
+
+		proc->blk_current = new;
+		proc->blk_current->flags = proc->blk_flags;
+		proc->blk_current->inode = proc->inode;
+		proc->blk_current->user = proc->user;
+		proc->blk_current->index = proc->blk_index++;
+		proc->blk_flags &= ~SQFS_BLK_FIRST_BLOCK;
+	}
+
+	*data = proc->blk_current->data + proc->blk_current->size;
+	*size = proc->max_block_size - proc->blk_current->size;
+	return 0;
+}
+
+int sqfs_block_processor_commit(sqfs_block_processor_t *proc, size_t size)
+{
 	sqfs_u64 filesize;
-	size_t diff;
 	int err;
 
 	if (!proc->begin_called)
 		return SQFS_ERROR_SEQUENCE;
 
+	if (size == 0)
+		return 0;
+
+	if (proc->blk_current == NULL)
+		return SQFS_ERROR_SEQUENCE;
+
+	if (size > proc->max_block_size - proc->blk_current->size)
+		return SQFS_ERROR_OVERFLOW;
+
 	if (proc->inode != NULL) {
 		sqfs_inode_get_file_size(*(proc->inode), &filesize);
 		sqfs_inode_set_file_size(*(proc->inode), filesize + size);
 	}
 
-	while (size > 0) {
-		if (proc->blk_current == NULL) {
-			err = get_new_block(proc, &new);
-			if (err != 0)
-				return err;
+	proc->blk_current->size += size;
+	proc->stats.input_bytes_read += size;
 
-			proc->blk_current = new;
-			proc->blk_current->flags = proc->blk_flags;
-			proc->blk_current->inode = proc->inode;
-			proc->blk_current->user = proc->user;
-			proc->blk_current->index = proc->blk_index++;
-			proc->blk_flags &= ~SQFS_BLK_FIRST_BLOCK;
-		}
+	if (proc->blk_current->size == proc->max_block_size) {
+		err = enqueue_block(proc, proc->blk_current);
+		proc->blk_current = NULL;
 
-		diff = proc->max_block_size - proc->blk_current->size;
+		if (err)
+			return err;
+	}
 
-		if (diff == 0) {
-			err = enqueue_block(proc, proc->blk_current);
-			proc->blk_current = NULL;
+	return 0;
+}
 
-			if (err)
-				return err;
-			continue;
-		}
+int sqfs_block_processor_append(sqfs_block_processor_t *proc, const void *data,
+				size_t size)
+{
+	size_t diff;
+	sqfs_u8 *dst;
+	int err;
+
+	if (!proc->begin_called)
+		return SQFS_ERROR_SEQUENCE;
+
+	while (size > 0) {
+		err = sqfs_block_processor_get_buffer(proc, &dst, &diff);
+		if (err != 0)
+			return err;
 
 		if (diff > size)
 			diff = size;
 
-		memcpy(proc->blk_current->data + proc->blk_current->size,
-		       data, diff);
+		memcpy(dst, data, diff);
+
+		err = sqfs_block_processor_commit(proc, diff);
+		if (err != 0)
+			return err;
 
 		size -= diff;
-		proc->blk_current->size += diff;
 		data = (const char *)data + diff;
-
-		proc->stats.input_bytes_read += diff;
-	}
-
-	if (proc->blk_current->size == proc->max_block_size) {
-		err = enqueue_block(proc, proc->blk_current);
-		proc->blk_current = NULL;
-
-		if (err)
-			return err;
 	}
 
 	return 0;
@@ -180,6 +223,9 @@ int sqfs_block_processor_end_file(sqfs_block_processor_t *proc)
 	if (!proc->begin_called)
 		return SQFS_ERROR_SEQUENCE;
 
+	if (proc->blk_current != NULL && proc->blk_current->size == 0)
+		discard_current_block(proc);
+
 	if (proc->blk_current == NULL) {
 		if (!(proc->blk_flags & SQFS_BLK_FIRST_BLOCK)) {
 			err = add_sentinel_block(proc);
@@ -0,0 +1,101 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/*
+ * dcache.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#define SQFS_BUILDING_DLL
+#include "dcache.h"
+
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static size_t get_slot(const dcache_t *cache, const dcache_dir_t *parent,
+		       const char *name, size_t len)
+{
+	sqfs_u64 hash = xxh32(name, len);
+
+	hash ^= parent->location * 0x9E3779B97F4A7C15ULL;
+	hash ^= (sqfs_u64)parent->size << 32;
+
+	return (hash ^ (hash >> 29)) % cache->num_slots;
+}
+
+static bool dir_equal(const dcache_dir_t *a, const dcache_dir_t *b)
+{
+	return a->location == b->location && a->size == b->size;
+}
+
+int dcache_init(dcache_t *cache, size_t num_slots)
+{
+	memset(cache, 0, sizeof(*cache));
+
+	if (num_slots == 0)
+		return 0;
+
+	cache->slots = alloc_array(sizeof(cache->slots[0]), num_slots);
+	if (cache->slots == NULL)
+		return -1;
+
+	cache->num_slots = num_slots;
+	return 0;
+}
+
+void dcache_cleanup(dcache_t *cache)
+{
+	size_t i;
+
+	for (i = 0; i < cache->num_slots; ++i)
+		free(cache->slots[i].name);
+
+	free(cache->slots);
+	memset(cache, 0, sizeof(*cache));
+}
+
+const dcache_ent_t *dcache_lookup(dcache_t *cache, const dcache_dir_t *parent,
+				  const char *name, size_t len)
+{
+	const dcache_ent_t *ent;
+
+	if (cache->num_slots == 0)
+		return NULL;
+
+	ent = cache->slots + get_slot(cache, parent, name, len);
+
+	if (ent->name == NULL || !dir_equal(&ent->parent, parent) ||
+	    strncmp(ent->name, name, len) != 0 || ent->name[len] != '\0') {
+		cache->misses += 1;
+		return NULL;
+	}
+
+	cache->hits += 1;
+	return ent;
+}
+
+void dcache_insert(dcache_t *cache, const dcache_dir_t *parent,
+		   const char *name, size_t len,
+		   sqfs_u64 inode_ref, const dcache_dir_t *dir)
+{
+	dcache_ent_t *ent;
+	char *copy;
+
+	if (cache->num_slots == 0)
+		return;
+
+	copy = malloc(len + 1);
+	if (copy == NULL)
+		return;
+
+	memcpy(copy, name, len);
+	copy[len] = '\0';
+
+	ent = cache->slots + get_slot(cache, parent, name, len);
+	free(ent->name);
+
+	ent->parent = *parent;
+	ent->name = copy;
+	ent->inode_ref = inode_ref;
+	ent->dir = *dir;
+}
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/*
+ * dcache.h
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#ifndef SQFS_DCACHE_H
+#define SQFS_DCACHE_H
+
+#include "config.h"
+
+#include "sqfs/predef.h"
+
+#include <stddef.h>
+
+/*
+  A directory listing is identified by its location in the directory table
+  and its size. The size is needed, because empty directories do not occupy
+  any space and may thus share their location with the next directory.
+ */
+typedef struct {
+	sqfs_u64 location;
+	sqfs_u32 size;
+} dcache_dir_t;
+
+typedef struct {
+	dcache_dir_t parent;
+	char *name;
+
+	/* inode reference of the entry */
+	sqfs_u64 inode_ref;
+
+	/* if the entry is a directory, its listing, otherwise zero size */
+	dcache_dir_t dir;
+} dcache_ent_t;
+
+/*
+  A bounded, direct mapped cache of (directory listing, name) -> inode
+  reference mappings. On collision, the older entry is replaced.
+ */
+typedef struct {
+	dcache_ent_t *slots;
+	size_t num_slots;
+
+	sqfs_u64 hits;
+	sqfs_u64 misses;
+} dcache_t;
+
+SQFS_INTERNAL int dcache_init(dcache_t *cache, size_t num_slots);
+
+SQFS_INTERNAL void dcache_cleanup(dcache_t *cache);
+
+SQFS_INTERNAL const dcache_ent_t *dcache_lookup(dcache_t *cache,
+						const dcache_dir_t *parent,
+						const char *name, size_t len);
+
+/* best effort, allocation failures are not reported */
+SQFS_INTERNAL void dcache_insert(dcache_t *cache, const dcache_dir_t *parent,
+				 const char *name, size_t len,
+				 sqfs_u64 inode_ref, const dcache_dir_t *dir);
+
+#endif /* SQFS_DCACHE_H */
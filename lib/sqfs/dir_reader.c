@@ -6,6 +6,8 @@
  */
 #define SQFS_BUILDING_DLL
 #include "config.h"
+#include "dir_state.h"
+#include "dcache.h"
 
 #include "sqfs/meta_reader.h"
 #include "sqfs/dir_reader.h"
@@ -13,12 +15,17 @@
 #include "sqfs/super.h"
 #include "sqfs/inode.h"
 #include "sqfs/error.h"
+#include "sqfs/block.h"
 #include "sqfs/dir.h"
+#include "compat.h"
 #include "util.h"
 
 #include <string.h>
 #include <stdlib.h>
 
+/* default size of the meta data block cache, in bytes */
+#define DEFAULT_CACHE_SIZE (4 * 1024 * 1024)
+
 struct sqfs_dir_reader_t {
 	sqfs_object_t base;
 
@@ -34,6 +41,18 @@ struct sqfs_dir_reader_t {
 	size_t start_size;
 	sqfs_u16 dir_offset;
 	sqfs_u16 inode_offset;
+
+	/* copy of the directory index of the current directory, if any */
+	sqfs_u8 *dir_index;
+	size_t dir_index_max;
+
+	/* byte offsets of the individual index entries in dir_index */
+	size_t *dir_index_offsets;
+	size_t dir_index_count;
+	size_t dir_index_count_max;
+
+	/* optional cache for sqfs_dir_reader_find_by_path */
+	dcache_t dcache;
 };
 
 static void dir_reader_destroy(sqfs_object_t *obj)
@@ -42,6 +61,9 @@ static void dir_reader_destroy(sqfs_object_t *obj)
 
 	sqfs_destroy(rd->meta_inode);
 	sqfs_destroy(rd->meta_dir);
+	dcache_cleanup(&rd->dcache);
+	free(rd->dir_index_offsets);
+	free(rd->dir_index);
 	free(rd);
 }
 
@@ -54,10 +76,40 @@ static sqfs_object_t *dir_reader_copy(const sqfs_object_t *obj)
 		return NULL;
 
 	memcpy(copy, rd, sizeof(*copy));
+	copy->dir_index = NULL;
+	copy->dir_index_offsets = NULL;
+	copy->dir_index_max = 0;
+	copy->dir_index_count = 0;
+	copy->dir_index_count_max = 0;
+
+	/* the copy gets an empty cache of the same size */
+	if (dcache_init(&copy->dcache, rd->dcache.num_slots)) {
+		free(copy);
+		return NULL;
+	}
+
+	if (rd->dir_index_count > 0) {
+		copy->dir_index = malloc(rd->dir_index_max);
+		if (copy->dir_index == NULL)
+			goto fail_idx;
+
+		copy->dir_index_offsets = alloc_array(sizeof(size_t),
+						      rd->dir_index_count);
+		if (copy->dir_index_offsets == NULL)
+			goto fail_idx;
+
+		memcpy(copy->dir_index, rd->dir_index, rd->dir_index_max);
+		memcpy(copy->dir_index_offsets, rd->dir_index_offsets,
+		       sizeof(size_t) * rd->dir_index_count);
+
+		copy->dir_index_max = rd->dir_index_max;
+		copy->dir_index_count = rd->dir_index_count;
+		copy->dir_index_count_max = rd->dir_index_count;
+	}
 
 	copy->meta_inode = sqfs_copy(rd->meta_inode);
 	if (copy->meta_inode == NULL)
-		goto fail_mino;
+		goto fail_idx;
 
 	copy->meta_dir = sqfs_copy(rd->meta_dir);
 	if (copy->meta_dir == NULL)
@@ -66,16 +118,74 @@ static sqfs_object_t *dir_reader_copy(const sqfs_object_t *obj)
 	return (sqfs_object_t *)copy;
 fail_mdir:
 	sqfs_destroy(copy->meta_inode);
-fail_mino:
+fail_idx:
+	dcache_cleanup(&copy->dcache);
+	free(copy->dir_index_offsets);
+	free(copy->dir_index);
 	free(copy);
 	return NULL;
 }
 
+static int store_dir_index(sqfs_dir_reader_t *rd,
+			   const sqfs_inode_generic_t *inode)
+{
+	size_t offset, count, size;
+	sqfs_dir_index_t ent;
+	void *new;
+
+	rd->dir_index_count = 0;
+
+	if (inode->base.type != SQFS_INODE_EXT_DIR ||
+	    inode->data.dir_ext.inodex_count == 0) {
+		return 0;
+	}
+
+	size = inode->payload_bytes_used;
+	count = inode->data.dir_ext.inodex_count;
+
+	if (size > rd->dir_index_max) {
+		new = realloc(rd->dir_index, size);
+		if (new == NULL)
+			return SQFS_ERROR_ALLOC;
+
+		rd->dir_index = new;
+		rd->dir_index_max = size;
+	}
+
+	if (count > rd->dir_index_count_max) {
+		new = realloc(rd->dir_index_offsets, sizeof(size_t) * count);
+		if (new == NULL)
+			return SQFS_ERROR_ALLOC;
+
+		rd->dir_index_offsets = new;
+		rd->dir_index_count_max = count;
+	}
+
+	memcpy(rd->dir_index, inode->extra, size);
+
+	/* silently ignore anything after a truncated entry */
+	for (offset = 0; rd->dir_index_count < count; ) {
+		if ((size - offset) < sizeof(ent))
+			break;
+
+		memcpy(&ent, rd->dir_index + offset, sizeof(ent));
+
+		if ((size - offset - sizeof(ent)) < ((size_t)ent.size + 1))
+			break;
+
+		rd->dir_index_offsets[rd->dir_index_count++] = offset;
+		offset += sizeof(ent) + ent.size + 1;
+	}
+
+	return 0;
+}
+
 sqfs_dir_reader_t *sqfs_dir_reader_create(const sqfs_super_t *super,
 					  sqfs_compressor_t *cmp,
 					  sqfs_file_t *file,
 					  sqfs_u32 flags)
 {
+	sqfs_meta_cache_t *cache;
 	sqfs_dir_reader_t *rd;
 	sqfs_u64 start, limit;
 
@@ -113,18 +223,89 @@ sqfs_dir_reader_t *sqfs_dir_reader_create(const sqfs_super_t *super,
 		return NULL;
 	}
 
+	cache = sqfs_meta_cache_create(DEFAULT_CACHE_SIZE, 0);
+	if (cache == NULL) {
+		sqfs_destroy(rd->meta_dir);
+		sqfs_destroy(rd->meta_inode);
+		free(rd);
+		return NULL;
+	}
+
+	sqfs_dir_reader_set_cache(rd, cache);
+	sqfs_destroy(cache);
+
 	((sqfs_object_t *)rd)->destroy = dir_reader_destroy;
 	((sqfs_object_t *)rd)->copy = dir_reader_copy;
 	rd->super = super;
 	return rd;
 }
 
+void sqfs_dir_reader_set_cache(sqfs_dir_reader_t *rd, sqfs_meta_cache_t *cache)
+{
+	sqfs_meta_reader_set_cache(rd->meta_inode, cache);
+	sqfs_meta_reader_set_cache(rd->meta_dir, cache);
+}
+
+int sqfs_dir_reader_set_dentry_cache(sqfs_dir_reader_t *rd,
+				     size_t max_entries)
+{
+	dcache_t cache;
+
+	if (dcache_init(&cache, max_entries))
+		return SQFS_ERROR_ALLOC;
+
+	dcache_cleanup(&rd->dcache);
+	rd->dcache = cache;
+	return 0;
+}
+
+void sqfs_dir_reader_get_dentry_cache_stats(const sqfs_dir_reader_t *rd,
+					    sqfs_u64 *hits, sqfs_u64 *misses)
+{
+	*hits = rd->dcache.hits;
+	*misses = rd->dcache.misses;
+}
+
+void sqfs_dir_reader_get_state(const sqfs_dir_reader_t *rd,
+			       sqfs_dir_reader_state_t *state)
+{
+	state->hdr = rd->hdr;
+	state->dir_block_start = rd->dir_block_start;
+	state->entries = rd->entries;
+	state->size = rd->size;
+	state->start_size = rd->start_size;
+	state->dir_offset = rd->dir_offset;
+
+	sqfs_meta_reader_get_position(rd->meta_dir, &state->block,
+				      &state->offset);
+}
+
+int sqfs_dir_reader_set_state(sqfs_dir_reader_t *rd,
+			      const sqfs_dir_reader_state_t *state)
+{
+	rd->hdr = state->hdr;
+	rd->dir_block_start = state->dir_block_start;
+	rd->entries = state->entries;
+	rd->size = state->size;
+	rd->start_size = state->start_size;
+	rd->dir_offset = state->dir_offset;
+	rd->dir_index_count = 0;
+
+	/* nothing left to read, the meta reader may not even be positioned */
+	if (rd->entries == 0 && rd->size < sizeof(rd->hdr))
+		return 0;
+
+	return sqfs_meta_reader_seek(rd->meta_dir, state->block,
+				     state->offset);
+}
+
 int sqfs_dir_reader_open_dir(sqfs_dir_reader_t *rd,
 			     const sqfs_inode_generic_t *inode,
 			     sqfs_u32 flags)
 {
 	sqfs_u64 block_start;
 	size_t size, offset;
+	int ret;
 
 	if (flags != 0)
 		return SQFS_ERROR_UNSUPPORTED;
@@ -141,18 +322,22 @@ int sqfs_dir_reader_open_dir(sqfs_dir_reader_t *rd,
 		return SQFS_ERROR_NOT_DIR;
 	}
 
+	block_start += rd->super->directory_table_start;
+
 	memset(&rd->hdr, 0, sizeof(rd->hdr));
 	rd->size = size;
 	rd->entries = 0;
+	rd->dir_index_count = 0;
+	rd->dir_block_start = block_start;
+	rd->dir_offset = offset;
+	rd->start_size = size;
 
 	if (rd->size <= sizeof(rd->hdr))
 		return 0;
 
-	block_start += rd->super->directory_table_start;
-
-	rd->dir_block_start = block_start;
-	rd->dir_offset = offset;
-	rd->start_size = size;
+	ret = store_dir_index(rd, inode);
+	if (ret)
+		return ret;
 
 	return sqfs_meta_reader_seek(rd->meta_dir, block_start, offset);
 }
@@ -200,33 +385,193 @@ int sqfs_dir_reader_rewind(sqfs_dir_reader_t *rd)
 	rd->size = rd->start_size;
 	rd->entries = 0;
 
+	/* empty directory, the meta reader was never positioned on it */
+	if (rd->start_size <= sizeof(rd->hdr))
+		return 0;
+
 	return sqfs_meta_reader_seek(rd->meta_dir, rd->dir_block_start,
 				     rd->dir_offset);
 }
 
-int sqfs_dir_reader_find(sqfs_dir_reader_t *rd, const char *name)
+static int compare_index_name(const sqfs_dir_reader_t *rd, size_t i,
+			      const char *name, size_t len)
 {
-	sqfs_dir_entry_t *ent;
+	sqfs_dir_index_t ent;
+	const sqfs_u8 *ptr;
+	size_t ent_len;
 	int ret;
 
-	if (rd->size != rd->start_size) {
+	ptr = rd->dir_index + rd->dir_index_offsets[i];
+	memcpy(&ent, ptr, sizeof(ent));
+	ent_len = (size_t)ent.size + 1;
+
+	ret = memcmp(ptr + sizeof(ent), name, ent_len < len ? ent_len : len);
+	if (ret != 0)
+		return ret;
+
+	return ent_len < len ? -1 : (ent_len > len ? 1 : 0);
+}
+
+static int seek_dir_index(sqfs_dir_reader_t *rd, const char *name, size_t len)
+{
+	size_t lower = 0, upper = rd->dir_index_count, mid, offset;
+	sqfs_dir_index_t ent;
+	sqfs_u64 block;
+
+	/* find the last index entry that is not past the name */
+	while (lower < upper) {
+		mid = lower + (upper - lower) / 2;
+
+		if (compare_index_name(rd, mid, name, len) <= 0) {
+			lower = mid + 1;
+		} else {
+			upper = mid;
+		}
+	}
+
+	/*
+	  Like the kernel, don't rely on the first header having an index
+	  entry. If the name sorts before all of them, scan from the start.
+	 */
+	if (lower == 0)
+		return sqfs_dir_reader_rewind(rd);
+
+	memcpy(&ent, rd->dir_index + rd->dir_index_offsets[lower - 1],
+	       sizeof(ent));
+
+	if (ent.index >= rd->start_size)
+		return sqfs_dir_reader_rewind(rd);
+
+	block = rd->super->directory_table_start + ent.start_block;
+	offset = (rd->dir_offset + ent.index) % SQFS_META_BLOCK_SIZE;
+
+	memset(&rd->hdr, 0, sizeof(rd->hdr));
+	rd->size = rd->start_size - ent.index;
+	rd->entries = 0;
+
+	return sqfs_meta_reader_seek(rd->meta_dir, block, offset);
+}
+
+static int read_entry_header(sqfs_dir_reader_t *rd, sqfs_dir_entry_t *ent)
+{
+	sqfs_u16 *diff_u16;
+	int err;
+
+	if (!rd->entries) {
+		if (rd->size < sizeof(rd->hdr))
+			return 1;
+
+		err = sqfs_meta_reader_read_dir_header(rd->meta_dir, &rd->hdr);
+		if (err)
+			return err;
+
+		rd->size -= sizeof(rd->hdr);
+		rd->entries = rd->hdr.count + 1;
+	}
+
+	err = sqfs_meta_reader_read(rd->meta_dir, ent, sizeof(*ent));
+	if (err)
+		return err;
+
+	diff_u16 = (sqfs_u16 *)&ent->inode_diff;
+	*diff_u16 = le16toh(*diff_u16);
+
+	ent->offset = le16toh(ent->offset);
+	ent->type = le16toh(ent->type);
+	ent->size = le16toh(ent->size);
+	return 0;
+}
+
+/* compare the name of an entry while reading it, without allocating it */
+static int read_compare_name(sqfs_dir_reader_t *rd, size_t ent_len,
+			     const char *name, size_t len, int *result)
+{
+	size_t diff, cmp_len, done = 0;
+	char buffer[128];
+	int ret;
+
+	*result = 0;
+
+	while (done < ent_len) {
+		diff = ent_len - done;
+		if (diff > sizeof(buffer))
+			diff = sizeof(buffer);
+
+		ret = sqfs_meta_reader_read(rd->meta_dir, buffer, diff);
+		if (ret)
+			return ret;
+
+		if (*result == 0) {
+			cmp_len = done < len ? (len - done) : 0;
+			if (cmp_len > diff)
+				cmp_len = diff;
+
+			*result = memcmp(buffer, name + done, cmp_len);
+			if (*result == 0 && cmp_len < diff)
+				*result = 1;
+		}
+
+		done += diff;
+	}
+
+	if (*result == 0 && len > ent_len)
+		*result = -1;
+
+	return 0;
+}
+
+static int find_entry(sqfs_dir_reader_t *rd, const char *name, size_t len)
+{
+	sqfs_dir_entry_t ent;
+	size_t count;
+	int ret, cmp;
+
+	if (rd->start_size <= sizeof(rd->hdr))
+		return SQFS_ERROR_NO_ENTRY;
+
+	if (rd->dir_index_count > 0) {
+		ret = seek_dir_index(rd, name, len);
+		if (ret)
+			return ret;
+	} else if (rd->size != rd->start_size) {
 		ret = sqfs_dir_reader_rewind(rd);
 		if (ret)
 			return ret;
 	}
 
 	do {
-		ret = sqfs_dir_reader_read(rd, &ent);
+		ret = read_entry_header(rd, &ent);
 		if (ret < 0)
 			return ret;
 		if (ret > 0)
 			return SQFS_ERROR_NO_ENTRY;
 
-		ret = strcmp((const char *)ent->name, name);
-		free(ent);
-	} while (ret < 0);
+		ret = read_compare_name(rd, (size_t)ent.size + 1,
+					name, len, &cmp);
+		if (ret)
+			return ret;
+
+		count = sizeof(ent) + ent.size + 1;
+
+		if (count > rd->size) {
+			rd->size = 0;
+			rd->entries = 0;
+		} else {
+			rd->size -= count;
+			rd->entries -= 1;
+		}
+	} while (cmp < 0);
 
-	return ret == 0 ? 0 : SQFS_ERROR_NO_ENTRY;
+	if (cmp > 0)
+		return SQFS_ERROR_NO_ENTRY;
+
+	rd->inode_offset = ent.offset;
+	return 0;
+}
+
+int sqfs_dir_reader_find(sqfs_dir_reader_t *rd, const char *name)
+{
+	return find_entry(rd, name, strlen(name));
 }
 
 int sqfs_dir_reader_get_inode(sqfs_dir_reader_t *rd,
@@ -251,13 +596,34 @@ int sqfs_dir_reader_get_root_inode(sqfs_dir_reader_t *rd,
 					   block_start, offset, inode);
 }
 
+static void get_dir_location(const sqfs_inode_generic_t *inode,
+			     dcache_dir_t *out)
+{
+	if (inode->base.type == SQFS_INODE_DIR) {
+		out->location = ((sqfs_u64)inode->data.dir.start_block << 16) |
+			inode->data.dir.offset;
+		out->size = inode->data.dir.size;
+	} else if (inode->base.type == SQFS_INODE_EXT_DIR) {
+		out->location =
+			((sqfs_u64)inode->data.dir_ext.start_block << 16) |
+			inode->data.dir_ext.offset;
+		out->size = inode->data.dir_ext.size;
+	} else {
+		out->location = 0;
+		out->size = 0;
+	}
+}
+
 int sqfs_dir_reader_find_by_path(sqfs_dir_reader_t *rd,
 				 const sqfs_inode_generic_t *start,
 				 const char *path, sqfs_inode_generic_t **out)
 {
 	sqfs_inode_generic_t *inode;
-	sqfs_dir_entry_t *ent;
+	dcache_dir_t dir, child_dir;
+	const dcache_ent_t *ent;
+	sqfs_u64 inode_ref = 0;
 	const char *ptr;
+	size_t len;
 	int ret = 0;
 
 	if (start == NULL) {
@@ -276,6 +642,8 @@ int sqfs_dir_reader_find_by_path(sqfs_dir_reader_t *rd,
 	if (ret)
 		return ret;
 
+	get_dir_location(inode, &dir);
+
 	while (*path != '\0') {
 		if (*path == '/') {
 			while (*path == '/')
@@ -283,44 +651,72 @@ int sqfs_dir_reader_find_by_path(sqfs_dir_reader_t *rd,
 			continue;
 		}
 
-		ret = sqfs_dir_reader_open_dir(rd, inode, 0);
-		free(inode);
-		if (ret)
-			return ret;
-
 		ptr = strchr(path, '/');
 		if (ptr == NULL) {
+			for (ptr = path; *ptr != '\0'; ++ptr)
+				;
+		}
+
+		len = ptr - path;
+
+		if (dir.size == 0) {
+			free(inode);
+			return SQFS_ERROR_NOT_DIR;
+		}
 
-			if (ptr == NULL) {
-				for (ptr = path; *ptr != '\0'; ++ptr)
-					;
-			}
+		/* on a hit, the intermediate inodes need not be decoded */
+		ent = dcache_lookup(&rd->dcache, &dir, path, len);
+		if (ent != NULL) {
+			free(inode);
+			inode = NULL;
+			inode_ref = ent->inode_ref;
+			dir = ent->dir;
+			path = ptr;
+			continue;
 		}
 
-		do {
-			ret = sqfs_dir_reader_read(rd, &ent);
-			if (ret < 0)
+		if (inode == NULL) {
+			ret = sqfs_meta_reader_read_inode(rd->meta_inode,
+							  rd->super,
+							  inode_ref >> 16,
+							  inode_ref & 0xFFFF,
+							  &inode);
+			if (ret)
 				return ret;
+		}
 
-			if (ret == 0) {
-				ret = strncmp((const char *)ent->name,
-					      path, ptr - path);
-				if (ret == 0)
-					ret = ent->name[ptr - path];
-				free(ent);
-			}
-		} while (ret < 0);
+		ret = sqfs_dir_reader_open_dir(rd, inode, 0);
+		free(inode);
+		if (ret)
+			return ret;
 
-		if (ret > 0)
-			return SQFS_ERROR_NO_ENTRY;
+		ret = find_entry(rd, path, len);
+		if (ret)
+			return ret;
 
 		ret = sqfs_dir_reader_get_inode(rd, &inode);
 		if (ret)
 			return ret;
 
+		inode_ref = ((sqfs_u64)rd->hdr.start_block << 16) |
+			rd->inode_offset;
+
+		get_dir_location(inode, &child_dir);
+		dcache_insert(&rd->dcache, &dir, path, len,
+			      inode_ref, &child_dir);
+
+		dir = child_dir;
 		path = ptr;
 	}
 
+	if (inode == NULL) {
+		ret = sqfs_meta_reader_read_inode(rd->meta_inode, rd->super,
+						  inode_ref >> 16,
+						  inode_ref & 0xFFFF, &inode);
+		if (ret)
+			return ret;
+	}
+
 	*out = inode;
 	return 0;
 }
@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/*
+ * dir_state.h
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#ifndef SQFS_DIR_STATE_H
+#define SQFS_DIR_STATE_H
+
+#include "config.h"
+
+#include "sqfs/predef.h"
+#include "sqfs/dir.h"
+
+/*
+  Snapshot of the position of a directory reader inside a directory listing,
+  used to suspend reading a directory and resume it later on, after the
+  reader has been used to read a different directory in between.
+ */
+typedef struct {
+	sqfs_dir_header_t hdr;
+	sqfs_u64 dir_block_start;
+	sqfs_u64 block;
+	size_t offset;
+	size_t entries;
+	size_t size;
+	size_t start_size;
+	sqfs_u16 dir_offset;
+} sqfs_dir_reader_state_t;
+
+SQFS_INTERNAL void sqfs_dir_reader_get_state(const sqfs_dir_reader_t *rd,
+					     sqfs_dir_reader_state_t *state);
+
+/*
+  Restore a previously saved position. The directory index of the listing
+  is not restored, so a subsequent sqfs_dir_reader_find falls back to a
+  linear scan.
+ */
+SQFS_INTERNAL int sqfs_dir_reader_set_state(sqfs_dir_reader_t *rd,
+					    const sqfs_dir_reader_state_t *state);
+
+#endif /* SQFS_DIR_STATE_H */
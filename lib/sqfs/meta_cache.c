@@ -0,0 +1,279 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/*
+ * meta_cache.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#define SQFS_BUILDING_DLL
+#include "meta_cache.h"
+
+#include "sqfs/meta_reader.h"
+#include "sqfs/block.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(__WINDOWS__)
+#include "w32threadwrap.h"
+#define HAVE_CACHE_LOCK
+#elif !defined(NO_THREAD_IMPL)
+#include <pthread.h>
+#define HAVE_CACHE_LOCK
+#endif
+
+#ifdef HAVE_CACHE_LOCK
+#define CACHE_LOCK(cache) pthread_mutex_lock(&(cache)->mtx)
+#define CACHE_UNLOCK(cache) pthread_mutex_unlock(&(cache)->mtx)
+#else
+#define CACHE_LOCK(cache)
+#define CACHE_UNLOCK(cache)
+#endif
+
+typedef struct cache_entry_t {
+	struct cache_entry_t *hash_next;
+	struct cache_entry_t *lru_prev;
+	struct cache_entry_t *lru_next;
+
+	sqfs_u64 block_start;
+	sqfs_u64 next_block;
+	size_t size;
+
+	sqfs_u8 data[];
+} cache_entry_t;
+
+struct sqfs_meta_cache_t {
+	sqfs_object_t base;
+
+#ifdef HAVE_CACHE_LOCK
+	pthread_mutex_t mtx;
+#endif
+	unsigned int refcount;
+
+	size_t max_size;
+	size_t used_size;
+
+	/* most recently used entry first */
+	cache_entry_t *lru_head;
+	cache_entry_t *lru_tail;
+
+	sqfs_u64 hits;
+	sqfs_u64 misses;
+
+	unsigned int hash_bits;
+	cache_entry_t *buckets[];
+};
+
+static size_t entry_cost(const cache_entry_t *ent)
+{
+	return sizeof(*ent) + ent->size;
+}
+
+static cache_entry_t **get_bucket(sqfs_meta_cache_t *cache, sqfs_u64 start)
+{
+	sqfs_u64 hash = start * 0x9E3779B97F4A7C15ULL;
+
+	return cache->buckets + (hash >> (64 - cache->hash_bits));
+}
+
+static void lru_unlink(sqfs_meta_cache_t *cache, cache_entry_t *ent)
+{
+	if (ent->lru_prev == NULL) {
+		cache->lru_head = ent->lru_next;
+	} else {
+		ent->lru_prev->lru_next = ent->lru_next;
+	}
+
+	if (ent->lru_next == NULL) {
+		cache->lru_tail = ent->lru_prev;
+	} else {
+		ent->lru_next->lru_prev = ent->lru_prev;
+	}
+
+	ent->lru_prev = NULL;
+	ent->lru_next = NULL;
+}
+
+static void lru_push_front(sqfs_meta_cache_t *cache, cache_entry_t *ent)
+{
+	ent->lru_prev = NULL;
+	ent->lru_next = cache->lru_head;
+
+	if (cache->lru_head == NULL) {
+		cache->lru_tail = ent;
+	} else {
+		cache->lru_head->lru_prev = ent;
+	}
+
+	cache->lru_head = ent;
+}
+
+static void evict_lru(sqfs_meta_cache_t *cache)
+{
+	cache_entry_t *ent = cache->lru_tail, **it;
+
+	for (it = get_bucket(cache, ent->block_start); *it != ent;
+	     it = &((*it)->hash_next))
+		;
+
+	*it = ent->hash_next;
+	lru_unlink(cache, ent);
+
+	cache->used_size -= entry_cost(ent);
+	free(ent);
+}
+
+static void meta_cache_destroy(sqfs_object_t *obj)
+{
+	sqfs_meta_cache_t *cache = (sqfs_meta_cache_t *)obj;
+	unsigned int count;
+
+	CACHE_LOCK(cache);
+	count = --(cache->refcount);
+	CACHE_UNLOCK(cache);
+
+	if (count > 0)
+		return;
+
+	while (cache->lru_tail != NULL)
+		evict_lru(cache);
+
+#ifdef HAVE_CACHE_LOCK
+	pthread_mutex_destroy(&cache->mtx);
+#endif
+	free(cache);
+}
+
+sqfs_meta_cache_t *sqfs_meta_cache_create(size_t max_size, sqfs_u32 flags)
+{
+	size_t count, min_size = sizeof(cache_entry_t) + SQFS_META_BLOCK_SIZE;
+	unsigned int bits = 4;
+	sqfs_meta_cache_t *cache;
+
+	if (flags != 0)
+		return NULL;
+
+	if (max_size < min_size)
+		max_size = min_size;
+
+	count = max_size / min_size;
+	while (bits < 20 && ((size_t)1 << bits) < count)
+		++bits;
+
+	cache = alloc_flex(sizeof(*cache), sizeof(cache->buckets[0]),
+			   (size_t)1 << bits);
+	if (cache == NULL)
+		return NULL;
+
+	memset(cache, 0, sizeof(*cache) +
+	       sizeof(cache->buckets[0]) * ((size_t)1 << bits));
+
+#ifdef HAVE_CACHE_LOCK
+	if (pthread_mutex_init(&cache->mtx, NULL) != 0) {
+		free(cache);
+		return NULL;
+	}
+#endif
+
+	((sqfs_object_t *)cache)->destroy = meta_cache_destroy;
+	cache->refcount = 1;
+	cache->max_size = max_size;
+	cache->hash_bits = bits;
+	return cache;
+}
+
+void sqfs_meta_cache_get_stats(sqfs_meta_cache_t *cache, sqfs_u64 *hits,
+			       sqfs_u64 *misses)
+{
+	CACHE_LOCK(cache);
+	*hits = cache->hits;
+	*misses = cache->misses;
+	CACHE_UNLOCK(cache);
+}
+
+sqfs_meta_cache_t *sqfs_meta_cache_grab(sqfs_meta_cache_t *cache)
+{
+	CACHE_LOCK(cache);
+	cache->refcount += 1;
+	CACHE_UNLOCK(cache);
+	return cache;
+}
+
+bool sqfs_meta_cache_lookup(sqfs_meta_cache_t *cache, sqfs_u64 block_start,
+			    sqfs_u8 *data, size_t *size, sqfs_u64 *next_block)
+{
+	cache_entry_t *ent;
+
+	CACHE_LOCK(cache);
+
+	for (ent = *get_bucket(cache, block_start); ent != NULL;
+	     ent = ent->hash_next) {
+		if (ent->block_start == block_start)
+			break;
+	}
+
+	if (ent == NULL) {
+		cache->misses += 1;
+		CACHE_UNLOCK(cache);
+		return false;
+	}
+
+	if (cache->lru_head != ent) {
+		lru_unlink(cache, ent);
+		lru_push_front(cache, ent);
+	}
+
+	memcpy(data, ent->data, ent->size);
+	*size = ent->size;
+	*next_block = ent->next_block;
+
+	cache->hits += 1;
+	CACHE_UNLOCK(cache);
+	return true;
+}
+
+void sqfs_meta_cache_insert(sqfs_meta_cache_t *cache, sqfs_u64 block_start,
+			    const sqfs_u8 *data, size_t size,
+			    sqfs_u64 next_block)
+{
+	cache_entry_t *ent, **bucket;
+
+	ent = alloc_flex(sizeof(*ent), 1, size);
+	if (ent == NULL)
+		return;
+
+	memset(ent, 0, sizeof(*ent));
+	ent->block_start = block_start;
+	ent->next_block = next_block;
+	ent->size = size;
+	memcpy(ent->data, data, size);
+
+	CACHE_LOCK(cache);
+
+	bucket = get_bucket(cache, block_start);
+
+	/* another reader sharing the cache might have been faster */
+	if (*bucket != NULL) {
+		cache_entry_t *it;
+
+		for (it = *bucket; it != NULL; it = it->hash_next) {
+			if (it->block_start == block_start) {
+				CACHE_UNLOCK(cache);
+				free(ent);
+				return;
+			}
+		}
+	}
+
+	while (cache->lru_tail != NULL &&
+	       (cache->used_size + entry_cost(ent)) > cache->max_size) {
+		evict_lru(cache);
+	}
+
+	ent->hash_next = *bucket;
+	*bucket = ent;
+	lru_push_front(cache, ent);
+	cache->used_size += entry_cost(ent);
+
+	CACHE_UNLOCK(cache);
+}
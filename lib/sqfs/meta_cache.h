@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/*
+ * meta_cache.h
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#ifndef SQFS_META_CACHE_H
+#define SQFS_META_CACHE_H
+
+#include "config.h"
+
+#include "sqfs/predef.h"
+
+SQFS_INTERNAL sqfs_meta_cache_t *sqfs_meta_cache_grab(sqfs_meta_cache_t *cache);
+
+/*
+  Look up the uncompressed data of a meta data block. On a hit, the data is
+  copied to the given buffer (which must be at least SQFS_META_BLOCK_SIZE
+  large) and true is returned.
+ */
+SQFS_INTERNAL bool sqfs_meta_cache_lookup(sqfs_meta_cache_t *cache,
+					  sqfs_u64 block_start, sqfs_u8 *data,
+					  size_t *size, sqfs_u64 *next_block);
+
+/*
+  Store the uncompressed data of a meta data block, possibly evicting the
+  least recently used blocks. The cache is best effort only, so allocation
+  failures are not reported.
+ */
+SQFS_INTERNAL void sqfs_meta_cache_insert(sqfs_meta_cache_t *cache,
+					  sqfs_u64 block_start,
+					  const sqfs_u8 *data, size_t size,
+					  sqfs_u64 next_block);
+
+#endif /* SQFS_META_CACHE_H */
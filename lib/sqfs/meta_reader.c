@@ -6,6 +6,7 @@
  */
 #define SQFS_BUILDING_DLL
 #include "config.h"
+#include "meta_cache.h"
 
 #include "sqfs/meta_reader.h"
 #include "sqfs/compressor.h"
@@ -39,6 +40,9 @@ struct sqfs_meta_reader_t {
 	/* A pointer to the compressor to use for extracting data */
 	sqfs_compressor_t *cmp;
 
+	/* An optional cache of uncompressed blocks, possibly shared */
+	sqfs_meta_cache_t *cache;
+
 	/* The raw data read from the input file */
 	sqfs_u8 data[SQFS_META_BLOCK_SIZE];
 
@@ -46,8 +50,11 @@ struct sqfs_meta_reader_t {
 	sqfs_u8 scratch[SQFS_META_BLOCK_SIZE];
 };
 
-static void meta_reader_destroy(sqfs_object_t *m)
+static void meta_reader_destroy(sqfs_object_t *obj)
 {
+	sqfs_meta_reader_t *m = (sqfs_meta_reader_t *)obj;
+
+	sqfs_destroy(m->cache);
 	free(m);
 }
 
@@ -58,6 +65,9 @@ static sqfs_object_t *meta_reader_copy(const sqfs_object_t *obj)
 
 	if (copy != NULL) {
 		memcpy(copy, m, sizeof(*m));
+
+		if (copy->cache != NULL)
+			sqfs_meta_cache_grab(copy->cache);
 	}
 
 	/* XXX: cmp and file aren't deep-copied because m
@@ -84,6 +94,16 @@ sqfs_meta_reader_t *sqfs_meta_reader_create(sqfs_file_t *file,
 	return m;
 }
 
+void sqfs_meta_reader_set_cache(sqfs_meta_reader_t *m,
+				sqfs_meta_cache_t *cache)
+{
+	if (cache != NULL)
+		sqfs_meta_cache_grab(cache);
+
+	sqfs_destroy(m->cache);
+	m->cache = cache;
+}
+
 int sqfs_meta_reader_seek(sqfs_meta_reader_t *m, sqfs_u64 block_start,
 			  size_t offset)
 {
@@ -104,6 +124,22 @@ int sqfs_meta_reader_seek(sqfs_meta_reader_t *m, sqfs_u64 block_start,
 		return 0;
 	}
 
+	if (m->cache != NULL &&
+	    sqfs_meta_cache_lookup(m->cache, block_start, m->data,
+				   &m->data_used, &m->next_block)) {
+		m->block_offset = 0xFFFFFFFFFFFFFFFFUL;
+
+		if (m->next_block > m->limit)
+			return SQFS_ERROR_OUT_OF_BOUNDS;
+
+		if (offset >= m->data_used)
+			return SQFS_ERROR_OUT_OF_BOUNDS;
+
+		m->block_offset = block_start;
+		m->offset = offset;
+		return 0;
+	}
+
 	err = m->file->read_at(m->file, block_start, &header, 2);
 	if (err)
 		return err;
@@ -135,6 +171,11 @@ int sqfs_meta_reader_seek(sqfs_meta_reader_t *m, sqfs_u64 block_start,
 		m->data_used = size;
 	}
 
+	if (m->cache != NULL) {
+		sqfs_meta_cache_insert(m->cache, block_start, m->data,
+				       m->data_used, block_start + size + 2);
+	}
+
 	if (offset >= m->data_used)
 		return SQFS_ERROR_OUT_OF_BOUNDS;
 
@@ -15,6 +15,7 @@
 #include "sqfs/inode.h"
 #include "sqfs/error.h"
 #include "sqfs/dir.h"
+#include "dir_state.h"
 #include "util.h"
 
 #include <string.h>
@@ -193,20 +194,16 @@ void sqfs_dir_tree_destroy(sqfs_tree_node_t *root)
 	free(root);
 }
 
-int sqfs_dir_reader_get_full_hierarchy(sqfs_dir_reader_t *rd,
-				       const sqfs_id_table_t *idtbl,
-				       const char *path, unsigned int flags,
-				       sqfs_tree_node_t **out)
+static int walk_path(sqfs_dir_reader_t *rd, const char *path,
+		     unsigned int flags, sqfs_tree_node_t **root_out,
+		     sqfs_tree_node_t **tail_out)
 {
 	sqfs_tree_node_t *root, *tail, *new;
 	sqfs_inode_generic_t *inode;
-	sqfs_dir_entry_t *ent;
 	const char *ptr;
+	char *name;
 	int ret;
 
-	if (flags & ~SQFS_TREE_ALL_FLAGS)
-		return SQFS_ERROR_UNSUPPORTED;
-
 	ret = sqfs_dir_reader_get_root_inode(rd, &inode);
 	if (ret)
 		return ret;
@@ -231,37 +228,33 @@ int sqfs_dir_reader_get_full_hierarchy(sqfs_dir_reader_t *rd,
 
 		ptr = strchr(path, '/');
 		if (ptr == NULL) {
+			for (ptr = path; *ptr != '\0'; ++ptr)
+				;
+		}
 
-			if (ptr == NULL) {
-				for (ptr = path; *ptr != '\0'; ++ptr)
-					;
-			}
+		name = malloc(ptr - path + 1);
+		if (name == NULL) {
+			ret = SQFS_ERROR_ALLOC;
+			goto fail;
 		}
 
-		for (;;) {
-			ret = sqfs_dir_reader_read(rd, &ent);
-			if (ret < 0)
-				goto fail;
-			if (ret > 0) {
-				ret = SQFS_ERROR_NO_ENTRY;
-				goto fail;
-			}
+		memcpy(name, path, ptr - path);
+		name[ptr - path] = '\0';
 
-			ret = strncmp((const char *)ent->name,
-				      path, ptr - path);
-			if (ret == 0 && ent->name[ptr - path] == '\0')
-				break;
-			free(ent);
+		ret = sqfs_dir_reader_find(rd, name);
+		if (ret) {
+			free(name);
+			goto fail;
 		}
 
 		ret = sqfs_dir_reader_get_inode(rd, &inode);
 		if (ret) {
-			free(ent);
+			free(name);
 			goto fail;
 		}
 
-		new = create_node(inode, (const char *)ent->name);
-		free(ent);
+		new = create_node(inode, name);
+		free(name);
 
 		if (new == NULL) {
 			free(inode);
@@ -282,6 +275,29 @@ int sqfs_dir_reader_get_full_hierarchy(sqfs_dir_reader_t *rd,
 		}
 	}
 
+	*root_out = root;
+	*tail_out = tail;
+	return 0;
+fail:
+	sqfs_dir_tree_destroy(root);
+	return ret;
+}
+
+int sqfs_dir_reader_get_full_hierarchy(sqfs_dir_reader_t *rd,
+				       const sqfs_id_table_t *idtbl,
+				       const char *path, unsigned int flags,
+				       sqfs_tree_node_t **out)
+{
+	sqfs_tree_node_t *root, *tail;
+	int ret;
+
+	if (flags & ~SQFS_TREE_ALL_FLAGS)
+		return SQFS_ERROR_UNSUPPORTED;
+
+	ret = walk_path(rd, path, flags, &root, &tail);
+	if (ret)
+		return ret;
+
 	if (tail->inode->base.type == SQFS_INODE_DIR ||
 	    tail->inode->base.type == SQFS_INODE_EXT_DIR) {
 		ret = sqfs_dir_reader_open_dir(rd, tail->inode, 0);
@@ -303,3 +319,325 @@ fail:
 	sqfs_dir_tree_destroy(root);
 	return ret;
 }
+
+/*****************************************************************************/
+
+typedef struct tree_level_t {
+	/* level of the directory containing this one */
+	struct tree_level_t *prev;
+
+	/* position in the listing, saved while walking a sub directory */
+	sqfs_dir_reader_state_t state;
+
+	sqfs_tree_node_t *node;
+
+	/* whether the directory node has already been handed out */
+	bool emitted;
+} tree_level_t;
+
+struct sqfs_tree_iterator_t {
+	sqfs_object_t base;
+
+	sqfs_dir_reader_t *rd;
+	const sqfs_id_table_t *idtbl;
+	unsigned int flags;
+
+	/* the starting node and the chain of parents leading to it */
+	sqfs_tree_node_t *root;
+	sqfs_tree_node_t *start;
+
+	/* stack of directories currently being walked */
+	tree_level_t *top;
+
+	/* directory level most recently handed out, if any */
+	tree_level_t *last_dir;
+
+	/* non-directory node read ahead or most recently handed out */
+	sqfs_tree_node_t *leaf;
+	bool leaf_pending;
+
+	/* set if the dir reader has to be re-positioned for the top level */
+	bool restore;
+
+	bool started;
+};
+
+static void free_node(sqfs_tree_node_t *n)
+{
+	free(n->inode);
+	free(n);
+}
+
+static void pop_level(sqfs_tree_iterator_t *it)
+{
+	tree_level_t *lvl = it->top;
+
+	it->top = lvl->prev;
+	it->restore = (it->top != NULL);
+
+	if (it->last_dir == lvl)
+		it->last_dir = NULL;
+
+	if (lvl->node != it->start)
+		free_node(lvl->node);
+
+	free(lvl);
+}
+
+static int push_level(sqfs_tree_iterator_t *it, sqfs_tree_node_t *n)
+{
+	tree_level_t *lvl;
+	int ret;
+
+	lvl = calloc(1, sizeof(*lvl));
+	if (lvl == NULL)
+		return SQFS_ERROR_ALLOC;
+
+	if (it->top != NULL)
+		sqfs_dir_reader_get_state(it->rd, &it->top->state);
+
+	ret = sqfs_dir_reader_open_dir(it->rd, n->inode, 0);
+	if (ret) {
+		free(lvl);
+		return ret;
+	}
+
+	lvl->node = n;
+	lvl->prev = it->top;
+	it->top = lvl;
+	it->restore = false;
+	return 0;
+}
+
+static int resolve_node_ids(const sqfs_id_table_t *idtbl, sqfs_tree_node_t *n)
+{
+	int ret;
+
+	ret = sqfs_id_table_index_to_id(idtbl, n->inode->base.uid_idx,
+					&n->uid);
+	if (ret)
+		return ret;
+
+	return sqfs_id_table_index_to_id(idtbl, n->inode->base.gid_idx,
+					 &n->gid);
+}
+
+/*
+  Read the next entry of the top level directory. A directory is pushed as a
+  new level, anything else is stored as pending leaf. Returns a positive
+  value if the directory has no more entries.
+ */
+static int read_next(sqfs_tree_iterator_t *it)
+{
+	sqfs_inode_generic_t *inode;
+	sqfs_dir_entry_t *ent;
+	sqfs_tree_node_t *n;
+	bool is_dir;
+	int ret;
+
+	if (it->restore) {
+		ret = sqfs_dir_reader_set_state(it->rd, &it->top->state);
+		if (ret)
+			return ret;
+
+		it->restore = false;
+	}
+
+	for (;;) {
+		ret = sqfs_dir_reader_read(it->rd, &ent);
+		if (ret)
+			return ret;
+
+		if (should_skip(ent->type, it->flags)) {
+			free(ent);
+			continue;
+		}
+
+		ret = sqfs_dir_reader_get_inode(it->rd, &inode);
+		if (ret) {
+			free(ent);
+			return ret;
+		}
+
+		is_dir = (inode->base.type == SQFS_INODE_DIR ||
+			  inode->base.type == SQFS_INODE_EXT_DIR);
+
+		/* without recursion, sub directories are always empty */
+		if (is_dir && (it->flags & SQFS_TREE_NO_RECURSE) &&
+		    (it->flags & SQFS_TREE_NO_EMPTY)) {
+			free(inode);
+			free(ent);
+			continue;
+		}
+
+		n = create_node(inode, (const char *)ent->name);
+		free(ent);
+
+		if (n == NULL) {
+			free(inode);
+			return SQFS_ERROR_ALLOC;
+		}
+
+		if (would_be_own_parent(it->top->node, n)) {
+			free_node(n);
+			return SQFS_ERROR_LINK_LOOP;
+		}
+
+		n->parent = it->top->node;
+
+		ret = resolve_node_ids(it->idtbl, n);
+		if (ret) {
+			free_node(n);
+			return ret;
+		}
+
+		if (is_dir && !(it->flags & SQFS_TREE_NO_RECURSE)) {
+			ret = push_level(it, n);
+			if (ret)
+				free_node(n);
+			return ret;
+		}
+
+		it->leaf = n;
+		it->leaf_pending = true;
+		return 0;
+	}
+}
+
+static void tree_iterator_destroy(sqfs_object_t *obj)
+{
+	sqfs_tree_iterator_t *it = (sqfs_tree_iterator_t *)obj;
+
+	while (it->top != NULL)
+		pop_level(it);
+
+	if (it->leaf != NULL)
+		free_node(it->leaf);
+
+	sqfs_dir_tree_destroy(it->root);
+	free(it);
+}
+
+int sqfs_tree_iterator_create(sqfs_dir_reader_t *rd,
+			      const sqfs_id_table_t *idtbl,
+			      const char *path, sqfs_u32 flags,
+			      sqfs_tree_iterator_t **out)
+{
+	sqfs_tree_iterator_t *it;
+	int ret;
+
+	if (flags & ~SQFS_TREE_ALL_FLAGS)
+		return SQFS_ERROR_UNSUPPORTED;
+
+	it = calloc(1, sizeof(*it));
+	if (it == NULL)
+		return SQFS_ERROR_ALLOC;
+
+	((sqfs_object_t *)it)->destroy = tree_iterator_destroy;
+	it->rd = rd;
+	it->idtbl = idtbl;
+	it->flags = flags;
+
+	ret = walk_path(rd, path, flags, &it->root, &it->start);
+	if (ret) {
+		free(it);
+		return ret;
+	}
+
+	ret = resolve_ids(it->root, idtbl);
+	if (ret)
+		goto fail;
+
+	if (it->start->inode->base.type == SQFS_INODE_DIR ||
+	    it->start->inode->base.type == SQFS_INODE_EXT_DIR) {
+		ret = push_level(it, it->start);
+		if (ret)
+			goto fail;
+
+		it->top->emitted = true;
+	}
+
+	*out = it;
+	return 0;
+fail:
+	sqfs_destroy(it);
+	return ret;
+}
+
+int sqfs_tree_iterator_next(sqfs_tree_iterator_t *it,
+			    const sqfs_tree_node_t **out)
+{
+	tree_level_t *lvl, *pending;
+	int ret;
+
+	it->last_dir = NULL;
+
+	if (!it->started) {
+		it->started = true;
+		it->last_dir = it->top;
+		*out = it->start;
+		return 0;
+	}
+
+	if (it->leaf != NULL && !it->leaf_pending) {
+		free_node(it->leaf);
+		it->leaf = NULL;
+	}
+
+	for (;;) {
+		/*
+		  Directories are handed out before their children. If empty
+		  directories are filtered out, this is deferred until it is
+		  known that something below them remains.
+		 */
+		if (it->leaf != NULL || !(it->flags & SQFS_TREE_NO_EMPTY)) {
+			pending = NULL;
+
+			for (lvl = it->top; lvl != NULL && !lvl->emitted;
+			     lvl = lvl->prev) {
+				pending = lvl;
+			}
+
+			if (pending != NULL) {
+				pending->emitted = true;
+				it->last_dir = pending;
+				*out = pending->node;
+				return 0;
+			}
+		}
+
+		if (it->leaf != NULL) {
+			it->leaf_pending = false;
+			*out = it->leaf;
+			return 0;
+		}
+
+		if (it->top == NULL)
+			return 1;
+
+		ret = read_next(it);
+		if (ret < 0)
+			return ret;
+
+		if (ret > 0)
+			pop_level(it);
+	}
+}
+
+void sqfs_tree_iterator_skip(sqfs_tree_iterator_t *it)
+{
+	tree_level_t *lvl = it->last_dir;
+
+	if (lvl == NULL)
+		return;
+
+	if (it->leaf != NULL) {
+		free_node(it->leaf);
+		it->leaf = NULL;
+	}
+
+	while (it->top != lvl)
+		pop_level(it);
+
+	pop_level(it);
+}
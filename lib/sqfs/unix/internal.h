@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/*
+ * internal.h
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#ifndef SQFS_UNIX_INTERNAL_H
+#define SQFS_UNIX_INTERNAL_H
+
+#include "config.h"
+
+#include "sqfs/predef.h"
+#include "sqfs/io.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+/*
+  Wrap an open file descriptor in an io_uring based file implementation.
+
+  On success, the returned object takes ownership of the file descriptor.
+  On failure (e.g. the kernel does not support io_uring or it is disabled
+  by a seccomp policy), NULL is returned and the caller still owns the
+  file descriptor and can fall back to the synchronous implementation.
+ */
+SQFS_INTERNAL sqfs_file_t *sqfs_file_uring_create(int fd, bool readonly,
+						  sqfs_u64 size);
+#endif
+
+#endif /* SQFS_UNIX_INTERNAL_H */
@@ -5,9 +5,8 @@
  * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
  */
 #define SQFS_BUILDING_DLL
-#include "config.h"
+#include "internal.h"
 
-#include "sqfs/io.h"
 #include "sqfs/error.h"
 
 #include <sys/stat.h>
@@ -186,6 +185,19 @@ sqfs_file_t *sqfs_open_file(const char *filename, sqfs_u32 flags)
 
 	file->size = sb.st_size;
 
+#ifdef HAVE_LINUX_IO_URING_H
+	if (flags & SQFS_FILE_OPEN_ASYNC_IO) {
+		base = sqfs_file_uring_create(file->fd, file->readonly,
+					      file->size);
+		if (base != NULL) {
+			free(file);
+			return base;
+		}
+
+		base = (sqfs_file_t *)file;
+	}
+#endif
+
 	base->read_at = stdio_read_at;
 	base->write_at = stdio_write_at;
 	base->get_size = stdio_get_size;
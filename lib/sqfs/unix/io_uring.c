@@ -0,0 +1,517 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/*
+ * io_uring.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#define SQFS_BUILDING_DLL
+#include "internal.h"
+
+#include "sqfs/error.h"
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+/* number of write requests that can be in flight at the same time */
+#define QUEUE_DEPTH (32)
+
+/* number of queued writes after which they are handed to the kernel */
+#define SUBMIT_BATCH (8)
+
+typedef struct {
+	struct iovec iov;
+	sqfs_u64 offset;
+	size_t capacity;
+	bool busy;
+} write_slot_t;
+
+typedef struct {
+	sqfs_file_t base;
+
+	bool readonly;
+	sqfs_u64 size;
+	int fd;
+
+	/* first error reported by an asynchronous write */
+	int error;
+
+	int ring_fd;
+	void *sq_ptr;
+	size_t sq_len;
+	void *cq_ptr;
+	size_t cq_len;
+	struct io_uring_sqe *sqes;
+	size_t sqes_len;
+
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	unsigned int to_submit;
+	unsigned int in_flight;
+
+	/* an extra slot used for synchronous reads */
+	write_slot_t slots[QUEUE_DEPTH + 1];
+} sqfs_file_uring_t;
+
+#define READ_SLOT QUEUE_DEPTH
+
+static int sys_io_uring_setup(unsigned int entries,
+			      struct io_uring_params *params)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned int to_submit,
+			      unsigned int min_complete, unsigned int flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit,
+			    min_complete, flags, NULL, 0);
+}
+
+static int ring_enter(sqfs_file_uring_t *file, unsigned int min_complete)
+{
+	unsigned int flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+	int ret;
+
+	for (;;) {
+		ret = sys_io_uring_enter(file->ring_fd, file->to_submit,
+					 min_complete, flags);
+		if (ret >= 0)
+			break;
+		if (errno == EINTR)
+			continue;
+		return SQFS_ERROR_IO;
+	}
+
+	file->to_submit -= ret > (int)file->to_submit ?
+		file->to_submit : (unsigned int)ret;
+	return 0;
+}
+
+static void ring_queue(sqfs_file_uring_t *file, int opcode, size_t slot_idx)
+{
+	write_slot_t *slot = file->slots + slot_idx;
+	struct io_uring_sqe *sqe;
+	unsigned int tail, idx;
+
+	tail = *(file->sq_tail);
+	idx = tail & *(file->sq_mask);
+	sqe = file->sqes + idx;
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = file->fd;
+	sqe->addr = (unsigned long)&slot->iov;
+	sqe->len = 1;
+	sqe->off = slot->offset;
+	sqe->user_data = slot_idx;
+
+	file->sq_array[idx] = idx;
+	__atomic_store_n(file->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	slot->busy = true;
+	file->to_submit += 1;
+	file->in_flight += 1;
+}
+
+static int write_remainder(sqfs_file_uring_t *file, write_slot_t *slot,
+			   size_t done)
+{
+	const char *ptr = (const char *)slot->iov.iov_base + done;
+	sqfs_u64 offset = slot->offset + done;
+	size_t size = slot->iov.iov_len - done;
+	ssize_t ret;
+
+	while (size > 0) {
+		ret = pwrite(file->fd, ptr, size, offset);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return SQFS_ERROR_IO;
+		}
+
+		if (ret == 0)
+			return SQFS_ERROR_OUT_OF_BOUNDS;
+
+		ptr += ret;
+		size -= ret;
+		offset += ret;
+	}
+
+	return 0;
+}
+
+static void reap_completions(sqfs_file_uring_t *file, int *read_result)
+{
+	unsigned int head, tail;
+	struct io_uring_cqe *cqe;
+	write_slot_t *slot;
+	int err;
+
+	head = *(file->cq_head);
+	tail = __atomic_load_n(file->cq_tail, __ATOMIC_ACQUIRE);
+
+	while (head != tail) {
+		cqe = file->cqes + (head & *(file->cq_mask));
+		slot = file->slots + cqe->user_data;
+
+		if (cqe->user_data == READ_SLOT) {
+			*read_result = cqe->res;
+		} else if (cqe->res < 0) {
+			if (file->error == 0)
+				file->error = SQFS_ERROR_IO;
+		} else if ((size_t)cqe->res < slot->iov.iov_len) {
+			err = write_remainder(file, slot, cqe->res);
+
+			if (err != 0 && file->error == 0)
+				file->error = err;
+		}
+
+		slot->busy = false;
+		file->in_flight -= 1;
+		++head;
+	}
+
+	__atomic_store_n(file->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static int drain_queue(sqfs_file_uring_t *file)
+{
+	int ret, dummy;
+
+	while (file->in_flight > 0) {
+		ret = ring_enter(file, 1);
+		if (ret)
+			return ret;
+
+		reap_completions(file, &dummy);
+	}
+
+	return file->error;
+}
+
+static int get_free_slot(sqfs_file_uring_t *file, size_t *out)
+{
+	size_t i;
+	int ret;
+
+	for (;;) {
+		for (i = 0; i < QUEUE_DEPTH; ++i) {
+			if (!file->slots[i].busy) {
+				*out = i;
+				return 0;
+			}
+		}
+
+		ret = drain_queue(file);
+		if (ret)
+			return ret;
+	}
+}
+
+/*****************************************************************************/
+
+static void uring_destroy(sqfs_object_t *base)
+{
+	sqfs_file_uring_t *file = (sqfs_file_uring_t *)base;
+	size_t i;
+
+	drain_queue(file);
+
+	munmap(file->sqes, file->sqes_len);
+	if (file->cq_ptr != file->sq_ptr)
+		munmap(file->cq_ptr, file->cq_len);
+	munmap(file->sq_ptr, file->sq_len);
+	close(file->ring_fd);
+	close(file->fd);
+
+	for (i = 0; i < QUEUE_DEPTH; ++i)
+		free(file->slots[i].iov.iov_base);
+
+	free(file);
+}
+
+static sqfs_object_t *uring_copy(const sqfs_object_t *base)
+{
+	const sqfs_file_uring_t *file = (const sqfs_file_uring_t *)base;
+	sqfs_file_t *copy;
+	int fd, err;
+
+	if (!file->readonly) {
+		errno = ENOTSUP;
+		return NULL;
+	}
+
+	fd = dup(file->fd);
+	if (fd < 0)
+		return NULL;
+
+	copy = sqfs_file_uring_create(fd, file->readonly, file->size);
+	if (copy == NULL) {
+		err = errno;
+		close(fd);
+		errno = err;
+	}
+
+	return (sqfs_object_t *)copy;
+}
+
+static int uring_read_at(sqfs_file_t *base, sqfs_u64 offset,
+			 void *buffer, size_t size)
+{
+	sqfs_file_uring_t *file = (sqfs_file_uring_t *)base;
+	write_slot_t *slot = file->slots + READ_SLOT;
+	int ret, result;
+
+	ret = drain_queue(file);
+	if (ret)
+		return ret;
+
+	while (size > 0) {
+		slot->iov.iov_base = buffer;
+		slot->iov.iov_len = size;
+		slot->offset = offset;
+
+		ring_queue(file, IORING_OP_READV, READ_SLOT);
+
+		result = -EINTR;
+
+		while (file->in_flight > 0) {
+			ret = ring_enter(file, 1);
+			if (ret)
+				return ret;
+
+			reap_completions(file, &result);
+		}
+
+		if (result == -EINTR || result == -EAGAIN)
+			continue;
+
+		if (result < 0)
+			return SQFS_ERROR_IO;
+
+		if (result == 0)
+			return SQFS_ERROR_OUT_OF_BOUNDS;
+
+		buffer = (char *)buffer + result;
+		size -= result;
+		offset += result;
+	}
+
+	return 0;
+}
+
+static int uring_write_at(sqfs_file_t *base, sqfs_u64 offset,
+			  const void *buffer, size_t size)
+{
+	sqfs_file_uring_t *file = (sqfs_file_uring_t *)base;
+	write_slot_t *slot;
+	size_t i;
+	void *new;
+	int ret;
+
+	if (file->error)
+		return file->error;
+
+	if (size == 0)
+		return 0;
+
+	/* the kernel is free to reorder requests, so wait for overlaps */
+	for (i = 0; i < QUEUE_DEPTH; ++i) {
+		slot = file->slots + i;
+
+		if (!slot->busy)
+			continue;
+
+		if (offset < (slot->offset + slot->iov.iov_len) &&
+		    slot->offset < (offset + size)) {
+			ret = drain_queue(file);
+			if (ret)
+				return ret;
+			break;
+		}
+	}
+
+	ret = get_free_slot(file, &i);
+	if (ret)
+		return ret;
+
+	slot = file->slots + i;
+
+	if (slot->capacity < size) {
+		new = realloc(slot->iov.iov_base, size);
+		if (new == NULL)
+			return SQFS_ERROR_ALLOC;
+
+		slot->iov.iov_base = new;
+		slot->capacity = size;
+	}
+
+	memcpy(slot->iov.iov_base, buffer, size);
+	slot->iov.iov_len = size;
+	slot->offset = offset;
+
+	ring_queue(file, IORING_OP_WRITEV, i);
+
+	if (file->to_submit >= SUBMIT_BATCH) {
+		ret = ring_enter(file, 0);
+		if (ret)
+			return ret;
+	}
+
+	if ((offset + size) >= file->size)
+		file->size = offset + size;
+
+	return 0;
+}
+
+static sqfs_u64 uring_get_size(const sqfs_file_t *base)
+{
+	const sqfs_file_uring_t *file = (const sqfs_file_uring_t *)base;
+
+	return file->size;
+}
+
+static int uring_truncate(sqfs_file_t *base, sqfs_u64 size)
+{
+	sqfs_file_uring_t *file = (sqfs_file_uring_t *)base;
+	int ret;
+
+	ret = drain_queue(file);
+	if (ret)
+		return ret;
+
+	if (ftruncate(file->fd, size))
+		return SQFS_ERROR_IO;
+
+	file->size = size;
+	return 0;
+}
+
+static int uring_flush(sqfs_file_t *base)
+{
+	return drain_queue((sqfs_file_uring_t *)base);
+}
+
+/*****************************************************************************/
+
+static void *ring_ptr(void *base, size_t offset)
+{
+	return (char *)base + offset;
+}
+
+static int map_ring(sqfs_file_uring_t *file, struct io_uring_params *p)
+{
+	void *sq, *cq;
+
+	file->sq_len = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+	file->cq_len = p->cq_off.cqes +
+		p->cq_entries * sizeof(struct io_uring_cqe);
+	file->sqes_len = p->sq_entries * sizeof(struct io_uring_sqe);
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (file->cq_len > file->sq_len)
+			file->sq_len = file->cq_len;
+		file->cq_len = file->sq_len;
+	}
+
+	file->sq_ptr = mmap(NULL, file->sq_len, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, file->ring_fd,
+			    IORING_OFF_SQ_RING);
+	if (file->sq_ptr == MAP_FAILED)
+		return -1;
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		file->cq_ptr = file->sq_ptr;
+	} else {
+		file->cq_ptr = mmap(NULL, file->cq_len, PROT_READ | PROT_WRITE,
+				    MAP_SHARED | MAP_POPULATE, file->ring_fd,
+				    IORING_OFF_CQ_RING);
+		if (file->cq_ptr == MAP_FAILED)
+			goto fail_sq;
+	}
+
+	file->sqes = mmap(NULL, file->sqes_len, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, file->ring_fd,
+			  IORING_OFF_SQES);
+	if (file->sqes == MAP_FAILED)
+		goto fail_cq;
+
+	sq = file->sq_ptr;
+	cq = file->cq_ptr;
+
+	file->sq_head = ring_ptr(sq, p->sq_off.head);
+	file->sq_tail = ring_ptr(sq, p->sq_off.tail);
+	file->sq_mask = ring_ptr(sq, p->sq_off.ring_mask);
+	file->sq_array = ring_ptr(sq, p->sq_off.array);
+
+	file->cq_head = ring_ptr(cq, p->cq_off.head);
+	file->cq_tail = ring_ptr(cq, p->cq_off.tail);
+	file->cq_mask = ring_ptr(cq, p->cq_off.ring_mask);
+	file->cqes = ring_ptr(cq, p->cq_off.cqes);
+	return 0;
+fail_cq:
+	if (file->cq_ptr != file->sq_ptr)
+		munmap(file->cq_ptr, file->cq_len);
+fail_sq:
+	munmap(file->sq_ptr, file->sq_len);
+	return -1;
+}
+
+sqfs_file_t *sqfs_file_uring_create(int fd, bool readonly, sqfs_u64 size)
+{
+	struct io_uring_params params;
+	sqfs_file_uring_t *file;
+	sqfs_file_t *base;
+	int temp;
+
+	file = calloc(1, sizeof(*file));
+	base = (sqfs_file_t *)file;
+	if (file == NULL)
+		return NULL;
+
+	memset(&params, 0, sizeof(params));
+
+	file->ring_fd = sys_io_uring_setup(QUEUE_DEPTH + 1, &params);
+	if (file->ring_fd < 0)
+		goto fail_free;
+
+	if (map_ring(file, &params))
+		goto fail_ring;
+
+	file->readonly = readonly;
+	file->size = size;
+	file->fd = fd;
+
+	base->read_at = uring_read_at;
+	base->write_at = uring_write_at;
+	base->get_size = uring_get_size;
+	base->truncate = uring_truncate;
+	base->flush = uring_flush;
+	((sqfs_object_t *)base)->copy = uring_copy;
+	((sqfs_object_t *)base)->destroy = uring_destroy;
+	return base;
+fail_ring:
+	temp = errno;
+	close(file->ring_fd);
+	errno = temp;
+fail_free:
+	temp = errno;
+	free(file);
+	errno = temp;
+	return NULL;
+}
@@ -19,6 +19,7 @@
 #endif
 
 #define DEF_POOL_SIZE (65536)
+#define DEF_ARENA_SIZE (1048576)
 #define MEM_ALIGN (8)
 
 typedef struct pool_t {
@@ -41,6 +42,45 @@ struct mem_pool_t {
 	pool_t *pool_list;
 };
 
+typedef struct chunk_t {
+	struct chunk_t *next;
+	size_t size;
+} chunk_t;
+
+struct mem_arena_t {
+	chunk_t *chunk_list;
+
+	unsigned char *ptr;
+	unsigned char *limit;
+};
+
+static void *map_pages(size_t size)
+{
+	void *ptr;
+
+#if defined(_WIN32) || defined(__WINDOWS__)
+	ptr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT,
+			   PAGE_READWRITE);
+#else
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (ptr == MAP_FAILED)
+		ptr = NULL;
+#endif
+	return ptr;
+}
+
+static void unmap_pages(void *ptr, size_t size)
+{
+#if defined(_WIN32) || defined(__WINDOWS__)
+	(void)size;
+	VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+	munmap(ptr, size);
+#endif
+}
+
 static size_t pool_size_from_bitmap_count(size_t count, size_t obj_size)
 {
 	size_t size, byte_count, bit_count;
@@ -65,19 +105,10 @@ static pool_t *create_pool(const mem_pool_t *mem)
 	unsigned char *ptr;
 	pool_t *pool;
 
-#if defined(_WIN32) || defined(__WINDOWS__)
-	pool = VirtualAlloc(NULL, mem->pool_size, MEM_RESERVE | MEM_COMMIT,
-			    PAGE_READWRITE);
-
+	pool = map_pages(mem->pool_size);
 	if (pool == NULL)
 		return NULL;
-#else
-	pool = mmap(NULL, mem->pool_size, PROT_READ | PROT_WRITE,
-		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 
-	if (pool == MAP_FAILED)
-		return NULL;
-#endif
 	pool->bitmap = pool->blob;
 	pool->obj_free = mem->bitmap_count * sizeof(unsigned int) * CHAR_BIT;
 
@@ -127,11 +158,7 @@ void mem_pool_destroy(mem_pool_t *mem)
 		pool_t *pool = mem->pool_list;
 		mem->pool_list = pool->next;
 
-#if defined(_WIN32) || defined(__WINDOWS__)
-		VirtualFree(pool, mem->pool_size, MEM_RELEASE);
-#else
-		munmap(pool, mem->pool_size);
-#endif
+		unmap_pages(pool, mem->pool_size);
 	}
 
 	free(mem);
@@ -203,3 +230,66 @@ void mem_pool_free(mem_pool_t *mem, void *ptr)
 
 	it->bitmap[i] &= ~(1 << j);
 }
+
+mem_arena_t *mem_arena_create(void)
+{
+	return calloc(1, sizeof(mem_arena_t));
+}
+
+void mem_arena_destroy(mem_arena_t *arena)
+{
+	while (arena->chunk_list != NULL) {
+		chunk_t *chunk = arena->chunk_list;
+		arena->chunk_list = chunk->next;
+
+		unmap_pages(chunk, chunk->size);
+	}
+
+	free(arena);
+}
+
+void *mem_arena_allocate(mem_arena_t *arena, size_t size)
+{
+	size_t header = sizeof(chunk_t), chunk_size;
+	chunk_t *chunk;
+	void *ptr;
+
+	if (size % MEM_ALIGN)
+		size += MEM_ALIGN - size % MEM_ALIGN;
+
+	if (header % MEM_ALIGN)
+		header += MEM_ALIGN - header % MEM_ALIGN;
+
+	if (size > (size_t)(arena->limit - arena->ptr)) {
+		/* fresh pages from the OS are already zero initialized */
+		chunk_size = DEF_ARENA_SIZE;
+
+		if (size > chunk_size - header) {
+			if (size > SIZE_MAX - header - 4095)
+				return NULL;
+
+			chunk_size = (header + size + 4095) & ~((size_t)4095);
+		}
+
+		chunk = map_pages(chunk_size);
+		if (chunk == NULL)
+			return NULL;
+
+		chunk->size = chunk_size;
+		chunk->next = arena->chunk_list;
+		arena->chunk_list = chunk;
+
+		/* keep bumping in the old chunk if the new one is used up */
+		if (chunk_size - header - size <
+		    (size_t)(arena->limit - arena->ptr)) {
+			return (unsigned char *)chunk + header;
+		}
+
+		arena->ptr = (unsigned char *)chunk + header;
+		arena->limit = (unsigned char *)chunk + chunk_size;
+	}
+
+	ptr = arena->ptr;
+	arena->ptr += size;
+	return ptr;
+}
@@ -0,0 +1,148 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/*
+ * sha256.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "config.h"
+#include "util.h"
+
+#include <string.h>
+
+/* SHA-256 as specified in FIPS 180-4 */
+
+static const sqfs_u32 K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+#define S0(x) (ROR(x, 2) ^ ROR(x, 13) ^ ROR(x, 22))
+#define S1(x) (ROR(x, 6) ^ ROR(x, 11) ^ ROR(x, 25))
+#define s0(x) (ROR(x, 7) ^ ROR(x, 18) ^ ((x) >> 3))
+#define s1(x) (ROR(x, 17) ^ ROR(x, 19) ^ ((x) >> 10))
+
+static void sha256_block(sqfs_u32 state[8], const sqfs_u8 *blk)
+{
+	sqfs_u32 a, b, c, d, e, f, g, h, t1, t2, w[64];
+	int i;
+
+	for (i = 0; i < 16; ++i) {
+		w[i] = ((sqfs_u32)blk[4 * i] << 24) |
+			((sqfs_u32)blk[4 * i + 1] << 16) |
+			((sqfs_u32)blk[4 * i + 2] << 8) |
+			(sqfs_u32)blk[4 * i + 3];
+	}
+
+	for (i = 16; i < 64; ++i)
+		w[i] = s1(w[i - 2]) + w[i - 7] + s0(w[i - 15]) + w[i - 16];
+
+	a = state[0]; b = state[1]; c = state[2]; d = state[3];
+	e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+	for (i = 0; i < 64; ++i) {
+		t1 = h + S1(e) + CH(e, f, g) + K[i] + w[i];
+		t2 = S0(a) + MAJ(a, b, c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sha256_init(sha256_ctx_t *ctx)
+{
+	static const sqfs_u32 initial[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+
+	memcpy(ctx->state, initial, sizeof(initial));
+	ctx->count = 0;
+}
+
+void sha256_update(sha256_ctx_t *ctx, const void *data, size_t size)
+{
+	const sqfs_u8 *ptr = data;
+	size_t used = ctx->count % sizeof(ctx->buffer), diff;
+
+	ctx->count += size;
+
+	if (used > 0) {
+		diff = sizeof(ctx->buffer) - used;
+		if (diff > size)
+			diff = size;
+
+		memcpy(ctx->buffer + used, ptr, diff);
+		ptr += diff;
+		size -= diff;
+		used += diff;
+
+		if (used < sizeof(ctx->buffer))
+			return;
+
+		sha256_block(ctx->state, ctx->buffer);
+	}
+
+	while (size >= sizeof(ctx->buffer)) {
+		sha256_block(ctx->state, ptr);
+		ptr += sizeof(ctx->buffer);
+		size -= sizeof(ctx->buffer);
+	}
+
+	memcpy(ctx->buffer, ptr, size);
+}
+
+void sha256_final(sha256_ctx_t *ctx, sqfs_u8 digest[SHA256_DIGEST_SIZE])
+{
+	size_t used = ctx->count % sizeof(ctx->buffer);
+	sqfs_u64 bits = ctx->count * 8;
+	int i;
+
+	ctx->buffer[used++] = 0x80;
+
+	if (used > sizeof(ctx->buffer) - 8) {
+		memset(ctx->buffer + used, 0, sizeof(ctx->buffer) - used);
+		sha256_block(ctx->state, ctx->buffer);
+		used = 0;
+	}
+
+	memset(ctx->buffer + used, 0, sizeof(ctx->buffer) - 8 - used);
+
+	for (i = 0; i < 8; ++i)
+		ctx->buffer[56 + i] = (sqfs_u8)(bits >> (56 - 8 * i));
+
+	sha256_block(ctx->state, ctx->buffer);
+
+	for (i = 0; i < 8; ++i) {
+		digest[4 * i] = (sqfs_u8)(ctx->state[i] >> 24);
+		digest[4 * i + 1] = (sqfs_u8)(ctx->state[i] >> 16);
+		digest[4 * i + 2] = (sqfs_u8)(ctx->state[i] >> 8);
+		digest[4 * i + 3] = (sqfs_u8)ctx->state[i];
+	}
+}
@@ -62,6 +62,9 @@ struct thread_pool_impl_t {
 
 	work_item_t *recycle;
 
+	/* dequeue items as soon as they are done, regardless of ticket */
+	bool unordered;
+
 	int status;
 
 	size_t num_workers;
@@ -75,7 +78,7 @@ static void store_completed(thread_pool_impl_t *pool, work_item_t *done,
 {
 	work_item_t *it = pool->done, *prev = NULL;
 
-	while (it != NULL) {
+	while (it != NULL && !pool->unordered) {
 		if (it->ticket_number >= done->ticket_number)
 			break;
 
@@ -148,8 +151,10 @@ static work_item_t *try_dequeue_done(thread_pool_impl_t *pool)
 	if (pool->done == NULL)
 		return NULL;
 
-	if (pool->done->ticket_number != pool->next_dequeue_ticket)
+	if (!pool->unordered &&
+	    pool->done->ticket_number != pool->next_dequeue_ticket) {
 		return NULL;
+	}
 
 	out = pool->done;
 	pool->done = out->next;
@@ -321,7 +326,8 @@ static int get_status(thread_pool_t *interface)
 	return status;
 }
 
-thread_pool_t *thread_pool_create(size_t num_jobs, thread_pool_worker_t worker)
+static thread_pool_t *create_pool(size_t num_jobs, thread_pool_worker_t worker,
+				  bool unordered)
 {
 	thread_pool_impl_t *pool;
 	thread_pool_t *interface;
@@ -349,6 +355,7 @@ thread_pool_t *thread_pool_create(size_t num_jobs, thread_pool_worker_t worker)
 	pthread_sigmask(SIG_SETMASK, &set, &oldset);
 
 	pool->num_workers = num_jobs;
+	pool->unordered = unordered;
 
 	for (i = 0; i < num_jobs; ++i) {
 		pool->workers[i].fun = worker;
@@ -390,3 +397,14 @@ fail_free:
 	free(pool);
 	return NULL;
 }
+
+thread_pool_t *thread_pool_create(size_t num_jobs, thread_pool_worker_t worker)
+{
+	return create_pool(num_jobs, worker, false);
+}
+
+thread_pool_t *thread_pool_create_unordered(size_t num_jobs,
+					    thread_pool_worker_t worker)
+{
+	return create_pool(num_jobs, worker, true);
+}
@@ -159,4 +159,11 @@ thread_pool_t *thread_pool_create(size_t num_jobs, thread_pool_worker_t worker)
 	(void)num_jobs;
 	return thread_pool_create_serial(worker);
 }
+
+thread_pool_t *thread_pool_create_unordered(size_t num_jobs,
+					    thread_pool_worker_t worker)
+{
+	(void)num_jobs;
+	return thread_pool_create_serial(worker);
+}
 #endif
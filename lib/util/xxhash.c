@@ -62,6 +62,29 @@ static sqfs_u32 XXH_readLE32(const sqfs_u8 *ptr)
 	return le32toh(value);
 }
 
+static sqfs_u32 xxh32_finalize(sqfs_u32 h32, const sqfs_u8 *p,
+			       const sqfs_u8 *b_end)
+{
+	while (p + 4 <= b_end) {
+		h32 += XXH_readLE32(p) * PRIME32_3;
+		h32 = xxh_rotl32(h32, 17) * PRIME32_4;
+		p += 4;
+	}
+
+	while (p < b_end) {
+		h32 += (*p) * PRIME32_5;
+		h32 = xxh_rotl32(h32, 11) * PRIME32_1;
+		p++;
+	}
+
+	h32 ^= h32 >> 15;
+	h32 *= PRIME32_2;
+	h32 ^= h32 >> 13;
+	h32 *= PRIME32_3;
+	h32 ^= h32 >> 16;
+	return h32;
+}
+
 sqfs_u32 xxh32(const void *input, const size_t len)
 {
 	const sqfs_u8 *p = (const sqfs_u8 *)input;
@@ -90,23 +113,82 @@ sqfs_u32 xxh32(const void *input, const size_t len)
 	}
 
 	h32 += (sqfs_u32)len;
+	return xxh32_finalize(h32, p, b_end);
+}
 
-	while (p + 4 <= b_end) {
-		h32 += XXH_readLE32(p) * PRIME32_3;
-		h32 = xxh_rotl32(h32, 17) * PRIME32_4;
-		p += 4;
+void xxh32_init(xxh32_ctx_t *ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->v1 = PRIME32_1 + PRIME32_2;
+	ctx->v2 = PRIME32_2;
+	ctx->v3 = 0;
+	ctx->v4 = 0 - PRIME32_1;
+}
+
+void xxh32_update(xxh32_ctx_t *ctx, const void *input, size_t len)
+{
+	const sqfs_u8 *p = (const sqfs_u8 *)input;
+	const sqfs_u8 *const b_end = p + len;
+	sqfs_u8 *mem = (sqfs_u8 *)ctx->mem32;
+
+	ctx->total_len += (sqfs_u32)len;
+	ctx->large_len |= (len >= 16) | (ctx->total_len >= 16);
+
+	if (ctx->memsize + len < 16) {
+		memcpy(mem + ctx->memsize, input, len);
+		ctx->memsize += (sqfs_u32)len;
+		return;
 	}
 
-	while (p < b_end) {
-		h32 += (*p) * PRIME32_5;
-		h32 = xxh_rotl32(h32, 11) * PRIME32_1;
-		p++;
+	if (ctx->memsize > 0) {
+		memcpy(mem + ctx->memsize, input, 16 - ctx->memsize);
+		ctx->v1 = xxh32_round(ctx->v1, XXH_readLE32(mem));
+		ctx->v2 = xxh32_round(ctx->v2, XXH_readLE32(mem + 4));
+		ctx->v3 = xxh32_round(ctx->v3, XXH_readLE32(mem + 8));
+		ctx->v4 = xxh32_round(ctx->v4, XXH_readLE32(mem + 12));
+		p += 16 - ctx->memsize;
+		ctx->memsize = 0;
 	}
 
-	h32 ^= h32 >> 15;
-	h32 *= PRIME32_2;
-	h32 ^= h32 >> 13;
-	h32 *= PRIME32_3;
-	h32 ^= h32 >> 16;
-	return h32;
+	if (p + 16 <= b_end) {
+		const sqfs_u8 *const limit = b_end - 16;
+		sqfs_u32 v1 = ctx->v1;
+		sqfs_u32 v2 = ctx->v2;
+		sqfs_u32 v3 = ctx->v3;
+		sqfs_u32 v4 = ctx->v4;
+
+		do {
+			v1 = xxh32_round(v1, XXH_readLE32(p     ));
+			v2 = xxh32_round(v2, XXH_readLE32(p +  4));
+			v3 = xxh32_round(v3, XXH_readLE32(p +  8));
+			v4 = xxh32_round(v4, XXH_readLE32(p + 12));
+			p += 16;
+		} while (p <= limit);
+
+		ctx->v1 = v1;
+		ctx->v2 = v2;
+		ctx->v3 = v3;
+		ctx->v4 = v4;
+	}
+
+	if (p < b_end) {
+		memcpy(mem, p, b_end - p);
+		ctx->memsize = (sqfs_u32)(b_end - p);
+	}
+}
+
+sqfs_u32 xxh32_final(const xxh32_ctx_t *ctx)
+{
+	const sqfs_u8 *p = (const sqfs_u8 *)ctx->mem32;
+	sqfs_u32 h32;
+
+	if (ctx->large_len) {
+		h32 = xxh_rotl32(ctx->v1, 1) + xxh_rotl32(ctx->v2, 7) +
+			xxh_rotl32(ctx->v3, 12) + xxh_rotl32(ctx->v4, 18);
+	} else {
+		h32 = ctx->v3 + PRIME32_5;
+	}
+
+	h32 += ctx->total_len;
+	return xxh32_finalize(h32, p, p + ctx->memsize);
 }
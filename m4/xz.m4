@@ -0,0 +1,33 @@
+AC_DEFUN([AC_TEST_XZ_DECODER_MT], [
+	AC_MSG_CHECKING([whether liblzma supports multi threaded decoding])
+	AC_LANG_PUSH([C])
+	ac_xz_have_decoder_mt="no"
+	ac_xz_save_CFLAGS="$CFLAGS"
+	CFLAGS="$CFLAGS $XZ_CFLAGS"
+	AC_COMPILE_IFELSE([AC_LANG_PROGRAM([#include <lzma.h>], [lzma_mt mt; mt.memlimit_stop = 0; lzma_stream_decoder_mt(NULL, &mt);])],
+			  ac_xz_have_decoder_mt="yes"
+			  AC_MSG_RESULT([yes]), AC_MSG_RESULT([no]))
+
+	AS_IF([test "x$ac_xz_have_decoder_mt" = "xyes"],
+		[AC_DEFINE(HAVE_XZ_DECODER_MT, 1, [Does liblzma support multi threaded decoding?])])
+
+	CFLAGS=$ac_xz_save_CFLAGS
+	AC_LANG_POP([C])
+])
+
+AC_DEFUN([AC_TEST_XZ_ENCODER_MT], [
+	AC_MSG_CHECKING([whether liblzma supports multi threaded encoding])
+	AC_LANG_PUSH([C])
+	ac_xz_have_encoder_mt="no"
+	ac_xz_save_CFLAGS="$CFLAGS"
+	CFLAGS="$CFLAGS $XZ_CFLAGS"
+	AC_COMPILE_IFELSE([AC_LANG_PROGRAM([#include <lzma.h>], [lzma_mt mt; mt.preset = 0; lzma_stream_encoder_mt(NULL, &mt);])],
+			  ac_xz_have_encoder_mt="yes"
+			  AC_MSG_RESULT([yes]), AC_MSG_RESULT([no]))
+
+	AS_IF([test "x$ac_xz_have_encoder_mt" = "xyes"],
+		[AC_DEFINE(HAVE_XZ_ENCODER_MT, 1, [Does liblzma support multi threaded encoding?])])
+
+	CFLAGS=$ac_xz_save_CFLAGS
+	AC_LANG_POP([C])
+])
@@ -0,0 +1,175 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * compress.c
+ *
+ * Copyright (C) 2021 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "fstream.h"
+#include "../test.h"
+
+#if defined(TEST_GZIP)
+#define COMP_ID FSTREAM_COMPRESSOR_GZIP
+#elif defined(TEST_XZ)
+#define COMP_ID FSTREAM_COMPRESSOR_XZ
+#elif defined(TEST_LZ4)
+#define COMP_ID FSTREAM_COMPRESSOR_LZ4
+#endif
+
+#define NUM_JOBS 4
+
+/* enough to be split up into several units */
+#define DATA_SIZE (1536 * 1024 + 123)
+
+static const char *words[] = {
+	"lorem", "ipsum", "dolor", "sit", "amet", "consectetur",
+	"adipiscing", "elit", "sed", "do", "eiusmod", "tempor",
+	"incididunt", "ut", "labore", "et", "dolore", "magna", "aliqua",
+};
+
+static char data[DATA_SIZE];
+static char result[DATA_SIZE + 1];
+
+static sqfs_u8 *comp_data = NULL;
+static size_t comp_size = 0;
+
+static void destroy_noop(sqfs_object_t *obj)
+{
+	(void)obj;
+}
+
+static int mem_append(ostream_t *strm, const void *buffer, size_t size)
+{
+	sqfs_u8 *new;
+	(void)strm;
+
+	new = realloc(comp_data, comp_size + size);
+	TEST_NOT_NULL(new);
+
+	memcpy(new + comp_size, buffer, size);
+	comp_data = new;
+	comp_size += size;
+	return 0;
+}
+
+static int mem_flush(ostream_t *strm)
+{
+	(void)strm;
+	return 0;
+}
+
+static const char *mem_ostream_get_filename(ostream_t *strm)
+{
+	(void)strm;
+	return "memstream";
+}
+
+static int precache_noop(istream_t *strm)
+{
+	(void)strm;
+	return 0;
+}
+
+static const char *mem_istream_get_filename(istream_t *strm)
+{
+	(void)strm;
+	return "memstream";
+}
+
+static ostream_t mem_ostream = {
+	.base = {
+		.destroy = destroy_noop,
+	},
+
+	.append = mem_append,
+	.flush = mem_flush,
+	.get_filename = mem_ostream_get_filename,
+};
+
+static istream_t mem_istream = {
+	.base = {
+		.destroy = destroy_noop,
+	},
+
+	.eof = true,
+
+	.precache = precache_noop,
+	.get_filename = mem_istream_get_filename,
+};
+
+static void generate_data(void)
+{
+	sqfs_u32 seed = 0xDEADBEEF;
+	size_t i = 0, len;
+	const char *w;
+
+	while (i < DATA_SIZE) {
+		seed = seed * 1103515245 + 12345;
+		w = words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+
+		len = strlen(w);
+		if (len > DATA_SIZE - i)
+			len = DATA_SIZE - i;
+
+		memcpy(data + i, w, len);
+		i += len;
+
+		if (i < DATA_SIZE)
+			data[i++] = ((seed >> 8) % 13) == 0 ? '\n' : ' ';
+	}
+}
+
+int main(void)
+{
+	istream_t *in;
+	ostream_t *out;
+	size_t i, diff;
+	int ret;
+
+	generate_data();
+
+	/* compress with multiple jobs, in odd sized pieces */
+	out = ostream_compressor_create(&mem_ostream, COMP_ID, NUM_JOBS);
+	TEST_NOT_NULL(out);
+
+	for (i = 0; i < DATA_SIZE; i += diff) {
+		diff = DATA_SIZE - i;
+		if (diff > 10007)
+			diff = 10007;
+
+		ret = ostream_append(out, data + i, diff);
+		TEST_EQUAL_I(ret, 0);
+	}
+
+	ret = ostream_flush(out);
+	TEST_EQUAL_I(ret, 0);
+
+	sqfs_destroy(out);
+
+	TEST_NOT_NULL(comp_data);
+	TEST_LESS_THAN_UI(comp_size, DATA_SIZE);
+
+	/* the result must be decodable by a plain, serial decoder */
+	mem_istream.buffer = comp_data;
+	mem_istream.buffer_used = comp_size;
+	mem_istream.buffer_offset = 0;
+
+	ret = istream_detect_compressor(&mem_istream, NULL);
+	TEST_EQUAL_I(ret, COMP_ID);
+
+	in = istream_compressor_create(&mem_istream, COMP_ID, 1);
+	TEST_NOT_NULL(in);
+
+	for (i = 0; i <= DATA_SIZE; i += ret) {
+		ret = istream_read(in, result + i, sizeof(result) - i);
+		TEST_ASSERT(ret >= 0);
+		if (ret == 0)
+			break;
+	}
+
+	TEST_EQUAL_UI(i, DATA_SIZE);
+	TEST_ASSERT(memcmp(result, data, DATA_SIZE) == 0);
+
+	sqfs_destroy(in);
+	free(comp_data);
+	return EXIT_SUCCESS;
+}
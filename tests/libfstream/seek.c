@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * seek.c
+ *
+ * Copyright (C) 2021 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "config.h"
+
+#include "fstream.h"
+#include "../test.h"
+
+#define FILE_SIZE (66)
+
+int main(void)
+{
+	char buffer[16];
+	istream_t *fp;
+	sqfs_s32 ret;
+
+	fp = istream_open_file(STRVALUE(TESTFILE));
+	TEST_NOT_NULL(fp);
+	TEST_EQUAL_I(istream_tell(fp), 0);
+
+	/* seek inside the buffered data */
+	ret = istream_read(fp, buffer, 11);
+	TEST_EQUAL_I(ret, 11);
+	TEST_ASSERT(memcmp(buffer, "\r\nThe quick", 11) == 0);
+	TEST_EQUAL_I(istream_tell(fp), 11);
+
+	TEST_EQUAL_I(istream_seek(fp, 2), 0);
+	TEST_EQUAL_I(istream_tell(fp), 2);
+
+	ret = istream_read(fp, buffer, 3);
+	TEST_EQUAL_I(ret, 3);
+	TEST_ASSERT(memcmp(buffer, "The", 3) == 0);
+
+	/* skipping forward */
+	TEST_EQUAL_I(istream_skip(fp, 25), 0);
+	TEST_EQUAL_I(istream_tell(fp), 30);
+
+	ret = istream_read(fp, buffer, 4);
+	TEST_EQUAL_I(ret, 4);
+	TEST_ASSERT(memcmp(buffer, "\r\n\r\n", 4) == 0);
+
+	/* drain the stream, then seek back on the underlying file */
+	TEST_EQUAL_I(istream_skip(fp, FILE_SIZE - 34), 0);
+	TEST_EQUAL_I(istream_precache(fp), 0);
+	TEST_EQUAL_UI(fp->buffer_used, 0);
+	TEST_EQUAL_I(istream_tell(fp), FILE_SIZE);
+
+	TEST_EQUAL_I(istream_seek(fp, 34), 0);
+	TEST_EQUAL_I(istream_tell(fp), 34);
+
+	ret = istream_read(fp, buffer, 10);
+	TEST_EQUAL_I(ret, 10);
+	TEST_ASSERT(memcmp(buffer, "jumps over", 10) == 0);
+
+	/* skipping past the end must fail */
+	TEST_ASSERT(istream_skip(fp, FILE_SIZE) != 0);
+
+	sqfs_destroy(fp);
+	return EXIT_SUCCESS;
+}
@@ -248,6 +248,62 @@ static sqfs_u8 data_in[] = {
 	0x77, 0x9b, 0xd5, 0x6d, 0x83, 0x36, 0x20, 0x4d,
 	0x1c, 0xeb, 0x8f, 0x6b, 0xb4, 0xf3, 0xf8, 0x05,
 	0x6b, 0x8b, 0x8b, 0x20, 0xbe, 0x01, 0x00, 0x00
+#elif defined(TEST_BGZF)
+	0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0xff, 0x06, 0x00, 0x42, 0x43, 0x02, 0x00,
+	0x8d, 0x00, 0x25, 0x8c, 0xc1, 0x0d, 0xc3, 0x30,
+	0x0c, 0x03, 0xff, 0x99, 0x82, 0x03, 0x04, 0x9d,
+	0xa4, 0xdf, 0x0e, 0xa0, 0xda, 0x42, 0x40, 0xc0,
+	0xb2, 0x1d, 0x4b, 0xea, 0xfc, 0x75, 0xd1, 0x1f,
+	0x0f, 0xc4, 0xdd, 0x73, 0x2c, 0x35, 0x70, 0x7a,
+	0x1a, 0xea, 0x68, 0x63, 0xc1, 0x19, 0x10, 0xd3,
+	0x38, 0x51, 0x46, 0x77, 0x2d, 0xa1, 0x91, 0x0b,
+	0x52, 0x39, 0xe9, 0x85, 0xfd, 0x82, 0x36, 0xee,
+	0xd3, 0xb5, 0x6e, 0x01, 0xca, 0x74, 0x1b, 0xf5,
+	0x08, 0xb5, 0xb9, 0x65, 0xf6, 0xc2, 0xca, 0x9a,
+	0x3d, 0x90, 0x81, 0x26, 0xef, 0x9d, 0x87, 0xc6,
+	0x3f, 0xad, 0x30, 0xb9, 0xba, 0x40, 0x1a, 0xef,
+	0x94, 0x07, 0x5e, 0x01, 0xed, 0xb4, 0xdd, 0x86,
+	0xf1, 0x37, 0x3e, 0x1b, 0xc5, 0xce, 0xe3, 0x4e,
+	0x3a, 0xfa, 0xf0, 0x58, 0xf9, 0x05, 0xd0, 0x6e,
+	0x27, 0x79, 0xa0, 0x00, 0x00, 0x00, 0x1f, 0x8b,
+	0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,
+	0x06, 0x00, 0x42, 0x43, 0x02, 0x00, 0x8b, 0x00,
+	0x25, 0x8d, 0xc1, 0x0d, 0x02, 0x31, 0x0c, 0x04,
+	0xff, 0x57, 0xc5, 0x56, 0x40, 0x15, 0x34, 0x62,
+	0x92, 0x05, 0x2c, 0x39, 0x71, 0xce, 0x89, 0x4f,
+	0x94, 0x4f, 0x10, 0xdf, 0xd1, 0x8c, 0xa6, 0x82,
+	0x1f, 0x46, 0xd1, 0x25, 0x4b, 0xbd, 0x23, 0xcd,
+	0xa4, 0x15, 0x87, 0xc9, 0xc3, 0x43, 0x27, 0xba,
+	0x4e, 0x45, 0x2e, 0x88, 0xe9, 0x99, 0x3a, 0xb6,
+	0x0c, 0x0a, 0x8a, 0xb7, 0xe6, 0xd5, 0x8f, 0xe2,
+	0x7d, 0xf2, 0x4c, 0x59, 0x37, 0xdc, 0x73, 0xdb,
+	0x92, 0x8b, 0xd0, 0xc8, 0x20, 0xaa, 0x9b, 0x07,
+	0xb4, 0x23, 0x38, 0x82, 0x6f, 0xf6, 0xca, 0xd0,
+	0xf5, 0x03, 0x97, 0x5b, 0x8e, 0xbd, 0x23, 0x2e,
+	0xda, 0x46, 0x9c, 0x93, 0x47, 0x51, 0xb3, 0x6c,
+	0xff, 0x8a, 0x60, 0xe2, 0x99, 0x2f, 0x95, 0x85,
+	0xfe, 0x05, 0x88, 0xfe, 0xa0, 0x3d, 0xa0, 0x00,
+	0x00, 0x00, 0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0xff, 0x06, 0x00, 0x42, 0x43,
+	0x02, 0x00, 0x7b, 0x00, 0x15, 0xca, 0xc1, 0x0d,
+	0xc3, 0x40, 0x08, 0x05, 0xd1, 0xbb, 0xab, 0xf8,
+	0x05, 0x44, 0xee, 0x22, 0x85, 0x10, 0x16, 0x4b,
+	0x48, 0x18, 0xd6, 0x2c, 0x48, 0x29, 0x3f, 0x9b,
+	0xdb, 0x48, 0x6f, 0xda, 0x8c, 0x30, 0x29, 0x95,
+	0xaa, 0xf3, 0xc4, 0xfb, 0xcb, 0x32, 0x4b, 0x3a,
+	0xb1, 0xd4, 0x0b, 0xc1, 0x4c, 0xc2, 0x54, 0xe0,
+	0x9e, 0x3a, 0xa8, 0x76, 0x79, 0xf8, 0x31, 0x33,
+	0x74, 0x88, 0xd7, 0x0b, 0xab, 0xf7, 0xa5, 0xbe,
+	0xdd, 0x26, 0xe1, 0x69, 0x45, 0x5c, 0x97, 0xb2,
+	0x12, 0x86, 0x2c, 0xc9, 0xbf, 0xde, 0x61, 0xa6,
+	0x05, 0x72, 0xbd, 0xa1, 0x03, 0xb2, 0x0a, 0x46,
+	0x9f, 0xc8, 0xbe, 0xcf, 0xe3, 0x07, 0x83, 0x49,
+	0x39, 0xdf, 0x7e, 0x00, 0x00, 0x00, 0x1f, 0x8b,
+	0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,
+	0x06, 0x00, 0x42, 0x43, 0x02, 0x00, 0x1b, 0x00,
+	0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00,
 #elif defined(TEST_ZSTD)
 	0x28, 0xb5, 0x2f, 0xfd, 0x04, 0x88, 0xa5, 0x08,
 	0x00, 0x46, 0x97, 0x3a, 0x1a, 0x80, 0x37, 0xcd,
@@ -328,6 +384,63 @@ static sqfs_u8 data_in[] = {
 	0x98, 0x50, 0x5a, 0xc2, 0xcf, 0xe1, 0x08, 0x02,
 	0x00, 0x0f, 0x1e, 0x44,	0x40, 0x79, 0x50, 0x67,
 	0x3d, 0xd3, 0x35, 0x8f
+#elif defined(TEST_LZ4)
+	0x04, 0x22, 0x4d, 0x18, 0x64, 0x40, 0xa7, 0xa8,
+	0x01, 0x00, 0x00, 0xf2, 0x57, 0x4c, 0x6f, 0x72,
+	0x65, 0x6d, 0x20, 0x69, 0x70, 0x73, 0x75, 0x6d,
+	0x20, 0x64, 0x6f, 0x6c, 0x6f, 0x72, 0x20, 0x73,
+	0x69, 0x74, 0x20, 0x61, 0x6d, 0x65, 0x74, 0x2c,
+	0x20, 0x63, 0x6f, 0x6e, 0x73, 0x65, 0x63, 0x74,
+	0x65, 0x74, 0x75, 0x72, 0x20, 0x61, 0x64, 0x69,
+	0x70, 0x69, 0x73, 0x63, 0x69, 0x6e, 0x67, 0x20,
+	0x65, 0x6c, 0x69, 0x74, 0x2c, 0x20, 0x73, 0x65,
+	0x64, 0x20, 0x64, 0x6f, 0x20, 0x65, 0x69, 0x75,
+	0x73, 0x6d, 0x6f, 0x64, 0x0a, 0x74, 0x65, 0x6d,
+	0x70, 0x6f, 0x72, 0x20, 0x69, 0x6e, 0x63, 0x69,
+	0x64, 0x69, 0x64, 0x75, 0x6e, 0x74, 0x20, 0x75,
+	0x74, 0x20, 0x6c, 0x61, 0x62, 0x6f, 0x72, 0x65,
+	0x20, 0x65, 0x74, 0x5b, 0x00, 0xf0, 0x0e, 0x65,
+	0x20, 0x6d, 0x61, 0x67, 0x6e, 0x61, 0x20, 0x61,
+	0x6c, 0x69, 0x71, 0x75, 0x61, 0x2e, 0x20, 0x55,
+	0x74, 0x20, 0x65, 0x6e, 0x69, 0x6d, 0x20, 0x61,
+	0x64, 0x20, 0x6d, 0x69, 0x09, 0x00, 0xf2, 0x1a,
+	0x76, 0x65, 0x6e, 0x69, 0x61, 0x6d, 0x2c, 0x0a,
+	0x71, 0x75, 0x69, 0x73, 0x20, 0x6e, 0x6f, 0x73,
+	0x74, 0x72, 0x75, 0x64, 0x20, 0x65, 0x78, 0x65,
+	0x72, 0x63, 0x69, 0x74, 0x61, 0x74, 0x69, 0x6f,
+	0x6e, 0x20, 0x75, 0x6c, 0x6c, 0x61, 0x6d, 0x63,
+	0x6f, 0x5a, 0x00, 0x00, 0x25, 0x00, 0x62, 0x69,
+	0x73, 0x69, 0x20, 0x75, 0x74, 0x53, 0x00, 0xf1,
+	0x02, 0x69, 0x70, 0x20, 0x65, 0x78, 0x20, 0x65,
+	0x61, 0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x6f, 0x64,
+	0x6f, 0x0a, 0xc1, 0x00, 0x70, 0x71, 0x75, 0x61,
+	0x74, 0x2e, 0x20, 0x44, 0x53, 0x00, 0xa2, 0x61,
+	0x75, 0x74, 0x65, 0x20, 0x69, 0x72, 0x75, 0x72,
+	0x65, 0x91, 0x00, 0xf0, 0x02, 0x20, 0x69, 0x6e,
+	0x20, 0x72, 0x65, 0x70, 0x72, 0x65, 0x68, 0x65,
+	0x6e, 0x64, 0x65, 0x72, 0x69, 0x74, 0x11, 0x00,
+	0xb0, 0x76, 0x6f, 0x6c, 0x75, 0x70, 0x74, 0x61,
+	0x74, 0x65, 0x20, 0x76, 0xea, 0x00, 0xa4, 0x20,
+	0x65, 0x73, 0x73, 0x65, 0x0a, 0x63, 0x69, 0x6c,
+	0x6c, 0x22, 0x01, 0xd0, 0x65, 0x20, 0x65, 0x75,
+	0x20, 0x66, 0x75, 0x67, 0x69, 0x61, 0x74, 0x20,
+	0x6e, 0x91, 0x00, 0xf0, 0x04, 0x20, 0x70, 0x61,
+	0x72, 0x69, 0x61, 0x74, 0x75, 0x72, 0x2e, 0x20,
+	0x45, 0x78, 0x63, 0x65, 0x70, 0x74, 0x65, 0x75,
+	0x47, 0x01, 0xf0, 0x04, 0x6e, 0x74, 0x20, 0x6f,
+	0x63, 0x63, 0x61, 0x65, 0x63, 0x61, 0x74, 0x20,
+	0x63, 0x75, 0x70, 0x69, 0x64, 0x61, 0x74, 0x32,
+	0x00, 0xa0, 0x6f, 0x6e, 0x0a, 0x70, 0x72, 0x6f,
+	0x69, 0x64, 0x65, 0x6e, 0x46, 0x01, 0x00, 0x2a,
+	0x01, 0xf0, 0x0b, 0x69, 0x6e, 0x20, 0x63, 0x75,
+	0x6c, 0x70, 0x61, 0x20, 0x71, 0x75, 0x69, 0x20,
+	0x6f, 0x66, 0x66, 0x69, 0x63, 0x69, 0x61, 0x20,
+	0x64, 0x65, 0x73, 0x65, 0x72, 0x1e, 0x00, 0x40,
+	0x6d, 0x6f, 0x6c, 0x6c, 0x93, 0x01, 0x00, 0x21,
+	0x01, 0xf0, 0x01, 0x69, 0x64, 0x20, 0x65, 0x73,
+	0x74, 0x20, 0x6c, 0x61, 0x62, 0x6f, 0x72, 0x75,
+	0x6d, 0x2e, 0x0a, 0x00, 0x00, 0x00, 0x00, 0xdc,
+	0x65, 0x9f, 0x99,
 #endif
 };
 
@@ -345,14 +458,27 @@ static const char orig[] =
 #elif defined(TEST_XZ) || defined(TEST_XZ2)
 #define COMP_NAME "xz"
 #define COMP_ID FSTREAM_COMPRESSOR_XZ
-#elif defined(TEST_GZIP)
+#elif defined(TEST_GZIP) || defined(TEST_BGZF)
 #define COMP_NAME "gzip"
 #define COMP_ID FSTREAM_COMPRESSOR_GZIP
 #elif defined(TEST_ZSTD) || defined(TEST_ZSTD2)
 #define COMP_NAME "zstd"
 #define COMP_ID FSTREAM_COMPRESSOR_ZSTD
+#elif defined(TEST_LZ4)
+#define COMP_NAME "lz4"
+#define COMP_ID FSTREAM_COMPRESSOR_LZ4
+#endif
+
+/* BGZF members can be decoded in parallel */
+#if defined(TEST_BGZF)
+#define NUM_JOBS 4
+#else
+#define NUM_JOBS 1
 #endif
 
+static sqfs_u8 data_work[sizeof(data_in)];
+static char big_buffer[16384];
+
 static void destroy_noop(sqfs_object_t *obj)
 {
 	(void)obj;
@@ -375,15 +501,21 @@ static istream_t memstream = {
 		.destroy = destroy_noop,
 	},
 
-	.buffer_used = sizeof(data_in) / sizeof(data_in[0]),
-	.buffer_offset = 0,
 	.eof = true,
-	.buffer = data_in,
+	.buffer = data_work,
 
 	.precache = precache_noop,
 	.get_filename = get_filename,
 };
 
+/* precache moves unread data to the front of the buffer, work on a copy */
+static void memstream_reset(void)
+{
+	memcpy(data_work, data_in, sizeof(data_in));
+	memstream.buffer_used = sizeof(data_in);
+	memstream.buffer_offset = 0;
+}
+
 int main(void)
 {
 	char buffer[2 * (sizeof(orig) / sizeof(orig[0]))];
@@ -395,6 +527,8 @@ int main(void)
 	/* XXX: null terminator not included in the compressed blob */
 	orig_sz = (sizeof(orig) / sizeof(orig[0])) - 1;
 
+	memstream_reset();
+
 	/* generic API test */
 	TEST_ASSERT(fstream_compressor_exists(COMP_ID));
 
@@ -408,7 +542,7 @@ int main(void)
 	TEST_EQUAL_I(ret, COMP_ID);
 
 	/* decoder test */
-	xfrm = istream_compressor_create(&memstream, COMP_ID);
+	xfrm = istream_compressor_create(&memstream, COMP_ID, NUM_JOBS);
 	TEST_NOT_NULL(xfrm);
 
 	name = istream_get_filename(xfrm);
@@ -424,6 +558,24 @@ int main(void)
 	ret = istream_read(xfrm, buffer, sizeof(buffer));
 	TEST_EQUAL_I(ret, 0);
 
+	sqfs_destroy(xfrm);
+
+	/* large reads decode straight into the destination buffer */
+	memstream_reset();
+
+	xfrm = istream_compressor_create(&memstream, COMP_ID, NUM_JOBS);
+	TEST_NOT_NULL(xfrm);
+
+	ret = istream_read(xfrm, big_buffer, sizeof(big_buffer));
+	TEST_ASSERT(ret > 0);
+	TEST_EQUAL_UI((size_t)ret, orig_sz);
+
+	ret = memcmp(big_buffer, orig, ret);
+	TEST_EQUAL_I(ret, 0);
+
+	ret = istream_read(xfrm, big_buffer, sizeof(big_buffer));
+	TEST_EQUAL_I(ret, 0);
+
 	/* cleanup */
 	sqfs_destroy(xfrm);
 	return EXIT_SUCCESS;
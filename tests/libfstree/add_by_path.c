@@ -9,6 +9,63 @@
 #include "fstree.h"
 #include "../test.h"
 
+static void test_large_dir(void)
+{
+	tree_node_t *dir, *n;
+	char path[64];
+	struct stat sb;
+	fstree_t fs;
+	int i;
+
+	TEST_ASSERT(fstree_init(&fs, NULL) == 0);
+
+	memset(&sb, 0, sizeof(sb));
+	sb.st_mode = S_IFREG | 0644;
+
+	/* enough entries that the directory gets a hash index */
+	for (i = 0; i < 1000; ++i) {
+		sprintf(path, "big/file%d", i);
+		TEST_NOT_NULL(fstree_add_generic(&fs, path, &sb, path));
+	}
+
+	dir = fstree_get_node_by_path(&fs, fs.root, "big", false, false);
+	TEST_NOT_NULL(dir);
+	TEST_NOT_NULL(dir->data.dir.index);
+
+	for (i = 0; i < 1000; ++i) {
+		sprintf(path, "big/file%d", i);
+		n = fstree_get_node_by_path(&fs, fs.root, path, false, false);
+		TEST_NOT_NULL(n);
+		TEST_ASSERT(n->parent == dir);
+		TEST_STR_EQUAL(n->name, path + 4);
+
+		TEST_NULL(fstree_add_generic(&fs, path, &sb, path));
+		TEST_EQUAL_UI(errno, EEXIST);
+	}
+
+	/* a prefix of an existing name is not a match */
+	TEST_NULL(fstree_get_node_by_path(&fs, fs.root, "big/file1000",
+					  false, false));
+	TEST_NULL(fstree_get_node_by_path(&fs, fs.root, "big/file",
+					  false, false));
+
+	/* path components are compared up to the next separator */
+	sb.st_mode = S_IFDIR | 0755;
+	TEST_NOT_NULL(fstree_add_generic(&fs, "big/sub/x", &sb, NULL));
+	n = fstree_get_node_by_path(&fs, fs.root, "big/sub/x", false, false);
+	TEST_NOT_NULL(n);
+	TEST_STR_EQUAL(n->name, "x");
+	TEST_STR_EQUAL(n->parent->name, "sub");
+
+	/* the index stays valid after sorting */
+	TEST_ASSERT(fstree_post_process(&fs) == 0);
+	n = fstree_get_node_by_path(&fs, fs.root, "big/file500", false, false);
+	TEST_NOT_NULL(n);
+	TEST_STR_EQUAL(n->name, "file500");
+
+	fstree_cleanup(&fs);
+}
+
 int main(void)
 {
 	tree_node_t *a, *b;
@@ -129,5 +186,7 @@ int main(void)
 	TEST_EQUAL_UI(errno, EEXIST);
 
 	fstree_cleanup(&fs);
+
+	test_large_dir();
 	return EXIT_SUCCESS;
 }
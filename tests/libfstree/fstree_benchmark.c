@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * fstree_benchmark.c
+ *
+ * Copyright (C) 2021 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "config.h"
+#include "compat.h"
+#include "fstree.h"
+
+#include <sys/resource.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+static struct option long_opts[] = {
+	{ "nodes", required_argument, NULL, 'n' },
+	{ "per-dir", required_argument, NULL, 'p' },
+	{ "help", no_argument, NULL, 'h' },
+	{ NULL, 0, NULL, 0 },
+};
+
+static const char *short_opts = "n:p:h";
+
+static const char *help_string =
+"Usage: fstree_benchmark [OPTIONS...]\n"
+"\n"
+"Builds a synthetic file system tree in memory, like tar2sqfs or gensquashfs\n"
+"with a listing file would, by adding regular files at increasing paths.\n"
+"The files are spread over directories below the root. The time to build\n"
+"the tree, the time to run the post processing, the peak resident set size\n"
+"and the time to tear the tree down again are reported.\n"
+"\n"
+"Possible options:\n"
+"\n"
+"  --nodes, -n <count>    Number of files to create. Default: 10000000.\n"
+"  --per-dir, -p <count>  Number of files per directory. Default: 1000.\n"
+"\n";
+
+static double time_diff(const struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (double)(end.tv_sec - start->tv_sec) +
+		(double)(end.tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long count = 10000000, per_dir = 1000, i;
+	double t_build, t_post, t_cleanup;
+	struct timespec start;
+	struct rusage usage;
+	struct stat sb;
+	char path[128];
+	fstree_t fs;
+
+	for (;;) {
+		i = getopt_long(argc, argv, short_opts, long_opts, NULL);
+		if ((int)i == -1)
+			break;
+
+		switch (i) {
+		case 'n':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			per_dir = strtoul(optarg, NULL, 10);
+			break;
+		case 'h':
+			fputs(help_string, stdout);
+			return EXIT_SUCCESS;
+		default:
+			fputs("Try `fstree_benchmark --help' for more "
+			      "information.\n", stderr);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (per_dir == 0)
+		per_dir = 1;
+
+	if (fstree_init(&fs, NULL))
+		return EXIT_FAILURE;
+
+	memset(&sb, 0, sizeof(sb));
+	sb.st_mode = S_IFREG | 0644;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < count; ++i) {
+		snprintf(path, sizeof(path), "dir%lu/file%lu",
+			 i / per_dir, i);
+
+		if (fstree_add_generic(&fs, path, &sb, path) == NULL) {
+			perror(path);
+			fstree_cleanup(&fs);
+			return EXIT_FAILURE;
+		}
+	}
+
+	t_build = time_diff(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (fstree_post_process(&fs)) {
+		fstree_cleanup(&fs);
+		return EXIT_FAILURE;
+	}
+
+	t_post = time_diff(&start);
+	getrusage(RUSAGE_SELF, &usage);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	fstree_cleanup(&fs);
+	t_cleanup = time_diff(&start);
+
+	printf("%lu files, %lu per directory\n", count, per_dir);
+	printf("build: %.3f seconds, post processing: %.3f seconds\n",
+	       t_build, t_post);
+	printf("cleanup: %.3f seconds\n", t_cleanup);
+	printf("peak RSS: %ld KiB\n", (long)usage.ru_maxrss);
+	return EXIT_SUCCESS;
+}
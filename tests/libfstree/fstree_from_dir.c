@@ -9,6 +9,12 @@
 #include "fstree.h"
 #include "../test.h"
 
+#if !defined(_WIN32) && !defined(__WINDOWS__)
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
 static void check_hierarchy(tree_node_t *root, bool recursive)
 {
 	tree_node_t *n, *m;
@@ -313,7 +319,178 @@ static void check_hierarchy(tree_node_t *root, bool recursive)
 	TEST_NULL(n);
 }
 
-int main(void)
+static int scan(fstree_t *fs, tree_node_t *root, unsigned int flags,
+		size_t num_jobs)
+{
+	if (num_jobs == 0)
+		return fstree_from_dir(fs, root, TEST_PATH, NULL, NULL, flags);
+
+	return fstree_from_subdir_parallel(fs, root, TEST_PATH, NULL, NULL,
+					   NULL, NULL, flags, num_jobs);
+}
+
+static int count_xattr_cb(void *user, fstree_t *fs, tree_node_t *node,
+			  const dir_scan_xattr_t *xattr, size_t count)
+{
+	size_t i;
+	(void)fs;
+
+	for (i = 0; i < count; ++i)
+		TEST_NOT_NULL(xattr[i].key);
+
+	node->xattr_idx = 42;
+	*((size_t *)user) += 1;
+	return 0;
+}
+
+static size_t count_nodes(const tree_node_t *n)
+{
+	size_t count = 1;
+
+	TEST_EQUAL_UI(n->xattr_idx, 42);
+
+	if (S_ISDIR(n->mode)) {
+		for (n = n->data.dir.children; n != NULL; n = n->next)
+			count += count_nodes(n);
+	}
+
+	return count;
+}
+
+static void test_xattr_cb(size_t num_jobs)
+{
+	size_t calls = 0;
+	fstree_t fs;
+
+	TEST_ASSERT(fstree_init(&fs, NULL) == 0);
+	TEST_ASSERT(fstree_from_subdir_parallel(&fs, fs.root, TEST_PATH,
+						NULL, NULL, count_xattr_cb,
+						&calls, DIR_SCAN_READ_XATTR,
+						num_jobs) == 0);
+
+	fstree_post_process(&fs);
+	check_hierarchy(fs.root, true);
+	TEST_EQUAL_UI(calls, count_nodes(fs.root));
+	fstree_cleanup(&fs);
+}
+
+#if !defined(_WIN32) && !defined(__WINDOWS__)
+/* the full path of the deepest directory is well past PATH_MAX */
+#define DEEP_LEVELS (30)
+#define DEEP_NAME_LEN (200)
+
+static void deep_name(char *buffer, int level)
+{
+	memset(buffer, 'x', DEEP_NAME_LEN);
+	buffer[0] = '0' + level / 10;
+	buffer[1] = '0' + level % 10;
+	buffer[DEEP_NAME_LEN] = '\0';
+}
+
+static void make_deep_tree(const char *path)
+{
+	char name[DEEP_NAME_LEN + 1];
+	int i, fd, next;
+
+	fd = open(path, O_DIRECTORY | O_RDONLY);
+	TEST_ASSERT(fd >= 0);
+
+	for (i = 0; i < DEEP_LEVELS; ++i) {
+		deep_name(name, i);
+		TEST_ASSERT(mkdirat(fd, name, 0755) == 0);
+
+		next = openat(fd, name, O_DIRECTORY | O_RDONLY);
+		TEST_ASSERT(next >= 0);
+		close(fd);
+		fd = next;
+	}
+
+	close(fd);
+}
+
+static void remove_deep_tree(const char *path)
+{
+	char name[DEEP_NAME_LEN + 1];
+	int i, fds[DEEP_LEVELS];
+
+	fds[0] = open(path, O_DIRECTORY | O_RDONLY);
+	TEST_ASSERT(fds[0] >= 0);
+
+	for (i = 1; i < DEEP_LEVELS; ++i) {
+		deep_name(name, i - 1);
+		fds[i] = openat(fds[i - 1], name, O_DIRECTORY | O_RDONLY);
+		TEST_ASSERT(fds[i] >= 0);
+	}
+
+	for (i = DEEP_LEVELS - 1; i >= 0; --i) {
+		deep_name(name, i);
+		TEST_ASSERT(unlinkat(fds[i], name, AT_REMOVEDIR) == 0);
+		close(fds[i]);
+	}
+
+	TEST_ASSERT(rmdir(path) == 0);
+}
+
+static void check_deep_tree(const tree_node_t *n, int level)
+{
+	char name[DEEP_NAME_LEN + 1];
+
+	for (; level < DEEP_LEVELS; ++level) {
+		deep_name(name, level);
+
+		n = n->data.dir.children;
+		TEST_NOT_NULL(n);
+		TEST_STR_EQUAL(n->name, name);
+		TEST_ASSERT(S_ISDIR(n->mode));
+		TEST_NULL(n->next);
+	}
+
+	TEST_NULL(n->data.dir.children);
+}
+
+static void test_deep_tree(void)
+{
+	static const size_t num_jobs[] = { 0, 1, 4 };
+	char path[] = "fstree_deep.XXXXXX";
+	char name[DEEP_NAME_LEN + 1];
+	fstree_t fs;
+	size_t i;
+	int ret;
+
+	TEST_NOT_NULL(mkdtemp(path));
+	make_deep_tree(path);
+
+	for (i = 0; i < sizeof(num_jobs) / sizeof(num_jobs[0]); ++i) {
+		TEST_ASSERT(fstree_init(&fs, NULL) == 0);
+
+		if (num_jobs[i] == 0) {
+			ret = fstree_from_dir(&fs, fs.root, path,
+					      NULL, NULL, 0);
+		} else {
+			ret = fstree_from_subdir_parallel(&fs, fs.root, path,
+							  NULL, NULL, NULL,
+							  NULL, 0, num_jobs[i]);
+		}
+
+		TEST_EQUAL_I(ret, 0);
+		check_deep_tree(fs.root, 0);
+		fstree_cleanup(&fs);
+	}
+
+	/* starting in a sub directory */
+	deep_name(name, 0);
+
+	TEST_ASSERT(fstree_init(&fs, NULL) == 0);
+	TEST_ASSERT(fstree_from_subdir_parallel(&fs, fs.root, path, name,
+						NULL, NULL, NULL, 0, 4) == 0);
+	check_deep_tree(fs.root, 1);
+	fstree_cleanup(&fs);
+
+	remove_deep_tree(path);
+}
+#endif
+
+static void run_tests(size_t num_jobs)
 {
 	struct stat sb;
 	tree_node_t *n;
@@ -321,8 +498,7 @@ int main(void)
 
 	/* recursively scan into root */
 	TEST_ASSERT(fstree_init(&fs, NULL) == 0);
-	TEST_ASSERT(fstree_from_dir(&fs, fs.root, TEST_PATH,
-				    NULL, NULL, 0) == 0);
+	TEST_ASSERT(scan(&fs, fs.root, 0, num_jobs) == 0);
 
 	fstree_post_process(&fs);
 	check_hierarchy(fs.root, true);
@@ -330,8 +506,7 @@ int main(void)
 
 	/* non-recursively scan into root */
 	TEST_ASSERT(fstree_init(&fs, NULL) == 0);
-	TEST_ASSERT(fstree_from_dir(&fs, fs.root, TEST_PATH, NULL, NULL,
-				    DIR_SCAN_NO_RECURSION) == 0);
+	TEST_ASSERT(scan(&fs, fs.root, DIR_SCAN_NO_RECURSION, num_jobs) == 0);
 
 	fstree_post_process(&fs);
 	check_hierarchy(fs.root, false);
@@ -343,11 +518,11 @@ int main(void)
 
 	TEST_ASSERT(fstree_init(&fs, NULL) == 0);
 
-	n = fstree_mknode(fs.root, "foodir", 6, NULL, &sb);
+	n = fstree_mknode(&fs, fs.root, "foodir", 6, NULL, &sb);
 	TEST_NOT_NULL(n);
 	fs.root->data.dir.children = n;
 
-	TEST_ASSERT(fstree_from_dir(&fs, n, TEST_PATH, NULL, NULL, 0) == 0);
+	TEST_ASSERT(scan(&fs, n, 0, num_jobs) == 0);
 
 	TEST_ASSERT(fs.root->data.dir.children == n);
 	TEST_NULL(n->next);
@@ -362,12 +537,11 @@ int main(void)
 
 	TEST_ASSERT(fstree_init(&fs, NULL) == 0);
 
-	n = fstree_mknode(fs.root, "foodir", 6, NULL, &sb);
+	n = fstree_mknode(&fs, fs.root, "foodir", 6, NULL, &sb);
 	TEST_NOT_NULL(n);
 	fs.root->data.dir.children = n;
 
-	TEST_ASSERT(fstree_from_dir(&fs, n, TEST_PATH, NULL, NULL,
-				    DIR_SCAN_NO_RECURSION) == 0);
+	TEST_ASSERT(scan(&fs, n, DIR_SCAN_NO_RECURSION, num_jobs) == 0);
 
 	TEST_ASSERT(fs.root->data.dir.children == n);
 	TEST_NULL(n->next);
@@ -375,6 +549,22 @@ int main(void)
 	fstree_post_process(&fs);
 	check_hierarchy(n, false);
 	fstree_cleanup(&fs);
+}
 
+int main(void)
+{
+	/* serial scanner, then the parallel one with 1 and 4 workers */
+	run_tests(0);
+	run_tests(1);
+	run_tests(4);
+
+	/* every kept node, including the root, goes through the callback */
+	test_xattr_cb(1);
+	test_xattr_cb(4);
+
+#if !defined(_WIN32) && !defined(__WINDOWS__)
+	/* scanning must not depend on the length of the full path */
+	test_deep_tree();
+#endif
 	return EXIT_SUCCESS;
 }
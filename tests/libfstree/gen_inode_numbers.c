@@ -9,14 +9,15 @@
 #include "fstree.h"
 #include "../test.h"
 
-static tree_node_t *gen_node(tree_node_t *parent, const char *name)
+static tree_node_t *gen_node(fstree_t *fs, tree_node_t *parent,
+			    const char *name)
 {
 	struct stat sb;
 
 	memset(&sb, 0, sizeof(sb));
 	sb.st_mode = S_IFDIR | 0755;
 
-	return fstree_mknode(parent, name, strlen(name), NULL, &sb);
+	return fstree_mknode(fs, parent, name, strlen(name), NULL, &sb);
 }
 
 static void check_children_before_root(tree_node_t *root)
@@ -59,24 +60,24 @@ int main(void)
 	// tree with 2 levels under root, fan out 3
 	TEST_ASSERT(fstree_init(&fs, NULL) == 0);
 
-	a = gen_node(fs.root, "a");
-	b = gen_node(fs.root, "b");
-	c = gen_node(fs.root, "c");
+	a = gen_node(&fs, fs.root, "a");
+	b = gen_node(&fs, fs.root, "b");
+	c = gen_node(&fs, fs.root, "c");
 	TEST_NOT_NULL(a);
 	TEST_NOT_NULL(b);
 	TEST_NOT_NULL(c);
 
-	TEST_NOT_NULL(gen_node(a, "a_a"));
-	TEST_NOT_NULL(gen_node(a, "a_b"));
-	TEST_NOT_NULL(gen_node(a, "a_c"));
+	TEST_NOT_NULL(gen_node(&fs, a, "a_a"));
+	TEST_NOT_NULL(gen_node(&fs, a, "a_b"));
+	TEST_NOT_NULL(gen_node(&fs, a, "a_c"));
 
-	TEST_NOT_NULL(gen_node(b, "b_a"));
-	TEST_NOT_NULL(gen_node(b, "b_b"));
-	TEST_NOT_NULL(gen_node(b, "b_c"));
+	TEST_NOT_NULL(gen_node(&fs, b, "b_a"));
+	TEST_NOT_NULL(gen_node(&fs, b, "b_b"));
+	TEST_NOT_NULL(gen_node(&fs, b, "b_c"));
 
-	TEST_NOT_NULL(gen_node(c, "c_a"));
-	TEST_NOT_NULL(gen_node(c, "c_b"));
-	TEST_NOT_NULL(gen_node(c, "c_c"));
+	TEST_NOT_NULL(gen_node(&fs, c, "c_a"));
+	TEST_NOT_NULL(gen_node(&fs, c, "c_b"));
+	TEST_NOT_NULL(gen_node(&fs, c, "c_c"));
 
 	fstree_post_process(&fs);
 	TEST_EQUAL_UI(fs.unique_inode_count, 13);
@@ -23,7 +23,7 @@ int main(void)
 	sb.st_rdev = 789;
 	sb.st_size = 4096;
 
-	root = fstree_mknode(NULL, "rootdir", 7, NULL, &sb);
+	root = fstree_mknode(NULL, NULL, "rootdir", 7, NULL, &sb);
 	TEST_EQUAL_UI(root->uid, sb.st_uid);
 	TEST_EQUAL_UI(root->gid, sb.st_gid);
 	TEST_EQUAL_UI(root->mode, sb.st_mode);
@@ -34,7 +34,7 @@ int main(void)
 	TEST_NULL(root->parent);
 	TEST_NULL(root->next);
 
-	a = fstree_mknode(root, "adir", 4, NULL, &sb);
+	a = fstree_mknode(NULL, root, "adir", 4, NULL, &sb);
 	TEST_ASSERT(a->parent == root);
 	TEST_NULL(a->next);
 	TEST_EQUAL_UI(a->link_count, 2);
@@ -43,7 +43,7 @@ int main(void)
 	TEST_NULL(root->parent);
 	TEST_NULL(root->next);
 
-	b = fstree_mknode(root, "bdir", 4, NULL, &sb);
+	b = fstree_mknode(NULL, root, "bdir", 4, NULL, &sb);
 	TEST_ASSERT(a->parent == root);
 	TEST_ASSERT(b->parent == root);
 	TEST_EQUAL_UI(b->link_count, 2);
@@ -24,7 +24,7 @@ int main(void)
 	sb.st_rdev = 789;
 	sb.st_size = 4096;
 
-	node = fstree_mknode(NULL, "filename", 8, "input", &sb);
+	node = fstree_mknode(NULL, NULL, "filename", 8, "input", &sb);
 	TEST_EQUAL_UI(node->uid, sb.st_uid);
 	TEST_EQUAL_UI(node->gid, sb.st_gid);
 	TEST_EQUAL_UI(node->mode, sb.st_mode);
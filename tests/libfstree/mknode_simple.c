@@ -23,7 +23,7 @@ int main(void)
 	sb.st_rdev = 789;
 	sb.st_size = 1337;
 
-	node = fstree_mknode(NULL, "sockfile", 8, NULL, &sb);
+	node = fstree_mknode(NULL, NULL, "sockfile", 8, NULL, &sb);
 	TEST_ASSERT((char *)node->name >= (char *)node->payload);
 	TEST_STR_EQUAL(node->name, "sockfile");
 	TEST_EQUAL_UI(node->uid, sb.st_uid);
@@ -43,7 +43,7 @@ int main(void)
 	sb.st_rdev = 789;
 	sb.st_size = 1337;
 
-	node = fstree_mknode(NULL, "fifo", 4, NULL, &sb);
+	node = fstree_mknode(NULL, NULL, "fifo", 4, NULL, &sb);
 	TEST_ASSERT((char *)node->name >= (char *)node->payload);
 	TEST_STR_EQUAL(node->name, "fifo");
 	TEST_EQUAL_UI(node->uid, sb.st_uid);
@@ -63,7 +63,7 @@ int main(void)
 	sb.st_rdev = 789;
 	sb.st_size = 1337;
 
-	node = fstree_mknode(NULL, "blkdev", 6, NULL, &sb);
+	node = fstree_mknode(NULL, NULL, "blkdev", 6, NULL, &sb);
 	TEST_ASSERT((char *)node->name >= (char *)node->payload);
 	TEST_STR_EQUAL(node->name, "blkdev");
 	TEST_EQUAL_UI(node->uid, sb.st_uid);
@@ -82,7 +82,7 @@ int main(void)
 	sb.st_rdev = 789;
 	sb.st_size = 1337;
 
-	node = fstree_mknode(NULL, "chardev", 7, NULL, &sb);
+	node = fstree_mknode(NULL, NULL, "chardev", 7, NULL, &sb);
 	TEST_ASSERT((char *)node->name >= (char *)node->payload);
 	TEST_STR_EQUAL(node->name, "chardev");
 	TEST_EQUAL_UI(node->uid, sb.st_uid);
@@ -23,7 +23,7 @@ int main(void)
 	sb.st_rdev = 789;
 	sb.st_size = 1337;
 
-	node = fstree_mknode(NULL, "symlink", 7, "target", &sb);
+	node = fstree_mknode(NULL, NULL, "symlink", 7, "target", &sb);
 	TEST_EQUAL_UI(node->uid, sb.st_uid);
 	TEST_EQUAL_UI(node->gid, sb.st_gid);
 	TEST_EQUAL_UI(node->mode, S_IFLNK | 0777);
@@ -36,7 +36,7 @@ int main(void)
 	TEST_STR_EQUAL(node->data.target, "target");
 	free(node);
 
-	node = fstree_mknode(NULL, "symlink", 7, "", &sb);
+	node = fstree_mknode(NULL, NULL, "symlink", 7, "", &sb);
 	TEST_EQUAL_UI(node->uid, sb.st_uid);
 	TEST_EQUAL_UI(node->gid, sb.st_gid);
 	TEST_EQUAL_UI(node->mode, S_IFLNK | 0777);
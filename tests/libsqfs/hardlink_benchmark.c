@@ -0,0 +1,284 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * hardlink_benchmark.c
+ *
+ * Copyright (C) 2021 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "config.h"
+#include "compat.h"
+#include "common.h"
+#include "hash_table.h"
+
+#include <stdlib.h>
+#include <getopt.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+static struct option long_opts[] = {
+	{ "links", required_argument, NULL, 'l' },
+	{ "per-inode", required_argument, NULL, 'p' },
+	{ "list-lookups", required_argument, NULL, 'c' },
+	{ "version", no_argument, NULL, 'V' },
+	{ "help", no_argument, NULL, 'h' },
+	{ NULL, 0, NULL, 0 },
+};
+
+static const char *short_opts = "l:p:c:hV";
+
+static const char *help_string =
+"Usage: hardlink_benchmark [OPTIONS...]\n"
+"\n"
+"Builds a synthetic file system tree in memory where groups of files share\n"
+"the same inode, runs hard link detection on it and then resolves the link\n"
+"target of every file, like sqfs2tar does when writing the tree. The lookup\n"
+"is timed once by walking the hard link list and once using the hash table\n"
+"index. Because the list walk is quadratic, only a limited number of list\n"
+"lookups is timed and the total is extrapolated from that.\n"
+"\n"
+"Possible options:\n"
+"\n"
+"  --links, -l <count>         Number of hard links to create.\n"
+"                              Default: 1000000.\n"
+"  --per-inode, -p <count>     Number of names per inode. Default: 2.\n"
+"  --list-lookups, -c <count>  Number of list lookups to time.\n"
+"                              Default: 200.\n"
+"\n";
+
+#define FILES_PER_DIR (1000)
+
+static double time_diff(const struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (double)(end.tv_sec - start->tv_sec) +
+		(double)(end.tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+static sqfs_tree_node_t *create_node(sqfs_tree_node_t *parent,
+				     const char *name, sqfs_u16 mode,
+				     sqfs_u32 inum)
+{
+	sqfs_tree_node_t *n = calloc(1, sizeof(*n) + strlen(name) + 1);
+
+	if (n == NULL)
+		return NULL;
+
+	n->inode = calloc(1, sizeof(*n->inode));
+	if (n->inode == NULL) {
+		free(n);
+		return NULL;
+	}
+
+	n->inode->base.mode = mode;
+	n->inode->base.inode_number = inum;
+	strcpy((char *)n->name, name);
+
+	if (parent != NULL) {
+		n->parent = parent;
+		n->next = parent->children;
+		parent->children = n;
+	}
+
+	return n;
+}
+
+static void destroy_tree(sqfs_tree_node_t *n)
+{
+	sqfs_tree_node_t *it;
+
+	while (n->children != NULL) {
+		it = n->children;
+		n->children = it->next;
+		destroy_tree(it);
+	}
+
+	free(n->inode);
+	free(n);
+}
+
+static sqfs_tree_node_t *create_tree(long num_files, long per_inode)
+{
+	sqfs_tree_node_t *root, *dir = NULL;
+	sqfs_u32 inum = 1;
+	char name[32];
+	long i;
+
+	root = create_node(NULL, "", S_IFDIR | 0755, inum++);
+	if (root == NULL)
+		return NULL;
+
+	for (i = 0; i < num_files; ++i) {
+		if ((i % FILES_PER_DIR) == 0) {
+			sprintf(name, "dir%ld", i / FILES_PER_DIR);
+
+			dir = create_node(root, name, S_IFDIR | 0755, inum++);
+			if (dir == NULL)
+				goto fail;
+		}
+
+		sprintf(name, "file%ld", i);
+
+		/* spread the names of an inode over different directories */
+		if (create_node(dir, name, S_IFREG | 0644,
+				0x100000 + (sqfs_u32)(i % (num_files /
+							   per_inode))) == NULL) {
+			goto fail;
+		}
+	}
+
+	return root;
+fail:
+	destroy_tree(root);
+	return NULL;
+}
+
+static sqfs_hard_link_t *find_in_list(sqfs_hard_link_t *links, sqfs_u32 inum)
+{
+	for (; links != NULL; links = links->next) {
+		if (links->inode_number == inum)
+			return links;
+	}
+
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	long i, num_links = 1000000, per_inode = 2, list_lookups = 200;
+	sqfs_tree_node_t *root, *dir, *n;
+	sqfs_hard_link_t *links, *lnk;
+	struct hash_table *index;
+	struct timespec start;
+	long count, found, total;
+	double seconds;
+	int status = EXIT_FAILURE;
+
+	for (;;) {
+		i = getopt_long(argc, argv, short_opts, long_opts, NULL);
+		if (i == -1)
+			break;
+
+		switch (i) {
+		case 'l':
+			num_links = strtol(optarg, NULL, 0);
+			break;
+		case 'p':
+			per_inode = strtol(optarg, NULL, 0);
+			break;
+		case 'c':
+			list_lookups = strtol(optarg, NULL, 0);
+			break;
+		case 'h':
+			fputs(help_string, stdout);
+			return EXIT_SUCCESS;
+		case 'V':
+			print_version("hardlink_benchmark");
+			return EXIT_SUCCESS;
+		default:
+			goto fail_arg;
+		}
+	}
+
+	if (num_links <= 0 || per_inode < 2 || list_lookups < 0) {
+		fputs("Link count must be > 0 and at least 2 names are "
+		      "needed per inode.\n", stderr);
+		goto fail_arg;
+	}
+
+	count = num_links / (per_inode - 1) * per_inode;
+
+	root = create_tree(count, per_inode);
+	if (root == NULL) {
+		fputs("out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	links = NULL;
+
+	if (sqfs_tree_find_hard_links(root, &links))
+		goto out_tree;
+
+	printf("detecting hard links: %.3f seconds\n", time_diff(&start));
+
+	/* build the index */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	index = sqfs_hard_link_index_create();
+	if (index == NULL)
+		goto out_links;
+
+	for (lnk = links; lnk != NULL; lnk = lnk->next) {
+		if (sqfs_hard_link_index_add(index, lnk))
+			goto out_index;
+	}
+
+	printf("building index: %.3f seconds\n", time_diff(&start));
+
+	/* lookup through the index */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	count = 0;
+	found = 0;
+
+	for (dir = root->children; dir != NULL; dir = dir->next) {
+		for (n = dir->children; n != NULL; n = n->next) {
+			lnk = sqfs_hard_link_index_find(index,
+						n->inode->base.inode_number);
+			count += 1;
+			found += (lnk != NULL);
+		}
+	}
+
+	seconds = time_diff(&start);
+	printf("index lookup: %ld files, %ld links, %.3f seconds, "
+	       "%.1f ns per lookup\n", count, found, seconds,
+	       count > 0 ? seconds * 1e9 / count : 0.0);
+	total = count;
+
+	/* lookup by walking the list */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	count = 0;
+	found = 0;
+
+	for (dir = root->children; dir != NULL; dir = dir->next) {
+		for (n = dir->children; n != NULL; n = n->next) {
+			if (count >= list_lookups)
+				break;
+
+			lnk = find_in_list(links, n->inode->base.inode_number);
+			count += 1;
+			found += (lnk != NULL);
+		}
+	}
+
+	seconds = time_diff(&start);
+	printf("list lookup: %ld files, %ld links, %.3f seconds, "
+	       "%.1f ns per lookup\n", count, found, seconds,
+	       count > 0 ? seconds * 1e9 / count : 0.0);
+
+	if (count > 0 && count < total) {
+		printf("list lookup: %.1f seconds extrapolated for %ld files\n",
+		       seconds / count * total, total);
+	}
+
+	status = EXIT_SUCCESS;
+out_index:
+	sqfs_hard_link_index_destroy(index);
+out_links:
+	while (links != NULL) {
+		lnk = links;
+		links = links->next;
+		free(lnk->target);
+		free(lnk);
+	}
+out_tree:
+	destroy_tree(root);
+	return status;
+fail_arg:
+	fputs("Try `hardlink_benchmark --help' for more information.\n",
+	      stderr);
+	return EXIT_FAILURE;
+}
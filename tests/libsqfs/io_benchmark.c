@@ -0,0 +1,182 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * io_benchmark.c
+ *
+ * Copyright (C) 2021 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "config.h"
+#include "compat.h"
+#include "common.h"
+
+#include "sqfs/io.h"
+
+#include <stdlib.h>
+#include <getopt.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+static struct option long_opts[] = {
+	{ "block-size", required_argument, NULL, 'b' },
+	{ "block-count", required_argument, NULL, 'c' },
+	{ "async", no_argument, NULL, 'a' },
+	{ "version", no_argument, NULL, 'V' },
+	{ "help", no_argument, NULL, 'h' },
+	{ NULL, 0, NULL, 0 },
+};
+
+static const char *short_opts = "b:c:ahV";
+
+static const char *help_string =
+"Usage: io_benchmark [OPTIONS...] <file>\n"
+"\n"
+"Writes a number of blocks to a file through the sqfs_file_t interface,\n"
+"reads them back and reports the throughput of both passes. The file is\n"
+"overwritten if it exists. To compare backends on a specific filesystem\n"
+"(e.g. tmpfs vs. NVMe), place the file there. To compare syscall counts,\n"
+"run the benchmark through `strace -c -f`.\n"
+"\n"
+"Possible options:\n"
+"\n"
+"  --block-size, -b <size>   Size of each block in bytes. Default: 131072.\n"
+"  --block-count, -c <count> How many blocks to write. Default: 8192.\n"
+"  --async, -a               Open the file with SQFS_FILE_OPEN_ASYNC_IO.\n"
+"\n";
+
+static double time_diff(const struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (double)(end.tv_sec - start->tv_sec) +
+		(double)(end.tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+static void print_result(const char *pass, double seconds, sqfs_u64 total)
+{
+	double mib = (double)total / (1024.0 * 1024.0);
+
+	printf("%s: %.1f MiB in %.3f seconds, %.1f MiB/s\n",
+	       pass, mib, seconds, seconds > 0.0 ? mib / seconds : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+	long i, block_size = 131072, block_count = 8192;
+	sqfs_u32 flags = SQFS_FILE_OPEN_OVERWRITE;
+	struct timespec start;
+	const char *filename;
+	sqfs_file_t *file;
+	sqfs_u8 *buffer;
+	int ret;
+
+	for (;;) {
+		i = getopt_long(argc, argv, short_opts, long_opts, NULL);
+		if (i == -1)
+			break;
+
+		switch (i) {
+		case 'b':
+			block_size = strtol(optarg, NULL, 0);
+			break;
+		case 'c':
+			block_count = strtol(optarg, NULL, 0);
+			break;
+		case 'a':
+			flags |= SQFS_FILE_OPEN_ASYNC_IO;
+			break;
+		case 'h':
+			fputs(help_string, stdout);
+			return EXIT_SUCCESS;
+		case 'V':
+			print_version("io_benchmark");
+			return EXIT_SUCCESS;
+		default:
+			goto fail_arg;
+		}
+	}
+
+	if (block_size <= 0 || block_count <= 0) {
+		fputs("Block size and count must be > 0.\n", stderr);
+		goto fail_arg;
+	}
+
+	if (optind >= argc) {
+		fputs("No output file specified.\n", stderr);
+		goto fail_arg;
+	}
+
+	filename = argv[optind];
+
+	buffer = malloc(block_size);
+	if (buffer == NULL) {
+		perror("allocating block buffer");
+		return EXIT_FAILURE;
+	}
+
+	file = sqfs_open_file(filename, flags);
+	if (file == NULL) {
+		perror(filename);
+		free(buffer);
+		return EXIT_FAILURE;
+	}
+
+	/* write pass */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < block_count; ++i) {
+		memset(buffer, i & 0xFF, block_size);
+
+		ret = file->write_at(file, file->get_size(file),
+				     buffer, block_size);
+		if (ret) {
+			sqfs_perror(filename, "writing block", ret);
+			goto fail;
+		}
+	}
+
+	if (file->flush != NULL) {
+		ret = file->flush(file);
+		if (ret) {
+			sqfs_perror(filename, "flushing file", ret);
+			goto fail;
+		}
+	}
+
+	print_result("write", time_diff(&start),
+		     (sqfs_u64)block_size * block_count);
+
+	/* read pass */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < block_count; ++i) {
+		ret = file->read_at(file, (sqfs_u64)i * block_size,
+				    buffer, block_size);
+		if (ret) {
+			sqfs_perror(filename, "reading block", ret);
+			goto fail;
+		}
+
+		if (buffer[0] != (i & 0xFF) ||
+		    buffer[block_size - 1] != (i & 0xFF)) {
+			fprintf(stderr, "%s: block %ld: data mismatch\n",
+				filename, i);
+			goto fail;
+		}
+	}
+
+	print_result("read", time_diff(&start),
+		     (sqfs_u64)block_size * block_count);
+
+	sqfs_destroy(file);
+	free(buffer);
+	return EXIT_SUCCESS;
+fail:
+	sqfs_destroy(file);
+	free(buffer);
+	return EXIT_FAILURE;
+fail_arg:
+	fputs("Try `io_benchmark --help' for more information.\n", stderr);
+	return EXIT_FAILURE;
+}
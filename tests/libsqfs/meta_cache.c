@@ -0,0 +1,168 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * meta_cache.c
+ *
+ * Copyright (C) 2021 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "config.h"
+#include "compat.h"
+#include "../test.h"
+
+#include "sqfs/meta_reader.h"
+#include "sqfs/compressor.h"
+#include "sqfs/error.h"
+#include "sqfs/block.h"
+#include "sqfs/io.h"
+
+#define NUM_BLOCKS (4)
+#define BLOCK_DATA_SIZE (SQFS_META_BLOCK_SIZE)
+
+static sqfs_u8 file_data[NUM_BLOCKS * (BLOCK_DATA_SIZE + 2)];
+static size_t uncompress_count = 0;
+
+static int dummy_read_at(sqfs_file_t *file, sqfs_u64 offset,
+			 void *buffer, size_t size)
+{
+	(void)file;
+
+	if (offset >= sizeof(file_data))
+		return SQFS_ERROR_OUT_OF_BOUNDS;
+
+	if (size > (sizeof(file_data) - offset))
+		return SQFS_ERROR_OUT_OF_BOUNDS;
+
+	memcpy(buffer, file_data + offset, size);
+	return 0;
+}
+
+static sqfs_u64 dummy_get_size(const sqfs_file_t *file)
+{
+	(void)file;
+	return sizeof(file_data);
+}
+
+static sqfs_s32 dummy_uncompress(sqfs_compressor_t *cmp, const sqfs_u8 *in,
+				 sqfs_u32 size, sqfs_u8 *out, sqfs_u32 outsize)
+{
+	(void)cmp;
+	if (outsize < size)
+		return 0;
+	memcpy(out, in, size);
+	uncompress_count += 1;
+	return size;
+}
+
+static sqfs_file_t dummy_file = {
+	{ NULL, NULL },
+	dummy_read_at,
+	NULL,
+	dummy_get_size,
+	NULL,
+};
+
+static sqfs_compressor_t dummy_uncompressor = {
+	{ NULL, NULL },
+	NULL,
+	NULL,
+	NULL,
+	dummy_uncompress,
+};
+
+static sqfs_u64 block_start(size_t i)
+{
+	return i * (BLOCK_DATA_SIZE + 2);
+}
+
+static void check_block(sqfs_meta_reader_t *m, size_t i)
+{
+	sqfs_u8 buffer[BLOCK_DATA_SIZE];
+	size_t j;
+	int ret;
+
+	ret = sqfs_meta_reader_seek(m, block_start(i), 0);
+	TEST_EQUAL_I(ret, 0);
+
+	ret = sqfs_meta_reader_read(m, buffer, sizeof(buffer));
+	TEST_EQUAL_I(ret, 0);
+
+	for (j = 0; j < sizeof(buffer); ++j)
+		TEST_EQUAL_UI(buffer[j], (i * 7 + j) & 0xFF);
+}
+
+int main(void)
+{
+	sqfs_meta_reader_t *a, *b, *copy;
+	sqfs_u64 hits, misses;
+	sqfs_meta_cache_t *cache;
+	sqfs_u16 hdr;
+	size_t i, j;
+
+	/* generate a few "compressed" blocks */
+	for (i = 0; i < NUM_BLOCKS; ++i) {
+		hdr = htole16(BLOCK_DATA_SIZE);
+		memcpy(file_data + block_start(i), &hdr, 2);
+
+		for (j = 0; j < BLOCK_DATA_SIZE; ++j)
+			file_data[block_start(i) + 2 + j] = (i * 7 + j) & 0xFF;
+	}
+
+	/* small enough to only fit 2 blocks */
+	cache = sqfs_meta_cache_create(2 * (BLOCK_DATA_SIZE + 128), 0);
+	TEST_NOT_NULL(cache);
+
+	a = sqfs_meta_reader_create(&dummy_file, &dummy_uncompressor,
+				    0, sizeof(file_data));
+	TEST_NOT_NULL(a);
+
+	b = sqfs_meta_reader_create(&dummy_file, &dummy_uncompressor,
+				    0, sizeof(file_data));
+	TEST_NOT_NULL(b);
+
+	sqfs_meta_reader_set_cache(a, cache);
+	sqfs_meta_reader_set_cache(b, cache);
+	sqfs_destroy(cache);
+
+	/* a block loaded by one reader is reused by the other one */
+	check_block(a, 0);
+	TEST_EQUAL_UI(uncompress_count, 1);
+
+	check_block(b, 0);
+	TEST_EQUAL_UI(uncompress_count, 1);
+
+	/* copies share the cache */
+	copy = sqfs_copy(a);
+	TEST_NOT_NULL(copy);
+
+	check_block(copy, 1);
+	TEST_EQUAL_UI(uncompress_count, 2);
+
+	check_block(b, 1);
+	TEST_EQUAL_UI(uncompress_count, 2);
+
+	sqfs_destroy(copy);
+
+	/* touch block 0, so block 1 is the least recently used one */
+	check_block(b, 0);
+	TEST_EQUAL_UI(uncompress_count, 2);
+
+	check_block(a, 2);
+	TEST_EQUAL_UI(uncompress_count, 3);
+
+	check_block(a, 0);
+	TEST_EQUAL_UI(uncompress_count, 3);
+
+	check_block(b, 1);
+	TEST_EQUAL_UI(uncompress_count, 4);
+
+	sqfs_meta_cache_get_stats(cache, &hits, &misses);
+	TEST_EQUAL_UI(hits, 4);
+	TEST_EQUAL_UI(misses, 4);
+
+	/* reading past the last block must still fail */
+	TEST_EQUAL_I(sqfs_meta_reader_seek(a, sizeof(file_data), 0),
+		     SQFS_ERROR_OUT_OF_BOUNDS);
+
+	sqfs_destroy(a);
+	sqfs_destroy(b);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,258 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * tree_benchmark.c
+ *
+ * Copyright (C) 2021 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "config.h"
+#include "compat.h"
+#include "common.h"
+
+#include <sys/resource.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+static struct option long_opts[] = {
+	{ "full", no_argument, NULL, 'f' },
+	{ "version", no_argument, NULL, 'V' },
+	{ "help", no_argument, NULL, 'h' },
+	{ NULL, 0, NULL, 0 },
+};
+
+static const char *short_opts = "fhV";
+
+static const char *help_string =
+"Usage: tree_benchmark [OPTIONS...] <squashfs-file>\n"
+"\n"
+"Walks the entire directory hierarchy of a SquashFS image and assembles the\n"
+"path of every node, like rdsquashfs --describe does. By default, the tree\n"
+"is streamed through a tree iterator. The time until the first node is\n"
+"available, the total time and the peak resident set size are reported.\n"
+"\n"
+"Because the peak RSS is a per process value, only one mode is measured per\n"
+"run. Run the benchmark once with and once without --full to compare them.\n"
+"\n"
+"Possible options:\n"
+"\n"
+"  --full, -f    Load the whole hierarchy into memory first, using\n"
+"                sqfs_dir_reader_get_full_hierarchy.\n"
+"\n";
+
+typedef struct {
+	struct timespec start;
+	double first;
+	size_t count;
+	sqfs_u64 path_bytes;
+} stats_t;
+
+static double time_diff(const struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (double)(end.tv_sec - start->tv_sec) +
+		(double)(end.tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+static int visit(stats_t *st, const sqfs_tree_node_t *n)
+{
+	char *path = sqfs_tree_node_get_path(n);
+
+	if (path == NULL) {
+		perror("assembling node path");
+		return -1;
+	}
+
+	if (st->count == 0)
+		st->first = time_diff(&st->start);
+
+	st->count += 1;
+	st->path_bytes += strlen(path);
+	free(path);
+	return 0;
+}
+
+static int visit_tree(stats_t *st, const sqfs_tree_node_t *n)
+{
+	if (visit(st, n))
+		return -1;
+
+	for (n = n->children; n != NULL; n = n->next) {
+		if (visit_tree(st, n))
+			return -1;
+	}
+
+	return 0;
+}
+
+static int walk_full(stats_t *st, sqfs_dir_reader_t *dr,
+		     const sqfs_id_table_t *idtbl)
+{
+	sqfs_tree_node_t *root;
+	int ret;
+
+	ret = sqfs_dir_reader_get_full_hierarchy(dr, idtbl, NULL, 0, &root);
+	if (ret) {
+		sqfs_perror(NULL, "reading filesystem tree", ret);
+		return -1;
+	}
+
+	ret = visit_tree(st, root);
+	sqfs_dir_tree_destroy(root);
+	return ret;
+}
+
+static int walk_stream(stats_t *st, sqfs_dir_reader_t *dr,
+		       const sqfs_id_table_t *idtbl)
+{
+	const sqfs_tree_node_t *n;
+	sqfs_tree_iterator_t *it;
+	int ret;
+
+	ret = sqfs_tree_iterator_create(dr, idtbl, NULL, 0, &it);
+	if (ret)
+		goto fail;
+
+	for (;;) {
+		ret = sqfs_tree_iterator_next(it, &n);
+		if (ret > 0)
+			break;
+		if (ret < 0) {
+			sqfs_destroy(it);
+			goto fail;
+		}
+
+		if (visit(st, n)) {
+			sqfs_destroy(it);
+			return -1;
+		}
+	}
+
+	sqfs_destroy(it);
+	return 0;
+fail:
+	sqfs_perror(NULL, "reading filesystem tree", ret);
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	int i, ret, status = EXIT_FAILURE;
+	sqfs_compressor_config_t cfg;
+	sqfs_dir_reader_t *dr = NULL;
+	sqfs_id_table_t *idtbl = NULL;
+	sqfs_compressor_t *cmp;
+	const char *filename;
+	struct rusage usage;
+	sqfs_super_t super;
+	sqfs_file_t *file;
+	bool full = false;
+	double total;
+	stats_t st;
+
+	for (;;) {
+		i = getopt_long(argc, argv, short_opts, long_opts, NULL);
+		if (i == -1)
+			break;
+
+		switch (i) {
+		case 'f':
+			full = true;
+			break;
+		case 'h':
+			fputs(help_string, stdout);
+			return EXIT_SUCCESS;
+		case 'V':
+			print_version("tree_benchmark");
+			return EXIT_SUCCESS;
+		default:
+			goto fail_arg;
+		}
+	}
+
+	if (optind >= argc) {
+		fputs("No image file specified.\n", stderr);
+		goto fail_arg;
+	}
+
+	filename = argv[optind];
+
+	file = sqfs_open_file(filename, SQFS_FILE_OPEN_READ_ONLY);
+	if (file == NULL) {
+		perror(filename);
+		return EXIT_FAILURE;
+	}
+
+	ret = sqfs_super_read(&super, file);
+	if (ret) {
+		sqfs_perror(filename, "reading super block", ret);
+		goto out_file;
+	}
+
+	sqfs_compressor_config_init(&cfg, super.compression_id,
+				    super.block_size,
+				    SQFS_COMP_FLAG_UNCOMPRESS);
+
+	ret = sqfs_compressor_create(&cfg, &cmp);
+	if (ret) {
+		sqfs_perror(filename, "creating compressor", ret);
+		goto out_file;
+	}
+
+	idtbl = sqfs_id_table_create(0);
+	if (idtbl == NULL) {
+		sqfs_perror(filename, "creating ID table", SQFS_ERROR_ALLOC);
+		goto out;
+	}
+
+	ret = sqfs_id_table_read(idtbl, file, &super, cmp);
+	if (ret) {
+		sqfs_perror(filename, "loading ID table", ret);
+		goto out;
+	}
+
+	dr = sqfs_dir_reader_create(&super, cmp, file, 0);
+	if (dr == NULL) {
+		sqfs_perror(filename, "creating dir reader",
+			    SQFS_ERROR_ALLOC);
+		goto out;
+	}
+
+	memset(&st, 0, sizeof(st));
+	clock_gettime(CLOCK_MONOTONIC, &st.start);
+
+	if (full) {
+		ret = walk_full(&st, dr, idtbl);
+	} else {
+		ret = walk_stream(&st, dr, idtbl);
+	}
+
+	if (ret)
+		goto out;
+
+	total = time_diff(&st.start);
+	getrusage(RUSAGE_SELF, &usage);
+
+	printf("%s: %lu nodes, %llu bytes of paths\n",
+	       full ? "full" : "stream", (unsigned long)st.count,
+	       (unsigned long long)st.path_bytes);
+	printf("first node after %.3f seconds, total %.3f seconds\n",
+	       st.first, total);
+	printf("peak RSS: %ld KiB\n", (long)usage.ru_maxrss);
+
+	status = EXIT_SUCCESS;
+out:
+	sqfs_destroy(dr);
+	sqfs_destroy(idtbl);
+	sqfs_destroy(cmp);
+out_file:
+	sqfs_destroy(file);
+	return status;
+fail_arg:
+	fputs("Try `tree_benchmark --help' for more information.\n", stderr);
+	return EXIT_FAILURE;
+}
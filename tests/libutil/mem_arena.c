@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * mem_arena.c
+ *
+ * Copyright (C) 2021 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "config.h"
+
+#include "mempool.h"
+#include "../test.h"
+
+static void check_zero(const unsigned char *ptr, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; ++i)
+		TEST_EQUAL_UI(ptr[i], 0);
+}
+
+int main(void)
+{
+	unsigned char *ptr, *last = NULL;
+	mem_arena_t *arena;
+	size_t i, size;
+
+	arena = mem_arena_create();
+	TEST_NOT_NULL(arena);
+
+	/* enough small objects to spill over into several chunks */
+	for (i = 0; i < 100000; ++i) {
+		size = 1 + i % 61;
+
+		ptr = mem_arena_allocate(arena, size);
+		TEST_NOT_NULL(ptr);
+		TEST_EQUAL_UI(((uintptr_t)ptr) % 8, 0);
+		TEST_ASSERT(ptr != last);
+		check_zero(ptr, size);
+
+		memset(ptr, 0xFF, size);
+		last = ptr;
+	}
+
+	/* larger than a chunk, gets a mapping of its own */
+	size = 3 * 1024 * 1024 + 5;
+	ptr = mem_arena_allocate(arena, size);
+	TEST_NOT_NULL(ptr);
+	check_zero(ptr, size);
+	memset(ptr, 0xFF, size);
+
+	/* must not clobber the oversized object */
+	last = mem_arena_allocate(arena, 16);
+	TEST_NOT_NULL(last);
+	check_zero(last, 16);
+	TEST_ASSERT(last + 16 <= ptr || last >= ptr + size);
+
+	mem_arena_destroy(arena);
+	return EXIT_SUCCESS;
+}
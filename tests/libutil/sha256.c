@@ -0,0 +1,101 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * sha256.c
+ *
+ * Copyright (C) 2019 David Oberhollenzer <goliath@infraroot.at>
+ */
+#include "config.h"
+
+#include "util.h"
+#include "../test.h"
+
+static const struct {
+	const char *plaintext;
+	size_t repeat;
+	const char *digest;
+} test_vectors[] = {
+	{
+		.plaintext = "",
+		.repeat = 1,
+		.digest = "e3b0c44298fc1c149afbf4c8996fb924"
+			"27ae41e4649b934ca495991b7852b855",
+	},
+	{
+		.plaintext = "abc",
+		.repeat = 1,
+		.digest = "ba7816bf8f01cfea414140de5dae2223"
+			"b00361a396177a9cb410ff61f20015ad",
+	},
+	{
+		.plaintext = "abcdbcdecdefdefgefghfghighijhijk"
+			"ijkljklmklmnlmnomnopnopq",
+		.repeat = 1,
+		.digest = "248d6a61d20638b8e5c026930c3e6039"
+			"a33ce45964ff2167f6ecedd419db06c1",
+	},
+	{
+		.plaintext = "a",
+		.repeat = 1000000,
+		.digest = "cdc76e5c9914fb9281a1c7e284d73e67"
+			"f1809a48a497200e046d39ccc7112cd0",
+	},
+};
+
+static void to_hex(const sqfs_u8 *digest, char *out)
+{
+	size_t i;
+
+	for (i = 0; i < SHA256_DIGEST_SIZE; ++i)
+		sprintf(out + 2 * i, "%02x", digest[i]);
+}
+
+int main(void)
+{
+	sqfs_u8 digest[SHA256_DIGEST_SIZE];
+	char hex[2 * SHA256_DIGEST_SIZE + 1];
+	char chunk[131];
+	sha256_ctx_t ctx;
+	size_t i, j;
+
+	for (i = 0; i < sizeof(test_vectors) / sizeof(test_vectors[0]); ++i) {
+		sha256_init(&ctx);
+
+		for (j = 0; j < test_vectors[i].repeat; ++j) {
+			sha256_update(&ctx, test_vectors[i].plaintext,
+				      strlen(test_vectors[i].plaintext));
+		}
+
+		sha256_final(&ctx, digest);
+		to_hex(digest, hex);
+
+		if (strcmp(hex, test_vectors[i].digest) != 0) {
+			fprintf(stderr, "Test case " PRI_SZ " failed!\n", i);
+			fprintf(stderr, "Expected result: %s\n",
+				test_vectors[i].digest);
+			fprintf(stderr, "Actual result:   %s\n", hex);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* feeding the same data in odd sized chunks must not matter */
+	memset(chunk, 'a', sizeof(chunk));
+	sha256_init(&ctx);
+
+	for (i = 0; i < 1000000; i += j) {
+		j = (i % sizeof(chunk)) + 1;
+		if (j > 1000000 - i)
+			j = 1000000 - i;
+
+		sha256_update(&ctx, chunk, j);
+	}
+
+	sha256_final(&ctx, digest);
+	to_hex(digest, hex);
+
+	if (strcmp(hex, test_vectors[3].digest) != 0) {
+		fprintf(stderr, "Chunked update failed!\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
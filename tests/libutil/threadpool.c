@@ -78,6 +78,35 @@ int main(void)
 
 	pool->destroy(pool);
 
+	/* the unordered pool must return every item exactly once */
+	pool = thread_pool_create_unordered(10, worker);
+	TEST_NOT_NULL(pool);
+
+	ptr = pool->dequeue(pool);
+	TEST_NULL(ptr);
+
+	for (i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+		values[i] = sizeof(values) / sizeof(values[0]) - i;
+
+		ret = pool->submit(pool, values + i);
+		TEST_EQUAL_I(ret, 0);
+	}
+
+	for (i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+		ptr = pool->dequeue(pool);
+
+		TEST_NOT_NULL(ptr);
+		TEST_ASSERT(ptr >= values &&
+			    ptr < values + sizeof(values) / sizeof(values[0]));
+		TEST_EQUAL_UI(*ptr, 42);
+		*ptr = 0;
+	}
+
+	ptr = pool->dequeue(pool);
+	TEST_NULL(ptr);
+
+	pool->destroy(pool);
+
 	/* redo the same test with the serial implementation */
 	pool = thread_pool_create_serial(worker);
 	TEST_NOT_NULL(pool);
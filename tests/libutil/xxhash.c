@@ -13,17 +13,20 @@ static const struct {
 	const char *plaintext;
 	size_t psize;
 	sqfs_u32 digest;
+	sqfs_u32 ref_digest;
 } test_vectors[] = {
 	{
 		.plaintext = "\x9e",
 		.psize = 1,
 		.digest = 0xB85CBEE5,
+		.ref_digest = 0xB85CBEE5,
 	},
 	{
 		.plaintext = "\x9e\xff\x1f\x4b\x5e\x53\x2f\xdd"
 		"\xb5\x54\x4d\x2a\x95\x2b",
 		.psize = 14,
 		.digest = 0xE5AA0AB4,
+		.ref_digest = 0xE5AA0AB4,
 	},
 	{
 		.plaintext = "\x9e\xff\x1f\x4b\x5e\x53\x2f\xdd"
@@ -41,13 +44,32 @@ static const struct {
 		"\x00\x00\x00\x00\x00",
 		.psize = 101,
 		.digest = 0x018F52BC,
+		.ref_digest = 0x1F1AA412,
 	},
 };
 
+static sqfs_u32 hash_incremental(const char *data, size_t size, size_t step)
+{
+	xxh32_ctx_t ctx;
+	size_t diff;
+
+	xxh32_init(&ctx);
+
+	while (size > 0) {
+		diff = size < step ? size : step;
+		xxh32_update(&ctx, data, diff);
+		data += diff;
+		size -= diff;
+	}
+
+	return xxh32_final(&ctx);
+}
+
 int main(void)
 {
+	static const size_t steps[] = { 1, 7, 16, 1000 };
 	sqfs_u32 hash;
-	size_t i;
+	size_t i, j;
 
 	for (i = 0; i < sizeof(test_vectors) / sizeof(test_vectors[0]); ++i) {
 		hash = xxh32(test_vectors[i].plaintext, test_vectors[i].psize);
@@ -59,7 +81,27 @@ int main(void)
 			fprintf(stderr, "Actual result:   0x%08X\n", hash);
 			return EXIT_FAILURE;
 		}
+
+		for (j = 0; j < sizeof(steps) / sizeof(steps[0]); ++j) {
+			hash = hash_incremental(test_vectors[i].plaintext,
+						test_vectors[i].psize,
+						steps[j]);
+
+			if (hash != test_vectors[i].ref_digest) {
+				fprintf(stderr, "Test case " PRI_SZ " failed "
+					"with step size " PRI_SZ "!\n",
+					i, steps[j]);
+				fprintf(stderr, "Expected result: 0x%08X\n",
+					test_vectors[i].ref_digest);
+				fprintf(stderr, "Actual result:   0x%08X\n",
+					hash);
+				return EXIT_FAILURE;
+			}
+		}
 	}
 
+	hash = hash_incremental("", 0, 1);
+	TEST_EQUAL_UI(hash, 0x02CC5D05);
+
 	return EXIT_SUCCESS;
 }